@@ -1,27 +1,103 @@
+#include "ProSelecta/Checkpoint.h"
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/EventLoop.h"
 #include "ProSelecta/FuncTypes.h"
+#include "ProSelecta/Histogram.h"
+#include "ProSelecta/Metrics.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/OutputSink.h"
 #include "ProSelecta/ProSelecta.h"
+#include "ProSelecta/Profiling.h"
+#include "ProSelecta/ResultStore.h"
+#include "ProSelecta/RunSummary.h"
+#include "ProSelecta/Skim.h"
+#include "ProSelecta/Timing.h"
+
+#ifdef ProSelecta_ROOT_IO
+#include "ProSelecta/ROOTIO.h"
+#endif
 
 #include "HepMC3/Reader.h"
 #include "HepMC3/ReaderFactory.h"
 
 #include "HepMC3/GenEvent.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <vector>
 
 std::vector<std::string> files_to_read;
-std::string filename;
+std::vector<std::string> input_args;
+std::vector<std::string> input_files;
+size_t nreaders = 4;
+size_t nprefetch = 256;
+std::optional<ps::AsciiReaderOptions> fast_ascii;
+bool use_index = false;
 
 std::string sel_symname;
 std::vector<std::string> projection_symnames;
 std::vector<std::string> wgt_symnames;
+std::vector<std::string> selection_symnames;
 
 std::vector<std::string> include_paths;
+std::vector<std::string> snippet_dirs;
 
 std::string ProSelecta_env_dir;
 
+bool print_timing = false;
+bool export_perf_symbols = false;
+bool export_gdb_symbols = false;
+
+std::string profile_path;
+
+double progress_interval = 0;
+std::string metrics_path;
+ps::LoopMetrics *loop_metrics = nullptr;
+
+size_t nforked_workers = 0;
+size_t nthreads = 0;
+size_t batch_size = 256;
+
+std::string output_path = "-";
+std::string output_format;
+bool write_rows = true;
+
+std::string skim_path;
+std::string skim_format;
+
+std::vector<std::string> hist_specs;
+std::string hist_output_path;
+
+ps::EventRange range;
+std::string summary_path;
+ps::RunSummary summary;
+
+std::string checkpoint_path;
+size_t checkpoint_step = 1 << 20;
+bool resume = false;
+
+std::string store_dir;
+
+ps::EventHooks hooks;
+std::vector<std::string> proj_funcnames;
+std::vector<std::string> wgt_funcnames;
+
 using namespace ps;
 
 void SayUsage(char const *argv[]) {
@@ -29,15 +105,176 @@ void SayUsage(char const *argv[]) {
       << "[USAGE]: " << argv[0] << "\n"
       << "\t-f <sourcefile.cxx>  : Source file to interpret. Can be passed "
          "more than once.\n"
-      << "\t-i <file.hepmc>      : Input HepMC3 file\n"
+      << "\t-i <file.hepmc>      : Input HepMC3 file, glob pattern, or "
+         "@<list> file with one\n"
+         "\t                       file or pattern per line. Can be passed "
+         "more than once,\n"
+         "\t                       files are read in order as one input.\n"
+         "\t                       ProSelectaCache event caches are read "
+         "directly.\n"
       << "\t-I <path>            : Path to include in the interpreter's search "
          "path\n"
+      << "\t-d <dir>             : Directory of snippets to load on demand, "
+         "the snippet\n"
+      << "\t                       defining a hook is only loaded when the "
+         "hook is\n"
+      << "\t                       requested. Can be passed more than once.\n"
+      << "  [Output]: \n"
+      << "\t-o <file>            : Output file [default: - for stdout]\n"
+      << "\t--format <fmt>       : Output format, one of csv, bin, or root. "
+         "Deduced from\n"
+      << "\t                       the extension of -o if not given: .root, "
+         ".bin, else csv.\n"
+      << "\t--no-rows            : Do not write per-event rows, e.g. when "
+         "only filling\n"
+      << "\t                       histograms.\n"
+      << "  [Histograms]: \n"
+      << "\t--Hist <spec>        : Fill a histogram in the event loop, can be "
+         "passed more\n"
+      << "\t                       than once. <spec> is a space-separated "
+         "list of a name\n"
+      << "\t                       followed by:\n"
+      << "\t                         axis=<proj>:<nbins>:<low>:<high> or\n"
+      << "\t                         axis=<proj>:<edge0>,<edge1>,...\n"
+      << "\t                           one per dimension, in order.\n"
+      << "\t                         weight=<wgt> : optional, can be given "
+         "more than\n"
+      << "\t                           once, the fill weight is the product.\n"
+      << "\t                         select=<sel> : optional, defaults to "
+         "--Select.\n"
+      << "\t--hist-out <file>    : Histogram output file, ROOT if it ends in "
+         ".root,\n"
+      << "\t                       otherwise a compact binary format.\n"
+      << "  [Skims]: \n"
+      << "\t--skim <file>        : Write the events that pass --Select to "
+         "<file>, with their\n"
+      << "\t                       weights and run info, and their input "
+         "event numbers in\n"
+      << "\t                       the ProSelecta.source_event attribute.\n"
+      << "\t--skim-format <fmt>  : One of hepmc3, hepmc2, hepevt, or pscache "
+         "for an event\n"
+      << "\t                       cache. Deduced from the extension of "
+         "--skim if not given,\n"
+      << "\t                       defaults to hepmc3.\n"
+      << "  [Event range]: \n"
+      << "\t--skip <N>           : Skip the first N events of the input.\n"
+      << "\t--max-events <N>     : Process at most N events after those "
+         "skipped.\n"
+      << "\t--shard <k>/<N>      : Process only shard k of N, 0 <= k < N. "
+         "The range is\n"
+      << "\t                       split into chunks of --shard-chunk "
+         "events, and shard\n"
+      << "\t                       k processes chunks k, k+N, k+2N, ... "
+         "Combine the\n"
+      << "\t                       outputs of every shard with "
+         "ProSelectaMerge.\n"
+      << "\t--shard-chunk <N>    : Events per shard chunk, a multiple of "
+         "--batch-size\n"
+      << "\t                       [default: 65536].\n"
+      << "\t--summary <file>     : Write a text summary of the events read "
+         "and selected,\n"
+      << "\t                       and the entries in each histogram.\n"
+      << "  [Checkpoints]: \n"
+      << "\t--checkpoint <file>  : Write the state of the run to <file> "
+         "after every\n"
+      << "\t                       --checkpoint-step events, so that an "
+         "interrupted run\n"
+      << "\t                       can be resumed. Rows must be written to a "
+         "csv or bin file.\n"
+      << "\t--checkpoint-step <N>: Events between checkpoints, a multiple of "
+         "--batch-size\n"
+      << "\t                       [default: 1048576].\n"
+      << "\t--resume             : Continue from the --checkpoint file if it "
+         "exists, or start\n"
+      << "\t                       from the beginning if not. The outputs are "
+         "identical to\n"
+      << "\t                       those of an uninterrupted run.\n"
+      << "  [Result store]: \n"
+      << "\t--store <dir>        : Keep the results of every hook on every "
+         "input file in\n"
+      << "\t                       <dir>, keyed by the content of the input "
+         "and of the -f\n"
+      << "\t                       and -d sources, and only read the inputs "
+         "that lack a\n"
+      << "\t                       result. Rows are identical to those of a "
+         "run without it.\n"
       << "  [Hooks]: \n"
       << "\t--Select <symname>   : Symbol to use for selecting events\n"
       << "\t--Project <symname>  : Symbol to use for projection, can be passed "
          "more than once.\n"
       << "\t--Weight <symname>   : Symbol to use for weights, can be passed "
          "more than once.\n"
+      << "\t--Selections <syms>  : Selection symbols to evaluate on every "
+         "event into a\n"
+      << "\t                       bitmask, written as one selmask column. "
+         "Bit i is set if\n"
+      << "\t                       the i-th selection passes. Takes any number "
+         "of symbols,\n"
+      << "\t                       and can be passed more than once. Pass "
+         "counts are\n"
+      << "\t                       written to --summary.\n"
+      << "  [Parallelism]: \n"
+      << "\t--fork <N>           : JIT all hooks once, then fork N worker "
+         "processes\n"
+      << "\t                       that each evaluate a contiguous Nth of the "
+         "events.\n"
+      << "\t                       Output is identical to the serial mode. "
+         "Inputs must\n"
+      << "\t                       be uncompressed HepMC3 ASCII files or "
+         "event caches,\n"
+      << "\t                       and rows must be written, from --Select or "
+         "--Selections.\n"
+      << "\t--threads <N>        : Read events on one thread and evaluate "
+         "batches of\n"
+      << "\t                       events on N worker threads. Output is "
+         "identical to\n"
+      << "\t                       the serial mode.\n"
+      << "\t--batch-size <N>     : Number of events per batch in --threads "
+         "mode [default: 256]\n"
+      << "\t--readers <N>        : Number of input files to open and decode "
+         "concurrently\n"
+      << "\t                       [default: 4].\n"
+      << "\t--prefetch <N>       : Number of events to decode ahead of the "
+         "event loop from\n"
+      << "\t                       each file being read [default: 256].\n"
+      << "\t--fast-ascii         : Read uncompressed HepMC3 ASCII inputs with "
+         "ProSelecta's\n"
+      << "\t                       memory-mapped parser rather than "
+         "HepMC3::ReaderAscii.\n"
+      << "\t--skip-positions     : Implies --fast-ascii, leave event and "
+         "vertex positions\n"
+      << "\t                       at 0.\n"
+      << "\t--skip-attributes    : Implies --fast-ascii, do not read event, "
+         "particle, or\n"
+      << "\t                       vertex attributes.\n"
+      << "\t--index              : Index uncompressed HepMC3 ASCII inputs, "
+         "in <file>.psidx\n"
+      << "\t                       sidecars, and seek past the events "
+         "skipped by --skip,\n"
+      << "\t                       --shard, and --resume, rather than "
+         "reading them.\n"
+      << "  [Diagnostics]: \n"
+      << "\t--timing             : Print interpreter start up, snippet and "
+         "symbol timing to stderr.\n"
+      << "\t--perf-map           : Export JIT'd snippet symbols for perf "
+         "(CLING_PROFILE).\n"
+      << "\t--gdb-jit            : Register JIT'd snippet code with the GDB "
+         "JIT interface\n"
+      << "\t                       (CLING_DEBUG).\n"
+      << "\t--profile <file>     : Time every call of every hook and write "
+         "the call counts,\n"
+      << "\t                       latency percentiles, and slowest events "
+         "of each as JSON.\n"
+      << "\t                       With --fork, worker k writes "
+         "<file>.<k>.\n"
+      << "\t--progress <s>       : Print the events read and selected, the "
+         "event rate,\n"
+      << "\t                       bytes read, and an ETA to stderr every "
+         "<s> seconds.\n"
+      << "\t--metrics-file <file>: Rewrite <file> with the same metrics in "
+         "the Prometheus\n"
+      << "\t                       text format every --progress interval, or "
+         "every 10 s.\n"
       << std::endl;
 }
 
@@ -47,6 +284,26 @@ void handleOpts(int argc, char const *argv[]) {
     if (std::string(argv[opt]) == "-?" || std::string(argv[opt]) == "--help") {
       SayUsage(argv);
       exit(0);
+    } else if (std::string(argv[opt]) == "--timing") {
+      print_timing = true;
+    } else if (std::string(argv[opt]) == "--perf-map") {
+      export_perf_symbols = true;
+    } else if (std::string(argv[opt]) == "--gdb-jit") {
+      export_gdb_symbols = true;
+    } else if (std::string(argv[opt]) == "--no-rows") {
+      write_rows = false;
+    } else if (std::string(argv[opt]) == "--resume") {
+      resume = true;
+    } else if (std::string(argv[opt]) == "--fast-ascii") {
+      fast_ascii = fast_ascii.value_or(AsciiReaderOptions());
+    } else if (std::string(argv[opt]) == "--skip-positions") {
+      fast_ascii = fast_ascii.value_or(AsciiReaderOptions());
+      fast_ascii->skip_positions = true;
+    } else if (std::string(argv[opt]) == "--skip-attributes") {
+      fast_ascii = fast_ascii.value_or(AsciiReaderOptions());
+      fast_ascii->skip_attributes = true;
+    } else if (std::string(argv[opt]) == "--index") {
+      use_index = true;
     } else if ((opt + 1) < argc) {
       if (std::string(argv[opt]) == "-f") {
         files_to_read.push_back(argv[++opt]);
@@ -56,14 +313,72 @@ void handleOpts(int argc, char const *argv[]) {
         while (((opt + 1) < argc) && (argv[opt + 1][0] != '-')) {
           projection_symnames.push_back(argv[++opt]);
         }
+      } else if (std::string(argv[opt]) == "--Selections") {
+        while (((opt + 1) < argc) && (argv[opt + 1][0] != '-')) {
+          selection_symnames.push_back(argv[++opt]);
+        }
       } else if (std::string(argv[opt]) == "--Weight") {
         wgt_symnames.push_back(argv[++opt]);
       } else if (std::string(argv[opt]) == "-i") {
-        filename = argv[++opt];
+        input_args.push_back(argv[++opt]);
       } else if (std::string(argv[opt]) == "-I") {
         include_paths.push_back(argv[++opt]);
+      } else if (std::string(argv[opt]) == "-d") {
+        snippet_dirs.push_back(argv[++opt]);
+      } else if (std::string(argv[opt]) == "-o") {
+        output_path = argv[++opt];
+      } else if (std::string(argv[opt]) == "--format") {
+        output_format = argv[++opt];
+      } else if (std::string(argv[opt]) == "--Hist") {
+        hist_specs.push_back(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--skim") {
+        skim_path = argv[++opt];
+      } else if (std::string(argv[opt]) == "--skim-format") {
+        skim_format = argv[++opt];
+      } else if (std::string(argv[opt]) == "--hist-out") {
+        hist_output_path = argv[++opt];
       } else if (std::string(argv[opt]) == "--env") {
         ProSelecta_env_dir = argv[++opt];
+      } else if (std::string(argv[opt]) == "--fork") {
+        nforked_workers = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--threads") {
+        nthreads = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--batch-size") {
+        batch_size = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--readers") {
+        nreaders = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--prefetch") {
+        nprefetch = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--skip") {
+        range.skip = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--max-events") {
+        range.max_events = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--shard") {
+        std::string shard = argv[++opt];
+        size_t slash = shard.find('/');
+        if (slash == std::string::npos) {
+          std::cout << "[ERROR]: Invalid --shard " << shard
+                    << ", expected <k>/<N>." << std::endl;
+          exit(1);
+        }
+        range.shard = std::stoul(shard.substr(0, slash));
+        range.nshards = std::stoul(shard.substr(slash + 1));
+      } else if (std::string(argv[opt]) == "--shard-chunk") {
+        range.chunk_size = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--summary") {
+        summary_path = argv[++opt];
+      } else if (std::string(argv[opt]) == "--checkpoint") {
+        checkpoint_path = argv[++opt];
+      } else if (std::string(argv[opt]) == "--checkpoint-step") {
+        checkpoint_step = std::stoul(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--store") {
+        store_dir = argv[++opt];
+      } else if (std::string(argv[opt]) == "--profile") {
+        profile_path = argv[++opt];
+      } else if (std::string(argv[opt]) == "--progress") {
+        progress_interval = std::stod(argv[++opt]);
+      } else if (std::string(argv[opt]) == "--metrics-file") {
+        metrics_path = argv[++opt];
       }
     } else {
       std::cout << "[ERROR]: Unknown option: " << argv[opt] << std::endl;
@@ -74,14 +389,691 @@ void handleOpts(int argc, char const *argv[]) {
   }
 }
 
+// Rows are handed to the sink in blocks of this many events
+size_t const sink_block_size = 1024;
+
+// Parses a --Hist specification, see SayUsage, and resolves its hooks
+HistogramSpec ParseHistSpec(std::string const &spec_str) {
+  auto fail = [&](std::string const &msg) {
+    std::cout << "[ERROR]: Invalid --Hist \"" << spec_str << "\": " << msg
+              << std::endl;
+    exit(1);
+  };
+
+  HistogramSpec spec;
+  std::stringstream ss(spec_str);
+  if (!(ss >> spec.name) || (spec.name.find('=') != std::string::npos)) {
+    fail("expected a histogram name first.");
+  }
+
+  std::string tok;
+  while (ss >> tok) {
+    size_t eq = tok.find('=');
+    std::string key = tok.substr(0, eq);
+    std::string val = (eq == std::string::npos) ? "" : tok.substr(eq + 1);
+
+    if (key == "axis") {
+      size_t colon = val.find(':');
+      if (colon == std::string::npos) {
+        fail("expected axis=<proj>:<binning>, got " + tok);
+      }
+      auto proj = ProSelecta::Get().get_projection_func(val.substr(0, colon));
+      if (!proj) {
+        fail("Cling didn't find a projection function named: " +
+             val.substr(0, colon));
+      }
+
+      std::string binning = val.substr(colon + 1);
+      try {
+        if (binning.find(',') != std::string::npos) {
+          HistogramAxis axis;
+          std::stringstream bss(binning);
+          for (std::string edge; std::getline(bss, edge, ',');) {
+            axis.edges.push_back(std::stod(edge));
+          }
+          spec.axes.push_back(axis);
+        } else {
+          std::stringstream bss(binning);
+          std::string nbins, low, high;
+          if (!std::getline(bss, nbins, ':') || !std::getline(bss, low, ':') ||
+              !std::getline(bss, high, ':')) {
+            fail("expected <nbins>:<low>:<high> or <edge0>,<edge1>,..., got " +
+                 binning);
+          }
+          spec.axes.push_back(HistogramAxis::uniform(
+              std::stoul(nbins), std::stod(low), std::stod(high)));
+        }
+      } catch (std::exception const &e) {
+        fail("failed to parse binning " + binning + ": " + e.what());
+      }
+      spec.projections.push_back(proj);
+    } else if (key == "weight") {
+      auto wgt = ProSelecta::Get().get_weight_func(val);
+      if (!wgt) {
+        fail("Cling didn't find a weight function named: " + val);
+      }
+      spec.weights.push_back(wgt);
+    } else if (key == "select") {
+      spec.select = ProSelecta::Get().get_select_func(val);
+      if (!spec.select) {
+        fail("Cling didn't find a selection function named: " + val);
+      }
+    } else {
+      fail("unknown key in " + tok);
+    }
+  }
+
+  if (spec.axes.empty()) {
+    fail("expected at least one axis.");
+  }
+  return spec;
+}
+
+// Every input file is read in order as a single input, see ps::MultiFileReader
+std::shared_ptr<MultiFileReader> OpenInputs() {
+  return std::make_shared<MultiFileReader>(input_files, nreaders, nprefetch,
+                                           fast_ascii, use_index, loop_metrics);
+}
+
+// Counts an evaluated event in the run summary
+void CountEvent(EventResult const &res) {
+  summary.events_read++;
+  summary.events_selected += res.pass;
+  for (size_t i = 0; i < summary.selection_passed.size(); ++i) {
+    summary.selection_passed[i].second += selmask_test(res.selmask, i);
+  }
+}
+
+// Counts an evaluated event in the progress metrics, in the modes that do not
+// use ps::EventLoop, which counts its own
+void CountMetrics(EventResult const &res) {
+  if (loop_metrics) {
+    loop_metrics->events_read.fetch_add(1, std::memory_order_relaxed);
+    loop_metrics->events_selected.fetch_add(res.pass,
+                                            std::memory_order_relaxed);
+  }
+}
+
+// Evaluates the hooks with --store, only reading the input files whose
+// results are not in the store. The results of each hook are keyed by the -f
+// file or -d snippet that defines it, and the headers that it includes from
+// the -I paths, see ps::HookSources.
+StoredRunResult RunStored(OutputSink *sink) {
+  ResultStore store(store_dir);
+  auto result = run_with_store(
+      store, HookSources(files_to_read, snippet_dirs, include_paths),
+      input_files,
+      {{hooks, sel_symname,
+        OutputColumns{proj_funcnames, wgt_funcnames, selection_symnames}}},
+      [&](std::vector<EventResult> const &block) {
+        for (auto const &res : block) {
+          CountEvent(res);
+          CountMetrics(res);
+        }
+        if (sink) {
+          sink->write(block);
+        }
+      },
+      std::max<size_t>(nthreads, 1), batch_size);
+  std::cerr << "[INFO]: Read " << result.events_read << " events from "
+            << result.files_read << " of " << input_files.size()
+            << " input files, the rest were in the result store." << std::endl;
+  return result;
+}
+
+// Processes the events of segment, e_it is the number of the next event that
+// the reader would read, and is updated as events are read
+int RunSerial(std::shared_ptr<HepMC3::Reader> rdr, OutputSink *sink,
+              SkimWriter *skim, HistogramSet *hists,
+              HistogramAccumulator *acc, EventRange const &segment,
+              size_t &e_it) {
+  std::vector<EventResult> rows;
+  std::vector<HistogramFill> fills;
+
+  while (!rdr->failed()) {
+    size_t next = segment.next(e_it);
+    if ((next >= segment.end()) || !skip_events(*rdr, next - e_it)) {
+      break;
+    }
+    e_it = next;
+
+    auto evt_in = next_event(*rdr);
+    if (!evt_in) {
+      break;
+    }
+
+    auto res = evaluate_event(hooks, e_it, *evt_in);
+    CountEvent(res);
+    CountMetrics(res);
+    if (hists) {
+      // applied in the same order as the fills of the threaded mode, so that
+      // both modes produce identical histograms
+      fills.clear();
+      hists->find_fills(*evt_in, res.pass, e_it, fills);
+      acc->add(fills);
+    }
+    if (skim && res.pass) {
+      skim->write(*evt_in, e_it);
+    }
+    if (sink) {
+      rows.push_back(std::move(res));
+      if (rows.size() == sink_block_size) {
+        sink->write(rows);
+        rows.clear();
+      }
+    }
+    recycle_event(*rdr, std::move(evt_in));
+    e_it++;
+  }
+  if (sink) {
+    sink->write(rows);
+  }
+  return 0;
+}
+
+// Forked workers send each evaluated event to the parent as a fixed-size
+// record: the event number, the pass flag, every projection and weight,
+// which are NaN for events that fail the selection, and the selection bitmask.
+size_t ForkedRecordSize() {
+  return sizeof(uint64_t) + sizeof(uint8_t) +
+         sizeof(double) * (hooks.projections.size() + hooks.weights.size()) +
+         sizeof(uint64_t) * selmask_words(hooks.selections.size());
+}
+
+void AppendForkedRecord(std::string &buf, EventResult const &res) {
+  uint64_t evtnum = res.evtnum;
+  uint8_t pass = res.pass;
+  buf.append(reinterpret_cast<char const *>(&evtnum), sizeof(evtnum));
+  buf.append(reinterpret_cast<char const *>(&pass), sizeof(pass));
+  for (size_t i = 0;
+       i < (hooks.projections.size() + hooks.weights.size()); ++i) {
+    double v = res.pass ? res.values[i]
+                        : std::numeric_limits<double>::quiet_NaN();
+    buf.append(reinterpret_cast<char const *>(&v), sizeof(v));
+  }
+  buf.append(reinterpret_cast<char const *>(res.selmask.data()),
+             sizeof(uint64_t) * res.selmask.size());
+}
+
+EventResult ReadForkedRecord(char const *rec) {
+  uint64_t evtnum;
+  uint8_t pass;
+  std::memcpy(&evtnum, rec, sizeof(evtnum));
+  std::memcpy(&pass, rec + sizeof(evtnum), sizeof(pass));
+  EventResult res{evtnum, bool(pass), {}, {}};
+  size_t const nvalues = hooks.projections.size() + hooks.weights.size();
+  char const *values = rec + sizeof(evtnum) + sizeof(pass);
+  if (res.pass) {
+    res.values.resize(nvalues);
+    std::memcpy(res.values.data(), values, sizeof(double) * nvalues);
+  }
+  res.selmask.resize(selmask_words(hooks.selections.size()));
+  std::memcpy(res.selmask.data(), values + sizeof(double) * nvalues,
+              sizeof(uint64_t) * res.selmask.size());
+  return res;
+}
+
+// Worker k of N evaluates the events [first, last) of the range, and writes
+// one record per event to its spool file, which the parent reads once the
+// worker has finished. Workers seek to their first event, with the event
+// indices or in the event caches, so no worker decodes the events of another.
+[[noreturn]] void
+RunForkedWorker(size_t worker, size_t first, size_t last, FILE *spool,
+                std::vector<std::shared_ptr<EventIndex const>> const &indices) {
+  int rtn = 0;
+  try {
+    MultiFileReader rdr(input_files, nreaders, nprefetch, fast_ascii, true);
+    for (size_t f = 0; f < indices.size(); ++f) {
+      if (indices[f]) {
+        rdr.set_index(f, indices[f]);
+      }
+    }
+
+    std::string buf;
+    auto flush_to_spool = [&]() {
+      if (fwrite(buf.data(), 1, buf.size(), spool) != buf.size()) {
+        throw std::runtime_error(std::strerror(errno));
+      }
+      buf.clear();
+    };
+
+    EventRange segment = range;
+    segment.max_events = last - range.skip;
+    // the number of the next event that the reader would read
+    size_t e_it = 0;
+    while (true) {
+      size_t next = segment.next(std::max(e_it, first));
+      if ((next >= segment.end()) || !skip_events(rdr, next - e_it)) {
+        break;
+      }
+      e_it = next;
+
+      auto evt_in = rdr.next_event();
+      if (!evt_in) {
+        break;
+      }
+
+      AppendForkedRecord(buf, evaluate_event(hooks, e_it, *evt_in));
+      rdr.recycle(std::move(evt_in));
+      if (buf.size() > (1 << 16)) {
+        flush_to_spool();
+      }
+      e_it++;
+    }
+    flush_to_spool();
+    if (fflush(spool)) {
+      throw std::runtime_error(std::strerror(errno));
+    }
+    // the hooks were called in this process, so each worker writes its own
+    if (profile_path.size()) {
+      ps::profiling::write_json(profile_path + "." + std::to_string(worker));
+    }
+  } catch (std::exception const &e) {
+    std::cerr << "[ERROR]: forked worker " << worker << " failed: " << e.what()
+              << std::endl;
+    rtn = 1;
+  }
+  // skip the atexit teardown of the interpreter state that this process
+  // shares copy-on-write with the parent
+  _exit(rtn);
+}
+
+// One reader thread and nthreads evaluation threads, see ps::EventLoop. Rows
+// are passed to the sink, selected events to the skim, and histogram fills
+// to acc, from this thread as evaluated batches come back in event
+// order. See RunSerial for segment and e_it.
+int RunThreaded(std::shared_ptr<HepMC3::Reader> rdr, size_t nthreads,
+                OutputSink *sink, SkimWriter *skim, HistogramSet *hists,
+                HistogramAccumulator *acc, EventRange const &segment,
+                size_t &e_it) {
+  EventLoop loop(hooks, nthreads, batch_size);
+  if (hists) {
+    loop.fill_histograms(*hists);
+  }
+  loop.set_metrics(loop_metrics);
+  loop.run(
+      *rdr,
+      [&](EventBatch const &batch) {
+        for (auto const &res : batch.results) {
+          CountEvent(res);
+        }
+        if (sink) {
+          sink->write(batch.results);
+        }
+        if (skim) {
+          skim->write(batch);
+        }
+        if (hists) {
+          acc->add(batch.fills);
+        }
+      },
+      segment, &e_it);
+  return 0;
+}
+
+// The summary of the run so far. rdr is null in the forked mode, which does
+// not track the statistics of each file.
+RunSummary SummarySoFar(MultiFileReader const *rdr) {
+  RunSummary so_far = summary;
+  so_far.inputs = rdr ? rdr->get_file_stats()
+                      : std::vector<InputFileStats>(input_files.size());
+  for (size_t i = 0; i < input_files.size(); ++i) {
+    so_far.inputs[i].path = input_files[i];
+  }
+  so_far.range = range;
+  so_far.batch_size = batch_size;
+  return so_far;
+}
+
+void WriteCheckpoint(MultiFileReader const &rdr, OutputSink *sink,
+                     HistogramAccumulator *acc, size_t e_it) {
+  Checkpoint ckpt;
+  ckpt.next_evtnum = e_it;
+  ckpt.input = rdr.position();
+  ckpt.summary = SummarySoFar(&rdr);
+  ckpt.select = sel_symname;
+  ckpt.columns =
+      OutputColumns{proj_funcnames, wgt_funcnames, selection_symnames};
+  if (sink) {
+    ckpt.output_path = output_path;
+    // the rows must be on disk before the checkpoint that refers to them
+    ckpt.output_size = sink->checkpoint();
+  }
+  if (acc) {
+    ckpt.histograms = acc->get_state();
+  }
+  ckpt.write(checkpoint_path);
+}
+
+// Describes how the run that wrote ckpt differs from this one, or returns an
+// empty string if this run can resume from it
+std::string CheckpointMismatch(Checkpoint const &ckpt, bool rows,
+                               OutputColumns const &columns,
+                               HistogramSet const *hists) {
+  auto const &was = ckpt.summary;
+  if (!std::equal(was.inputs.begin(), was.inputs.end(), input_files.begin(),
+                  input_files.end(),
+                  [](InputFileStats const &in, std::string const &path) {
+                    return in.path == path;
+                  })) {
+    return "input files";
+  }
+  if ((was.range.skip != range.skip) ||
+      (was.range.max_events != range.max_events) ||
+      (was.range.shard != range.shard) ||
+      (was.range.nshards != range.nshards) ||
+      (was.range.chunk_size != range.chunk_size)) {
+    return "event ranges";
+  }
+  if (was.batch_size != batch_size) {
+    return "batch sizes";
+  }
+  if (ckpt.select != sel_symname) {
+    return "--Select functions";
+  }
+  if (ckpt.columns.selections != selection_symnames) {
+    return "--Selections";
+  }
+  if (rows != bool(ckpt.output_size) ||
+      (rows && ((ckpt.output_path != output_path) ||
+                (ckpt.columns.projections != columns.projections) ||
+                (ckpt.columns.weights != columns.weights)))) {
+    return "row outputs";
+  }
+  if (bool(hists) != bool(ckpt.histograms)) {
+    return "histograms";
+  }
+  if (hists) {
+    auto const &was_hists = ckpt.histograms->total;
+    if (!std::equal(was_hists.begin(), was_hists.end(),
+                    hists->histograms.begin(), hists->histograms.end(),
+                    [](Histogram const &a, Histogram const &b) {
+                      return (a.name == b.name) && (a.axes == b.axes);
+                    })) {
+      return "histograms";
+    }
+  }
+  return "";
+}
+
+// Runs the serial or threaded mode from event e_it. With --checkpoint, the
+// range is processed in segments that end at multiples of checkpoint_step,
+// and a checkpoint is written after each. As checkpoint_step is a multiple of
+// batch_size, the segments do not change which events are batched together,
+// and so do not change the histograms.
+int RunSegments(std::shared_ptr<MultiFileReader> rdr, OutputSink *sink,
+                SkimWriter *skim, HistogramSet *hists,
+                HistogramAccumulator *acc, size_t e_it) {
+  bool const threaded = (nthreads > 1) && (sink || skim || hists);
+  while (true) {
+    EventRange segment = range;
+    if (checkpoint_path.size()) {
+      size_t first = range.next(e_it);
+      if (first >= range.end()) {
+        return 0;
+      }
+      size_t end = std::min(range.end(),
+                            ((first / checkpoint_step) + 1) * checkpoint_step);
+      segment.max_events = end - range.skip;
+    }
+
+    int rtn = threaded ? RunThreaded(rdr, nthreads, sink, skim, hists, acc,
+                                     segment, e_it)
+                       : RunSerial(rdr, sink, skim, hists, acc, segment, e_it);
+    if (rtn || !checkpoint_path.size() || rdr->failed() ||
+        (range.next(e_it) >= range.end())) {
+      return rtn;
+    }
+    WriteCheckpoint(*rdr, sink, acc, e_it);
+  }
+}
+
+// An unnamed temporary file in $TMPDIR, or /tmp, for the records of a worker
+FILE *OpenSpool() {
+  char const *dir = std::getenv("TMPDIR");
+  std::string path =
+      std::string((dir && *dir) ? dir : "/tmp") + "/ProSelectaCPP.XXXXXX";
+  int fd = mkstemp(path.data());
+  if (fd < 0) {
+    throw std::runtime_error("Failed to create a spool file for a forked "
+                             "worker in " +
+                             path + ": " + std::strerror(errno));
+  }
+  unlink(path.c_str());
+  return fdopen(fd, "w+");
+}
+
+// The events of every input, and the index of each HepMC3 ASCII file, so that
+// the range can be split between the workers before they are forked. Throws
+// std::runtime_error for inputs that cannot be seeked in.
+size_t CountForkedEvents(
+    std::vector<std::shared_ptr<EventIndex const>> &indices) {
+  size_t nevents = 0;
+  for (auto const &path : input_files) {
+    if (is_event_cache(path)) {
+      nevents += EventCacheReader(path).size();
+      indices.push_back(nullptr);
+      continue;
+    }
+    if (!is_hepmc3_ascii(path)) {
+      throw std::runtime_error(
+          "--fork can only split uncompressed HepMC3 ASCII files and event "
+          "caches between workers, use --threads for " +
+          path);
+    }
+    // sidecars are only written with --index
+    auto index = load_event_index(path);
+    if (!index) {
+      index = build_event_index(path);
+      if (use_index && !save_event_index(*index)) {
+        std::cout << "[WARN]: Failed to write " << event_index_path(path)
+                  << std::endl;
+      }
+    }
+    nevents += index->nevents();
+    indices.push_back(std::make_shared<EventIndex const>(std::move(*index)));
+  }
+  return nevents;
+}
+
+// The workers of the forked mode, and the spool file of each, from
+// StartForked until CollectForked has read them. Workers that are never
+// collected, because the parent failed first, are killed.
+struct ForkedWorkers {
+  std::vector<pid_t> pids;
+  std::vector<FILE *> spools;
+
+  ForkedWorkers() = default;
+  ForkedWorkers(ForkedWorkers const &) = delete;
+  ForkedWorkers &operator=(ForkedWorkers const &) = delete;
+  ~ForkedWorkers() {
+    for (pid_t pid : pids) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    for (FILE *spool : spools) {
+      fclose(spool);
+    }
+  }
+};
+
+// Forks the workers, each of which evaluates a contiguous part of the range.
+// Must be called before any other thread is started, as only the calling
+// thread is copied into the workers: the input decoders, the AsyncSink writer
+// and the MetricsReporter are all started afterwards, in the parent.
+int StartForked(size_t nworkers, ForkedWorkers &workers) {
+  std::vector<std::shared_ptr<EventIndex const>> indices;
+  size_t const nevents = CountForkedEvents(indices);
+  // the range is split into one contiguous part per worker
+  size_t const last = std::min(range.end(), nevents);
+  size_t const first = std::min(range.skip, last);
+
+  // anything still buffered would otherwise be written once per worker
+  std::cout << std::flush;
+  std::cerr << std::flush;
+
+  for (size_t worker = 0; worker < nworkers; ++worker) {
+    workers.spools.push_back(OpenSpool());
+    auto [begin, end] = event_part(last - first, worker, nworkers);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      std::cout << "[ERROR]: Failed to fork worker: " << std::strerror(errno)
+                << std::endl;
+      return 1;
+    }
+
+    if (pid == 0) {
+      for (size_t other = 0; other < worker; ++other) {
+        fclose(workers.spools[other]);
+      }
+      RunForkedWorker(worker, first + begin, first + end,
+                      workers.spools.back(), indices);
+    }
+    workers.pids.push_back(pid);
+  }
+  return 0;
+}
+
+// Waits for each of the workers, and passes their records to the sink
+int CollectForked(ForkedWorkers &workers, OutputSink &sink) {
+  // the workers' parts are in event order, so their records are written
+  // in worker order
+  int rtn = 0;
+  std::vector<char> rec(ForkedRecordSize());
+  std::vector<EventResult> rows;
+  for (size_t worker = 0; worker < workers.pids.size(); ++worker) {
+    int status = 0;
+    waitpid(workers.pids[worker], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      std::cout << "[ERROR]: forked worker " << worker << " exited abnormally."
+                << std::endl;
+      rtn = 1;
+    }
+    // rows after those of a failed worker would leave a gap in the output
+    FILE *spool = workers.spools[worker];
+    rewind(spool);
+    while (!rtn && (fread(rec.data(), rec.size(), 1, spool) == 1)) {
+      rows.push_back(ReadForkedRecord(rec.data()));
+      CountEvent(rows.back());
+      CountMetrics(rows.back());
+      if (rows.size() == sink_block_size) {
+        sink.write(rows);
+        rows.clear();
+      }
+    }
+  }
+  workers.pids.clear();
+  sink.write(rows);
+  return rtn;
+}
+
 int main(int argc, char const *argv[]) {
+#ifdef ProSelecta_ROOT_IO
+  ps::enable_root_io();
+#endif
 
   handleOpts(argc, argv);
 
+  try {
+    range.validate(batch_size);
+    input_files = expand_input_paths(input_args);
+  } catch (std::runtime_error const &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+  if (input_files.empty()) {
+    std::cout << "[ERROR]: No input files, pass at least one -i." << std::endl;
+    return 1;
+  }
+  if (resume && !checkpoint_path.size()) {
+    std::cout << "[ERROR]: --resume requires a --checkpoint file." << std::endl;
+    return 1;
+  }
+  if (checkpoint_path.size()) {
+    if (!checkpoint_step || (checkpoint_step % batch_size)) {
+      std::cout << "[ERROR]: --checkpoint-step " << checkpoint_step
+                << " must be a multiple of --batch-size " << batch_size
+                << std::endl;
+      return 1;
+    }
+    if (nforked_workers > 1) {
+      std::cout << "[ERROR]: --checkpoint is not supported with --fork, use "
+                   "--threads instead."
+                << std::endl;
+      return 1;
+    }
+  }
+  if (skim_path.size()) {
+    if (!sel_symname.size()) {
+      std::cout << "[ERROR]: --skim requires a --Select function."
+                << std::endl;
+      return 1;
+    }
+    if (nforked_workers > 1) {
+      std::cout << "[ERROR]: --skim is not supported with --fork, use "
+                   "--threads instead."
+                << std::endl;
+      return 1;
+    }
+    if (checkpoint_path.size()) {
+      std::cout << "[ERROR]: --skim is not supported with --checkpoint."
+                << std::endl;
+      return 1;
+    }
+  }
+
+  if (hist_specs.size() && (nforked_workers > 1)) {
+    std::cout << "[ERROR]: --Hist is not supported with --fork, use "
+                 "--threads instead."
+              << std::endl;
+    return 1;
+  }
+
+  // the workers only write rows, there is nothing else for them to share
+  if ((nforked_workers > 1) &&
+      (!(sel_symname.size() || selection_symnames.size()) || !write_rows)) {
+    std::cout << "[ERROR]: --fork requires row output, from --Select or "
+                 "--Selections without --no-rows, use --threads instead."
+              << std::endl;
+    return 1;
+  }
+
+  if (store_dir.size()) {
+    char const *unsupported =
+        (range.skip || (range.max_events != EventRange().max_events) ||
+         (range.nshards > 1))
+            ? "--skip, --max-events, or --shard"
+        : hist_specs.size()      ? "--Hist"
+        : skim_path.size()       ? "--skim"
+        : (nforked_workers > 1)  ? "--fork"
+        : checkpoint_path.size() ? "--checkpoint"
+                                 : nullptr;
+    if (unsupported) {
+      std::cout << "[ERROR]: --store is not supported with " << unsupported
+                << "." << std::endl;
+      return 1;
+    }
+  }
+
+  if (export_perf_symbols || export_gdb_symbols) {
+    ProSelecta::Get().enable_jit_symbol_export(export_perf_symbols,
+                                               export_gdb_symbols);
+  }
+
+  // only hooks fetched from now on are profiled
+  if (profile_path.size()) {
+    ps::profiling::enable();
+  }
+
   for (auto const &p : include_paths) {
     ProSelecta::Get().add_include_path(p);
   }
 
+  for (auto const &d : snippet_dirs) {
+    ProSelecta::Get().add_snippet_directory(d);
+  }
+
   for (auto const &file_to_read : files_to_read) {
     if (!ProSelecta::Get().load_file(file_to_read.c_str())) {
       std::cout << "[ERROR]: Cling failed interpreting: " << argv[1]
@@ -90,23 +1082,32 @@ int main(int argc, char const *argv[]) {
     }
   }
 
-  ps::SelectFunc sel_func;
   if (sel_symname.length()) {
-    sel_func = ProSelecta::Get().get_select_func(sel_symname);
+    hooks.select = ProSelecta::Get().get_select_func(sel_symname);
 
-    if (!sel_func) {
+    if (!hooks.select) {
       std::cout << "[ERROR]: Cling didn't find a function named: "
                 << sel_symname << " in the input file." << std::endl;
       return 1;
     }
   }
 
-  std::vector<ps::ProjectionFunc> proj_funcs;
-  std::vector<std::string> proj_funcnames;
+  for (auto &sel_sym_name : selection_symnames) {
+    auto sel_func = ProSelecta::Get().get_select_func(sel_sym_name);
+    // unlike projections, a missing selection would shift every later bit
+    if (!sel_func) {
+      std::cout << "[ERROR]: Cling didn't find a selection function named: "
+                << sel_sym_name << " in the input file." << std::endl;
+      return 1;
+    }
+    hooks.selections.push_back(sel_func);
+    summary.selection_passed.emplace_back(sel_sym_name, 0);
+  }
+
   for (auto &proj_sym_name : projection_symnames) {
     auto proj_func = ProSelecta::Get().get_projection_func(proj_sym_name);
     if (proj_func) {
-      proj_funcs.push_back(proj_func);
+      hooks.projections.push_back(proj_func);
       proj_funcnames.push_back(proj_sym_name);
     } else {
       std::cout << "[WARN]: Cling didn't find a projection function named: "
@@ -115,12 +1116,10 @@ int main(int argc, char const *argv[]) {
     }
   }
 
-  std::vector<ps::WeightFunc> wgt_funcs;
-  std::vector<std::string> wgt_funcnames;
   for (auto &wgt_sym_name : wgt_symnames) {
     auto wgt_func = ProSelecta::Get().get_weight_func(wgt_sym_name);
     if (wgt_func) {
-      wgt_funcs.push_back(wgt_func);
+      hooks.weights.push_back(wgt_func);
       wgt_funcnames.push_back(wgt_sym_name);
     } else {
       std::cout << "[WARN]: Cling didn't find a weight function named: "
@@ -128,59 +1127,227 @@ int main(int argc, char const *argv[]) {
     }
   }
 
-  std::shared_ptr<HepMC3::Reader> rdr = HepMC3::deduce_reader(filename);
-  if (!rdr) {
-    std::cout << "[ERROR]: Failed to determine input type for HepMC3 file: "
-              << filename << std::endl;
-    return 1;
+  // only write rows if we're running a selection
+  bool const rows = (hooks.select || hooks.selections.size()) && write_rows;
+  OutputColumns const columns{proj_funcnames, wgt_funcnames,
+                              selection_symnames};
+
+  std::optional<ps::timing::PhaseTimer> loop_timer;
+  std::string const inputs_name =
+      (input_files.size() == 1)
+          ? input_files.front()
+          : (std::to_string(input_files.size()) + " files");
+  loop_timer.emplace("open_input", inputs_name);
+
+  // the workers are forked before this process starts any other thread, each
+  // opens its own reader
+  std::optional<ForkedWorkers> forked;
+  if (nforked_workers > 1) {
+    try {
+      forked.emplace();
+      if (StartForked(nforked_workers, *forked)) {
+        return 1;
+      }
+    } catch (std::runtime_error const &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  // the readers count the bytes that they read from when they are opened
+  LoopMetrics metrics;
+  bool const report_metrics = (progress_interval > 0) || metrics_path.size();
+  if (report_metrics) {
+    loop_metrics = &metrics;
   }
 
-  size_t e_it = 0;
+  // with --store, only the input files without stored results are opened
+  std::shared_ptr<MultiFileReader> rdr;
+  if (!store_dir.size() && !forked) {
+    rdr = OpenInputs();
+  }
 
-  if (sel_func) {
-    std::cout << "# evtnum, pass";
-    if (proj_funcs.size()) {
-      std::cout << ", ";
+  std::optional<HistogramSet> hists;
+  if (hist_specs.size()) {
+    if (!hist_output_path.size()) {
+      std::cout << "[ERROR]: --Hist requires an output file, pass --hist-out."
+                << std::endl;
+      return 1;
     }
-    for (size_t i = 0; i < proj_funcs.size(); ++i) {
-      std::cout << proj_funcnames[i]
-                << (((i + 1) == proj_funcs.size()) ? "" : ", ");
+    if ((range.nshards > 1) && (hist_output_path.size() > 5) &&
+        (hist_output_path.substr(hist_output_path.size() - 5) == ".root")) {
+      std::cout << "[ERROR]: Sharded runs write histogram chunks for "
+                   "ProSelectaMerge, --hist-out cannot be a ROOT file."
+                << std::endl;
+      return 1;
     }
-    std::cout << std::endl;
-  } // only print the header if we're running the selection
+    std::vector<HistogramSpec> specs;
+    for (auto const &spec_str : hist_specs) {
+      specs.push_back(ParseHistSpec(spec_str));
+    }
+    hists.emplace(specs);
+  }
 
-  while (!rdr->failed()) {
-    HepMC3::GenEvent evt_in;
-    rdr->read_event(evt_in);
-    if (rdr->failed()) {
-      break;
+  std::optional<Checkpoint> ckpt;
+  if (resume && std::filesystem::exists(checkpoint_path)) {
+    try {
+      ckpt = Checkpoint::read(checkpoint_path);
+    } catch (std::runtime_error const &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+      return 1;
+    }
+    std::string mismatch = CheckpointMismatch(*ckpt, rows, columns,
+                                              hists ? &hists.value() : nullptr);
+    if (mismatch.size()) {
+      std::cout << "[ERROR]: Cannot resume from " << checkpoint_path
+                << ", it was written by a run with different " << mismatch
+                << "." << std::endl;
+      return 1;
     }
+    std::cout << "[INFO]: Resuming from " << checkpoint_path << " at event "
+              << ckpt->next_evtnum << ", " << ckpt->summary.events_read
+              << " events already read." << std::endl;
+    summary.events_read = ckpt->summary.events_read;
+    summary.events_selected = ckpt->summary.events_selected;
+    summary.selection_passed = ckpt->summary.selection_passed;
+  }
 
-    if (sel_func) {
-      std::cout << e_it << ", ";
-      bool selected = sel_func(evt_in);
-      if (selected) {
-        std::cout << (selected ? "pass, " : "cut, ");
-        for (size_t i = 0; i < proj_funcs.size(); ++i) {
-          std::cout << proj_funcs[i](evt_in)
-                    << (((i + 1) == proj_funcs.size()) ? "" : ", ");
-        }
-        for (size_t i = 0; i < wgt_funcs.size(); ++i) {
-          std::cout << wgt_funcs[i](evt_in)
-                    << (((i + 1) == wgt_funcs.size()) ? "" : ", ");
-        }
-        std::cout << std::endl;
+  std::unique_ptr<OutputSink> sink;
+  if (rows) {
+    try {
+      sink = std::make_unique<AsyncSink>(
+          deduce_sink(output_path, output_format));
+      if (ckpt) {
+        sink->resume(columns, ckpt->output_size);
       } else {
-        std::cout << "cut, ";
-        for (size_t i = 0; i < proj_funcs.size(); ++i) {
-          std::cout << " - " << (((i + 1) == proj_funcs.size()) ? "" : ", ");
+        sink->open(columns);
+        // fail now, rather than at the first checkpoint, if the output
+        // cannot be checkpointed
+        if (checkpoint_path.size()) {
+          sink->checkpoint();
         }
-        for (size_t i = 0; i < wgt_funcs.size(); ++i) {
-          std::cout << " - " << (((i + 1) == wgt_funcs.size()) ? "" : ", ");
-        }
-        std::cout << std::endl;
       }
-    } // end selection section
-    e_it++;
+    } catch (std::runtime_error const &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+      return 1;
+    }
   }
-}
\ No newline at end of file
+
+  std::unique_ptr<SkimWriter> skim;
+  if (skim_path.size()) {
+    try {
+      skim = std::make_unique<SkimWriter>(
+          deduce_writer(skim_path, skim_format), input_files);
+    } catch (std::runtime_error const &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  // the reporter is stopped, with a last report, when it goes out of scope
+  std::optional<MetricsReporter> reporter;
+  if (report_metrics) {
+    // the ETA is estimated from the events left if the range is limited,
+    // otherwise from the input files left to read. Forked workers read the
+    // input in other processes, so their bytes are not counted here.
+    uint64_t events_total = 0;
+    uint64_t bytes_total = 0;
+    if ((range.max_events != EventRange().max_events) &&
+        (range.nshards == 1)) {
+      events_total = range.max_events - summary.events_read;
+    } else if (nforked_workers <= 1) {
+      for (auto const &path : input_files) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        bytes_total += ec ? 0 : size;
+      }
+    }
+    reporter.emplace(metrics, (progress_interval > 0) ? progress_interval : 10,
+                     progress_interval > 0, metrics_path, bytes_total,
+                     events_total);
+  }
+
+  loop_timer.emplace("event_loop", inputs_name);
+  int rtn = 0;
+  HistogramSet *hists_ptr = hists ? &hists.value() : nullptr;
+  // sharded runs keep the chunk partials so that the shards can be merged
+  std::optional<HistogramAccumulator> acc;
+  if (hists) {
+    acc.emplace(hists->histograms, range.chunk_size, range.nshards > 1);
+  }
+  HistogramAccumulator *acc_ptr = acc ? &acc.value() : nullptr;
+  std::optional<StoredRunResult> stored;
+  try {
+    size_t first_evtnum = 0;
+    if (ckpt) {
+      rdr->seek(ckpt->input, ckpt->summary.inputs);
+      if (acc) {
+        acc->restore(*ckpt->histograms);
+      }
+      first_evtnum = ckpt->next_evtnum;
+    }
+
+    if (forked) {
+      if (summary_path.size()) {
+        std::cout << "[WARN]: Per-file event counts and weight sums are not "
+                     "tracked with --fork, they will be 0 in the summary."
+                  << std::endl;
+      }
+      rtn = CollectForked(*forked, *sink);
+    } else if (store_dir.size()) {
+      stored = RunStored(sink.get());
+    } else {
+      rtn = RunSegments(rdr, sink.get(), skim.get(), hists_ptr, acc_ptr,
+                        first_evtnum);
+    }
+    if (sink) {
+      sink->close();
+    }
+    if (skim) {
+      skim->close();
+    }
+    if (reporter) {
+      reporter->stop();
+    }
+    if (acc) {
+      auto const &totals = acc->finish();
+      for (auto const &hist : totals) {
+        summary.histogram_entries.emplace_back(hist.name, hist.entries);
+      }
+      if (range.nshards > 1) {
+        write_histogram_chunks(hist_output_path,
+                               {hists->histograms, acc->get_chunks()});
+      } else {
+        write_histograms(hist_output_path, totals);
+      }
+    }
+    if (summary_path.size()) {
+      RunSummary so_far = SummarySoFar(rdr.get());
+      if (stored) {
+        so_far.inputs = stored->inputs;
+      }
+      so_far.write(summary_path);
+    }
+    // a later run with --resume starts again from the beginning
+    if (checkpoint_path.size() && !rtn) {
+      std::filesystem::remove(checkpoint_path);
+    }
+  } catch (std::runtime_error const &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+  loop_timer.reset();
+
+  if (print_timing) {
+    std::cerr << ps::timing::summary() << std::flush;
+  }
+  if (profile_path.size()) {
+    try {
+      ps::profiling::write_json(profile_path);
+    } catch (std::runtime_error const &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+      return 1;
+    }
+  }
+  return rtn;
+}
@@ -0,0 +1,92 @@
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/MultiFileReader.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+std::vector<std::string> input_args;
+std::string output_path;
+size_t block_events = 1024;
+bool compress = false;
+
+using namespace ps;
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[USAGE]: " << argv[0]
+      << " -i <file.hepmc> -o <file> [--compress] [--block-events <N>]\n"
+      << "\tConverts HepMC3 files into a single ProSelecta event cache, "
+         "which\n"
+      << "\tProSelectaCPP reads without parsing text. The run info of the "
+         "first\n"
+      << "\tevent is stored for the whole cache.\n"
+      << "\t-i <file.hepmc>      : Input HepMC3 file, glob pattern, or "
+         "@<list> file with one\n"
+         "\t                       file or pattern per line. Can be passed "
+         "more than once,\n"
+         "\t                       files are converted in order.\n"
+      << "\t-o <file>            : Output event cache\n"
+      << "\t--compress           : Compress blocks with zlib, if this build "
+         "supports it.\n"
+      << "\t--block-events <N>   : Number of events per block, defaults to "
+      << block_events << ".\n"
+      << std::endl;
+}
+
+void handleOpts(int argc, char const *argv[]) {
+  int opt = 1;
+  while (opt < argc) {
+    if (std::string(argv[opt]) == "-?" || std::string(argv[opt]) == "--help") {
+      SayUsage(argv);
+      exit(0);
+    } else if (((opt + 1) < argc) && (std::string(argv[opt]) == "-i")) {
+      input_args.push_back(argv[++opt]);
+    } else if (((opt + 1) < argc) && (std::string(argv[opt]) == "-o")) {
+      output_path = argv[++opt];
+    } else if (std::string(argv[opt]) == "--compress") {
+      compress = true;
+    } else if (((opt + 1) < argc) &&
+               (std::string(argv[opt]) == "--block-events")) {
+      block_events = std::stoul(argv[++opt]);
+    } else {
+      std::cout << "[ERROR]: Unknown option: " << argv[opt] << std::endl;
+      SayUsage(argv);
+      exit(1);
+    }
+    opt++;
+  }
+}
+
+int main(int argc, char const *argv[]) {
+
+  handleOpts(argc, argv);
+
+  if (!output_path.size() || input_args.empty() || !block_events) {
+    std::cout << "[ERROR]: Expected -o <file>, at least one -i, and a "
+                 "non-zero --block-events."
+              << std::endl;
+    SayUsage(argv);
+    return 1;
+  }
+
+  try {
+    MultiFileReader rdr(expand_input_paths(input_args));
+    EventCacheWriter wrtr(output_path, block_events,
+                          compress ? EventCache::kZlib : EventCache::kNone);
+    size_t nevents = 0;
+    while (auto evt = rdr.next_event()) {
+      wrtr.write_event(*evt);
+      rdr.recycle(std::move(evt));
+      nevents++;
+    }
+    wrtr.close();
+    std::cout << "[INFO]: Wrote " << nevents << " events to " << output_path
+              << std::endl;
+  } catch (std::runtime_error const &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/MultiFileReader.h"
+
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+std::vector<std::string> input_args;
+bool rebuild = false;
+size_t nparts = 0;
+
+using namespace ps;
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[USAGE]: " << argv[0]
+      << " -i <file.hepmc> [--rebuild] [--parts <N>]\n"
+      << "\tIndexes uncompressed HepMC3 ASCII files into <file>.psidx "
+         "sidecars, which\n"
+      << "\thold the byte offset of every event, and prints the number of "
+         "events and\n"
+      << "\tthe sum of their weights. Files with an up to date index are not "
+         "read.\n"
+      << "\t-i <file.hepmc>      : Input HepMC3 file, glob pattern, or "
+         "@<list> file with one\n"
+         "\t                       file or pattern per line. Can be passed "
+         "more than once.\n"
+      << "\t--rebuild            : Index every file again, even if its index "
+         "is up to date.\n"
+      << "\t--parts <N>          : Print the --skip and --max-events options "
+         "that split the\n"
+      << "\t                       events of the files, read as a single "
+         "input, into N\n"
+      << "\t                       parts for ProSelectaCPP.\n"
+      << std::endl;
+}
+
+void handleOpts(int argc, char const *argv[]) {
+  int opt = 1;
+  while (opt < argc) {
+    if (std::string(argv[opt]) == "-?" || std::string(argv[opt]) == "--help") {
+      SayUsage(argv);
+      exit(0);
+    } else if (((opt + 1) < argc) && (std::string(argv[opt]) == "-i")) {
+      input_args.push_back(argv[++opt]);
+    } else if (std::string(argv[opt]) == "--rebuild") {
+      rebuild = true;
+    } else if (((opt + 1) < argc) && (std::string(argv[opt]) == "--parts")) {
+      nparts = std::stoul(argv[++opt]);
+    } else {
+      std::cout << "[ERROR]: Unknown option: " << argv[opt] << std::endl;
+      SayUsage(argv);
+      exit(1);
+    }
+    opt++;
+  }
+}
+
+int main(int argc, char const *argv[]) {
+
+  handleOpts(argc, argv);
+
+  if (input_args.empty()) {
+    std::cout << "[ERROR]: Expected at least one -i." << std::endl;
+    SayUsage(argv);
+    return 1;
+  }
+
+  try {
+    InputFileStats total{"total"};
+    for (auto const &path : expand_input_paths(input_args)) {
+      if (!is_hepmc3_ascii(path)) {
+        std::cout << "[ERROR]: " << path
+                  << " is not an uncompressed HepMC3 ASCII file." << std::endl;
+        return 1;
+      }
+      std::optional<EventIndex> index;
+      if (!rebuild) {
+        index = load_event_index(path);
+      }
+      if (!index) {
+        index = build_event_index(path);
+        if (!save_event_index(*index)) {
+          std::cout << "[WARN]: Failed to write " << event_index_path(path)
+                    << std::endl;
+        }
+      }
+      std::cout << path << ": " << index->nevents()
+                << " events, sumw: " << index->sumw << std::endl;
+      total.nevents += index->nevents();
+      total.sumw += index->sumw;
+      total.sumw2 += index->sumw2;
+    }
+    std::cout << "total: " << total.nevents << " events, sumw: " << total.sumw
+              << ", sumw2: " << total.sumw2 << std::endl;
+
+    for (size_t k = 0; k < nparts; ++k) {
+      auto [first, last] = event_part(total.nevents, k, nparts);
+      std::cout << "part " << k << ": --skip " << first << " --max-events "
+                << (last - first) << std::endl;
+    }
+  } catch (std::runtime_error const &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
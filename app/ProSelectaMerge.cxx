@@ -0,0 +1,225 @@
+#include "ProSelecta/Histogram.h"
+#include "ProSelecta/OutputSink.h"
+#include "ProSelecta/RunSummary.h"
+
+#ifdef ProSelecta_ROOT_IO
+#include "ProSelecta/ROOTIO.h"
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+std::vector<std::string> input_paths;
+std::string output_path;
+std::string output_format;
+
+using namespace ps;
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[USAGE]: " << argv[0] << " -o <file> [--format <fmt>] <inputs...>\n"
+      << "\tCombines the outputs of the shards of a ProSelectaCPP --shard k/N "
+         "run into\n"
+      << "\texactly the output of a single unsharded run. Every input must be "
+         "of the\n"
+      << "\tsame kind, one of:\n"
+      << "\t  histogram chunks written by --hist-out,\n"
+      << "\t  run summaries written by --summary,\n"
+      << "\t  or rows written by -o, in any of the csv, bin, or root "
+         "formats.\n"
+      << "\t-o <file>            : Output file\n"
+      << "\t--format <fmt>       : Format of merged rows, one of csv, bin, or "
+         "root. Deduced\n"
+      << "\t                       from the extension of -o if not given.\n"
+      << std::endl;
+}
+
+void handleOpts(int argc, char const *argv[]) {
+  int opt = 1;
+  while (opt < argc) {
+    if (std::string(argv[opt]) == "-?" || std::string(argv[opt]) == "--help") {
+      SayUsage(argv);
+      exit(0);
+    } else if (((opt + 1) < argc) && (std::string(argv[opt]) == "-o")) {
+      output_path = argv[++opt];
+    } else if (((opt + 1) < argc) && (std::string(argv[opt]) == "--format")) {
+      output_format = argv[++opt];
+    } else if (argv[opt][0] == '-') {
+      std::cout << "[ERROR]: Unknown option: " << argv[opt] << std::endl;
+      SayUsage(argv);
+      exit(1);
+    } else {
+      input_paths.push_back(argv[opt]);
+    }
+    opt++;
+  }
+}
+
+bool IsRunSummary(std::string const &path) {
+  std::ifstream ifs(path);
+  std::string line;
+  return std::getline(ifs, line) && (line == RunSummary::header);
+}
+
+// Sums the chunk partials of every shard in chunk order, as a single run
+// would have
+void MergeHistograms() {
+  std::vector<Histogram> prototype;
+  std::vector<HistogramChunk> chunks;
+  for (auto const &path : input_paths) {
+    auto file = read_histogram_chunks(path);
+    if (prototype.empty()) {
+      prototype = file.prototype;
+    }
+    for (auto &chunk : file.chunks) {
+      chunks.push_back(std::move(chunk));
+    }
+  }
+
+  std::stable_sort(chunks.begin(), chunks.end(),
+                   [](HistogramChunk const &a, HistogramChunk const &b) {
+                     return a.index < b.index;
+                   });
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    if (chunks[i].index == chunks[i - 1].index) {
+      std::stringstream ss("");
+      ss << "Chunk " << chunks[i].index
+         << " appears in more than one input, were the same shard's outputs "
+            "passed twice?";
+      throw std::runtime_error(ss.str());
+    }
+  }
+
+  for (auto &hist : prototype) {
+    hist.reset();
+  }
+  for (auto const &chunk : chunks) {
+    add_histograms(prototype, chunk.histograms);
+  }
+  write_histograms(output_path, prototype);
+}
+
+void MergeSummaries() {
+  std::vector<RunSummary> shards;
+  for (auto const &path : input_paths) {
+    shards.push_back(RunSummary::read(path));
+  }
+  RunSummary::merge_shards(shards).write(output_path);
+}
+
+// Interleaves the rows of every shard back into event order. The rows of each
+// shard are already in event order, so they are streamed through a k-way
+// merge that only holds one block of rows per input in memory.
+void MergeRows() {
+  struct Input {
+    std::unique_ptr<OutputTableReader> rdr;
+    std::vector<EventResult> rows;
+    size_t next;
+  };
+
+  std::vector<Input> inputs;
+  for (auto const &path : input_paths) {
+    Input in{open_output_table(path), {}, 0};
+    auto const &cols = in.rdr->columns();
+    auto const &first = inputs.size() ? inputs[0].rdr->columns() : cols;
+    if ((cols.projections != first.projections) ||
+        (cols.weights != first.weights) ||
+        (cols.selections != first.selections)) {
+      throw std::runtime_error("Input " + path + " has different columns to " +
+                               input_paths[0]);
+    }
+    inputs.push_back(std::move(in));
+  }
+
+  // the next row of each input, smallest event number, then input, first
+  using Head = std::pair<size_t, size_t>;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  // queues the next row of input i, reading its next block if needed
+  auto push_next = [&](size_t i) {
+    auto &in = inputs[i];
+    while (in.next == in.rows.size()) {
+      in.next = 0;
+      if (!in.rdr->read(in.rows)) {
+        return;
+      }
+    }
+    heads.push({in.rows[in.next].evtnum, i});
+  };
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    push_next(i);
+  }
+
+  AsyncSink sink(deduce_sink(output_path, output_format));
+  sink.open(inputs[0].rdr->columns());
+
+  std::vector<EventResult> block;
+  std::optional<size_t> last_evtnum;
+  while (heads.size()) {
+    auto [evtnum, i] = heads.top();
+    heads.pop();
+    if (last_evtnum && (evtnum <= *last_evtnum)) {
+      std::stringstream ss("");
+      if (evtnum == *last_evtnum) {
+        ss << "Event " << evtnum
+           << " appears in more than one input, were the same shard's "
+              "outputs passed twice?";
+      } else {
+        ss << "The rows of " << input_paths[i]
+           << " are not in event order, at event " << evtnum << ".";
+      }
+      throw std::runtime_error(ss.str());
+    }
+    last_evtnum = evtnum;
+
+    block.push_back(std::move(inputs[i].rows[inputs[i].next++]));
+    if (block.size() == 4096) {
+      sink.write(block);
+      block.clear();
+    }
+    push_next(i);
+  }
+  sink.write(block);
+  sink.close();
+}
+
+int main(int argc, char const *argv[]) {
+#ifdef ProSelecta_ROOT_IO
+  ps::enable_root_io();
+#endif
+
+  handleOpts(argc, argv);
+
+  if (!output_path.size() || input_paths.empty()) {
+    std::cout << "[ERROR]: Expected -o <file> and at least one input."
+              << std::endl;
+    SayUsage(argv);
+    return 1;
+  }
+
+  try {
+    if (is_histogram_chunks(input_paths.front())) {
+      MergeHistograms();
+    } else if (IsRunSummary(input_paths.front())) {
+      MergeSummaries();
+    } else if (is_histograms_binary(input_paths.front())) {
+      throw std::runtime_error(
+          "Histograms of unsharded runs cannot be merged exactly, only the "
+          "histogram chunks written by --shard runs.");
+    } else {
+      MergeRows();
+    }
+  } catch (std::runtime_error const &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+import yaml
+
+import pyProSelecta as pps
+
+import argparse, os
+
+parser = argparse.ArgumentParser(
+  description="Runs every selection of a build manifest over the same "
+  "inputs in a single pass, each event is read once and evaluated by every "
+  "analysis. Each selection, with the projections and weights listed beside "
+  "it, writes its own output file, <outdir>/<select>.<format>, with the same "
+  "rows as ProSelectaCPP --Select <select> --Project ... would.")
+parser.add_argument("manifest", help="build manifest, see "
+  "examples/example_build_manifest.yml")
+parser.add_argument("-i", "--input", action="append", required=True,
+  help="HepMC3 input file, glob pattern, or @list file. Can be repeated")
+parser.add_argument("-o", "--outdir", default=".",
+  help="directory to write the per-analysis outputs to")
+parser.add_argument("--format", default="csv", choices=["csv", "bin", "root"],
+  help="format of the per-analysis outputs")
+parser.add_argument("--threads", type=int, default=1,
+  help="number of event evaluation threads")
+parser.add_argument("--batch-size", type=int, default=256,
+  help="number of events per evaluation batch")
+parser.add_argument("--readers", type=int, default=4,
+  help="number of input files decoded concurrently")
+parser.add_argument("-I", "--include", action="append", default=[],
+  help="path to include in the interpreter's search path. Can be repeated")
+parser.add_argument("--store",
+  help="directory to keep the results of every function on every input "
+  "file in, keyed by the snippet that defines the function and the headers "
+  "that it includes, so that later runs only read the inputs that lack a "
+  "result")
+args = parser.parse_args()
+
+with open(args.manifest) as manifest:
+  data = yaml.safe_load(manifest)
+
+manifest_dir = os.path.dirname(os.path.abspath(args.manifest))
+
+for path in args.include:
+  pps.add_include_path(path)
+
+analyses = []
+snippets = []
+for analysis in data:
+  snippet = analysis["snippet"]
+  # snippets are looked for beside the manifest if not found as given
+  if not os.path.exists(snippet):
+    snippet = os.path.join(manifest_dir, snippet)
+  print(f"snippet file: {snippet}")
+  snippets.append(snippet)
+  if not pps.load_file(snippet):
+    raise RuntimeError(f"Failed to parse snippet file {snippet}. See above cling output for errors")
+
+  funcs = analysis["functions"]
+  for sf in funcs["select"]:
+    print(f"  analysis: {sf}")
+    analyses.append({
+      "select": sf,
+      "project": funcs.get("project", []),
+      "weight": funcs.get("weight", []),
+      "output": os.path.join(args.outdir, f"{sf}.{args.format}"),
+      "format": args.format })
+
+os.makedirs(args.outdir, exist_ok=True)
+
+result = pps.run_analyses(args.input, analyses, nthreads=args.threads,
+  batch_size=args.batch_size, readers=args.readers, store=args.store or "",
+  sources=snippets, include_paths=args.include)
+
+print(f"read {result['events_read']} events")
+for name, nselected in result["events_selected"].items():
+  print(f"  {name}: {nselected} selected")
@@ -4,6 +4,7 @@
 
 #include <array>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ps::detail {
@@ -60,6 +61,62 @@ struct broadcast_return<std::vector<int>, ValueType> {
   using type = std::vector<ValueType>;
 };
 
+// the type returned by ps::part::highest and ps::part::lowest: a single
+// particle for a collection of particles, or a particle per sub-collection for
+// a collection of collections of particles.
+template <typename PartCollectionCollection> struct select_part_return {
+  using type = HepMC3::ConstGenParticlePtr;
+};
+
+template <typename Parts, size_t N>
+struct select_part_return<std::array<Parts, N>> {
+  using type = std::conditional_t<
+      is_std_array_part<std::array<Parts, N>>::value,
+      HepMC3::ConstGenParticlePtr, std::array<HepMC3::ConstGenParticlePtr, N>>;
+};
+
+template <typename Parts> struct select_part_return<std::vector<Parts>> {
+  using type =
+      std::conditional_t<is_std_vector_part<std::vector<Parts>>::value,
+                         HepMC3::ConstGenParticlePtr,
+                         std::vector<HepMC3::ConstGenParticlePtr>>;
+};
+
+// the type returned by ps::part::sum, analogous to select_part_return
+template <typename Projector> struct projected {
+  using type = decltype(std::declval<Projector const &>()(
+      std::declval<HepMC3::ConstGenParticlePtr>()));
+};
+
+template <typename Projector, typename PartCollectionCollection>
+struct sum_return {
+  using type = typename projected<Projector>::type;
+};
+
+template <typename Projector, typename Parts, size_t N>
+struct sum_return<Projector, std::array<Parts, N>> {
+  using type = std::conditional_t<
+      is_std_array_part<std::array<Parts, N>>::value,
+      typename projected<Projector>::type,
+      std::array<typename projected<Projector>::type, N>>;
+};
+
+template <typename Projector, typename Parts>
+struct sum_return<Projector, std::vector<Parts>> {
+  using type =
+      std::conditional_t<is_std_vector_part<std::vector<Parts>>::value,
+                         typename projected<Projector>::type,
+                         std::vector<typename projected<Projector>::type>>;
+};
+
+// the type returned by ps::part::filter, arrays of particles cannot be
+// filtered in place and are returned as vectors
+template <typename PartCollectionCollection> struct filter_return {
+  using type = std::conditional_t<
+      is_std_array_part<PartCollectionCollection>::value,
+      std::vector<HepMC3::ConstGenParticlePtr>, PartCollectionCollection>;
+};
+
 struct flatten {};
 
 } // namespace ps::detail
\ No newline at end of file
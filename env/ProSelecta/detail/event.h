@@ -13,7 +13,7 @@
 namespace ps::detail {
 
 template <int status, typename Collection, bool select_from_pdg_list = true>
-inline std::vector<HepMC3::ConstGenParticlePtr>
+std::vector<HepMC3::ConstGenParticlePtr>
 particles(HepMC3::GenEvent const &evt, Collection const &pdgs) {
 
   std::vector<HepMC3::ConstGenParticlePtr> selected_parts = {};
@@ -46,7 +46,7 @@ particles(HepMC3::GenEvent const &evt, Collection const &pdgs) {
 }
 
 template <int status, typename Collection>
-inline bool has_particles(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+bool has_particles(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   bool hasall = true;
 
   for (auto id : PIDs) {
@@ -57,9 +57,8 @@ inline bool has_particles(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 }
 
 template <int status, typename Collection>
-inline bool has_particles_exact(HepMC3::GenEvent const &ev,
-                                Collection const &PIDs,
-                                Collection const &counts) {
+bool has_particles_exact(HepMC3::GenEvent const &ev, Collection const &PIDs,
+                         Collection const &counts) {
   bool hasall = true;
 
   for (size_t i = 0; i < PIDs.size(); ++i) {
@@ -75,9 +74,8 @@ inline bool has_particles_exact(HepMC3::GenEvent const &ev,
 }
 
 template <int status, typename Collection>
-inline bool has_particles_atleast(HepMC3::GenEvent const &ev,
-                                  Collection const &PIDs,
-                                  Collection const &counts) {
+bool has_particles_atleast(HepMC3::GenEvent const &ev, Collection const &PIDs,
+                           Collection const &counts) {
   bool hasall = true;
 
   for (size_t i = 0; i < PIDs.size(); ++i) {
@@ -93,7 +91,7 @@ inline bool has_particles_atleast(HepMC3::GenEvent const &ev,
 }
 
 template <int status>
-inline std::vector<HepMC3::ConstGenParticlePtr>
+std::vector<HepMC3::ConstGenParticlePtr>
 nuclear_particles(HepMC3::GenEvent const &evt) {
 
   std::vector<HepMC3::ConstGenParticlePtr> selected_parts = {};
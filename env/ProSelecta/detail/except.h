@@ -1,65 +1,141 @@
 #pragma once
 
-#include "TSystem.h"
+#include <execinfo.h>
+#include <unistd.h>
 
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace ps::detail {
+
+// The environment does not depend on ROOT, so it cannot print a stack trace by
+// itself. libProSelectaInterpreter installs a hook that prints one via
+// gSystem->StackTrace(), for both interpreted and compiled code, and
+// standalone builds of snippets may install their own.
+using backtrace_hook_t = void (*)();
+
+inline backtrace_hook_t &backtrace_hook() {
+  static backtrace_hook_t hook = nullptr;
+  return hook;
+}
+
+// Stack traces are printed only if ProSelecta_BACKTRACE is set in the
+// environment. This is deliberately not CLING_DEBUG, which is also set to
+// register JIT'd code with gdb, see ps::cling::enable_jit_symbol_export.
+inline bool backtrace_enabled() {
+  static bool const enabled = std::getenv("ProSelecta_BACKTRACE");
+  return enabled;
+}
+
+inline void print_backtrace_hint() {
+  std::cerr << "Failed generating a useful Stack Trace as environment "
+               "variable ProSelecta_BACKTRACE is not set, define this in the "
+               "environment and re-run the calling process (which might be "
+               "jupyter) to see the stacktrace for this failure."
+            << std::endl;
+}
+
+inline void print_backtrace() {
+  if (!backtrace_hook()) {
+    return;
+  }
+  if (backtrace_enabled()) {
+    backtrace_hook()();
+  } else {
+    print_backtrace_hint();
+  }
+}
+
+// The hook prints the stack of its caller, which is only where the exception
+// was thrown if it is called from the constructor. Lazy diagnostics instead
+// keep the return addresses of the frames at construction, which are cheap to
+// take, and only look up their symbols if they are printed.
+inline std::vector<void *> capture_backtrace() {
+  if (!backtrace_hook() || !backtrace_enabled()) {
+    return {};
+  }
+  std::vector<void *> frames(64);
+  frames.resize(::backtrace(frames.data(), int(frames.size())));
+  return frames;
+}
+
+inline void print_captured_backtrace(std::vector<void *> const &frames) {
+  if (!backtrace_hook()) {
+    return;
+  }
+  if (backtrace_enabled()) {
+    ::backtrace_symbols_fd(frames.data(), int(frames.size()), STDERR_FILENO);
+  } else {
+    print_backtrace_hint();
+  }
+}
+
+// By default, diagnostics are printed when an exception is constructed. If
+// ProSelecta_LAZY_EXCEPTION_DIAGNOSTICS is defined, they are instead printed
+// the first time that what() is called, so that exceptions which are caught
+// and handled, e.g. for events without a requested particle, are cheap. The
+// stack trace is still that of the constructor, see capture_backtrace.
+#ifdef ProSelecta_LAZY_EXCEPTION_DIAGNOSTICS
+constexpr bool lazy_exception_diagnostics = true;
+#else
+constexpr bool lazy_exception_diagnostics = false;
+#endif
+
 struct exception : public std::exception {
   std::stringstream msgstrm;
   std::string msg;
+  mutable bool diagnosed;
+  // with lazy diagnostics, the frames of the stack that the exception was
+  // constructed on, if ProSelecta_BACKTRACE is set
+  std::vector<void *> frames;
 
-  exception() : msgstrm(), msg() {
-    auto CLING_DEBUG = std::getenv("CLING_DEBUG");
-    if (CLING_DEBUG) {
-      gSystem->StackTrace();
-    } else {
-      std::cerr << "Failed generating a useful Stack Trace as environment "
-                   "variables CLING_DEBUG != 1, define this in the environment "
-                   "and re-run the calling process (which might be jupyter) to "
-                   "see the stacktrace for this failure."
-                << std::endl;
-    }
+  exception() : msgstrm(), msg(), diagnosed(false), frames() {
+    diagnose_or_capture();
     msg = msgstrm.str();
   }
-  exception(std::string const &m) : msgstrm(), msg() {
-    auto CLING_DEBUG = std::getenv("CLING_DEBUG");
-    if (CLING_DEBUG) {
-      gSystem->StackTrace();
-    } else {
-      std::cerr << "Failed generating a useful Stack Trace as environment "
-                   "variables CLING_DEBUG != 1, define this in the environment "
-                   "and re-run the calling process (which might be jupyter) to "
-                   "see the stacktrace for this failure."
-                << std::endl;
-    }
+  exception(std::string const &m)
+      : msgstrm(), msg(), diagnosed(false), frames() {
+    diagnose_or_capture();
     msgstrm << m;
     msg = msgstrm.str();
   }
-  exception(exception const &other) : msgstrm(), msg() {
-    auto CLING_DEBUG = std::getenv("CLING_DEBUG");
-    if (CLING_DEBUG) {
-      gSystem->StackTrace();
-    } else {
-      std::cerr << "Failed generating a useful Stack Trace as environment "
-                   "variables CLING_DEBUG != 1, define this in the environment "
-                   "and re-run the calling process (which might be jupyter) to "
-                   "see the stacktrace for this failure."
-                << std::endl;
-    }
+  // copies are made while an exception is in flight, they are not new
+  // failures
+  exception(exception const &other)
+      : msgstrm(), msg(), diagnosed(other.diagnosed), frames(other.frames) {
     msgstrm << other.msg;
     msg = msgstrm.str();
   }
-  const char *what() const noexcept { return msg.c_str(); }
+  const char *what() const noexcept {
+    if (!diagnosed) {
+      diagnosed = true;
+      try {
+        print_captured_backtrace(frames);
+      } catch (...) {
+      }
+    }
+    return msg.c_str();
+  }
 
   template <typename T> exception &operator<<(T const &obj) {
     msgstrm << obj;
     msg = msgstrm.str();
     return (*this);
   }
+
+private:
+  void diagnose_or_capture() {
+    if constexpr (lazy_exception_diagnostics) {
+      frames = capture_backtrace();
+    } else {
+      diagnosed = true;
+      print_backtrace();
+    }
+  }
 };
 
 } // namespace ps::detail
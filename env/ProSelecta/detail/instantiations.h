@@ -0,0 +1,221 @@
+// Lists the instantiations of the environment templates that snippets most
+// commonly use: the event functions for the PID lists that single PIDs,
+// ps::pids and the ps::pdg groups build, with one to four PIDs, and the part
+// functions for the built-in projectors applied to the particles of one PID,
+// or of a pair of PIDs. Only combinations that make sense are listed, angles
+// are sorted by but not summed, for example. Anything else is instantiated
+// by cling on demand. test/InstantiationsTests.cxx uses every one of these
+// and checks, with nm, that none are left unused or compiled again.
+//
+// This header deliberately has no include guard. libProSelectaInterpreter
+// includes it with ProSelecta_INSTANTIATE defined as `template` to compile the
+// instantiations, and the interpreter environment includes it with
+// ProSelecta_INSTANTIATE defined as `extern template` so that cling links
+// against those instead of instantiating and JIT compiling them for each
+// snippet.
+
+#ifndef ProSelecta_INSTANTIATE
+#error                                                                         \
+    "ProSelecta_INSTANTIATE must be defined before including instantiations.h"
+#endif
+
+namespace ps::detail::inst {
+
+using pids1 = std::array<int, 1>;
+using pids2 = std::array<int, 2>;
+using pids3 = std::array<int, 3>;
+using pids4 = std::array<int, 4>;
+
+using parts = std::vector<HepMC3::ConstGenParticlePtr>;
+using parts2 = std::array<parts, 2>;
+
+using p3mod = ps::detail::p3mod;
+using energy = ps::detail::energy;
+using kinetic_energy = ps::detail::kinetic_energy;
+using theta = ps::detail::theta;
+using costheta = ps::detail::costheta;
+using momentum = ps::detail::momentum;
+
+} // namespace ps::detail::inst
+
+#define ProSelecta_INSTANTIATE_PID_FUNCS(C)                                    \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::detail::particles<ps::detail::kUndecayedPhysical, C,                     \
+                        ps::detail::kFromPDGList>(HepMC3::GenEvent const &,    \
+                                                  C const &);                  \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::detail::particles<ps::detail::kBeam, C, ps::detail::kFromPDGList>(       \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::detail::particles<ps::detail::kTarget, C, ps::detail::kFromPDGList>(     \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::detail::particles<ps::detail::kUndecayedPhysical, C,                     \
+                        ps::detail::kNotFromPDGList>(                          \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE bool                                                  \
+  ps::detail::has_particles<ps::detail::kUndecayedPhysical, C>(                \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE bool ps::detail::has_particles<ps::detail::kBeam, C>( \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE bool                                                  \
+  ps::detail::has_particles<ps::detail::kTarget, C>(HepMC3::GenEvent const &,  \
+                                                    C const &);                \
+  ProSelecta_INSTANTIATE bool                                                  \
+  ps::detail::has_particles_exact<ps::detail::kUndecayedPhysical, C>(          \
+      HepMC3::GenEvent const &, C const &, C const &);                         \
+  ProSelecta_INSTANTIATE bool                                                  \
+  ps::detail::has_particles_atleast<ps::detail::kUndecayedPhysical, C>(        \
+      HepMC3::GenEvent const &, C const &, C const &);                         \
+  ProSelecta_INSTANTIATE ps::detail::broadcast_return<C, int>::type            \
+  ps::event::num_out_part<C>(HepMC3::GenEvent const &, C const &);             \
+  ProSelecta_INSTANTIATE int ps::event::num_out_part<C>(                       \
+      HepMC3::GenEvent const &, C const &, ps::detail::flatten const &);       \
+  ProSelecta_INSTANTIATE int ps::event::num_out_part_except<C>(                \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE bool ps::event::has_out_part<C>(                      \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE bool ps::event::has_exact_out_part<C>(                \
+      HepMC3::GenEvent const &, C const &, C const &);                         \
+  ProSelecta_INSTANTIATE bool ps::event::out_part_topology_matches<C>(         \
+      HepMC3::GenEvent const &, C const &, C const &);                         \
+  ProSelecta_INSTANTIATE bool ps::event::has_at_least_out_part<C>(             \
+      HepMC3::GenEvent const &, C const &, C const &);                         \
+  ProSelecta_INSTANTIATE ps::detail::broadcast_return<                         \
+      C, std::vector<HepMC3::ConstGenParticlePtr>>::type                       \
+  ps::event::all_out_part<C>(HepMC3::GenEvent const &, C const &);             \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::event::all_out_part<C>(HepMC3::GenEvent const &, C const &,              \
+                             ps::detail::flatten const &);                     \
+  ProSelecta_INSTANTIATE                                                       \
+  ps::detail::broadcast_return<C, HepMC3::ConstGenParticlePtr>::type           \
+  ps::event::hm_out_part<C>(HepMC3::GenEvent const &, C const &);              \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::event::hm_out_part<C>(HepMC3::GenEvent const &, C const &,               \
+                            ps::detail::flatten const &);                      \
+  ProSelecta_INSTANTIATE                                                       \
+  ps::detail::broadcast_return<C, HepMC3::ConstGenParticlePtr>::type           \
+  ps::event::try_hm_out_part<C>(HepMC3::GenEvent const &, C const &);          \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::event::try_hm_out_part<C>(HepMC3::GenEvent const &, C const &,           \
+                                ps::detail::flatten const &);                  \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::event::all_out_part_except<C>(HepMC3::GenEvent const &, C const &);      \
+  ProSelecta_INSTANTIATE bool ps::event::has_beam_part<C>(                     \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::event::beam_part<C>(HepMC3::GenEvent const &, C const &);                \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::event::try_beam_part<C>(HepMC3::GenEvent const &, C const &);            \
+  ProSelecta_INSTANTIATE bool ps::event::has_target_part<C>(                   \
+      HepMC3::GenEvent const &, C const &);                                    \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::event::target_part<C>(HepMC3::GenEvent const &, C const &);              \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::event::try_target_part<C>(HepMC3::GenEvent const &, C const &)
+
+// sorting functions of a projector and a collection of particles, or a
+// collection of collections of particles
+#define ProSelecta_INSTANTIATE_PROJECTOR_FUNCS(P, PC)                          \
+  ProSelecta_INSTANTIATE PC ps::part::sort_ascending<P, PC>(P const &, PC);    \
+  ProSelecta_INSTANTIATE ps::detail::select_part_return<PC>::type              \
+  ps::part::highest<P, PC>(P const &, PC);                                     \
+  ProSelecta_INSTANTIATE ps::detail::select_part_return<PC>::type              \
+  ps::part::lowest<P, PC>(P const &, PC);                                      \
+  ProSelecta_INSTANTIATE ps::detail::select_part_return<PC>::type              \
+  ps::part::try_highest<P, PC>(P const &, PC const &);                         \
+  ProSelecta_INSTANTIATE ps::detail::select_part_return<PC>::type              \
+  ps::part::try_lowest<P, PC>(P const &, PC const &)
+
+// sorting functions of a projector and a collection of collections of
+// particles only
+#define ProSelecta_INSTANTIATE_PROJECTOR_FLATTEN_FUNCS(P, PC)                  \
+  ProSelecta_INSTANTIATE_PROJECTOR_FUNCS(P, PC);                               \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::part::sort_ascending<P, PC>(P const &, PC, ps::detail::flatten const &); \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::part::highest<P, PC>(P const &, PC, ps::detail::flatten const &);        \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::part::lowest<P, PC>(P const &, PC, ps::detail::flatten const &);         \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::part::try_highest<P, PC>(P const &, PC const &,                          \
+                               ps::detail::flatten const &);                   \
+  ProSelecta_INSTANTIATE HepMC3::ConstGenParticlePtr                           \
+  ps::part::try_lowest<P, PC>(P const &, PC const &,                           \
+                              ps::detail::flatten const &)
+
+// projectors that particles are sorted by, and that can be summed over them
+#define ProSelecta_INSTANTIATE_SORTING_PROJECTOR(P)                            \
+  ProSelecta_INSTANTIATE_PROJECTOR_FUNCS(P, ps::detail::inst::parts);          \
+  ProSelecta_INSTANTIATE_PROJECTOR_FLATTEN_FUNCS(P, ps::detail::inst::parts2)
+
+#define ProSelecta_INSTANTIATE_SUMMING_PROJECTOR(P)                            \
+  ProSelecta_INSTANTIATE ps::detail::sum_return<P,                             \
+                                                ps::detail::inst::parts>::type \
+  ps::part::sum<P, ps::detail::inst::parts>(P const &,                         \
+                                            ps::detail::inst::parts const &);  \
+  ProSelecta_INSTANTIATE                                                       \
+  ps::detail::sum_return<P, ps::detail::inst::parts2>::type                    \
+  ps::part::sum<P, ps::detail::inst::parts2>(                                  \
+      P const &, ps::detail::inst::parts2 const &);                            \
+  ProSelecta_INSTANTIATE ps::detail::projected<P>::type                        \
+  ps::part::sum<P, ps::detail::inst::parts2>(                                  \
+      P const &, ps::detail::inst::parts2 const &, ps::detail::flatten const &)
+
+#define ProSelecta_INSTANTIATE_PART_FUNCS(PC)                                  \
+  ProSelecta_INSTANTIATE ps::detail::filter_return<PC>::type                   \
+  ps::part::filter<PC>(ps::cuts const &, PC)
+
+#define ProSelecta_INSTANTIATE_PART_FLATTEN_FUNCS(PC)                          \
+  ProSelecta_INSTANTIATE_PART_FUNCS(PC);                                       \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::part::filter<PC>(ps::cuts const &, PC const &,                           \
+                       ps::detail::flatten const &);                           \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::part::cat<PC>(PC const &);                                               \
+  ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>              \
+  ps::detail::cat<PC>(PC const &)
+
+ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>
+ps::detail::particles<ps::detail::kUndecayedPhysical, std::array<int, 0>,
+                      ps::detail::kFromPDGList>(HepMC3::GenEvent const &,
+                                                std::array<int, 0> const &);
+ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>
+ps::detail::particles<ps::detail::kBeam, std::array<int, 0>,
+                      ps::detail::kFromPDGList>(HepMC3::GenEvent const &,
+                                                std::array<int, 0> const &);
+ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>
+ps::detail::particles<ps::detail::kTarget, std::array<int, 0>,
+                      ps::detail::kFromPDGList>(HepMC3::GenEvent const &,
+                                                std::array<int, 0> const &);
+ProSelecta_INSTANTIATE std::vector<HepMC3::ConstGenParticlePtr>
+ps::detail::nuclear_particles<ps::detail::kUndecayedPhysical>(
+    HepMC3::GenEvent const &);
+
+ProSelecta_INSTANTIATE_PID_FUNCS(ps::detail::inst::pids1);
+ProSelecta_INSTANTIATE_PID_FUNCS(ps::detail::inst::pids2);
+ProSelecta_INSTANTIATE_PID_FUNCS(ps::detail::inst::pids3);
+ProSelecta_INSTANTIATE_PID_FUNCS(ps::detail::inst::pids4);
+
+ProSelecta_INSTANTIATE_SORTING_PROJECTOR(ps::detail::inst::p3mod);
+ProSelecta_INSTANTIATE_SORTING_PROJECTOR(ps::detail::inst::energy);
+ProSelecta_INSTANTIATE_SORTING_PROJECTOR(ps::detail::inst::kinetic_energy);
+ProSelecta_INSTANTIATE_SORTING_PROJECTOR(ps::detail::inst::theta);
+ProSelecta_INSTANTIATE_SORTING_PROJECTOR(ps::detail::inst::costheta);
+
+// angles are not summed
+ProSelecta_INSTANTIATE_SUMMING_PROJECTOR(ps::detail::inst::p3mod);
+ProSelecta_INSTANTIATE_SUMMING_PROJECTOR(ps::detail::inst::energy);
+ProSelecta_INSTANTIATE_SUMMING_PROJECTOR(ps::detail::inst::kinetic_energy);
+ProSelecta_INSTANTIATE_SUMMING_PROJECTOR(ps::detail::inst::momentum);
+
+ProSelecta_INSTANTIATE_PART_FUNCS(ps::detail::inst::parts);
+ProSelecta_INSTANTIATE_PART_FLATTEN_FUNCS(ps::detail::inst::parts2);
+
+#undef ProSelecta_INSTANTIATE_PID_FUNCS
+#undef ProSelecta_INSTANTIATE_PROJECTOR_FUNCS
+#undef ProSelecta_INSTANTIATE_PROJECTOR_FLATTEN_FUNCS
+#undef ProSelecta_INSTANTIATE_SORTING_PROJECTOR
+#undef ProSelecta_INSTANTIATE_SUMMING_PROJECTOR
+#undef ProSelecta_INSTANTIATE_PART_FUNCS
+#undef ProSelecta_INSTANTIATE_PART_FLATTEN_FUNCS
@@ -4,7 +4,8 @@
 
 namespace ps::detail {
 template <typename PartCollectionCollection>
-inline auto cat(PartCollectionCollection const &part_groups) {
+std::vector<typename PartCollectionCollection::value_type::value_type>
+cat(PartCollectionCollection const &part_groups) {
 
   std::vector<typename PartCollectionCollection::value_type::value_type> outs;
   for (auto const &parts : part_groups) {
@@ -7,3 +7,12 @@
 #include "ProSelecta/pdg.h"
 #include "ProSelecta/unit.h"
 #include "ProSelecta/vect.h"
+
+// The interpreter defines this before including the environment so that
+// cling uses the template instantiations compiled into
+// libProSelectaInterpreter.
+#ifdef ProSelecta_EXTERN_TEMPLATES
+#define ProSelecta_INSTANTIATE extern template
+#include "ProSelecta/detail/instantiations.h"
+#undef ProSelecta_INSTANTIATE
+#endif
@@ -9,6 +9,7 @@
 
 #include "HepMC3/GenEvent.h"
 
+#include <optional>
 #include <stdexcept>
 
 namespace ps {
@@ -22,7 +23,8 @@ NEW_PS_EXCEPT(MoreThanOneTargetPart);
 NEW_PS_EXCEPT(NoSignalProcessId);
 
 template <typename Collection>
-inline auto num_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+typename ps::detail::broadcast_return<Collection, int>::type
+num_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "num_out_part: EmptyPIDList");
@@ -50,8 +52,8 @@ inline auto num_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 }
 
 template <typename Collection>
-inline auto num_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
-                         ps::detail::flatten const &) {
+int num_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
+                 ps::detail::flatten const &) {
 
   auto const &all_num_out_part = num_out_part(ev, PIDs);
 
@@ -71,8 +73,7 @@ inline int num_out_part(HepMC3::GenEvent const &ev, int PID = 0) {
 }
 
 template <typename Collection>
-inline int num_out_part_except(HepMC3::GenEvent const &ev,
-                               Collection const &PIDs) {
+int num_out_part_except(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "num_out_part_except: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -94,7 +95,7 @@ inline int num_out_part_except(HepMC3::GenEvent const &ev, int PID) {
 }
 
 template <typename Collection>
-inline bool has_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+bool has_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "has_out_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -121,9 +122,8 @@ inline bool has_out_part(HepMC3::GenEvent const &ev, int PID) {
 }
 
 template <typename Collection>
-inline bool has_exact_out_part(HepMC3::GenEvent const &ev,
-                               Collection const &PIDs,
-                               Collection const &counts) {
+bool has_exact_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
+                        Collection const &counts) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "has_exact_out_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -145,9 +145,9 @@ inline bool has_exact_out_part(HepMC3::GenEvent const &ev, int PID, int count) {
 }
 
 template <typename Collection>
-inline bool out_part_topology_matches(HepMC3::GenEvent const &ev,
-                                      Collection const &PIDs,
-                                      Collection const &counts) {
+bool out_part_topology_matches(HepMC3::GenEvent const &ev,
+                               Collection const &PIDs,
+                               Collection const &counts) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "out_part_topology_matches: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -173,9 +173,8 @@ inline bool out_part_topology_matches(HepMC3::GenEvent const &ev,
 }
 
 template <typename Collection>
-inline bool has_at_least_out_part(HepMC3::GenEvent const &ev,
-                                  Collection const &PIDs,
-                                  Collection const &counts) {
+bool has_at_least_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
+                           Collection const &counts) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "has_at_least_out_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -204,7 +203,9 @@ inline bool has_at_least_out_part(HepMC3::GenEvent const &ev, int PID,
 }
 
 template <typename Collection>
-inline auto all_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+typename ps::detail::broadcast_return<
+    Collection, std::vector<HepMC3::ConstGenParticlePtr>>::type
+all_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "all_out_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -231,8 +232,9 @@ inline auto all_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 }
 
 template <typename Collection>
-inline auto all_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
-                         ps::detail::flatten const &) {
+std::vector<HepMC3::ConstGenParticlePtr>
+all_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
+             ps::detail::flatten const &) {
   return ps::detail::particles<ps::detail::kUndecayedPhysical>(ev, PIDs);
 }
 
@@ -248,7 +250,9 @@ all_out_part(HepMC3::GenEvent const &ev, int PID = 0) {
 }
 
 template <typename Collection>
-inline auto hm_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+typename ps::detail::broadcast_return<Collection,
+                                      HepMC3::ConstGenParticlePtr>::type
+hm_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "hm_out_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -276,8 +280,9 @@ inline auto hm_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 }
 
 template <typename Collection>
-inline auto hm_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs,
-                        ps::detail::flatten const &) {
+HepMC3::ConstGenParticlePtr hm_out_part(HepMC3::GenEvent const &ev,
+                                        Collection const &PIDs,
+                                        ps::detail::flatten const &) {
   return ps::part::highest(ps::p3mod, all_out_part(ev, PIDs, ps::flatten));
 }
 
@@ -288,9 +293,55 @@ inline HepMC3::ConstGenParticlePtr hm_out_part(HepMC3::GenEvent const &ev,
                      ev, std::array{PID}));
 }
 
+// The try_ variants of the functions that throw when an event does not
+// contain the requested particles return nullptr, or an empty optional,
+// instead. Prefer them in hot paths where missing particles are expected.
+// Ambiguous requests, such as more than one matching beam particle, still
+// throw.
+template <typename Collection>
+typename ps::detail::broadcast_return<Collection,
+                                      HepMC3::ConstGenParticlePtr>::type
+try_hm_out_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+  static_assert(ps::detail::is_std_vector_or_array_int<Collection>::value,
+                "PIDs type must be a std::array<int,N> or std::vector<int>");
+
+  typename ps::detail::broadcast_return<Collection,
+                                        HepMC3::ConstGenParticlePtr>::type outs;
+
+  if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
+    outs.resize(PIDs.size());
+  }
+
+  for (size_t i = 0; i < PIDs.size(); ++i) {
+    outs[i] = ps::part::try_highest(
+        ps::p3mod, ps::detail::particles<ps::detail::kUndecayedPhysical>(
+                       ev, std::array{PIDs[i]}));
+  }
+  return outs;
+}
+
+template <typename Collection>
+HepMC3::ConstGenParticlePtr try_hm_out_part(HepMC3::GenEvent const &ev,
+                                            Collection const &PIDs,
+                                            ps::detail::flatten const &) {
+  if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
+    if (!PIDs.size()) {
+      return nullptr;
+    }
+  }
+  return ps::part::try_highest(ps::p3mod, all_out_part(ev, PIDs, ps::flatten));
+}
+
+inline HepMC3::ConstGenParticlePtr try_hm_out_part(HepMC3::GenEvent const &ev,
+                                                   int PID) {
+  return ps::part::try_highest(
+      ps::p3mod, ps::detail::particles<ps::detail::kUndecayedPhysical>(
+                     ev, std::array{PID}));
+}
+
 template <typename Collection>
-inline auto all_out_part_except(HepMC3::GenEvent const &ev,
-                                Collection const &PIDs) {
+std::vector<HepMC3::ConstGenParticlePtr>
+all_out_part_except(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   return ps::detail::particles<ps::detail::kUndecayedPhysical, Collection,
                                ps::detail::kNotFromPDGList>(ev, PIDs);
 }
@@ -302,7 +353,7 @@ inline auto all_out_part_except(HepMC3::GenEvent const &ev, int PID) {
 }
 
 template <typename Collection>
-inline bool has_beam_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+bool has_beam_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "has_beam_part: EmptyPIDList");
@@ -345,7 +396,8 @@ inline auto beam_part(HepMC3::GenEvent const &ev, int PID = 0) {
 }
 
 template <typename Collection>
-inline auto beam_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+HepMC3::ConstGenParticlePtr beam_part(HepMC3::GenEvent const &ev,
+                                      Collection const &PIDs) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "beam_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -380,9 +432,48 @@ inline auto beam_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   return parts.front();
 }
 
+inline HepMC3::ConstGenParticlePtr try_beam_part(HepMC3::GenEvent const &ev,
+                                                 int PID = 0) {
+  auto parts =
+      PID ? ps::detail::particles<ps::detail::kBeam>(ev, std::array{PID})
+          : ps::detail::particles<ps::detail::kBeam>(ev, std::array<int, 0>{});
+  if (parts.size() > 1) {
+    std::stringstream ss;
+    ss << "try_beam_part(" << PID << "): MoreThanOneBeamPart";
+    throw MoreThanOneBeamPart(ss.str());
+  }
+  return parts.size() ? parts.front() : nullptr;
+}
+
 template <typename Collection>
-inline bool has_target_part(HepMC3::GenEvent const &ev,
-                            Collection const &PIDs) {
+HepMC3::ConstGenParticlePtr try_beam_part(HepMC3::GenEvent const &ev,
+                                          Collection const &PIDs) {
+  static_assert(!ps::detail::is_zero_std_array<Collection>::value,
+                "try_beam_part: EmptyPIDList");
+  static_assert(ps::detail::is_std_vector_or_array_int<Collection>::value,
+                "PIDs type must be a std::array<int,N> or std::vector<int>");
+
+  if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
+    if (!PIDs.size()) {
+      return nullptr;
+    }
+  }
+
+  auto parts = ps::detail::particles<ps::detail::kBeam>(ev, PIDs);
+  if (parts.size() > 1) {
+    std::stringstream ss;
+    ss << "try_beam_part({";
+    for (auto PID : PIDs) {
+      ss << PID << ", ";
+    }
+    ss << "}): MoreThanOneBeamPart";
+    throw MoreThanOneBeamPart(ss.str());
+  }
+  return parts.size() ? parts.front() : nullptr;
+}
+
+template <typename Collection>
+bool has_target_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
 
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "has_target_part: EmptyPIDList");
@@ -425,7 +516,8 @@ inline auto target_part(HepMC3::GenEvent const &ev, int PID = 0) {
 }
 
 template <typename Collection>
-inline auto target_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
+HepMC3::ConstGenParticlePtr target_part(HepMC3::GenEvent const &ev,
+                                        Collection const &PIDs) {
   static_assert(!ps::detail::is_zero_std_array<Collection>::value,
                 "target_part: EmptyPIDList");
   if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
@@ -460,19 +552,65 @@ inline auto target_part(HepMC3::GenEvent const &ev, Collection const &PIDs) {
   return parts.front();
 }
 
+inline HepMC3::ConstGenParticlePtr
+try_target_part(HepMC3::GenEvent const &ev, int PID = 0) {
+  auto parts =
+      PID ? ps::detail::particles<ps::detail::kTarget>(ev, std::array{PID})
+          : ps::detail::particles<ps::detail::kTarget>(ev,
+                                                       std::array<int, 0>{});
+  if (parts.size() > 1) {
+    std::stringstream ss;
+    ss << "try_target_part(" << PID << "): MoreThanOneTargetPart";
+    throw MoreThanOneTargetPart(ss.str());
+  }
+  return parts.size() ? parts.front() : nullptr;
+}
+
+template <typename Collection>
+HepMC3::ConstGenParticlePtr try_target_part(HepMC3::GenEvent const &ev,
+                                            Collection const &PIDs) {
+  static_assert(!ps::detail::is_zero_std_array<Collection>::value,
+                "try_target_part: EmptyPIDList");
+  static_assert(ps::detail::is_std_vector_or_array_int<Collection>::value,
+                "PIDs type must be a std::array<int,N> or std::vector<int>");
+
+  if constexpr (ps::detail::is_std_vector_int<Collection>::value) {
+    if (!PIDs.size()) {
+      return nullptr;
+    }
+  }
+
+  auto parts = ps::detail::particles<ps::detail::kTarget>(ev, PIDs);
+  if (parts.size() > 1) {
+    std::stringstream ss;
+    ss << "try_target_part({";
+    for (auto PID : PIDs) {
+      ss << PID << ", ";
+    }
+    ss << "}): MoreThanOneTargetPart";
+    throw MoreThanOneTargetPart(ss.str());
+  }
+  return parts.size() ? parts.front() : nullptr;
+}
+
 inline auto out_nuclear_parts(HepMC3::GenEvent const &ev) {
   return ps::detail::nuclear_particles<ps::detail::kUndecayedPhysical>(ev);
 }
 
-inline int signal_process_id(HepMC3::GenEvent const &ev) {
+inline std::optional<int> try_signal_process_id(HepMC3::GenEvent const &ev) {
+  auto attr = ev.attribute<HepMC3::IntAttribute>("signal_process_id");
+  if (!attr) {
+    return std::nullopt;
+  }
+  return attr->value();
+}
 
-  auto const &attr_names = ev.attribute_names();
-  if (std::find(attr_names.begin(), attr_names.end(), "signal_process_id") ==
-      attr_names.end()) {
+inline int signal_process_id(HepMC3::GenEvent const &ev) {
+  auto sid = try_signal_process_id(ev);
+  if (!sid) {
     throw NoSignalProcessId("Event contains no signal_process_id attribute");
   }
-
-  return ev.attribute<HepMC3::IntAttribute>("signal_process_id")->value();
+  return *sid;
 }
 
 } // namespace event
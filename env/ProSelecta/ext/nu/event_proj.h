@@ -9,12 +9,25 @@ namespace ps::ext::nu {
 using namespace ps;
 
 double enu_GeV(HepMC3::GenEvent const &ev) {
-  return event::beam_part(ev, pdg::kNeutralLeptons)->momentum().e() / unit::GeV;
+  auto nu = event::try_beam_part(ev, pdg::kNeutralLeptons);
+
+  if (!nu) {
+    return kMissingDatum<double>;
+  }
+
+  return nu->momentum().e() / unit::GeV;
 }
 
 std::array<HepMC3::ConstGenParticlePtr, 2>
 GetNuFSLep(HepMC3::GenEvent const &ev) {
-  auto nu = event::beam_part(ev, pdg::kNeutralLeptons);
+  auto nu = event::try_beam_part(ev, pdg::kNeutralLeptons);
+
+  if (!nu) {
+    return {nullptr, nullptr};
+  }
+  if (!nu->end_vertex()) {
+    return {nu, nullptr};
+  }
 
   int fslep_ccpid = nu->pid() > 0 ? nu->pid() - 1 : nu->pid() + 1;
 
@@ -111,68 +124,83 @@ double q3lep_GeV(HepMC3::GenEvent const &ev) {
 }
 
 double hm_pprot_GeV(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kProton)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kProton);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kProton)->momentum().p3mod() / unit::GeV_c;
+  return hmpart->momentum().p3mod() / unit::GeV_c;
 }
 
 double hm_thetaprot_deg(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kProton)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kProton);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kProton)->momentum().theta() / unit::deg;
+  return hmpart->momentum().theta() / unit::deg;
 }
 
 double hm_ppip_GeV(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kPiPlus)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kPiPlus);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kPiPlus)->momentum().p3mod() / unit::GeV_c;
+  return hmpart->momentum().p3mod() / unit::GeV_c;
 }
 
 double hm_thetapip_deg(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kPiPlus)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kPiPlus);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kPiPlus)->momentum().theta() / unit::deg;
+  return hmpart->momentum().theta() / unit::deg;
 }
 
 double hm_ppim_GeV(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kPiMinus)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kPiMinus);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kPiMinus)->momentum().p3mod() /
-         unit::GeV_c;
+  return hmpart->momentum().p3mod() / unit::GeV_c;
 }
 
 double hm_thetapim_deg(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kPiMinus)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kPiMinus);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kPiMinus)->momentum().theta() / unit::deg;
+  return hmpart->momentum().theta() / unit::deg;
 }
 
 double hm_ppi0_GeV(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kPiZero)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kPiZero);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kPiZero)->momentum().p3mod() / unit::GeV_c;
+  return hmpart->momentum().p3mod() / unit::GeV_c;
 }
 
 double hm_thetapi0_deg(HepMC3::GenEvent const &ev) {
-  if (!event::has_out_part(ev, pdg::kPiZero)) {
+  auto hmpart = event::try_hm_out_part(ev, pdg::kPiZero);
+
+  if (!hmpart) {
     return kMissingDatum<double>;
   }
 
-  return event::hm_out_part(ev, pdg::kPiZero)->momentum().theta() / unit::deg;
+  return hmpart->momentum().theta() / unit::deg;
 }
 
 } // namespace ps::ext::nu
\ No newline at end of file
@@ -25,13 +25,14 @@ NEW_PS_EXCEPT(TooManyParts);
 NEW_PS_EXCEPT(InvalidProjector);
 
 template <typename PartCollectionCollection>
-inline auto cat(PartCollectionCollection const &part_groups) {
-    return ps::detail::cat(part_groups);
+std::vector<typename PartCollectionCollection::value_type::value_type>
+cat(PartCollectionCollection const &part_groups) {
+  return ps::detail::cat(part_groups);
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto sort_ascending(T const &projector,
-                           PartCollectionCollection part_groups) {
+PartCollectionCollection sort_ascending(T const &projector,
+                                        PartCollectionCollection part_groups) {
 
   if constexpr (ps::detail::is_std_vector_or_array_part<
                     PartCollectionCollection>::value) {
@@ -50,13 +51,15 @@ inline auto sort_ascending(T const &projector,
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto sort_ascending(T const &projector, PartCollectionCollection parts,
-                           ps::detail::flatten const &) {
+std::vector<HepMC3::ConstGenParticlePtr>
+sort_ascending(T const &projector, PartCollectionCollection parts,
+               ps::detail::flatten const &) {
   return sort_ascending(projector, ps::detail::cat(parts));
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto highest(T const &projector, PartCollectionCollection parts) {
+typename ps::detail::select_part_return<PartCollectionCollection>::type
+highest(T const &projector, PartCollectionCollection parts) {
   if constexpr (ps::detail::is_std_vector_or_array_part<
                     PartCollectionCollection>::value) {
     if (!parts.size()) {
@@ -97,8 +100,9 @@ inline auto highest(T const &projector, PartCollectionCollection parts) {
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto highest(T const &projector, PartCollectionCollection parts,
-                    ps::detail::flatten const &) {
+HepMC3::ConstGenParticlePtr highest(T const &projector,
+                                    PartCollectionCollection parts,
+                                    ps::detail::flatten const &) {
   auto all_parts = ps::detail::cat(parts);
   if (!all_parts.size()) {
     throw EmptyParticleList("highest: no particles");
@@ -107,7 +111,8 @@ inline auto highest(T const &projector, PartCollectionCollection parts,
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto lowest(T const &projector, PartCollectionCollection parts) {
+typename ps::detail::select_part_return<PartCollectionCollection>::type
+lowest(T const &projector, PartCollectionCollection parts) {
   if constexpr (ps::detail::is_std_vector_or_array_part<
                     PartCollectionCollection>::value) {
     if (!parts.size()) {
@@ -148,8 +153,9 @@ inline auto lowest(T const &projector, PartCollectionCollection parts) {
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto lowest(T const &projector, PartCollectionCollection parts,
-                   ps::detail::flatten const &) {
+HepMC3::ConstGenParticlePtr lowest(T const &projector,
+                                   PartCollectionCollection parts,
+                                   ps::detail::flatten const &) {
   auto all_parts = ps::detail::cat(parts);
   if (!all_parts.size()) {
     throw EmptyParticleList("lowest: no particles");
@@ -157,8 +163,69 @@ inline auto lowest(T const &projector, PartCollectionCollection parts,
   return sort_ascending(projector, all_parts).front();
 }
 
+// Like highest and lowest, but return nullptr, or nullptr entries, for empty
+// particle collections instead of throwing.
+template <typename T, typename PartCollectionCollection>
+typename ps::detail::select_part_return<PartCollectionCollection>::type
+try_highest(T const &projector, PartCollectionCollection const &parts) {
+  if constexpr (ps::detail::is_std_vector_or_array_part<
+                    PartCollectionCollection>::value) {
+    if (!parts.size()) {
+      return nullptr;
+    }
+    return highest(projector, parts);
+  } else {
+    typename ps::detail::select_part_return<PartCollectionCollection>::type
+        outs;
+    if constexpr (ps::detail::is_std_vector<PartCollectionCollection>::value) {
+      outs.resize(parts.size());
+    }
+    for (size_t i = 0; i < parts.size(); ++i) {
+      outs[i] = try_highest(projector, parts[i]);
+    }
+    return outs;
+  }
+}
+
+template <typename T, typename PartCollectionCollection>
+typename ps::detail::select_part_return<PartCollectionCollection>::type
+try_lowest(T const &projector, PartCollectionCollection const &parts) {
+  if constexpr (ps::detail::is_std_vector_or_array_part<
+                    PartCollectionCollection>::value) {
+    if (!parts.size()) {
+      return nullptr;
+    }
+    return lowest(projector, parts);
+  } else {
+    typename ps::detail::select_part_return<PartCollectionCollection>::type
+        outs;
+    if constexpr (ps::detail::is_std_vector<PartCollectionCollection>::value) {
+      outs.resize(parts.size());
+    }
+    for (size_t i = 0; i < parts.size(); ++i) {
+      outs[i] = try_lowest(projector, parts[i]);
+    }
+    return outs;
+  }
+}
+
+template <typename T, typename PartCollectionCollection>
+HepMC3::ConstGenParticlePtr try_highest(T const &projector,
+                                        PartCollectionCollection const &parts,
+                                        ps::detail::flatten const &) {
+  return try_highest(projector, ps::detail::cat(parts));
+}
+
+template <typename T, typename PartCollectionCollection>
+HepMC3::ConstGenParticlePtr try_lowest(T const &projector,
+                                       PartCollectionCollection const &parts,
+                                       ps::detail::flatten const &) {
+  return try_lowest(projector, ps::detail::cat(parts));
+}
+
 template <typename PartCollectionCollection>
-inline auto filter(ps::cuts const &c, PartCollectionCollection parts) {
+typename ps::detail::filter_return<PartCollectionCollection>::type
+filter(ps::cuts const &c, PartCollectionCollection parts) {
 
   if constexpr (ps::detail::is_std_array_part<
                     PartCollectionCollection>::value) {
@@ -185,15 +252,16 @@ inline auto filter(ps::cuts const &c, PartCollectionCollection parts) {
 }
 
 template <typename PartCollectionCollection>
-inline auto filter(ps::cuts const &c,
-                   PartCollectionCollection const &part_groups,
-                   ps::detail::flatten const &) {
+std::vector<HepMC3::ConstGenParticlePtr>
+filter(ps::cuts const &c, PartCollectionCollection const &part_groups,
+       ps::detail::flatten const &) {
 
   return filter(c, ps::detail::cat(part_groups));
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto sum(T const &projector, PartCollectionCollection const &parts) {
+typename ps::detail::sum_return<T, PartCollectionCollection>::type
+sum(T const &projector, PartCollectionCollection const &parts) {
 
   if constexpr (ps::detail::is_std_vector_or_array_part<
                     PartCollectionCollection>::value) {
@@ -235,8 +303,9 @@ inline auto sum(T const &projector, PartCollectionCollection const &parts) {
 }
 
 template <typename T, typename PartCollectionCollection>
-inline auto sum(T const &projector, PartCollectionCollection const &parts,
-                ps::detail::flatten const &) {
+typename ps::detail::projected<T>::type
+sum(T const &projector, PartCollectionCollection const &parts,
+    ps::detail::flatten const &) {
   return std::accumulate(
       parts.begin(), parts.end(), decltype(projector(parts.front().front())){},
       [&](auto const &all_tot, auto const &partarr) {
@@ -1,20 +1,36 @@
+#include "ProSelecta/MultiAnalysis.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/Progressive.h"
 #include "ProSelecta/ProSelecta_cling.h"
+#include "ProSelecta/Profiling.h"
+#include "ProSelecta/ResultStore.h"
+#include "ProSelecta/Timing.h"
 
 #include "ProSelecta/env.h"
 
+#ifdef ProSelecta_ROOT_IO
+#include "ProSelecta/ROOTIO.h"
+#endif
+
 #include "pybind11/functional.h"
 #include "pybind11/operators.h"
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 #include "pybind11/stl_bind.h"
 
+#include <cmath>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace py = pybind11;
 
 void pyProSelectaExtNuInit(py::module &);
 
 PYBIND11_MODULE(pyProSelecta, m) {
+#ifdef ProSelecta_ROOT_IO
+  ps::enable_root_io();
+#endif
   m.doc() = "ProSelecta implementation in python";
 
   m.add_object("hm", py::module::import("pyHepMC3"));
@@ -22,10 +38,56 @@ PYBIND11_MODULE(pyProSelecta, m) {
   m.def("load_file", &ps::cling::load_file);
   m.def("load_text", &ps::cling::load_text);
   m.def("load_analysis", &ps::cling::load_analysis);
+  m.def("unload_file", &ps::cling::unload_file);
+  m.def("reload_file", &ps::cling::reload_file);
+  m.def("unload_analysis", &ps::cling::unload_analysis);
+  m.def("reload_analysis", &ps::cling::reload_analysis);
   m.def("add_include_path", &ps::cling::add_include_path);
+  m.def("add_snippet_directory", &ps::cling::add_snippet_directory);
+  m.def("enable_jit_symbol_export", &ps::cling::enable_jit_symbol_export,
+        py::arg("perf") = true, py::arg("gdb") = false);
 
   m.attr("kMissingDatum") = ps::kMissingDatum<double>;
 
+  auto m_ps_timing = m.def_submodule(
+      "timing", "ProSelecta interpreter start up and JIT phase timing");
+  py::class_<ps::timing::PhaseRecord>(m_ps_timing, "PhaseRecord")
+      .def_readonly("phase", &ps::timing::PhaseRecord::phase)
+      .def_readonly("name", &ps::timing::PhaseRecord::name)
+      .def_readonly("wall_s", &ps::timing::PhaseRecord::wall_s)
+      .def_readonly("peak_rss_kb", &ps::timing::PhaseRecord::peak_rss_kb)
+      .def_readonly("peak_rss_growth_kb",
+                    &ps::timing::PhaseRecord::peak_rss_growth_kb)
+      .def("__repr__", [](ps::timing::PhaseRecord const &rec) {
+        return "<PhaseRecord " + rec.phase + ":" + rec.name + " " +
+               std::to_string(rec.wall_s) + " s>";
+      });
+  m_ps_timing.def("records", &ps::timing::records);
+  m_ps_timing.def("summary", &ps::timing::summary);
+  m_ps_timing.def("reset", &ps::timing::reset);
+
+  auto m_ps_profiling = m.def_submodule(
+      "profiling", "ProSelecta per-function hook latency profiling");
+  py::class_<ps::profiling::SlowCall>(m_ps_profiling, "SlowCall")
+      .def_readonly("seconds", &ps::profiling::SlowCall::seconds)
+      .def_readonly("event_number", &ps::profiling::SlowCall::event_number)
+      .def_readonly("nparticles", &ps::profiling::SlowCall::nparticles);
+  py::class_<ps::profiling::FunctionProfile>(m_ps_profiling, "FunctionProfile")
+      .def_readonly("kind", &ps::profiling::FunctionProfile::kind)
+      .def_readonly("name", &ps::profiling::FunctionProfile::name)
+      .def_readonly("calls", &ps::profiling::FunctionProfile::calls)
+      .def_readonly("total_s", &ps::profiling::FunctionProfile::total_s)
+      .def_readonly("p50_s", &ps::profiling::FunctionProfile::p50_s)
+      .def_readonly("p99_s", &ps::profiling::FunctionProfile::p99_s)
+      .def_readonly("max_s", &ps::profiling::FunctionProfile::max_s)
+      .def_readonly("slowest", &ps::profiling::FunctionProfile::slowest);
+  m_ps_profiling.def("enable", &ps::profiling::enable, py::arg("on") = true);
+  m_ps_profiling.def("enabled", &ps::profiling::enabled);
+  m_ps_profiling.def("profiles", &ps::profiling::profiles);
+  m_ps_profiling.def("reset", &ps::profiling::reset);
+  m_ps_profiling.def("json", &ps::profiling::json);
+  m_ps_profiling.def("write_json", &ps::profiling::write_json);
+
   auto m_ps_select = m.def_submodule("select", "ProSelecta select interface");
   m_ps_select.def("get", &ps::cling::get_select_func);
   m_ps_select.def("get_vect", &ps::cling::get_selects_func);
@@ -38,6 +100,247 @@ PYBIND11_MODULE(pyProSelecta, m) {
   auto m_ps_weight = m.def_submodule("weight", "ProSelecta weight interface");
   m_ps_weight.def("get", &ps::cling::get_weight_func);
 
+  // Each analysis is a dict with a select function name, optional lists of
+  // project and weight function names, an output path, and an optional
+  // output format and name. The functions are looked up here so that the
+  // event loop never calls back into python, and it runs without the GIL.
+  // If store is a directory, the results of each analysis on each input are
+  // kept there, keyed by the content of the input and of the source of each
+  // function, found in the sources files or snippet_dirs with the headers
+  // that they include from include_paths, see ps::HookSources, and only
+  // inputs without results are read.
+  m.def(
+      "run_analyses",
+      [](std::vector<std::string> const &inputs,
+         std::vector<py::dict> const &specs, size_t nthreads,
+         size_t batch_size, size_t nreaders, std::string const &store_dir,
+         std::vector<std::string> const &sources,
+         std::vector<std::string> const &snippet_dirs,
+         std::vector<std::string> const &include_paths) {
+        if (store_dir.size() && sources.empty() && snippet_dirs.empty()) {
+          throw std::runtime_error(
+              "A result store requires the sources that define the "
+              "analysis functions.");
+        }
+
+        auto get_names = [](py::dict const &spec, char const *key) {
+          return spec.contains(key)
+                     ? spec[key].cast<std::vector<std::string>>()
+                     : std::vector<std::string>{};
+        };
+        auto lookup_failed = [](char const *kind, std::string const &name) {
+          return std::runtime_error("Failed to find " + std::string(kind) +
+                                    " function: " + name);
+        };
+
+        std::vector<ps::Analysis> analyses;
+        for (auto const &spec : specs) {
+          ps::Analysis ana;
+          std::string sel_name = spec["select"].cast<std::string>();
+          ana.name = spec.contains("name") ? spec["name"].cast<std::string>()
+                                           : sel_name;
+          ana.output_path = spec["output"].cast<std::string>();
+          if (spec.contains("format")) {
+            ana.output_format = spec["format"].cast<std::string>();
+          }
+
+          ana.select_name = sel_name;
+          ana.hooks.select = ps::cling::get_select_func(sel_name);
+          if (!ana.hooks.select) {
+            throw lookup_failed("selection", sel_name);
+          }
+          for (auto const &name : get_names(spec, "project")) {
+            ana.hooks.projections.push_back(
+                ps::cling::get_projection_func(name));
+            if (!ana.hooks.projections.back()) {
+              throw lookup_failed("projection", name);
+            }
+            ana.columns.projections.push_back(name);
+          }
+          for (auto const &name : get_names(spec, "weight")) {
+            ana.hooks.weights.push_back(ps::cling::get_weight_func(name));
+            if (!ana.hooks.weights.back()) {
+              throw lookup_failed("weight", name);
+            }
+            ana.columns.weights.push_back(name);
+          }
+          analyses.push_back(std::move(ana));
+        }
+
+        ps::AnalysesResult res{0, {}};
+        {
+          py::gil_scoped_release nogil;
+          if (store_dir.size()) {
+            ps::ResultStore store(store_dir);
+            res = ps::run_analyses(
+                ps::expand_input_paths(inputs), store,
+                ps::HookSources(sources, snippet_dirs, include_paths),
+                analyses, nthreads, batch_size);
+          } else {
+            ps::MultiFileReader rdr(ps::expand_input_paths(inputs), nreaders);
+            res = ps::run_analyses(rdr, analyses, nthreads, batch_size);
+          }
+        }
+
+        py::dict selected;
+        for (size_t i = 0; i < analyses.size(); ++i) {
+          selected[py::str(analyses[i].name)] = res.events_selected[i];
+        }
+        py::dict out;
+        out["events_read"] = res.events_read;
+        out["events_selected"] = selected;
+        return out;
+      },
+      py::arg("inputs"), py::arg("analyses"), py::arg("nthreads") = 1,
+      py::arg("batch_size") = 256, py::arg("readers") = 4,
+      py::arg("store") = "", py::arg("sources") = std::vector<std::string>{},
+      py::arg("snippet_dirs") = std::vector<std::string>{},
+      py::arg("include_paths") = std::vector<std::string>{});
+
+  // Estimates the number of events that pass the select function, and the
+  // histograms, from blocks of events read in a random order, see
+  // ps::run_progressive. Each histogram is a dict with a name, a list of
+  // axes, each either (projection, nbins, low, high) or (projection, edges),
+  // an optional list of weight function names, and an optional select
+  // function name. If callback is given, it is called with the estimates
+  // after every block, and sampling stops early if it returns False. The
+  // estimates are returned as a dict, as passed to callback, with (value,
+  // error) pairs for the number of selected events and the efficiency, and
+  // the flattened bin contents of each histogram, including the underflow
+  // and overflow bins, and their errors. The exact histograms match those of
+  // ProSelectaCPP --Hist run with --shard-chunk chunk_size.
+  m.def(
+      "run_progressive",
+      [](std::vector<std::string> const &inputs, std::string const &select,
+         std::vector<py::dict> const &histograms, size_t block_events,
+         double precision, size_t min_blocks, double time_budget, bool exact,
+         uint64_t seed, size_t nthreads, py::object const &callback,
+         size_t chunk_size) {
+        auto lookup_failed = [](char const *kind, std::string const &name) {
+          return std::runtime_error("Failed to find " + std::string(kind) +
+                                    " function: " + name);
+        };
+
+        ps::SelectFunc sel;
+        if (select.size()) {
+          sel = ps::cling::get_select_func(select);
+          if (!sel) {
+            throw lookup_failed("selection", select);
+          }
+        }
+
+        std::vector<ps::HistogramSpec> specs;
+        for (auto const &hist : histograms) {
+          ps::HistogramSpec spec;
+          spec.name = hist["name"].cast<std::string>();
+          for (auto const &ax :
+               hist["axes"].cast<std::vector<py::sequence>>()) {
+            auto const name = ax[0].cast<std::string>();
+            spec.projections.push_back(ps::cling::get_projection_func(name));
+            if (!spec.projections.back()) {
+              throw lookup_failed("projection", name);
+            }
+            if (ax.size() == 4) {
+              spec.axes.push_back(ps::HistogramAxis::uniform(
+                  ax[1].cast<size_t>(), ax[2].cast<double>(),
+                  ax[3].cast<double>()));
+            } else if (ax.size() == 2) {
+              spec.axes.push_back(
+                  ps::HistogramAxis{ax[1].cast<std::vector<double>>()});
+            } else {
+              throw std::runtime_error(
+                  "Histogram axes must be (projection, nbins, low, high) or "
+                  "(projection, edges): " +
+                  spec.name);
+            }
+          }
+          if (hist.contains("weight")) {
+            for (auto const &name :
+                 hist["weight"].cast<std::vector<std::string>>()) {
+              spec.weights.push_back(ps::cling::get_weight_func(name));
+              if (!spec.weights.back()) {
+                throw lookup_failed("weight", name);
+              }
+            }
+          }
+          if (hist.contains("select")) {
+            auto const name = hist["select"].cast<std::string>();
+            spec.select = ps::cling::get_select_func(name);
+            if (!spec.select) {
+              throw lookup_failed("selection", name);
+            }
+          }
+          specs.push_back(std::move(spec));
+        }
+
+        auto to_dict = [](ps::ProgressiveEstimate const &est) {
+          py::dict hists;
+          for (auto const &h : est.histograms) {
+            std::vector<std::vector<double>> edges;
+            for (auto const &ax : h.axes) {
+              edges.push_back(ax.edges);
+            }
+            std::vector<double> errors;
+            for (auto sumw2 : h.sumw2) {
+              errors.push_back(std::sqrt(sumw2));
+            }
+            py::dict hd;
+            hd["edges"] = edges;
+            hd["values"] = h.sumw;
+            hd["errors"] = errors;
+            hd["entries"] = h.entries;
+            hists[py::str(h.name)] = hd;
+          }
+          py::dict out;
+          out["blocks_read"] = est.blocks_read;
+          out["nblocks"] = est.nblocks;
+          out["events_read"] = est.events_read;
+          out["nevents"] = est.nevents;
+          out["elapsed_s"] = est.elapsed_s;
+          out["exact"] = est.exact;
+          out["selected"] =
+              py::make_tuple(est.selected.value, est.selected.error);
+          out["efficiency"] =
+              py::make_tuple(est.efficiency.value, est.efficiency.error);
+          out["histograms"] = hists;
+          return out;
+        };
+
+        std::function<bool(ps::ProgressiveEstimate const &)> progress;
+        if (!callback.is_none()) {
+          progress = [&](ps::ProgressiveEstimate const &est) {
+            py::gil_scoped_acquire gil;
+            auto more = callback(to_dict(est));
+            return more.is_none() || more.cast<bool>();
+          };
+        }
+
+        ps::ProgressiveOptions opts;
+        opts.block_events = block_events;
+        opts.precision = precision;
+        opts.min_blocks = min_blocks;
+        opts.time_budget_s = time_budget;
+        opts.exact = exact;
+        opts.chunk_size = chunk_size;
+        opts.seed = seed;
+        opts.nthreads = nthreads;
+
+        ps::ProgressiveEstimate est;
+        {
+          py::gil_scoped_release nogil;
+          est = ps::run_progressive(ps::expand_input_paths(inputs), sel, specs,
+                                    opts, progress);
+        }
+        return to_dict(est);
+      },
+      py::arg("inputs"), py::arg("select") = "",
+      py::arg("histograms") = std::vector<py::dict>{},
+      py::arg("block_events") = 4096, py::arg("precision") = 0.0,
+      py::arg("min_blocks") = 10, py::arg("time_budget") = 0.0,
+      py::arg("exact") = false, py::arg("seed") = 0, py::arg("nthreads") = 1,
+      py::arg("callback") = py::none(),
+      py::arg("chunk_size") = ps::EventRange().chunk_size);
+
   py::class_<ps::cuts>(m, "cuts")
       .def("__call__", &ps::cuts::operator(), py::arg("event"))
       .def("__and__", &ps::cuts::operator&&, py::arg("other"))
@@ -138,6 +441,9 @@ PYBIND11_MODULE(pyProSelecta, m) {
   EVENT_INT_OR_VECTPID_BINDING(m_ps_event, beam_part);
   EVENT_INT_OR_VECTPID_BINDING(m_ps_event, has_target_part);
   EVENT_INT_OR_VECTPID_BINDING(m_ps_event, target_part);
+  EVENT_INT_OR_VECTPID_flatten_BINDING(m_ps_event, try_hm_out_part);
+  EVENT_INT_OR_VECTPID_BINDING(m_ps_event, try_beam_part);
+  EVENT_INT_OR_VECTPID_BINDING(m_ps_event, try_target_part);
   m_ps_event
       .def(
           "out_nuclear_parts",
@@ -146,6 +452,8 @@ PYBIND11_MODULE(pyProSelecta, m) {
           },
           py::arg("event"))
       .def("signal_process_id", &ps::event::signal_process_id, py::arg("event"))
+      .def("try_signal_process_id", &ps::event::try_signal_process_id,
+           py::arg("event"))
       .def("has_exact_out_part",
            [](HepMC3::GenEvent const &ev, int PID, int count) {
              return ps::event::has_exact_out_part(ev, PID, count);
@@ -205,6 +513,8 @@ PYBIND11_MODULE(pyProSelecta, m) {
   PARTSFUNC_BINDINGS(m_ps_part, sort_ascending);
   PARTSFUNC_BINDINGS(m_ps_part, highest);
   PARTSFUNC_BINDINGS(m_ps_part, lowest);
+  PARTSFUNC_BINDINGS(m_ps_part, try_highest);
+  PARTSFUNC_BINDINGS(m_ps_part, try_lowest);
   PARTSFUNC_BINDINGS(m_ps_part, sum);
   m_ps_part
       .def(
@@ -43,7 +43,7 @@ void pyProSelectaExtNuInit(py::module &m) {
           "signal_process_id_filter",
           [](int sid) -> ps::SelectFunc {
             return [sid](HepMC3::GenEvent const &ev) {
-              return ps::event::signal_process_id(ev) == sid;
+              return ps::event::try_signal_process_id(ev) == sid;
             };
           },
           py::arg("signal_process_id"))
@@ -51,8 +51,8 @@ void pyProSelectaExtNuInit(py::module &m) {
           "signal_process_id_filter",
           [](int sid_low, int sid_high) -> ps::SelectFunc {
             return [sid_low, sid_high](HepMC3::GenEvent const &ev) {
-              return !((ps::event::signal_process_id(ev) < sid_low) ||
-                       (ps::event::signal_process_id(ev) > sid_high));
+              auto sid = ps::event::try_signal_process_id(ev);
+              return sid && !((*sid < sid_low) || (*sid > sid_high));
             };
           },
           py::arg("signal_process_id_min"), py::arg("signal_process_id_max"));
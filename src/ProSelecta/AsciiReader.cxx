@@ -0,0 +1,513 @@
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/Metrics.h"
+
+#include "HepMC3/Data/GenRunInfoData.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace ps {
+
+namespace {
+
+char const version_line[] = "HepMC::Version";
+char const start_line[] = "HepMC::Asciiv3-START_EVENT_LISTING";
+char const end_line[] = "HepMC::Asciiv3-END_EVENT_LISTING";
+
+bool is_space(char c) { return (c == ' ') || (c == '\t') || (c == '\r'); }
+
+bool starts_with(char const *b, char const *e, std::string_view prefix) {
+  return (size_t(e - b) >= prefix.size()) &&
+         !std::memcmp(b, prefix.data(), prefix.size());
+}
+
+// The end of the line starting at b, before its newline
+char const *line_end(char const *b, char const *e) {
+  auto nl = static_cast<char const *>(std::memchr(b, '\n', e - b));
+  return nl ? nl : e;
+}
+
+// The start of the line after the one ending at eol
+char const *next_line(char const *eol, char const *e) {
+  return (eol < e) ? (eol + 1) : e;
+}
+
+// The start of the first event line at or after b
+char const *find_event(char const *b, char const *e) {
+  while ((b < e) && (*b != 'E')) {
+    b = next_line(line_end(b, e), e);
+  }
+  return b;
+}
+
+// The space-separated fields of a line
+struct Fields {
+  char const *pos;
+  char const *end;
+
+  void skip_space() {
+    while ((pos < end) && is_space(*pos)) {
+      ++pos;
+    }
+  }
+
+  template <typename T> bool number(T &v) {
+    skip_space();
+    auto res = std::from_chars(pos, end, v);
+    if (res.ec != std::errc()) {
+      return false;
+    }
+    pos = res.ptr;
+    return true;
+  }
+
+  std::string_view word() {
+    skip_space();
+    char const *b = pos;
+    while ((pos < end) && !is_space(*pos)) {
+      ++pos;
+    }
+    return std::string_view(b, pos - b);
+  }
+
+  bool expect(char c) {
+    skip_space();
+    if ((pos < end) && (*pos == c)) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  // The rest of the line after a single separating space
+  std::string_view rest() {
+    if ((pos < end) && (*pos == ' ')) {
+      ++pos;
+    }
+    char const *e = end;
+    if ((e > pos) && (e[-1] == '\r')) {
+      --e;
+    }
+    return std::string_view(pos, e - pos);
+  }
+};
+
+// HepMC3 writes newlines in strings as \| and backslashes as \\, see
+// HepMC3::WriterAscii
+void unescape(std::string_view str, std::string &out) {
+  out.clear();
+  if (str.find('\\') == std::string_view::npos) {
+    out.assign(str.data(), str.size());
+    return;
+  }
+  out.reserve(str.size());
+  for (size_t i = 0; i < str.size(); ++i) {
+    if ((str[i] == '\\') && ((i + 1) < str.size())) {
+      ++i;
+      out += (str[i] == '|') ? '\n' : str[i];
+    } else {
+      out += str[i];
+    }
+  }
+}
+
+} // namespace
+
+AsciiReader::AsciiReader(std::string const &p, AsciiReaderOptions o)
+    : path(p), opts(o), map(nullptr), map_size(0), pos(nullptr),
+      run_info_begin(0), run_info_end(0), is_failed(false), metrics(nullptr),
+      data(),
+      vertex_used(), implicit_parents(), implicit_children() {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if ((fd < 0) || fstat(fd, &st)) {
+    std::stringstream ss("");
+    ss << "Failed to open HepMC3 file: " << path << ": "
+       << std::strerror(errno);
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    throw std::runtime_error(ss.str());
+  }
+  map_size = st.st_size;
+  if (map_size) {
+    void *m = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    map = (m == MAP_FAILED) ? nullptr : static_cast<char const *>(m);
+  }
+  ::close(fd);
+  if (!map) {
+    throw std::runtime_error("Failed to map HepMC3 file: " + path);
+  }
+  madvise(const_cast<char *>(map), map_size, MADV_SEQUENTIAL);
+
+  char const *end = map + map_size;
+  char const *second = next_line(line_end(map, end), end);
+  if (!starts_with(map, end, version_line) ||
+      !starts_with(second, end, start_line)) {
+    munmap(const_cast<char *>(map), map_size);
+    map = nullptr;
+    throw std::runtime_error("Not a HepMC3 ASCII file: " + path);
+  }
+  pos = next_line(line_end(second, end), end);
+  run_info_begin = pos - map;
+
+  try {
+    read_run_info();
+    run_info_end = pos - map;
+  } catch (...) {
+    munmap(const_cast<char *>(map), map_size);
+    map = nullptr;
+    throw;
+  }
+}
+
+AsciiReader::~AsciiReader() { close(); }
+
+void AsciiReader::throw_malformed(char const *line, char const *eol,
+                                  char const *what) const {
+  std::stringstream ss("");
+  ss << "Malformed HepMC3 ASCII at byte " << (line - map) << " of " << path
+     << ", " << what << ": "
+     << std::string_view(line, std::min<size_t>(eol - line, 80));
+  throw std::runtime_error(ss.str());
+}
+
+// The run info is the weight names, tools, and run attributes before the
+// first event
+void AsciiReader::read_run_info() {
+  char const *end = map + map_size;
+  HepMC3::GenRunInfoData rid;
+  std::string str;
+  while ((pos < end) && (*pos != 'E')) {
+    char const *eol = line_end(pos, end);
+    Fields f{pos + 1, eol};
+    if (*pos == 'W') {
+      for (auto name = f.word(); name.size(); name = f.word()) {
+        rid.weight_names.emplace_back(name);
+      }
+    } else if (*pos == 'T') {
+      f.skip_space();
+      // the name, version, and description are separated by newlines
+      unescape(f.rest(), str);
+      size_t a = str.find('\n');
+      size_t b = (a == std::string::npos) ? a : str.find('\n', a + 1);
+      rid.tool_name.push_back(str.substr(0, a));
+      rid.tool_version.push_back(
+          (a == std::string::npos) ? "" : str.substr(a + 1, b - a - 1));
+      rid.tool_description.push_back(
+          (b == std::string::npos) ? "" : str.substr(b + 1));
+    } else if (*pos == 'A') {
+      auto name = f.word();
+      if (name.empty()) {
+        throw_malformed(pos, eol, "expected a run attribute name");
+      }
+      rid.attribute_name.emplace_back(name);
+      unescape(f.rest(), str);
+      rid.attribute_string.push_back(str);
+    }
+    pos = next_line(eol, end);
+  }
+
+  auto run = std::make_shared<HepMC3::GenRunInfo>();
+  run->read_data(rid);
+  set_run_info(run);
+}
+
+void AsciiReader::set_metrics(LoopMetrics *m) { metrics = m; }
+
+void AsciiReader::count_bytes(char const *from) {
+  if (metrics) {
+    metrics->bytes_read.fetch_add(pos - from, std::memory_order_relaxed);
+  }
+}
+
+bool AsciiReader::read_data(HepMC3::GenEventData &d) {
+  if (!map) {
+    is_failed = true;
+    return false;
+  }
+  char const *const from = pos;
+  char const *end = map + map_size;
+  pos = find_event(pos, end);
+  if (pos >= end) {
+    is_failed = true;
+    return false;
+  }
+
+  char const *eol = line_end(pos, end);
+  Fields ev{pos + 1, eol};
+  size_t nvertices, nparticles;
+  if (!ev.number(d.event_number) || !ev.number(nvertices) ||
+      !ev.number(nparticles) || (nvertices > map_size) ||
+      (nparticles > map_size)) {
+    throw_malformed(pos, eol, "expected E <number> <nvertices> <nparticles>");
+  }
+  d.momentum_unit = HepMC3::Units::GEV;
+  d.length_unit = HepMC3::Units::MM;
+  d.particles.clear();
+  d.particles.reserve(nparticles);
+  d.vertices.assign(nvertices, HepMC3::GenVertexData{0, HepMC3::FourVector()});
+  vertex_used.assign(nvertices, 0);
+  d.weights.clear();
+  d.event_pos = HepMC3::FourVector();
+  d.links1.clear();
+  d.links2.clear();
+  d.attribute_id.clear();
+  d.attribute_name.clear();
+  d.attribute_string.clear();
+  implicit_parents.clear();
+
+  auto position = [&](Fields &f, HepMC3::FourVector &v, char const *line) {
+    double x, y, z, t;
+    if (!f.number(x) || !f.number(y) || !f.number(z) || !f.number(t)) {
+      throw_malformed(line, f.end, "expected a position @ <x> <y> <z> <t>");
+    }
+    v = HepMC3::FourVector(x, y, z, t);
+  };
+  auto add_attribute = [&](int id, std::string_view name,
+                           std::string_view value) {
+    d.attribute_id.push_back(id);
+    d.attribute_name.emplace_back(name);
+    d.attribute_string.emplace_back();
+    unescape(value, d.attribute_string.back());
+  };
+
+  if (!opts.skip_positions && ev.expect('@')) {
+    position(ev, d.event_pos, pos);
+  }
+
+  for (pos = next_line(eol, end); (pos < end) && (*pos != 'E');
+       pos = next_line(eol, end)) {
+    char const *line = pos;
+    eol = line_end(line, end);
+    Fields f{line + 1, eol};
+
+    if (*line == 'P') {
+      int id, parent, pid, status;
+      double px, py, pz, e, m;
+      if (!f.number(id) || !f.number(parent) || !f.number(pid) ||
+          !f.number(px) || !f.number(py) || !f.number(pz) || !f.number(e) ||
+          !f.number(m) || !f.number(status)) {
+        throw_malformed(line, eol,
+                        "expected P <id> <parent> <pid> <px> <py> <pz> <e> "
+                        "<m> <status>");
+      }
+      if (size_t(id) != (d.particles.size() + 1)) {
+        throw_malformed(line, eol, "particles are not numbered in order");
+      }
+      d.particles.push_back(HepMC3::GenParticleData{
+          pid, status, true, m, HepMC3::FourVector(px, py, pz, e)});
+      if (parent < 0) {
+        d.links1.push_back(parent);
+        d.links2.push_back(id);
+      } else if (parent > 0) {
+        // a child of a particle, through an implicit vertex
+        size_t i = std::find(implicit_parents.begin(), implicit_parents.end(),
+                             parent) -
+                   implicit_parents.begin();
+        if (i == implicit_parents.size()) {
+          implicit_parents.push_back(parent);
+          if (i == implicit_children.size()) {
+            implicit_children.emplace_back();
+          }
+          implicit_children[i].clear();
+        }
+        implicit_children[i].push_back(id);
+      }
+    } else if (*line == 'V') {
+      int64_t id;
+      int status;
+      if (!f.number(id) || !f.number(status) || (id >= 0) ||
+          (size_t(-id) > map_size) || !f.expect('[')) {
+        throw_malformed(line, eol, "expected V <id> <status> [<in>,...]");
+      }
+      if (!f.expect(']')) {
+        do {
+          int in;
+          if (!f.number(in)) {
+            throw_malformed(line, eol, "expected an incoming particle id");
+          }
+          d.links1.push_back(in);
+          d.links2.push_back(int(id));
+        } while (f.expect(','));
+        if (!f.expect(']')) {
+          throw_malformed(line, eol, "expected ] after incoming particles");
+        }
+      }
+      size_t v = size_t(-id) - 1;
+      if (v >= d.vertices.size()) {
+        d.vertices.resize(v + 1, HepMC3::GenVertexData{0, {}});
+        vertex_used.resize(v + 1, 0);
+      }
+      d.vertices[v].status = status;
+      vertex_used[v] = 1;
+      if (!opts.skip_positions && f.expect('@')) {
+        position(f, d.vertices[v].position, line);
+      }
+    } else if (*line == 'W') {
+      double w;
+      while (f.number(w)) {
+        d.weights.push_back(w);
+      }
+      if (!f.word().empty()) {
+        throw_malformed(line, eol, "expected weight values");
+      }
+    } else if (*line == 'U') {
+      auto momentum = f.word();
+      auto length = f.word();
+      if (((momentum != "GEV") && (momentum != "MEV")) ||
+          ((length != "MM") && (length != "CM"))) {
+        throw_malformed(line, eol, "expected U <GEV|MEV> <MM|CM>");
+      }
+      d.momentum_unit =
+          (momentum == "GEV") ? HepMC3::Units::GEV : HepMC3::Units::MEV;
+      d.length_unit = (length == "MM") ? HepMC3::Units::MM : HepMC3::Units::CM;
+    } else if (starts_with(line, eol, "HepMC::")) {
+      if (starts_with(line, eol, end_line)) {
+        pos = next_line(eol, end);
+        break;
+      }
+    } else if (opts.skip_attributes) {
+      continue;
+    } else if (*line == 'A') {
+      int id;
+      auto name = (f.number(id) ? f.word() : std::string_view());
+      if (name.empty()) {
+        throw_malformed(line, eol, "expected A <id> <name> <value>");
+      }
+      add_attribute(id, name, f.rest());
+    } else if (*line == 'C') {
+      // the cross section, heavy ion, and PDF lines of HepMC3 3.0
+      add_attribute(0, "GenCrossSection", f.rest());
+    } else if (*line == 'H') {
+      add_attribute(0, "GenHeavyIon", f.rest());
+    } else if (*line == 'F') {
+      add_attribute(0, "GenPdfInfo", f.rest());
+    }
+  }
+
+  // implicit vertices take the ids that the explicit vertices left free
+  size_t v = 0;
+  for (size_t i = 0; i < implicit_parents.size(); ++i) {
+    while ((v < vertex_used.size()) && vertex_used[v]) {
+      ++v;
+    }
+    if (v == vertex_used.size()) {
+      d.vertices.push_back(HepMC3::GenVertexData{0, {}});
+      vertex_used.push_back(0);
+    }
+    vertex_used[v] = 1;
+    int const id = -int(v + 1);
+    d.links1.push_back(implicit_parents[i]);
+    d.links2.push_back(id);
+    for (int child : implicit_children[i]) {
+      d.links1.push_back(id);
+      d.links2.push_back(child);
+    }
+  }
+  while (d.vertices.size() && !vertex_used[d.vertices.size() - 1]) {
+    d.vertices.pop_back();
+  }
+
+  // GenEvent::read_data does not check the links
+  int const nparts = int(d.particles.size());
+  int const nverts = int(d.vertices.size());
+  for (size_t i = 0; i < d.links1.size(); ++i) {
+    int p = (d.links1[i] > 0) ? d.links1[i] : d.links2[i];
+    int v = (d.links1[i] > 0) ? d.links2[i] : d.links1[i];
+    if ((p < 1) || (p > nparts) || (v > -1) || (v < -nverts)) {
+      std::stringstream ss("");
+      ss << "Malformed HepMC3 ASCII in event " << d.event_number << " of "
+         << path << ", a vertex refers to a missing particle, or a particle "
+         << "to a missing vertex.";
+      throw std::runtime_error(ss.str());
+    }
+  }
+  count_bytes(from);
+  return true;
+}
+
+size_t AsciiReader::tell() {
+  if (!map) {
+    return 0;
+  }
+  pos = find_event(pos, map + map_size);
+  return pos - map;
+}
+
+bool AsciiReader::seek(size_t offset) {
+  if (!map || (offset >= map_size) || (map[offset] != 'E') ||
+      (offset && (map[offset - 1] != '\n'))) {
+    return false;
+  }
+  pos = map + offset;
+  is_failed = false;
+  return true;
+}
+
+bool AsciiReader::read_event(HepMC3::GenEvent &evt) {
+  if (!read_data(data)) {
+    return false;
+  }
+  evt.read_data(data);
+  evt.set_run_info(run_info());
+  return true;
+}
+
+bool AsciiReader::skip(const int nevents) {
+  if (!map) {
+    is_failed = true;
+    return false;
+  }
+  char const *const from = pos;
+  char const *end = map + map_size;
+  bool found = true;
+  for (int i = 0; found && (i < nevents); ++i) {
+    pos = find_event(pos, end);
+    if (pos >= end) {
+      is_failed = true;
+      found = false;
+    } else {
+      pos = find_event(next_line(line_end(pos, end), end), end);
+    }
+  }
+  count_bytes(from);
+  return found;
+}
+
+void AsciiReader::close() {
+  if (map) {
+    munmap(const_cast<char *>(map), map_size);
+    map = nullptr;
+  }
+  is_failed = true;
+}
+
+bool is_hepmc3_ascii(std::string const &path) {
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"),
+                                           &std::fclose);
+  if (!f) {
+    return false;
+  }
+  char head[256];
+  size_t n = std::fread(head, 1, sizeof(head), f.get());
+  char const *second = next_line(line_end(head, head + n), head + n);
+  return starts_with(head, head + n, version_line) &&
+         starts_with(second, head + n, start_line);
+}
+
+} // namespace ps
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "HepMC3/Data/GenEventData.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/Reader.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+struct LoopMetrics;
+
+// The parts of the event record that an AsciiReader can leave out, for
+// analyses that never look at them
+struct AsciiReaderOptions {
+  // leave event and vertex positions at zero rather than parsing them
+  bool skip_positions = false;
+  // drop the attributes of events, particles, and vertices, the run
+  // attributes are always read
+  bool skip_attributes = false;
+};
+
+// Reads HepMC3 ASCII files, as HepMC3::ReaderAscii does, but through a
+// read-only memory map. Lines are found with memchr, and numbers are parsed
+// with std::from_chars, straight into a reused HepMC3::GenEventData, so that
+// reading an event costs little more than the GenEvent::read_data that builds
+// it, and nothing if read_data is called instead of read_event. Skipping only
+// looks for the start of each event.
+//
+// Vertices that the writer left implicit, those with a single incoming
+// particle and no position or attributes, are given the ids that the event's
+// explicit vertices left free, in the order that they are found. Malformed
+// lines are reported by throwing std::runtime_error.
+class AsciiReader : public HepMC3::Reader {
+  std::string path;
+  AsciiReaderOptions opts;
+  char const *map;
+  size_t map_size;
+  // the start of the next line to parse
+  char const *pos;
+  // the byte range of the run info lines
+  size_t run_info_begin;
+  size_t run_info_end;
+  bool is_failed;
+  LoopMetrics *metrics;
+  HepMC3::GenEventData data;
+  // whether each vertex id of the event being read has been given out
+  std::vector<char> vertex_used;
+  // the implicit vertices of the event being read, the parent particle and
+  // the children of each
+  std::vector<int> implicit_parents;
+  std::vector<std::vector<int>> implicit_children;
+
+  [[noreturn]] void throw_malformed(char const *line, char const *eol,
+                                    char const *what) const;
+  void read_run_info();
+  void count_bytes(char const *from);
+
+public:
+  explicit AsciiReader(std::string const &path,
+                       AsciiReaderOptions opts = AsciiReaderOptions());
+  ~AsciiReader();
+
+  // Adds the bytes of the events read or skipped to metrics->bytes_read from
+  // now on, metrics must outlive the reader
+  void set_metrics(LoopMetrics *metrics);
+
+  // Fills data with the next event, without building a GenEvent
+  bool read_data(HepMC3::GenEventData &data);
+
+  // The byte offset of the next event line, or the size of the file at the
+  // end of the events
+  size_t tell();
+  // Continues from the event line at byte offset, such as one from tell or
+  // an EventIndex. Returns false, and does not move, if no event line starts
+  // there.
+  bool seek(size_t offset);
+  // The byte offset and size of the run info lines before the first event
+  size_t run_info_offset() const { return run_info_begin; }
+  size_t run_info_size() const { return run_info_end - run_info_begin; }
+
+  bool read_event(HepMC3::GenEvent &evt) override;
+  bool skip(const int nevents) override;
+  bool failed() override { return is_failed; }
+  void close() override;
+};
+
+// Whether the file at path is uncompressed HepMC3 ASCII
+bool is_hepmc3_ascii(std::string const &path);
+
+} // namespace ps
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace ps {
+
+// A blocking first-in-first-out queue that holds at most capacity items, used
+// to hand work between the threads of the event loop.
+//
+// Once closed, push fails immediately and pop drains any remaining items
+// before returning std::nullopt.
+template <typename T> class BoundedQueue {
+  std::mutex mtx;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+  std::deque<T> items;
+  size_t capacity;
+  bool closed;
+
+public:
+  explicit BoundedQueue(size_t cap) : capacity(cap ? cap : 1), closed(false) {}
+  BoundedQueue(BoundedQueue const &) = delete;
+  BoundedQueue &operator=(BoundedQueue const &) = delete;
+
+  // blocks while the queue is full, returns false if the queue was closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lk(mtx);
+    not_full.wait(lk, [&]() { return closed || (items.size() < capacity); });
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(item));
+    lk.unlock();
+    not_empty.notify_one();
+    return true;
+  }
+
+  // blocks while the queue is empty, returns std::nullopt once the queue is
+  // closed and drained
+  std::optional<T> pop() {
+    std::unique_lock<std::mutex> lk(mtx);
+    not_empty.wait(lk, [&]() { return closed || !items.empty(); });
+    if (items.empty()) {
+      return std::nullopt;
+    }
+    std::optional<T> item(std::move(items.front()));
+    items.pop_front();
+    lk.unlock();
+    not_full.notify_one();
+    return item;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lk(mtx);
+      closed = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+};
+
+} // namespace ps
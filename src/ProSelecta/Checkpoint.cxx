@@ -0,0 +1,155 @@
+#include "ProSelecta/Checkpoint.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+template <typename T> void append_pod(std::string &buf, T const &v) {
+  buf.append(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+void append_string(std::string &buf, std::string const &str) {
+  append_pod(buf, uint64_t(str.size()));
+  buf += str;
+}
+
+void append_strings(std::string &buf, std::vector<std::string> const &strs) {
+  append_pod(buf, uint64_t(strs.size()));
+  for (auto const &str : strs) {
+    append_string(buf, str);
+  }
+}
+
+void read_or_throw(FILE *f, std::string const &path, void *data,
+                   size_t size) {
+  if (size && (std::fread(data, 1, size, f) != size)) {
+    throw std::runtime_error("Unexpected end of checkpoint file: " + path);
+  }
+}
+
+template <typename T> T read_pod(FILE *f, std::string const &path) {
+  T v;
+  read_or_throw(f, path, &v, sizeof(T));
+  return v;
+}
+
+std::string read_string(FILE *f, std::string const &path) {
+  std::string str(read_pod<uint64_t>(f, path), '\0');
+  read_or_throw(f, path, str.data(), str.size());
+  return str;
+}
+
+std::vector<std::string> read_strings(FILE *f, std::string const &path) {
+  std::vector<std::string> strs(read_pod<uint64_t>(f, path));
+  for (auto &str : strs) {
+    str = read_string(f, path);
+  }
+  return strs;
+}
+
+[[noreturn]] void throw_errno(char const *what, std::string const &path) {
+  std::stringstream ss("");
+  ss << what << ": " << path << ": " << std::strerror(errno);
+  throw std::runtime_error(ss.str());
+}
+
+} // namespace
+
+char const Checkpoint::magic[9] = "PSCKPT02";
+
+void Checkpoint::write(std::string const &path) const {
+  std::string buf(magic, 8);
+  append_pod(buf, uint64_t(next_evtnum));
+  append_pod(buf, uint64_t(input.file));
+  append_pod(buf, uint64_t(input.events));
+  append_string(buf, select);
+  append_string(buf, output_path);
+  append_strings(buf, columns.projections);
+  append_strings(buf, columns.weights);
+  append_strings(buf, columns.selections);
+  append_pod(buf, output_size);
+  append_string(buf, summary.str());
+
+  append_pod(buf, uint8_t(bool(histograms)));
+  if (histograms) {
+    append_histograms(buf, histograms->total);
+    append_pod(buf, uint8_t(bool(histograms->current)));
+    if (histograms->current) {
+      append_pod(buf, uint64_t(histograms->current->index));
+      append_histograms(buf, histograms->current->histograms);
+    }
+    append_pod(buf, uint64_t(histograms->chunks.size()));
+    for (auto const &chunk : histograms->chunks) {
+      append_pod(buf, uint64_t(chunk.index));
+      append_histograms(buf, chunk.histograms);
+    }
+  }
+
+  std::string tmp = path + ".tmp";
+  FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (!f) {
+    throw_errno("Failed to open checkpoint file", tmp);
+  }
+  bool ok = (std::fwrite(buf.data(), 1, buf.size(), f) == buf.size()) &&
+            !std::fflush(f) && !fsync(fileno(f));
+  ok = !std::fclose(f) && ok;
+  if (!ok) {
+    throw_errno("Failed writing checkpoint file", tmp);
+  }
+  if (std::rename(tmp.c_str(), path.c_str())) {
+    throw_errno("Failed to replace checkpoint file", path);
+  }
+}
+
+Checkpoint Checkpoint::read(std::string const &path) {
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"),
+                                           &std::fclose);
+  if (!f) {
+    throw_errno("Failed to open checkpoint file", path);
+  }
+  char file_magic[8];
+  if ((std::fread(file_magic, 1, 8, f.get()) != 8) ||
+      std::memcmp(file_magic, magic, 8)) {
+    throw std::runtime_error("Not a ProSelecta checkpoint file: " + path);
+  }
+
+  Checkpoint ckpt;
+  ckpt.next_evtnum = read_pod<uint64_t>(f.get(), path);
+  ckpt.input.file = read_pod<uint64_t>(f.get(), path);
+  ckpt.input.events = read_pod<uint64_t>(f.get(), path);
+  ckpt.select = read_string(f.get(), path);
+  ckpt.output_path = read_string(f.get(), path);
+  ckpt.columns.projections = read_strings(f.get(), path);
+  ckpt.columns.weights = read_strings(f.get(), path);
+  ckpt.columns.selections = read_strings(f.get(), path);
+  ckpt.output_size = read_pod<uint64_t>(f.get(), path);
+  std::stringstream summary(read_string(f.get(), path));
+  ckpt.summary = RunSummary::parse(summary, path);
+
+  if (read_pod<uint8_t>(f.get(), path)) {
+    HistogramAccumulator::State state;
+    state.total = read_histograms(f.get(), path);
+    if (read_pod<uint8_t>(f.get(), path)) {
+      state.current = HistogramChunk{read_pod<uint64_t>(f.get(), path), {}};
+      state.current->histograms = read_histograms(f.get(), path);
+    }
+    state.chunks.resize(read_pod<uint64_t>(f.get(), path));
+    for (auto &chunk : state.chunks) {
+      chunk.index = read_pod<uint64_t>(f.get(), path);
+      chunk.histograms = read_histograms(f.get(), path);
+    }
+    ckpt.histograms = std::move(state);
+  }
+  return ckpt;
+}
+
+} // namespace ps
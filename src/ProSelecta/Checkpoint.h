@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ProSelecta/Histogram.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/OutputSink.h"
+#include "ProSelecta/RunSummary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace ps {
+
+// The state of a ProSelectaCPP run between two segments of its event range,
+// from which an interrupted run can be resumed to give exactly the results of
+// an uninterrupted one.
+//
+// Stored in a native-endian binary format that begins with the 8-byte magic.
+// The summary is embedded as its text, and the histograms in the binary
+// histogram format.
+struct Checkpoint {
+  // the number of the next event that the reader would read, and where that
+  // event is in the input files
+  size_t next_evtnum = 0;
+  InputPosition input;
+  // the cutflow so far, including the statistics of every input file. It
+  // also identifies the run: its inputs, range, and batch size.
+  RunSummary summary;
+  // the --Select function, or an empty string if there is none
+  std::string select;
+  // the rows written so far, output_size is 0 if rows are not written
+  std::string output_path;
+  OutputColumns columns;
+  uint64_t output_size = 0;
+  // the partial sums, if histograms are filled
+  std::optional<HistogramAccumulator::State> histograms;
+
+  static char const magic[9];
+
+  // Writes to a temporary file that is synced to disk and then renamed over
+  // path, so that path always holds a complete checkpoint, even if the
+  // process is killed while writing. Throws std::runtime_error on failure.
+  void write(std::string const &path) const;
+  static Checkpoint read(std::string const &path);
+};
+
+} // namespace ps
@@ -0,0 +1,7 @@
+#include "ProSelecta/env.h"
+
+// Compiles the instantiations that the interpreter environment declares
+// extern, see ProSelecta/detail/instantiations.h
+#define ProSelecta_INSTANTIATE template
+#include "ProSelecta/detail/instantiations.h"
+#undef ProSelecta_INSTANTIATE
@@ -0,0 +1,739 @@
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/Metrics.h"
+
+#include "HepMC3/Data/GenEventData.h"
+#include "HepMC3/Data/GenRunInfoData.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/ReaderFactory.h"
+
+#ifdef ProSelecta_EVENTCACHE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+char const EventCache::magic[9] = "PSEVC001";
+char const EventCache::end_magic[9] = "PSEVCEND";
+
+bool EventCache::has_zlib() {
+#ifdef ProSelecta_EVENTCACHE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+namespace {
+
+size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+
+template <typename T> void append_pod(std::string &buf, T const &v) {
+  buf.append(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+void pad(std::string &buf) { buf.resize(padded(buf.size()), '\0'); }
+
+template <typename T>
+void append_column(std::string &buf, std::vector<T> const &col) {
+  append_pod(buf, uint64_t(col.size()));
+  buf.append(reinterpret_cast<char const *>(col.data()),
+             sizeof(T) * col.size());
+  pad(buf);
+}
+
+void append_strings(std::string &buf, std::vector<std::string> const &strs) {
+  append_pod(buf, uint64_t(strs.size()));
+  for (auto const &str : strs) {
+    append_pod(buf, uint64_t(str.size()));
+    buf += str;
+  }
+}
+
+[[noreturn]] void throw_corrupt(std::string const &path, char const *what) {
+  std::stringstream ss("");
+  ss << "Corrupt event cache: " << path << ": " << what;
+  throw std::runtime_error(ss.str());
+}
+
+// Reads values from a span of the mapped file, or a decompressed block,
+// throwing if they would run past its end
+struct Cursor {
+  char const *pos;
+  char const *end;
+  std::string const &path;
+
+  void need(size_t size) {
+    if (size_t(end - pos) < size) {
+      throw_corrupt(path, "unexpected end of data");
+    }
+  }
+
+  template <typename T> T pod() {
+    need(sizeof(T));
+    T v;
+    std::memcpy(&v, pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+  }
+
+  std::vector<std::string> strings() {
+    size_t nstrs = pod<uint64_t>();
+    // each string has at least its length
+    need(sizeof(uint64_t) * std::min<size_t>(nstrs, SIZE_MAX / 8));
+    std::vector<std::string> strs(nstrs);
+    for (auto &str : strs) {
+      size_t size = pod<uint64_t>();
+      need(size);
+      str.assign(pos, size);
+      pos += size;
+    }
+    return strs;
+  }
+};
+
+template <typename T> struct Column {
+  T const *data = nullptr;
+  size_t size = 0;
+
+  T const &operator[](size_t i) const { return data[i]; }
+  T const &back() const { return data[size - 1]; }
+};
+
+// Whether ends are the end offsets of consecutive ranges that cover all size
+// values of a column
+bool valid_ends(Column<uint64_t> const &ends, size_t size) {
+  uint64_t begin = 0;
+  for (size_t i = 0; i < ends.size; ++i) {
+    if ((ends[i] < begin) || (ends[i] > size)) {
+      return false;
+    }
+    begin = ends[i];
+  }
+  return begin == size;
+}
+
+template <typename T> void take_column(Cursor &cur, Column<T> &col) {
+  col.size = cur.template pod<uint64_t>();
+  if (col.size > (size_t(cur.end - cur.pos) / sizeof(T))) {
+    throw_corrupt(cur.path, "column runs past the end of its block");
+  }
+  col.data = reinterpret_cast<T const *>(cur.pos);
+  cur.pos += std::min(padded(sizeof(T) * col.size), size_t(cur.end - cur.pos));
+}
+
+} // namespace
+
+// The columns of the events of one block, see EventCache
+struct EventCacheWriter::Columns {
+  std::vector<int32_t> evtnum;
+  std::vector<int32_t> units;
+  std::vector<double> pos_x, pos_y, pos_z, pos_t;
+  std::vector<uint64_t> particle_end, vertex_end, weight_end, link_end,
+      attribute_end;
+
+  std::vector<int32_t> pid, pstatus;
+  std::vector<uint8_t> mass_set;
+  std::vector<double> mass, px, py, pz, e;
+
+  std::vector<int32_t> vstatus;
+  std::vector<double> vx, vy, vz, vt;
+
+  std::vector<double> weights;
+  std::vector<int32_t> links1, links2;
+
+  // the name and then the value of each attribute, back to back in chars
+  std::vector<int32_t> attribute_id;
+  std::vector<uint64_t> attribute_name_end, attribute_string_end;
+  std::vector<char> chars;
+
+  size_t size() const { return evtnum.size(); }
+
+  void append_to(std::string &buf) const {
+    append_column(buf, evtnum);
+    append_column(buf, units);
+    for (auto const *col : {&pos_x, &pos_y, &pos_z, &pos_t}) {
+      append_column(buf, *col);
+    }
+    for (auto const *col : {&particle_end, &vertex_end, &weight_end,
+                            &link_end, &attribute_end}) {
+      append_column(buf, *col);
+    }
+    append_column(buf, pid);
+    append_column(buf, pstatus);
+    append_column(buf, mass_set);
+    for (auto const *col : {&mass, &px, &py, &pz, &e}) {
+      append_column(buf, *col);
+    }
+    append_column(buf, vstatus);
+    for (auto const *col : {&vx, &vy, &vz, &vt, &weights}) {
+      append_column(buf, *col);
+    }
+    append_column(buf, links1);
+    append_column(buf, links2);
+    append_column(buf, attribute_id);
+    append_column(buf, attribute_name_end);
+    append_column(buf, attribute_string_end);
+    append_column(buf, chars);
+  }
+
+  void clear() { *this = Columns(); }
+};
+
+// The columns of one block read back, pointing into the mapped file or into
+// inflated
+struct EventCacheReader::Block {
+  size_t number = 0;
+  size_t nevents = 0;
+  std::vector<uint64_t> inflated;
+
+  Column<int32_t> evtnum, units;
+  Column<double> pos_x, pos_y, pos_z, pos_t;
+  Column<uint64_t> particle_end, vertex_end, weight_end, link_end,
+      attribute_end;
+
+  Column<int32_t> pid, pstatus;
+  Column<uint8_t> mass_set;
+  Column<double> mass, px, py, pz, e;
+
+  Column<int32_t> vstatus;
+  Column<double> vx, vy, vz, vt;
+
+  Column<double> weights;
+  Column<int32_t> links1, links2;
+
+  Column<int32_t> attribute_id;
+  Column<uint64_t> attribute_name_end, attribute_string_end;
+  Column<char> chars;
+
+  // reused for every event, so that its vectors keep their capacity
+  HepMC3::GenEventData data;
+
+  void parse(Cursor cur, size_t n) {
+    take_column(cur, evtnum);
+    take_column(cur, units);
+    for (auto *col : {&pos_x, &pos_y, &pos_z, &pos_t}) {
+      take_column(cur, *col);
+    }
+    for (auto *col : {&particle_end, &vertex_end, &weight_end, &link_end,
+                      &attribute_end}) {
+      take_column(cur, *col);
+    }
+    take_column(cur, pid);
+    take_column(cur, pstatus);
+    take_column(cur, mass_set);
+    for (auto *col : {&mass, &px, &py, &pz, &e}) {
+      take_column(cur, *col);
+    }
+    take_column(cur, vstatus);
+    for (auto *col : {&vx, &vy, &vz, &vt, &weights}) {
+      take_column(cur, *col);
+    }
+    take_column(cur, links1);
+    take_column(cur, links2);
+    take_column(cur, attribute_id);
+    take_column(cur, attribute_name_end);
+    take_column(cur, attribute_string_end);
+    take_column(cur, chars);
+
+    // every offset is checked, so that a corrupt block throws rather than
+    // reading past the end of its columns
+    bool ok = n && (evtnum.size == n) && (units.size == n);
+    for (auto *col : {&pos_x, &pos_y, &pos_z, &pos_t}) {
+      ok = ok && (col->size == n);
+    }
+    for (auto *col : {&particle_end, &vertex_end, &weight_end, &link_end,
+                      &attribute_end}) {
+      ok = ok && (col->size == n);
+    }
+    ok = ok && (pstatus.size == pid.size) && (mass_set.size == pid.size) &&
+         (links2.size == links1.size);
+    for (auto *col : {&mass, &px, &py, &pz, &e}) {
+      ok = ok && (col->size == pid.size);
+    }
+    for (auto *col : {&vx, &vy, &vz, &vt}) {
+      ok = ok && (col->size == vstatus.size);
+    }
+    ok = ok && valid_ends(particle_end, pid.size) &&
+         valid_ends(vertex_end, vstatus.size) &&
+         valid_ends(weight_end, weights.size) &&
+         valid_ends(link_end, links1.size) &&
+         valid_ends(attribute_end, attribute_id.size) &&
+         (attribute_name_end.size == attribute_id.size) &&
+         valid_ends(attribute_string_end, chars.size);
+    for (size_t i = 0; ok && (i < n); ++i) {
+      ok = (units[i] >= 0) && ((units[i] & 0xff) <= HepMC3::Units::GEV) &&
+           ((units[i] >> 8) <= HepMC3::Units::CM);
+    }
+    for (size_t a = 0; ok && (a < attribute_id.size); ++a) {
+      ok = (attribute_name_end[a] >= (a ? attribute_string_end[a - 1] : 0)) &&
+           (attribute_name_end[a] <= attribute_string_end[a]);
+    }
+    if (!ok) {
+      throw_corrupt(cur.path, "inconsistent column lengths");
+    }
+  }
+
+  void fill(size_t i, HepMC3::GenEventData &d) const {
+    d.event_number = evtnum[i];
+    d.momentum_unit = HepMC3::Units::MomentumUnit(units[i] & 0xff);
+    d.length_unit = HepMC3::Units::LengthUnit(units[i] >> 8);
+    d.event_pos = HepMC3::FourVector(pos_x[i], pos_y[i], pos_z[i], pos_t[i]);
+
+    d.particles.clear();
+    for (size_t p = (i ? particle_end[i - 1] : 0); p < particle_end[i]; ++p) {
+      d.particles.push_back(HepMC3::GenParticleData{
+          pid[p], pstatus[p], bool(mass_set[p]), mass[p],
+          HepMC3::FourVector(px[p], py[p], pz[p], e[p])});
+    }
+    d.vertices.clear();
+    for (size_t v = (i ? vertex_end[i - 1] : 0); v < vertex_end[i]; ++v) {
+      d.vertices.push_back(HepMC3::GenVertexData{
+          vstatus[v], HepMC3::FourVector(vx[v], vy[v], vz[v], vt[v])});
+    }
+    size_t wb = i ? weight_end[i - 1] : 0;
+    d.weights.assign(weights.data + wb, weights.data + weight_end[i]);
+    size_t lb = i ? link_end[i - 1] : 0;
+    d.links1.assign(links1.data + lb, links1.data + link_end[i]);
+    d.links2.assign(links2.data + lb, links2.data + link_end[i]);
+
+    d.attribute_id.clear();
+    d.attribute_name.clear();
+    d.attribute_string.clear();
+    for (size_t a = (i ? attribute_end[i - 1] : 0); a < attribute_end[i];
+         ++a) {
+      size_t name_begin = a ? attribute_string_end[a - 1] : 0;
+      d.attribute_id.push_back(attribute_id[a]);
+      d.attribute_name.emplace_back(chars.data + name_begin,
+                                    chars.data + attribute_name_end[a]);
+      d.attribute_string.emplace_back(chars.data + attribute_name_end[a],
+                                      chars.data + attribute_string_end[a]);
+    }
+  }
+};
+
+EventCacheWriter::EventCacheWriter(std::string const &p, size_t be,
+                                   EventCache::Codec c)
+    : path(p), file(nullptr), block_events(std::max<size_t>(be, 1)), codec(c),
+      cols(std::make_unique<Columns>()), header_written(false), offset(0),
+      index(), nevents(0) {
+  if ((codec != EventCache::kNone) &&
+      ((codec != EventCache::kZlib) || !EventCache::has_zlib())) {
+    throw std::runtime_error(
+        "Event cache compression is not supported by this build.");
+  }
+  file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    std::stringstream ss("");
+    ss << "Failed to open event cache: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+}
+
+EventCacheWriter::~EventCacheWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void EventCacheWriter::write_bytes(void const *data, size_t size) {
+  if (size && (std::fwrite(data, 1, size, file) != size)) {
+    std::stringstream ss("");
+    ss << "Failed writing to event cache: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+  offset += size;
+}
+
+void EventCacheWriter::write_header(
+    std::shared_ptr<HepMC3::GenRunInfo> const &run) {
+  HepMC3::GenRunInfoData rid;
+  if (run) {
+    run->write_data(rid);
+  }
+  std::string buf(EventCache::magic, 8);
+  for (auto const *strs :
+       {&rid.weight_names, &rid.tool_name, &rid.tool_version,
+        &rid.tool_description, &rid.attribute_name, &rid.attribute_string}) {
+    append_strings(buf, *strs);
+  }
+  pad(buf);
+  write_bytes(buf.data(), buf.size());
+  header_written = true;
+}
+
+void EventCacheWriter::write_block() {
+  if (!cols->size()) {
+    return;
+  }
+  std::string payload;
+  cols->append_to(payload);
+
+  std::string stored;
+  if (codec == EventCache::kZlib) {
+#ifdef ProSelecta_EVENTCACHE_ZLIB
+    uLongf stored_size = compressBound(payload.size());
+    stored.resize(stored_size);
+    if (compress2(reinterpret_cast<Bytef *>(stored.data()), &stored_size,
+                  reinterpret_cast<Bytef const *>(payload.data()),
+                  payload.size(), Z_BEST_SPEED) != Z_OK) {
+      throw std::runtime_error("Failed to compress event cache block: " +
+                               path);
+    }
+    stored.resize(stored_size);
+#endif
+  }
+  std::string const &data = (codec == EventCache::kNone) ? payload : stored;
+
+  index.push_back(offset);
+  index.push_back(nevents - cols->size());
+  index.push_back(cols->size());
+
+  std::string header;
+  append_pod(header, uint64_t(cols->size()));
+  append_pod(header, uint64_t(codec));
+  append_pod(header, uint64_t(payload.size()));
+  append_pod(header, uint64_t(data.size()));
+  write_bytes(header.data(), header.size());
+  write_bytes(data.data(), data.size());
+  char const zeros[8] = {};
+  write_bytes(zeros, padded(data.size()) - data.size());
+  cols->clear();
+}
+
+void EventCacheWriter::write_event(HepMC3::GenEvent const &evt) {
+  if (!file) {
+    throw std::runtime_error("Event cache is closed: " + path);
+  }
+  if (!header_written) {
+    write_header(run_info() ? run_info() : evt.run_info());
+  }
+
+  HepMC3::GenEventData d;
+  evt.write_data(d);
+
+  auto &c = *cols;
+  c.evtnum.push_back(d.event_number);
+  c.units.push_back(int32_t(d.momentum_unit) | (int32_t(d.length_unit) << 8));
+  c.pos_x.push_back(d.event_pos.x());
+  c.pos_y.push_back(d.event_pos.y());
+  c.pos_z.push_back(d.event_pos.z());
+  c.pos_t.push_back(d.event_pos.t());
+
+  for (auto const &p : d.particles) {
+    c.pid.push_back(p.pid);
+    c.pstatus.push_back(p.status);
+    c.mass_set.push_back(p.is_mass_set);
+    c.mass.push_back(p.mass);
+    c.px.push_back(p.momentum.px());
+    c.py.push_back(p.momentum.py());
+    c.pz.push_back(p.momentum.pz());
+    c.e.push_back(p.momentum.e());
+  }
+  c.particle_end.push_back(c.pid.size());
+
+  for (auto const &v : d.vertices) {
+    c.vstatus.push_back(v.status);
+    c.vx.push_back(v.position.x());
+    c.vy.push_back(v.position.y());
+    c.vz.push_back(v.position.z());
+    c.vt.push_back(v.position.t());
+  }
+  c.vertex_end.push_back(c.vstatus.size());
+
+  c.weights.insert(c.weights.end(), d.weights.begin(), d.weights.end());
+  c.weight_end.push_back(c.weights.size());
+
+  c.links1.insert(c.links1.end(), d.links1.begin(), d.links1.end());
+  c.links2.insert(c.links2.end(), d.links2.begin(), d.links2.end());
+  c.link_end.push_back(c.links1.size());
+
+  for (size_t a = 0; a < d.attribute_id.size(); ++a) {
+    c.attribute_id.push_back(d.attribute_id[a]);
+    c.chars.insert(c.chars.end(), d.attribute_name[a].begin(),
+                   d.attribute_name[a].end());
+    c.attribute_name_end.push_back(c.chars.size());
+    c.chars.insert(c.chars.end(), d.attribute_string[a].begin(),
+                   d.attribute_string[a].end());
+    c.attribute_string_end.push_back(c.chars.size());
+  }
+  c.attribute_end.push_back(c.attribute_id.size());
+
+  nevents++;
+  if (c.size() == block_events) {
+    write_block();
+  }
+}
+
+void EventCacheWriter::close() {
+  if (!file) {
+    return;
+  }
+  if (!header_written) {
+    write_header(run_info());
+  }
+  write_block();
+
+  uint64_t index_offset = offset;
+  write_bytes(index.data(), sizeof(uint64_t) * index.size());
+  std::string trailer;
+  append_pod(trailer, index_offset);
+  append_pod(trailer, uint64_t(index.size() / 3));
+  append_pod(trailer, nevents);
+  trailer.append(EventCache::end_magic, 8);
+  write_bytes(trailer.data(), trailer.size());
+
+  FILE *f = file;
+  file = nullptr;
+  if (std::fclose(f)) {
+    std::stringstream ss("");
+    ss << "Failed to close event cache: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+}
+
+EventCacheReader::EventCacheReader(std::string const &p)
+    : path(p), map(nullptr), map_size(0), index(), nevents(0), next(0),
+      block(0), loaded(std::make_unique<Block>()), is_failed(false),
+      metrics(nullptr) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if ((fd < 0) || fstat(fd, &st)) {
+    std::stringstream ss("");
+    ss << "Failed to open event cache: " << path << ": "
+       << std::strerror(errno);
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    throw std::runtime_error(ss.str());
+  }
+  map_size = st.st_size;
+  if (map_size) {
+    void *m = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    map = (m == MAP_FAILED) ? nullptr : static_cast<char const *>(m);
+  }
+  ::close(fd);
+  if (!map) {
+    throw std::runtime_error("Failed to map event cache: " + path);
+  }
+  madvise(const_cast<char *>(map), map_size, MADV_SEQUENTIAL);
+
+  try {
+    size_t const trailer_size = 3 * sizeof(uint64_t) + 8;
+    if ((map_size < (8 + trailer_size)) ||
+        std::memcmp(map, EventCache::magic, 8)) {
+      throw std::runtime_error("Not a ProSelecta event cache: " + path);
+    }
+    if (std::memcmp(map + map_size - 8, EventCache::end_magic, 8)) {
+      throw_corrupt(path, "no index, the writer may not have been closed");
+    }
+
+    Cursor trailer{map + map_size - trailer_size, map + map_size, path};
+    uint64_t index_offset = trailer.pod<uint64_t>();
+    uint64_t nblocks = trailer.pod<uint64_t>();
+    nevents = trailer.pod<uint64_t>();
+    if ((index_offset > (map_size - trailer_size)) ||
+        (nblocks > ((map_size - trailer_size - index_offset) /
+                    (3 * sizeof(uint64_t))))) {
+      throw_corrupt(path, "bad index");
+    }
+    index.resize(3 * nblocks);
+    if (nblocks) {
+      std::memcpy(index.data(), map + index_offset,
+                  sizeof(uint64_t) * index.size());
+    }
+
+    Cursor header{map + 8, map + index_offset, path};
+    HepMC3::GenRunInfoData rid;
+    for (auto *strs :
+         {&rid.weight_names, &rid.tool_name, &rid.tool_version,
+          &rid.tool_description, &rid.attribute_name, &rid.attribute_string}) {
+      *strs = header.strings();
+    }
+    auto run = std::make_shared<HepMC3::GenRunInfo>();
+    run->read_data(rid);
+    set_run_info(run);
+  } catch (...) {
+    munmap(const_cast<char *>(map), map_size);
+    map = nullptr;
+    throw;
+  }
+}
+
+EventCacheReader::~EventCacheReader() { close(); }
+
+EventCacheReader::Block const *EventCacheReader::seek_next(size_t &i) {
+  if (!map || (next >= nevents)) {
+    return nullptr;
+  }
+  while ((block < (index.size() / 3)) &&
+         (next >= (index[3 * block + 1] + index[3 * block + 2]))) {
+    block++;
+  }
+  if (block >= (index.size() / 3)) {
+    throw_corrupt(path, "index does not cover every event");
+  }
+
+  if ((next < index[3 * block + 1]) || (index[3 * block] > map_size)) {
+    throw_corrupt(path, "bad index");
+  }
+
+  Block &b = *loaded;
+  if (!b.nevents || (b.number != block)) {
+    // left empty until the block has been parsed, so that a block that
+    // failed to parse is never used
+    b.nevents = 0;
+    Cursor cur{map + index[3 * block], map + map_size, path};
+    uint64_t block_nevents = cur.pod<uint64_t>();
+    uint64_t codec = cur.pod<uint64_t>();
+    [[maybe_unused]] uint64_t raw_size = cur.pod<uint64_t>();
+    uint64_t stored_size = cur.pod<uint64_t>();
+    cur.need(stored_size);
+    if (block_nevents != index[3 * block + 2]) {
+      throw_corrupt(path, "block does not match the index");
+    }
+
+    if (codec == EventCache::kNone) {
+      b.parse(Cursor{cur.pos, cur.pos + stored_size, path}, block_nevents);
+    } else if (codec == EventCache::kZlib) {
+#ifdef ProSelecta_EVENTCACHE_ZLIB
+      // zlib cannot compress by more than a factor of about 1000
+      if (raw_size > (1100 * stored_size + 64)) {
+        throw_corrupt(path, "bad block size");
+      }
+      b.inflated.resize(padded(raw_size) / sizeof(uint64_t));
+      uLongf size = raw_size;
+      if ((uncompress(reinterpret_cast<Bytef *>(b.inflated.data()), &size,
+                      reinterpret_cast<Bytef const *>(cur.pos),
+                      stored_size) != Z_OK) ||
+          (size != raw_size)) {
+        throw_corrupt(path, "failed to decompress block");
+      }
+      char const *raw = reinterpret_cast<char const *>(b.inflated.data());
+      b.parse(Cursor{raw, raw + raw_size, path}, block_nevents);
+#else
+      throw std::runtime_error("Event cache " + path +
+                               " is compressed, but this build does not "
+                               "support compression.");
+#endif
+    } else {
+      throw_corrupt(path, "unknown codec");
+    }
+    b.number = block;
+    b.nevents = block_nevents;
+    if (metrics) {
+      metrics->bytes_read.fetch_add((cur.pos - (map + index[3 * block])) +
+                                        stored_size,
+                                    std::memory_order_relaxed);
+    }
+  }
+  i = next - index[3 * block + 1];
+  return &b;
+}
+
+void EventCacheReader::set_metrics(LoopMetrics *m) { metrics = m; }
+
+bool EventCacheReader::read_event(HepMC3::GenEvent &evt) {
+  size_t i;
+  auto const *b = seek_next(i);
+  if (!b) {
+    is_failed = true;
+    return false;
+  }
+  b->fill(i, loaded->data);
+  evt.read_data(loaded->data);
+  evt.set_run_info(run_info());
+  next++;
+  return true;
+}
+
+bool EventCacheReader::read_view(CachedEvent &evt) {
+  size_t i;
+  auto const *b = seek_next(i);
+  if (!b) {
+    is_failed = true;
+    return false;
+  }
+  size_t pb = i ? b->particle_end[i - 1] : 0;
+  size_t wb = i ? b->weight_end[i - 1] : 0;
+  evt = CachedEvent{b->evtnum[i],
+                    b->particle_end[i] - pb,
+                    b->pid.data + pb,
+                    b->pstatus.data + pb,
+                    b->px.data + pb,
+                    b->py.data + pb,
+                    b->pz.data + pb,
+                    b->e.data + pb,
+                    b->mass.data + pb,
+                    b->weight_end[i] - wb,
+                    b->weights.data + wb};
+  next++;
+  return true;
+}
+
+bool EventCacheReader::skip(const int n) {
+  if (n > 0) {
+    if (size_t(n) > (nevents - std::min(next, nevents))) {
+      is_failed = true;
+    }
+    next = std::min(nevents, next + size_t(n));
+  }
+  return !is_failed;
+}
+
+bool EventCacheReader::seek(size_t event) {
+  if (!map || (event >= nevents)) {
+    return false;
+  }
+  // seek_next only moves forward through the blocks
+  if ((block >= (index.size() / 3)) || (event < index[3 * block + 1])) {
+    block = 0;
+  }
+  next = event;
+  is_failed = false;
+  return true;
+}
+
+void EventCacheReader::close() {
+  if (map) {
+    munmap(const_cast<char *>(map), map_size);
+    map = nullptr;
+  }
+  is_failed = true;
+}
+
+bool is_event_cache(std::string const &path) {
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"),
+                                           &std::fclose);
+  char file_magic[8];
+  return f && (std::fread(file_magic, 1, 8, f.get()) == 8) &&
+         !std::memcmp(file_magic, EventCache::magic, 8);
+}
+
+std::shared_ptr<HepMC3::Reader>
+open_reader(std::string const &path, AsciiReaderOptions const *fast_ascii) {
+  if (is_event_cache(path)) {
+    return std::make_shared<EventCacheReader>(path);
+  }
+  if (fast_ascii && is_hepmc3_ascii(path)) {
+    return std::make_shared<AsciiReader>(path, *fast_ascii);
+  }
+  return HepMC3::deduce_reader(path);
+}
+
+} // namespace ps
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/Reader.h"
+#include "HepMC3/Writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+struct AsciiReaderOptions;
+struct LoopMetrics;
+
+// The ProSelecta event cache, a native-endian columnar binary format for
+// events that are analysed many times, so that later passes do not pay for
+// parsing HepMC3 text.
+//
+// The file begins with the 8-byte magic and the run info: the weight names,
+// the tools, and the run attributes. It is followed by blocks of events, each
+// is the number of events, the codec, 0 for none or 1 for zlib, and the raw
+// and stored sizes of its payload, followed by the payload. The payload holds
+// the columns of every event in the block in turn: per-event event numbers,
+// units, positions, and the end offsets of each event's particles, vertices,
+// weights, links, and attributes, and then the particle, vertex, weight, link
+// and attribute columns of all of the events. Each column is its uint64
+// length followed by its values. Everything is padded to 8 bytes, so that the
+// columns of uncompressed blocks can be used in place from a mapped file. The
+// file ends with an index of the offset, first event, and number of events of
+// every block, followed by the offset of the index, the number of blocks and
+// events, and the 8-byte end magic.
+struct EventCache {
+  static char const magic[9];
+  static char const end_magic[9];
+
+  enum Codec : uint64_t { kNone = 0, kZlib = 1 };
+  // Whether this build can read and write zlib compressed blocks
+  static bool has_zlib();
+};
+
+// The columns of one event in an event cache, read without building a
+// GenEvent. The pointers are into the mapped file, or the decompressed block,
+// and are only valid until the reader moves on.
+struct CachedEvent {
+  int event_number;
+  size_t nparticles;
+  int32_t const *pid;
+  int32_t const *status;
+  double const *px;
+  double const *py;
+  double const *pz;
+  double const *e;
+  double const *mass;
+  size_t nweights;
+  double const *weights;
+};
+
+// Writes events into an event cache in blocks of block_events. The run info
+// is taken from set_run_info or, if that was not called, from the first
+// event, and is written with it. Errors are reported by throwing
+// std::runtime_error.
+class EventCacheWriter : public HepMC3::Writer {
+  struct Columns;
+
+  std::string path;
+  FILE *file;
+  size_t block_events;
+  EventCache::Codec codec;
+  std::unique_ptr<Columns> cols;
+  bool header_written;
+  uint64_t offset;
+  // offset, first event, and number of events of each block
+  std::vector<uint64_t> index;
+  uint64_t nevents;
+
+  void write_bytes(void const *data, size_t size);
+  void write_header(std::shared_ptr<HepMC3::GenRunInfo> const &run);
+  void write_block();
+
+public:
+  explicit EventCacheWriter(std::string const &path,
+                            size_t block_events = 1024,
+                            EventCache::Codec codec = EventCache::kNone);
+  ~EventCacheWriter();
+
+  void write_event(HepMC3::GenEvent const &evt) override;
+  bool failed() override { return !file; }
+  void close() override;
+};
+
+// Reads an event cache through a read-only memory map. Events are filled from
+// the columns of their block with GenEvent::read_data, with no text to parse,
+// and skipping is free, as only blocks that events are read from are
+// decompressed. read_view reads the columns of an event without building a
+// GenEvent at all.
+class EventCacheReader : public HepMC3::Reader {
+  struct Block;
+
+  std::string path;
+  char const *map;
+  size_t map_size;
+  std::vector<uint64_t> index;
+  size_t nevents;
+  size_t next;
+  size_t block;
+  std::unique_ptr<Block> loaded;
+  bool is_failed;
+  LoopMetrics *metrics;
+
+  // Returns the block holding event next and its index in it, or nullptr at
+  // the end of the cache
+  Block const *seek_next(size_t &i);
+
+public:
+  explicit EventCacheReader(std::string const &path);
+  ~EventCacheReader();
+
+  // The number of events in the cache
+  size_t size() const { return nevents; }
+  // Adds the stored size of each block that events are read from to
+  // metrics->bytes_read from now on, metrics must outlive the reader
+  void set_metrics(LoopMetrics *metrics);
+
+  bool read_event(HepMC3::GenEvent &evt) override;
+  bool read_view(CachedEvent &evt);
+  bool skip(const int nevents) override;
+  // Continues from the event-th event of the cache, before or after the next.
+  // Returns false, and does not move, if there is no such event.
+  bool seek(size_t event);
+  bool failed() override { return is_failed; }
+  void close() override;
+};
+
+// Whether the file at path starts with the event cache magic
+bool is_event_cache(std::string const &path);
+
+// Opens an EventCacheReader for event caches, an AsciiReader with the
+// fast_ascii options, if they are given, for uncompressed HepMC3 ASCII files,
+// and otherwise the reader that HepMC3::deduce_reader finds for the file,
+// which may be nullptr
+std::shared_ptr<HepMC3::Reader>
+open_reader(std::string const &path,
+            AsciiReaderOptions const *fast_ascii = nullptr);
+
+} // namespace ps
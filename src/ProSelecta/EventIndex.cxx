@@ -0,0 +1,173 @@
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/AsciiReader.h"
+
+#include "HepMC3/Data/GenEventData.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+char const index_magic[9] = "PSIDX001";
+
+// The fixed-size fields after the magic: the file size, modification time,
+// run info offset and size, sumw, sumw2, and the number of events
+size_t const header_size = 8 + 7 * 8;
+
+template <typename T> void append_pod(std::string &buf, T const &v) {
+  buf.append(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+template <typename T> T read_pod(char const *&data) {
+  T v;
+  std::memcpy(&v, data, sizeof(T));
+  data += sizeof(T);
+  return v;
+}
+
+// The size and modification time of the file at path
+bool file_version(std::string const &path, uint64_t &size, int64_t &mtime_ns) {
+  struct stat st;
+  if (stat(path.c_str(), &st)) {
+    return false;
+  }
+  size = st.st_size;
+  mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  return true;
+}
+
+} // namespace
+
+std::pair<size_t, size_t> event_part(size_t nevents, size_t k,
+                                     size_t nparts) {
+  if (k >= nparts) {
+    std::stringstream ss("");
+    ss << "Invalid part " << k << " of " << nparts;
+    throw std::runtime_error(ss.str());
+  }
+  auto first = [&](size_t i) {
+    return (nevents / nparts) * i + std::min(i, nevents % nparts);
+  };
+  return {first(k), first(k + 1)};
+}
+
+std::string event_index_path(std::string const &path) {
+  return path + ".psidx";
+}
+
+EventIndexBuilder::EventIndexBuilder(std::string const &path,
+                                     AsciiReader &rdr) {
+  index.path = path;
+  if (!file_version(path, index.file_size, index.mtime_ns)) {
+    std::stringstream ss("");
+    ss << "Failed to stat file to index: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+  index.run_info_offset = rdr.run_info_offset();
+  index.run_info_size = rdr.run_info_size();
+}
+
+void EventIndexBuilder::add(size_t offset, std::vector<double> const &weights) {
+  index.offsets.push_back(offset);
+  double w = weights.size() ? weights.front() : 1;
+  index.sumw += w;
+  index.sumw2 += w * w;
+}
+
+EventIndex build_event_index(std::string const &path) {
+  AsciiReader rdr(path, AsciiReaderOptions{true, true});
+  EventIndexBuilder builder(path, rdr);
+  HepMC3::GenEventData data;
+  for (size_t offset = rdr.tell(); rdr.read_data(data);
+       offset = rdr.tell()) {
+    builder.add(offset, data.weights);
+  }
+  return builder.get();
+}
+
+std::optional<EventIndex> load_event_index(std::string const &path) {
+  std::ifstream ifs(event_index_path(path), std::ios::binary);
+  if (!ifs) {
+    return std::nullopt;
+  }
+  std::stringstream ss("");
+  ss << ifs.rdbuf();
+  std::string const buf = ss.str();
+  if ((buf.size() < header_size) || std::memcmp(buf.data(), index_magic, 8)) {
+    return std::nullopt;
+  }
+
+  EventIndex index;
+  index.path = path;
+  char const *data = buf.data() + 8;
+  index.file_size = read_pod<uint64_t>(data);
+  index.mtime_ns = read_pod<int64_t>(data);
+  index.run_info_offset = read_pod<uint64_t>(data);
+  index.run_info_size = read_pod<uint64_t>(data);
+  index.sumw = read_pod<double>(data);
+  index.sumw2 = read_pod<double>(data);
+  uint64_t const nevents = read_pod<uint64_t>(data);
+
+  uint64_t size;
+  int64_t mtime_ns;
+  // a truncated index, or one of an older version of the file, is rebuilt
+  if (!file_version(path, size, mtime_ns) || (size != index.file_size) ||
+      (mtime_ns != index.mtime_ns) || (nevents > buf.size()) ||
+      (buf.size() != (header_size + sizeof(uint64_t) * nevents))) {
+    return std::nullopt;
+  }
+  index.offsets.resize(nevents);
+  std::memcpy(index.offsets.data(), data, sizeof(uint64_t) * nevents);
+  return index;
+}
+
+bool save_event_index(EventIndex const &index) {
+  std::string buf(index_magic, 8);
+  append_pod(buf, index.file_size);
+  append_pod(buf, index.mtime_ns);
+  append_pod(buf, index.run_info_offset);
+  append_pod(buf, index.run_info_size);
+  append_pod(buf, index.sumw);
+  append_pod(buf, index.sumw2);
+  append_pod(buf, uint64_t(index.offsets.size()));
+  buf.append(reinterpret_cast<char const *>(index.offsets.data()),
+             sizeof(uint64_t) * index.offsets.size());
+
+  // written to a temporary file that is renamed into place, so that
+  // concurrent readers of the same file never see a partial index
+  std::string const path = event_index_path(index.path);
+  std::string const tmp = path + ".tmp." + std::to_string(getpid());
+  FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  bool ok = (std::fwrite(buf.data(), 1, buf.size(), f) == buf.size());
+  ok = !std::fclose(f) && ok;
+  if (!ok || std::rename(tmp.c_str(), path.c_str())) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+EventIndex open_event_index(std::string const &path) {
+  if (auto index = load_event_index(path)) {
+    return *index;
+  }
+  auto index = build_event_index(path);
+  save_event_index(index);
+  return index;
+}
+
+} // namespace ps
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ProSelecta/MultiFileReader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ps {
+
+class AsciiReader;
+
+// The events [first, last) of part k of nparts of nevents events, the parts
+// are contiguous, differ in size by at most one event, and together cover
+// every event. Throws std::runtime_error unless k < nparts.
+std::pair<size_t, size_t> event_part(size_t nevents, size_t k, size_t nparts);
+
+// The byte offset of every event of a HepMC3 ASCII file, and its totals, so
+// that any range of its events can be read without reading those before it.
+//
+// Indices are kept in a sidecar file next to the file that they index, see
+// event_index_path, and are only used while the size and modification time
+// of the file match those that it was indexed with.
+struct EventIndex {
+  std::string path;
+  // the size and modification time of the file when it was indexed
+  uint64_t file_size = 0;
+  int64_t mtime_ns = 0;
+  // the byte range of the W, T, and A lines before the first event
+  uint64_t run_info_offset = 0;
+  uint64_t run_info_size = 0;
+  // the sums of the first weight of each event, or 1 for events without
+  // weights, as in InputFileStats
+  double sumw = 0;
+  double sumw2 = 0;
+  // the byte offset of the E line of each event
+  std::vector<uint64_t> offsets;
+
+  size_t nevents() const { return offsets.size(); }
+  InputFileStats stats() const { return {path, nevents(), sumw, sumw2}; }
+
+  // The events [first, last) of part k of nparts of the file, see event_part
+  std::pair<size_t, size_t> part(size_t k, size_t nparts) const {
+    return event_part(nevents(), k, nparts);
+  }
+};
+
+// The sidecar file of the index of the file at path
+std::string event_index_path(std::string const &path);
+
+// Indexes a HepMC3 ASCII file from the events that an AsciiReader reads from
+// its start, so that a file can be indexed while it is decoded rather than
+// read again to index it.
+class EventIndexBuilder {
+  EventIndex index;
+
+public:
+  // rdr reads path, and has not read any events yet. Throws
+  // std::runtime_error if path cannot be stat'd.
+  EventIndexBuilder(std::string const &path, AsciiReader &rdr);
+
+  // Adds the event at offset, as AsciiReader::tell gave before it was read
+  void add(size_t offset, std::vector<double> const &weights);
+
+  // The index once every event of the file has been added
+  EventIndex const &get() const { return index; }
+};
+
+// Indexes the HepMC3 ASCII file at path by reading it with an AsciiReader,
+// throws std::runtime_error if it is not HepMC3 ASCII, or is malformed
+EventIndex build_event_index(std::string const &path);
+
+// The index in the sidecar of the file at path, or nothing if there is none,
+// or if it is out of date
+std::optional<EventIndex> load_event_index(std::string const &path);
+
+// Writes index to its sidecar, returns false if it could not be written,
+// such as for files in read-only directories
+bool save_event_index(EventIndex const &index);
+
+// Loads the index of the file at path, or builds it, and saves it for the
+// next run, if it is missing or out of date
+EventIndex open_event_index(std::string const &path);
+
+} // namespace ps
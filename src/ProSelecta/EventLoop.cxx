@@ -0,0 +1,316 @@
+#include "ProSelecta/EventLoop.h"
+
+#include "ProSelecta/BoundedQueue.h"
+#include "ProSelecta/Metrics.h"
+#include "ProSelecta/MultiFileReader.h"
+
+#include "HepMC3/Reader.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace ps {
+
+EventResult evaluate_event(EventHooks const &hooks, size_t evtnum,
+                           HepMC3::GenEvent const &evt) {
+  EventResult res{
+      evtnum, hooks.select ? bool(hooks.select(evt)) : true, {}, {}};
+  if (hooks.selections.size()) {
+    res.selmask.assign(selmask_words(hooks.selections.size()), 0);
+    for (size_t i = 0; i < hooks.selections.size(); ++i) {
+      if (hooks.selections[i](evt)) {
+        res.selmask[i / 64] |= (uint64_t(1) << (i % 64));
+      }
+    }
+  }
+  if (res.pass) {
+    res.values.reserve(hooks.projections.size() + hooks.weights.size());
+    for (auto const &proj : hooks.projections) {
+      res.values.push_back(proj(evt));
+    }
+    for (auto const &wgt : hooks.weights) {
+      res.values.push_back(wgt(evt));
+    }
+  }
+  return res;
+}
+
+size_t EventRange::end() const {
+  return (max_events > (std::numeric_limits<size_t>::max() - skip))
+             ? std::numeric_limits<size_t>::max()
+             : (skip + max_events);
+}
+
+bool EventRange::contains(size_t evtnum) const {
+  return (evtnum >= skip) && (evtnum < end()) &&
+         (((evtnum / chunk_size) % nshards) == shard);
+}
+
+size_t EventRange::next(size_t evtnum) const {
+  evtnum = std::max(evtnum, skip);
+  if ((nshards > 1) && (evtnum < end())) {
+    size_t chunk = evtnum / chunk_size;
+    size_t nchunks_ahead = (shard + nshards - (chunk % nshards)) % nshards;
+    if (nchunks_ahead) {
+      evtnum = (chunk + nchunks_ahead) * chunk_size;
+    }
+  }
+  return std::min(evtnum, end());
+}
+
+size_t EventRange::run_end(size_t evtnum) const {
+  if (nshards > 1) {
+    return std::min(end(), ((evtnum / chunk_size) + 1) * chunk_size);
+  }
+  return end();
+}
+
+void EventRange::validate(size_t batch_size) const {
+  std::stringstream ss("");
+  if (!nshards || (shard >= nshards)) {
+    ss << "Invalid shard " << shard << "/" << nshards
+       << ", expected 0 <= shard < nshards.";
+  } else if (!chunk_size || ((nshards > 1) && (chunk_size % batch_size))) {
+    ss << "Invalid shard chunk size " << chunk_size
+       << ", it must be a multiple of the batch size " << batch_size << ".";
+  } else {
+    return;
+  }
+  throw std::runtime_error(ss.str());
+}
+
+bool skip_events(HepMC3::Reader &rdr, size_t nevents) {
+  while (nevents) {
+    int n = int(std::min<size_t>(nevents, std::numeric_limits<int>::max()));
+    rdr.skip(n);
+    if (rdr.failed()) {
+      return false;
+    }
+    nevents -= n;
+  }
+  return true;
+}
+
+std::unique_ptr<HepMC3::GenEvent> next_event(HepMC3::Reader &rdr,
+                                             GenEventPool *pool) {
+  if (auto *mfr = dynamic_cast<MultiFileReader *>(&rdr)) {
+    return mfr->next_event();
+  }
+  auto evt = pool ? pool->acquire() : std::make_unique<HepMC3::GenEvent>();
+  rdr.read_event(*evt);
+  if (rdr.failed()) {
+    recycle_event(rdr, std::move(evt), pool);
+    return nullptr;
+  }
+  return evt;
+}
+
+void recycle_event(HepMC3::Reader &rdr, std::unique_ptr<HepMC3::GenEvent> evt,
+                   GenEventPool *pool) {
+  if (auto *mfr = dynamic_cast<MultiFileReader *>(&rdr)) {
+    mfr->recycle(std::move(evt));
+  } else if (pool) {
+    pool->release(std::move(evt));
+  }
+}
+
+EventLoop::EventLoop(EventHooks h, size_t nt, size_t bs, size_t qd)
+    : EventLoop(std::vector<EventHooks>{std::move(h)}, nt, bs, qd) {}
+
+EventLoop::EventLoop(std::vector<EventHooks> h, size_t nt, size_t bs,
+                     size_t qd)
+    : hooks(std::move(h)), nthreads(std::max<size_t>(nt, 1)),
+      batch_size(std::max<size_t>(bs, 1)), queue_depth(std::max<size_t>(qd, 1)),
+      histograms(), metrics(nullptr) {
+  if (hooks.empty()) {
+    throw std::runtime_error("EventLoop requires at least one set of hooks.");
+  }
+}
+
+void EventLoop::fill_histograms(HistogramSet const &hists) {
+  histograms = hists.empty_clone();
+}
+
+void EventLoop::set_metrics(LoopMetrics *m) { metrics = m; }
+
+size_t EventLoop::run(HepMC3::Reader &rdr,
+                      std::function<void(EventBatch &)> const &consume,
+                      EventRange const &range, size_t *evtnum_io) {
+
+  range.validate(batch_size);
+
+  using BatchQueue = BoundedQueue<std::unique_ptr<EventBatch>>;
+
+  // batch b is always evaluated by worker b % nthreads, so the batches can be
+  // collected in order by visiting the output queues round-robin
+  std::vector<std::unique_ptr<BatchQueue>> inputs;
+  std::vector<std::unique_ptr<BatchQueue>> outputs;
+  for (size_t w = 0; w < nthreads; ++w) {
+    inputs.push_back(std::make_unique<BatchQueue>(queue_depth));
+    outputs.push_back(std::make_unique<BatchQueue>(queue_depth));
+  }
+
+  // queue depths are only tracked with metrics, and are left at zero
+  auto add_depth = [&](std::atomic<uint64_t> LoopMetrics::*depth,
+                       int64_t n) {
+    if (metrics) {
+      (metrics->*depth).fetch_add(uint64_t(n), std::memory_order_relaxed);
+    }
+  };
+
+  // the number of the next event that the reader would read
+  size_t evtnum = evtnum_io ? *evtnum_io : 0;
+
+  GenEventPool pool;
+  std::exception_ptr reader_error;
+  std::thread reader([&]() {
+    try {
+      for (size_t b = 0; !rdr.failed(); ++b) {
+        size_t first = range.next(evtnum);
+        if ((first >= range.end()) || !skip_events(rdr, first - evtnum)) {
+          break;
+        }
+        evtnum = first;
+
+        // batches never span a multiple of batch_size, so that they cover
+        // the same events regardless of where the range starts
+        size_t last = std::min(range.run_end(first),
+                               ((first / batch_size) + 1) * batch_size);
+
+        auto batch = std::make_unique<EventBatch>();
+        batch->index = b;
+        batch->first_evtnum = first;
+        batch->events.reserve(last - first);
+
+        for (size_t n = 0; n < (last - first); ++n) {
+          auto evt = next_event(rdr, &pool);
+          if (!evt) {
+            break;
+          }
+          batch->events.push_back(std::move(evt));
+        }
+        size_t n = batch->events.size();
+        evtnum += n;
+        if (!n) {
+          break;
+        }
+        batch->nevents = n;
+
+        add_depth(&LoopMetrics::input_queue_depth, 1);
+        if (!inputs[b % nthreads]->push(std::move(batch))) {
+          add_depth(&LoopMetrics::input_queue_depth, -1);
+          break; // the loop was aborted
+        }
+        if (metrics) {
+          metrics->events_read.fetch_add(n, std::memory_order_relaxed);
+        }
+      }
+    } catch (...) {
+      reader_error = std::current_exception();
+    }
+    for (auto &q : inputs) {
+      q->close();
+    }
+  });
+
+  std::vector<std::thread> workers;
+  for (size_t w = 0; w < nthreads; ++w) {
+    workers.emplace_back([&, w]() {
+      while (auto batch = inputs[w]->pop()) {
+        add_depth(&LoopMetrics::input_queue_depth, -1);
+        auto &b = **batch;
+        try {
+          b.results.reserve(b.nevents * hooks.size());
+          for (size_t i = 0; i < b.nevents; ++i) {
+            for (auto const &h : hooks) {
+              b.results.push_back(
+                  evaluate_event(h, b.first_evtnum + i, *b.events[i]));
+            }
+            if (histograms) {
+              histograms->find_fills(*b.events[i],
+                                     b.results[i * hooks.size()].pass,
+                                     b.first_evtnum + i, b.fills);
+            }
+          }
+          if (metrics) {
+            uint64_t nselected = 0;
+            for (size_t i = 0; i < b.nevents; ++i) {
+              nselected += b.results[i * hooks.size()].pass;
+            }
+            metrics->events_selected.fetch_add(nselected,
+                                               std::memory_order_relaxed);
+          }
+        } catch (...) {
+          b.error = std::current_exception();
+        }
+        add_depth(&LoopMetrics::output_queue_depth, 1);
+        if (!outputs[w]->push(std::move(*batch))) {
+          add_depth(&LoopMetrics::output_queue_depth, -1);
+          break;
+        }
+      }
+      outputs[w]->close();
+    });
+  }
+
+  size_t nevents = 0;
+  std::exception_ptr error;
+  for (size_t b = 0;; ++b) {
+    auto batch = outputs[b % nthreads]->pop();
+    if (!batch) {
+      // the worker that would have evaluated batch b has finished, so there
+      // are no more batches
+      break;
+    }
+    add_depth(&LoopMetrics::output_queue_depth, -1);
+    if ((*batch)->error) {
+      error = (*batch)->error;
+      break;
+    }
+    try {
+      consume(**batch);
+    } catch (...) {
+      error = std::current_exception();
+      break;
+    }
+    nevents += (*batch)->nevents;
+    for (auto &evt : (*batch)->events) {
+      recycle_event(rdr, std::move(evt), &pool);
+    }
+  }
+
+  if (error) {
+    // unblock the reader and any workers still waiting to hand off a batch
+    for (size_t w = 0; w < nthreads; ++w) {
+      inputs[w]->close();
+      outputs[w]->close();
+    }
+  }
+
+  reader.join();
+  for (auto &w : workers) {
+    w.join();
+  }
+  if (evtnum_io) {
+    *evtnum_io = evtnum;
+  }
+  if (metrics) {
+    // batches left in the queues of an aborted loop are dropped
+    metrics->input_queue_depth.store(0, std::memory_order_relaxed);
+    metrics->output_queue_depth.store(0, std::memory_order_relaxed);
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  if (reader_error) {
+    std::rethrow_exception(reader_error);
+  }
+  return nevents;
+}
+
+} // namespace ps
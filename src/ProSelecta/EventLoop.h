@@ -0,0 +1,181 @@
+#pragma once
+
+#include "ProSelecta/FuncTypes.h"
+#include "ProSelecta/GenEventPool.h"
+#include "ProSelecta/Histogram.h"
+
+#include "HepMC3/GenEvent.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace HepMC3 {
+class Reader;
+}
+
+namespace ps {
+
+struct LoopMetrics;
+
+// The hooks that are evaluated for every event, every event passes if select
+// is not set. The selections are evaluated on every event, whether or not it
+// passes select, into a bitmask.
+struct EventHooks {
+  SelectFunc select;
+  std::vector<ProjectionFunc> projections;
+  std::vector<WeightFunc> weights;
+  std::vector<SelectFunc> selections;
+};
+
+struct EventResult {
+  size_t evtnum;
+  bool pass;
+  // the projections followed by the weights, only evaluated for events that
+  // pass the selection
+  std::vector<double> values;
+  // bit i % 64 of word i / 64 is set if selection i passed, empty if there
+  // are no selections
+  std::vector<uint64_t> selmask;
+};
+
+// The number of 64-bit words in the bitmask of nselections selections
+inline size_t selmask_words(size_t nselections) {
+  return (nselections + 63) / 64;
+}
+inline bool selmask_test(std::vector<uint64_t> const &mask, size_t i) {
+  return (mask[i / 64] >> (i % 64)) & 1;
+}
+
+// Evaluates the hooks on a single event, projections and weights are only
+// evaluated if the event is selected.
+EventResult evaluate_event(EventHooks const &hooks, size_t evtnum,
+                           HepMC3::GenEvent const &evt);
+
+// The events of an input to process, numbered from 0 at the start of the
+// input. Events in [skip, skip + max_events) are processed. If nshards > 1,
+// that range is further divided into chunks of chunk_size events, aligned to
+// multiples of chunk_size, and only chunks shard, shard + nshards,
+// shard + 2 * nshards, ... are processed. The shards of a range are disjoint
+// and together cover it.
+struct EventRange {
+  size_t skip = 0;
+  size_t max_events = std::numeric_limits<size_t>::max();
+  size_t shard = 0;
+  size_t nshards = 1;
+  size_t chunk_size = 1 << 16;
+
+  // one past the last event of the unsharded range
+  size_t end() const;
+  bool contains(size_t evtnum) const;
+  // The first event >= evtnum in the range, or end() if there are none
+  size_t next(size_t evtnum) const;
+  // One past the last event of the contiguous run of events in the range that
+  // starts at evtnum, which must be in the range
+  size_t run_end(size_t evtnum) const;
+
+  // throws std::runtime_error if the range cannot be processed in batches of
+  // batch_size events, the chunks of a sharded range must hold a whole number
+  // of batches
+  void validate(size_t batch_size) const;
+};
+
+// Skips nevents events, returns false if the end of the input was reached
+bool skip_events(HepMC3::Reader &rdr, size_t nevents);
+
+// Reads the next event, or returns nullptr at the end of the input. Events
+// that a MultiFileReader has already decoded are handed over, not copied.
+// Other readers read into an event taken from pool, if given.
+std::unique_ptr<HepMC3::GenEvent> next_event(HepMC3::Reader &rdr,
+                                             GenEventPool *pool = nullptr);
+// Hands an event from next_event back to be refilled, to the MultiFileReader
+// that decoded it, or to pool
+void recycle_event(HepMC3::Reader &rdr, std::unique_ptr<HepMC3::GenEvent> evt,
+                   GenEventPool *pool = nullptr);
+
+// A contiguous run of events, batch index covers events
+// [first_evtnum, first_evtnum + nevents)
+struct EventBatch {
+  size_t index;
+  size_t first_evtnum;
+  size_t nevents;
+  std::vector<std::unique_ptr<HepMC3::GenEvent>> events;
+  // the results of every set of hooks on every event, results[i * nhooks + h]
+  // is that of hooks h on event i
+  std::vector<EventResult> results;
+  // the histogram fills of the events of this batch, in event order, if the
+  // loop fills histograms, see HistogramAccumulator
+  std::vector<HistogramFill> fills;
+  // set if evaluating a hook on this batch threw
+  std::exception_ptr error;
+};
+
+// Evaluates the hooks on every event read from a HepMC3::Reader with a pool of
+// worker threads.
+//
+// A reader thread fills batches of batch_size events and deals them
+// round-robin onto per-worker queues of depth queue_depth. The calling thread
+// collects evaluated batches from the workers in the same order and passes
+// them to consume, so batches are always consumed in event order, regardless
+// of how long each took to evaluate.
+//
+// The hooks are called concurrently from different threads and so must not
+// modify shared state.
+//
+// Batches never span a multiple of batch_size, or a chunk boundary of a
+// sharded EventRange, whose chunk_size must be a multiple of batch_size.
+//
+// Events are recycled once their batch has been consumed, see GenEventPool.
+//
+// Several independent sets of hooks, such as the analyses of a
+// multi-analysis run, can be evaluated on each event as it is read, rather
+// than reading the input once per set, see EventBatch::results.
+//
+// The bins that each event fills are found on the worker threads, using the
+// selection of the first set of hooks, see EventBatch::fills. Applying the
+// fills in the order that the batches are consumed gives a result that
+// depends on neither batch_size nor nthreads.
+//
+// If metrics are given, events read are counted by the reader thread, events
+// selected by the first set of hooks by the workers, and the queue depths are
+// tracked, once per batch.
+class EventLoop {
+  std::vector<EventHooks> hooks;
+  size_t nthreads;
+  size_t batch_size;
+  size_t queue_depth;
+  std::optional<HistogramSet> histograms;
+  LoopMetrics *metrics;
+
+public:
+  EventLoop(EventHooks hooks, size_t nthreads, size_t batch_size = 256,
+            size_t queue_depth = 4);
+  EventLoop(std::vector<EventHooks> hooks, size_t nthreads,
+            size_t batch_size = 256, size_t queue_depth = 4);
+
+  // Find the fills of hists for every batch, see EventBatch
+  void fill_histograms(HistogramSet const &hists);
+  // Update metrics, which must outlive every call to run
+  void set_metrics(LoopMetrics *metrics);
+
+  // Returns the number of events read in range. Exceptions thrown by the
+  // hooks, the reader, or consume are rethrown on the calling thread after all
+  // worker threads have stopped.
+  //
+  // If evtnum is given, it holds the number of the next event that rdr would
+  // read, rather than 0, and is updated when run returns, so that a range can
+  // be processed over several calls, as when checkpointing.
+  //
+  // consume may move the results and fills out of a batch, but not its
+  // events, which are handed back to be refilled.
+  size_t run(HepMC3::Reader &rdr,
+             std::function<void(EventBatch &)> const &consume,
+             EventRange const &range = EventRange(), size_t *evtnum = nullptr);
+};
+
+} // namespace ps
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "HepMC3/GenEvent.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ps {
+
+// A thread-safe free list of GenEvents, so that the events handed around the
+// event loop are reused rather than allocated and destroyed for every event.
+//
+// HepMC3 particles and vertices are shared_ptrs that are always freed when an
+// event is cleared, but a reused event keeps its own allocation and the
+// capacity of its particle, vertex, and weight vectors. Released events are
+// not cleared until they are acquired again, so that the clearing happens on
+// the acquiring thread, which is usually a background reader thread.
+class GenEventPool {
+  std::mutex mtx;
+  std::vector<std::unique_ptr<HepMC3::GenEvent>> free;
+  size_t nallocated;
+
+public:
+  GenEventPool() : mtx(), free(), nallocated(0) {}
+  GenEventPool(GenEventPool const &) = delete;
+  GenEventPool &operator=(GenEventPool const &) = delete;
+
+  // Returns an empty event, reused if one is free
+  std::unique_ptr<HepMC3::GenEvent> acquire() {
+    std::unique_ptr<HepMC3::GenEvent> evt;
+    {
+      std::lock_guard<std::mutex> lk(mtx);
+      if (free.empty()) {
+        nallocated++;
+      } else {
+        evt = std::move(free.back());
+        free.pop_back();
+      }
+    }
+    if (!evt) {
+      return std::make_unique<HepMC3::GenEvent>();
+    }
+    evt->clear();
+    return evt;
+  }
+
+  void release(std::unique_ptr<HepMC3::GenEvent> evt) {
+    if (!evt) {
+      return;
+    }
+    std::lock_guard<std::mutex> lk(mtx);
+    free.push_back(std::move(evt));
+  }
+
+  // The number of events allocated by the pool so far
+  size_t allocated() {
+    std::lock_guard<std::mutex> lk(mtx);
+    return nallocated;
+  }
+};
+
+} // namespace ps
@@ -0,0 +1,417 @@
+#include "ProSelecta/Histogram.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+char const hist_magic[9] = "PSHIST01";
+char const chunks_magic[9] = "PSHCHK01";
+
+template <typename T> void append_pod(std::string &buf, T const &v) {
+  buf.append(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+template <typename T>
+void append_array(std::string &buf, std::vector<T> const &v) {
+  append_pod(buf, uint64_t(v.size()));
+  buf.append(reinterpret_cast<char const *>(v.data()), sizeof(T) * v.size());
+}
+
+void read_or_throw(FILE *f, std::string const &path, void *data,
+                   size_t size) {
+  if (size && (std::fread(data, 1, size, f) != size)) {
+    throw std::runtime_error("Unexpected end of histogram file: " + path);
+  }
+}
+
+template <typename T> T read_pod(FILE *f, std::string const &path) {
+  T v;
+  read_or_throw(f, path, &v, sizeof(T));
+  return v;
+}
+
+template <typename T>
+std::vector<T> read_array(FILE *f, std::string const &path) {
+  std::vector<T> v(read_pod<uint64_t>(f, path));
+  read_or_throw(f, path, v.data(), sizeof(T) * v.size());
+  return v;
+}
+
+void write_file(std::string const &path, std::string const &buf) {
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "wb"),
+                                           &std::fclose);
+  if (!f || (std::fwrite(buf.data(), 1, buf.size(), f.get()) != buf.size())) {
+    throw std::runtime_error("Failed to write histogram file: " + path);
+  }
+}
+
+std::unique_ptr<FILE, int (*)(FILE *)> open_with_magic(std::string const &path,
+                                                       char const *magic) {
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"),
+                                           &std::fclose);
+  if (!f) {
+    throw std::runtime_error("Failed to open histogram file: " + path);
+  }
+
+  char file_magic[8];
+  if ((std::fread(file_magic, 1, 8, f.get()) != 8) ||
+      std::memcmp(file_magic, magic, 8)) {
+    std::stringstream ss("");
+    ss << path << " is not a file of type " << std::string(magic, 8);
+    throw std::runtime_error(ss.str());
+  }
+  return f;
+}
+
+bool has_magic(std::string const &path, char const *magic) {
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"),
+                                           &std::fclose);
+  char file_magic[8];
+  return f && (std::fread(file_magic, 1, 8, f.get()) == 8) &&
+         !std::memcmp(file_magic, magic, 8);
+}
+
+} // namespace
+
+void append_histograms(std::string &buf, std::vector<Histogram> const &hists) {
+  append_pod(buf, uint64_t(hists.size()));
+  for (auto const &hist : hists) {
+    append_pod(buf, uint64_t(hist.name.size()));
+    buf += hist.name;
+    append_pod(buf, uint64_t(hist.axes.size()));
+    for (auto const &axis : hist.axes) {
+      append_array(buf, axis.edges);
+    }
+    append_pod(buf, uint64_t(hist.entries));
+    append_array(buf, hist.sumw);
+    append_array(buf, hist.sumw2);
+  }
+}
+
+std::vector<Histogram> read_histograms(FILE *f, std::string const &path) {
+  std::vector<Histogram> hists(read_pod<uint64_t>(f, path));
+  for (auto &hist : hists) {
+    hist.name.resize(read_pod<uint64_t>(f, path));
+    read_or_throw(f, path, hist.name.data(), hist.name.size());
+    hist.axes.resize(read_pod<uint64_t>(f, path));
+    for (auto &axis : hist.axes) {
+      axis.edges = read_array<double>(f, path);
+    }
+    hist.entries = read_pod<uint64_t>(f, path);
+    hist.sumw = read_array<double>(f, path);
+    hist.sumw2 = read_array<double>(f, path);
+  }
+  return hists;
+}
+
+HistogramAxis HistogramAxis::uniform(size_t nbins, double low, double high) {
+  if (!nbins || !(high > low)) {
+    std::stringstream ss("");
+    ss << "Invalid uniform histogram axis: " << nbins << " bins from " << low
+       << " to " << high;
+    throw std::runtime_error(ss.str());
+  }
+  HistogramAxis axis;
+  for (size_t i = 0; i <= nbins; ++i) {
+    axis.edges.push_back(low + (high - low) * double(i) / double(nbins));
+  }
+  return axis;
+}
+
+size_t HistogramAxis::find_bin(double x) const {
+  if (x < edges.front()) {
+    return 0;
+  } else if (!(x < edges.back())) {
+    return nbins() + 1;
+  }
+  return std::upper_bound(edges.begin(), edges.end(), x) - edges.begin();
+}
+
+Histogram::Histogram() : name(), axes(), sumw(), sumw2(), entries(0) {}
+
+Histogram::Histogram(std::string n, std::vector<HistogramAxis> a)
+    : name(std::move(n)), axes(std::move(a)), sumw(), sumw2(), entries(0) {
+  if (axes.empty()) {
+    std::stringstream ss("");
+    ss << "Histogram " << name << " has no axes.";
+    throw std::runtime_error(ss.str());
+  }
+  size_t nbins = 1;
+  for (auto const &axis : axes) {
+    if ((axis.edges.size() < 2) ||
+        !std::is_sorted(axis.edges.begin(), axis.edges.end(),
+                        std::less_equal<double>())) {
+      std::stringstream ss("");
+      ss << "Histogram " << name
+         << " has an axis without at least two increasing bin edges.";
+      throw std::runtime_error(ss.str());
+    }
+    nbins *= axis.nbins() + 2;
+  }
+  sumw.resize(nbins, 0);
+  sumw2.resize(nbins, 0);
+}
+
+size_t Histogram::find_bin(double const *x) const {
+  size_t bin = 0;
+  size_t stride = 1;
+  for (size_t i = 0; i < axes.size(); ++i) {
+    bin += axes[i].find_bin(x[i]) * stride;
+    stride *= axes[i].nbins() + 2;
+  }
+  return bin;
+}
+
+void Histogram::fill(double const *x, double w) { fill_bin(find_bin(x), w); }
+
+void Histogram::fill_bin(size_t bin, double w) {
+  sumw[bin] += w;
+  sumw2[bin] += w * w;
+  entries++;
+}
+
+void Histogram::add(Histogram const &other) {
+  if (axes != other.axes) {
+    std::stringstream ss("");
+    ss << "Cannot add histogram " << other.name << " to histogram " << name
+       << " as they have different binning.";
+    throw std::runtime_error(ss.str());
+  }
+  for (size_t i = 0; i < sumw.size(); ++i) {
+    sumw[i] += other.sumw[i];
+    sumw2[i] += other.sumw2[i];
+  }
+  entries += other.entries;
+}
+
+void Histogram::reset() {
+  std::fill(sumw.begin(), sumw.end(), 0);
+  std::fill(sumw2.begin(), sumw2.end(), 0);
+  entries = 0;
+}
+
+void apply_fills(std::vector<Histogram> &hists,
+                 std::vector<HistogramFill> const &fills) {
+  for (auto const &f : fills) {
+    hists[f.hist].fill_bin(f.bin, f.w);
+  }
+}
+
+HistogramSet::HistogramSet(std::vector<HistogramSpec> s)
+    : specs(std::make_shared<std::vector<HistogramSpec> const>(std::move(s))),
+      histograms() {
+  for (auto const &spec : *specs) {
+    if (spec.projections.size() != spec.axes.size()) {
+      std::stringstream ss("");
+      ss << "Histogram " << spec.name << " has " << spec.axes.size()
+         << " axes but " << spec.projections.size() << " projections.";
+      throw std::runtime_error(ss.str());
+    }
+    histograms.emplace_back(spec.name, spec.axes);
+  }
+}
+
+HistogramSet HistogramSet::empty_clone() const {
+  HistogramSet clone(*this);
+  clone.reset();
+  return clone;
+}
+
+void HistogramSet::fill(HepMC3::GenEvent const &ev, bool pass) {
+  // reused, so that filling does not allocate once it has grown
+  thread_local std::vector<HistogramFill> fills;
+  fills.clear();
+  find_fills(ev, pass, 0, fills);
+  apply_fills(histograms, fills);
+}
+
+void HistogramSet::find_fills(HepMC3::GenEvent const &ev, bool pass,
+                              size_t evtnum,
+                              std::vector<HistogramFill> &fills) const {
+  // the coordinates of one fill, per thread as this may be called from several
+  thread_local std::vector<double> x;
+  for (size_t h = 0; h < specs->size(); ++h) {
+    auto const &spec = (*specs)[h];
+    if (!(spec.select ? bool(spec.select(ev)) : pass)) {
+      continue;
+    }
+    x.resize(spec.projections.size());
+    for (size_t i = 0; i < spec.projections.size(); ++i) {
+      x[i] = spec.projections[i](ev);
+    }
+    double w = 1;
+    for (auto const &wgt : spec.weights) {
+      w *= wgt(ev);
+    }
+    fills.push_back({evtnum, h, histograms[h].find_bin(x.data()), w});
+  }
+}
+
+void HistogramSet::add(HistogramSet const &other) {
+  add_histograms(histograms, other.histograms);
+}
+
+void HistogramSet::reset() {
+  for (auto &hist : histograms) {
+    hist.reset();
+  }
+}
+
+void add_histograms(std::vector<Histogram> &into,
+                    std::vector<Histogram> const &from) {
+  if (into.size() != from.size()) {
+    std::stringstream ss("");
+    ss << "Cannot add a set of " << from.size() << " histograms to a set of "
+       << into.size() << ".";
+    throw std::runtime_error(ss.str());
+  }
+  for (size_t h = 0; h < into.size(); ++h) {
+    into[h].add(from[h]);
+  }
+}
+
+HistogramAccumulator::HistogramAccumulator(
+    std::vector<Histogram> const &prototype, size_t cs, bool keep)
+    : chunk_size(cs ? cs : 1), keep_chunks(keep), total(prototype),
+      current{0, prototype}, current_open(false), chunks() {
+  for (auto &hist : total) {
+    hist.reset();
+  }
+  for (auto &hist : current.histograms) {
+    hist.reset();
+  }
+}
+
+void HistogramAccumulator::finish_chunk() {
+  if (!current_open) {
+    return;
+  }
+  add_histograms(total, current.histograms);
+  if (keep_chunks) {
+    chunks.push_back(current);
+  }
+  for (auto &hist : current.histograms) {
+    hist.reset();
+  }
+  current_open = false;
+}
+
+void HistogramAccumulator::add(std::vector<HistogramFill> const &fills) {
+  for (auto const &f : fills) {
+    size_t index = f.evtnum / chunk_size;
+    if (current_open && (current.index != index)) {
+      finish_chunk();
+    }
+    current.index = index;
+    current_open = true;
+    current.histograms[f.hist].fill_bin(f.bin, f.w);
+  }
+}
+
+void HistogramAccumulator::add_chunk(HistogramChunk const &chunk) {
+  finish_chunk();
+  add_histograms(total, chunk.histograms);
+  if (keep_chunks) {
+    chunks.push_back(chunk);
+  }
+}
+
+HistogramAccumulator::State HistogramAccumulator::get_state() const {
+  State state{total, std::nullopt, chunks};
+  if (current_open) {
+    state.current = current;
+  }
+  return state;
+}
+
+void HistogramAccumulator::restore(State state) {
+  total = std::move(state.total);
+  current_open = bool(state.current);
+  if (current_open) {
+    current = std::move(*state.current);
+  } else {
+    for (auto &hist : current.histograms) {
+      hist.reset();
+    }
+  }
+  chunks = std::move(state.chunks);
+}
+
+std::vector<Histogram> const &HistogramAccumulator::finish() {
+  finish_chunk();
+  return total;
+}
+
+void write_histograms_binary(std::string const &path,
+                             std::vector<Histogram> const &hists) {
+  std::string buf(hist_magic, 8);
+  append_histograms(buf, hists);
+  write_file(path, buf);
+}
+
+std::vector<Histogram> read_histograms_binary(std::string const &path) {
+  auto f = open_with_magic(path, hist_magic);
+  return read_histograms(f.get(), path);
+}
+
+void write_histogram_chunks(std::string const &path,
+                            HistogramChunkFile const &chunks) {
+  std::string buf(chunks_magic, 8);
+  append_histograms(buf, chunks.prototype);
+  append_pod(buf, uint64_t(chunks.chunks.size()));
+  for (auto const &chunk : chunks.chunks) {
+    append_pod(buf, uint64_t(chunk.index));
+    append_histograms(buf, chunk.histograms);
+  }
+  write_file(path, buf);
+}
+
+HistogramChunkFile read_histogram_chunks(std::string const &path) {
+  auto f = open_with_magic(path, chunks_magic);
+  HistogramChunkFile chunks;
+  chunks.prototype = read_histograms(f.get(), path);
+  chunks.chunks.resize(read_pod<uint64_t>(f.get(), path));
+  for (auto &chunk : chunks.chunks) {
+    chunk.index = read_pod<uint64_t>(f.get(), path);
+    chunk.histograms = read_histograms(f.get(), path);
+  }
+  return chunks;
+}
+
+bool is_histograms_binary(std::string const &path) {
+  return has_magic(path, hist_magic);
+}
+
+bool is_histogram_chunks(std::string const &path) {
+  return has_magic(path, chunks_magic);
+}
+
+ROOTHistogramWriter &root_histogram_writer() {
+  static ROOTHistogramWriter writer = nullptr;
+  return writer;
+}
+
+void write_histograms(std::string const &path,
+                      std::vector<Histogram> const &hists) {
+  if (std::filesystem::path(path).extension() == ".root") {
+    if (!root_histogram_writer()) {
+      throw std::runtime_error(
+          "ROOT files require ProSelectaROOTIO, which was either not built or "
+          "not enabled with ps::enable_root_io: " +
+          path);
+    }
+    root_histogram_writer()(path, hists);
+  } else {
+    write_histograms_binary(path, hists);
+  }
+}
+
+} // namespace ps
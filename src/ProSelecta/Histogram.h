@@ -0,0 +1,203 @@
+#pragma once
+
+#include "ProSelecta/FuncTypes.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+// The bin edges of one histogram axis
+struct HistogramAxis {
+  std::vector<double> edges;
+
+  static HistogramAxis uniform(size_t nbins, double low, double high);
+
+  size_t nbins() const { return edges.size() - 1; }
+  // As in ROOT, bin 0 is the underflow bin and bin nbins() + 1 is the
+  // overflow bin, NaNs are placed in the overflow bin.
+  size_t find_bin(double x) const;
+
+  bool operator==(HistogramAxis const &other) const {
+    return edges == other.edges;
+  }
+};
+
+// A weighted histogram of any dimension with an underflow and an overflow bin
+// on each axis. Bins are stored with the first axis varying fastest, so that
+// the global bin numbers match those of ROOT's TH1, TH2 and TH3.
+struct Histogram {
+  std::string name;
+  std::vector<HistogramAxis> axes;
+  std::vector<double> sumw;
+  std::vector<double> sumw2;
+  size_t entries;
+
+  Histogram();
+  Histogram(std::string name, std::vector<HistogramAxis> axes);
+
+  // x holds one coordinate per axis
+  size_t find_bin(double const *x) const;
+  void fill(double const *x, double w = 1);
+  void fill_bin(size_t bin, double w = 1);
+
+  // Adds the contents of another histogram with identical binning
+  void add(Histogram const &other);
+  void reset();
+};
+
+// How to fill one histogram. Every event that is selected is filled at the
+// value of one projection per axis, with a weight that is the product of the
+// weight functions, or 1 if there are none. If select is not set, the
+// histogram is filled for every event that passes the event loop selection.
+struct HistogramSpec {
+  std::string name;
+  std::vector<HistogramAxis> axes;
+  std::vector<ProjectionFunc> projections;
+  std::vector<WeightFunc> weights;
+  SelectFunc select;
+};
+
+// One fill of histogram hist of a HistogramSet, from event evtnum
+struct HistogramFill {
+  size_t evtnum;
+  size_t hist;
+  size_t bin;
+  double w;
+};
+
+// Fills each fill, which must be in event order, into the histogram at
+// position hist of hists
+void apply_fills(std::vector<Histogram> &hists,
+                 std::vector<HistogramFill> const &fills);
+
+// The histograms described by a list of HistogramSpecs.
+//
+// To fill in parallel, each thread finds the bins that its events fill with
+// find_fills, which only evaluates the hooks, and the fills are applied in
+// event order on one thread. Because floating point addition is not
+// associative, this gives exactly the result of filling every event in turn,
+// however many threads found the fills.
+class HistogramSet {
+  std::shared_ptr<std::vector<HistogramSpec> const> specs;
+
+public:
+  std::vector<Histogram> histograms;
+
+  explicit HistogramSet(std::vector<HistogramSpec> specs);
+
+  // A set of empty histograms with the same specifications
+  HistogramSet empty_clone() const;
+
+  // Evaluates the histogram hooks and fills every histogram that selects ev.
+  // pass is the event loop selection, used for specs without their own.
+  void fill(HepMC3::GenEvent const &ev, bool pass);
+  // Appends the fills that fill would make for event evtnum to fills, without
+  // filling, may be called from several threads at once
+  void find_fills(HepMC3::GenEvent const &ev, bool pass, size_t evtnum,
+                  std::vector<HistogramFill> &fills) const;
+
+  void add(HistogramSet const &other);
+  void reset();
+};
+
+// The histograms filled from the events of one chunk of an EventRange
+struct HistogramChunk {
+  size_t index;
+  std::vector<Histogram> histograms;
+};
+
+// Sums histogram fills in a fixed order that does not depend on how a run was
+// threaded or sharded. The fills of the events in each chunk of chunk_size
+// events are applied in event order to a chunk partial, which is reset, not
+// re-created, for each chunk, and the chunk partials are summed in chunk
+// order into the total. Only whole histograms are added at chunk boundaries.
+//
+// As the shards of an EventRange process whole chunks, the chunk partials
+// kept by sharded runs can be combined with add_chunk to give exactly the
+// total of a single run over the whole range.
+class HistogramAccumulator {
+public:
+  // The partial sums part way through a run, for checkpoints
+  struct State {
+    std::vector<Histogram> total;
+    std::optional<HistogramChunk> current;
+    std::vector<HistogramChunk> chunks;
+  };
+
+private:
+  size_t chunk_size;
+  bool keep_chunks;
+  std::vector<Histogram> total;
+  HistogramChunk current;
+  bool current_open;
+  std::vector<HistogramChunk> chunks;
+
+  void finish_chunk();
+
+public:
+  HistogramAccumulator(std::vector<Histogram> const &prototype,
+                       size_t chunk_size, bool keep_chunks = false);
+
+  // Fills must be added in event order
+  void add(std::vector<HistogramFill> const &fills);
+  // Chunks must be added in chunk order
+  void add_chunk(HistogramChunk const &chunk);
+
+  // Completes the current chunk and returns the total
+  std::vector<Histogram> const &finish();
+  // The completed chunk partials, if keep_chunks
+  std::vector<HistogramChunk> const &get_chunks() const { return chunks; }
+
+  // Adding the same partials after restoring a state gives exactly the same
+  // total as adding them to the accumulator that the state was taken from
+  State get_state() const;
+  void restore(State state);
+};
+
+// Adds each histogram in from to the histogram at the same position in into
+void add_histograms(std::vector<Histogram> &into,
+                    std::vector<Histogram> const &from);
+
+// Appends hists to buf in the binary format, without a magic, and reads them
+// back from f, for embedding histograms in other binary files. path is only
+// used in error messages.
+void append_histograms(std::string &buf, std::vector<Histogram> const &hists);
+std::vector<Histogram> read_histograms(FILE *f, std::string const &path);
+
+// A compact native-endian binary format, for merging and post-processing
+void write_histograms_binary(std::string const &path,
+                             std::vector<Histogram> const &hists);
+std::vector<Histogram> read_histograms_binary(std::string const &path);
+
+// The chunk partials of a sharded run, and a set of empty histograms that
+// defines the binning, so that shards without any events can be merged
+struct HistogramChunkFile {
+  std::vector<Histogram> prototype;
+  std::vector<HistogramChunk> chunks;
+};
+
+// Stored in a similar binary format
+void write_histogram_chunks(std::string const &path,
+                            HistogramChunkFile const &chunks);
+HistogramChunkFile read_histogram_chunks(std::string const &path);
+
+// Whether the file at path starts with the magic of the binary histogram, or
+// the histogram chunk, format
+bool is_histograms_binary(std::string const &path);
+bool is_histogram_chunks(std::string const &path);
+
+// Writes ROOT files, set by ps::enable_root_io, see ProSelecta/ROOTIO.h
+using ROOTHistogramWriter = void (*)(std::string const &,
+                                     std::vector<Histogram> const &);
+ROOTHistogramWriter &root_histogram_writer();
+
+// Writes a ROOT file if path ends in .root, and the binary format otherwise
+void write_histograms(std::string const &path,
+                      std::vector<Histogram> const &hists);
+
+} // namespace ps
@@ -0,0 +1,172 @@
+#include "ProSelecta/Metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace ps {
+
+namespace {
+
+std::string format_hms(double s) {
+  long ts = long(s + 0.5);
+  std::stringstream ss("");
+  ss << (ts / 3600) << ":" << std::setw(2) << std::setfill('0')
+     << ((ts / 60) % 60) << ":" << std::setw(2) << std::setfill('0')
+     << (ts % 60);
+  return ss.str();
+}
+
+} // namespace
+
+std::string format_progress(MetricsSnapshot const &snap) {
+  std::stringstream ss("");
+  ss << std::fixed << std::setprecision(1) << "[PROGRESS]: "
+     << snap.events_read << " events read, " << snap.events_selected
+     << " selected, " << (snap.events_per_s * 1E-3) << " kHz (avg "
+     << (snap.events_per_s_avg * 1E-3) << " kHz)";
+  if (snap.bytes_read) {
+    ss << ", " << (snap.bytes_read / 1E6);
+    if (snap.bytes_total) {
+      ss << "/" << (snap.bytes_total / 1E6) << " MB ("
+         << std::min(100.0, (100.0 * snap.bytes_read) / snap.bytes_total)
+         << "%)";
+    } else {
+      ss << " MB";
+    }
+  }
+  if (snap.eta_s >= 0) {
+    ss << ", ETA " << format_hms(snap.eta_s);
+  }
+  if (snap.input_queue_depth || snap.output_queue_depth) {
+    ss << ", queued " << snap.input_queue_depth << " in "
+       << snap.output_queue_depth << " out";
+  }
+  return ss.str();
+}
+
+std::string format_prometheus(MetricsSnapshot const &snap) {
+  std::stringstream ss("");
+  ss << std::setprecision(17);
+  auto metric = [&](char const *name, char const *type, char const *help,
+                    auto value) {
+    ss << "# HELP proselecta_" << name << " " << help << "\n"
+       << "# TYPE proselecta_" << name << " " << type << "\n"
+       << "proselecta_" << name << " " << value << "\n";
+  };
+  metric("events_read_total", "counter", "Events read from the input.",
+         snap.events_read);
+  metric("events_selected_total", "counter",
+         "Events that passed the selection.", snap.events_selected);
+  metric("events_per_second", "gauge",
+         "Events read per second over the last interval.", snap.events_per_s);
+  metric("events_per_second_average", "gauge",
+         "Events read per second since the event loop started.",
+         snap.events_per_s_avg);
+  metric("bytes_read_total", "counter",
+         "Bytes of the input files read.",
+         snap.bytes_read);
+  metric("input_bytes", "gauge", "Total size of the input files.",
+         snap.bytes_total);
+  if (snap.eta_s >= 0) {
+    metric("eta_seconds", "gauge",
+           "Estimated seconds until the event loop finishes.", snap.eta_s);
+  }
+  metric("input_queue_depth", "gauge", "Batches waiting to be evaluated.",
+         snap.input_queue_depth);
+  metric("output_queue_depth", "gauge",
+         "Evaluated batches waiting to be consumed.", snap.output_queue_depth);
+  metric("elapsed_seconds", "gauge", "Seconds since the event loop started.",
+         snap.elapsed_s);
+  return ss.str();
+}
+
+MetricsReporter::MetricsReporter(LoopMetrics const &m, double interval_s,
+                                 bool p, std::string tf, uint64_t bt,
+                                 uint64_t et)
+    : metrics(m), interval(std::max(interval_s, 1E-3)), print(p),
+      textfile(std::move(tf)), bytes_total(bt), events_total(et),
+      start(std::chrono::steady_clock::now()), last(start),
+      last_events_read(metrics.events_read.load(std::memory_order_relaxed)),
+      mtx(), cv(), stopping(false), thread() {
+  thread = std::thread([this]() {
+    std::unique_lock<std::mutex> lk(mtx);
+    while (!cv.wait_for(lk, interval, [this]() { return stopping; })) {
+      lk.unlock();
+      report();
+      lk.lock();
+    }
+  });
+}
+
+MetricsReporter::~MetricsReporter() { stop(); }
+
+void MetricsReporter::stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  thread.join();
+  report();
+}
+
+MetricsSnapshot MetricsReporter::snapshot() {
+  auto now = std::chrono::steady_clock::now();
+  MetricsSnapshot snap;
+  snap.elapsed_s = std::chrono::duration<double>(now - start).count();
+  snap.events_read = metrics.events_read.load(std::memory_order_relaxed);
+  snap.events_selected =
+      metrics.events_selected.load(std::memory_order_relaxed);
+  snap.input_queue_depth =
+      metrics.input_queue_depth.load(std::memory_order_relaxed);
+  snap.output_queue_depth =
+      metrics.output_queue_depth.load(std::memory_order_relaxed);
+
+  double dt = std::chrono::duration<double>(now - last).count();
+  snap.events_per_s =
+      (dt > 0) ? ((snap.events_read - last_events_read) / dt) : 0;
+  snap.events_per_s_avg =
+      (snap.elapsed_s > 0) ? (snap.events_read / snap.elapsed_s) : 0;
+  last = now;
+  last_events_read = snap.events_read;
+
+  snap.bytes_read = metrics.bytes_read.load(std::memory_order_relaxed);
+  snap.bytes_total = bytes_total;
+
+  snap.eta_s = -1;
+  if (events_total && (snap.events_per_s_avg > 0)) {
+    snap.eta_s = (events_total - std::min(snap.events_read, events_total)) /
+                 snap.events_per_s_avg;
+  } else if (bytes_total && snap.bytes_read && (snap.elapsed_s > 0)) {
+    snap.eta_s = (bytes_total - std::min(snap.bytes_read, bytes_total)) /
+                 (snap.bytes_read / snap.elapsed_s);
+  }
+  return snap;
+}
+
+void MetricsReporter::report() {
+  auto snap = snapshot();
+  if (print) {
+    std::cerr << format_progress(snap) << std::endl;
+  }
+  if (textfile.size()) {
+    std::string tmp = textfile + ".tmp";
+    {
+      std::ofstream ofs(tmp);
+      ofs << format_prometheus(snap);
+    }
+    if (std::rename(tmp.c_str(), textfile.c_str())) {
+      std::cerr << "[WARN]: Failed to write metrics file: " << textfile
+                << std::endl;
+    }
+  }
+}
+
+} // namespace ps
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ps {
+
+// Counters and gauges of the progress of an event loop. They are updated with
+// relaxed atomics by whichever thread does the work, at most once per event
+// and usually once per batch, and read by a MetricsReporter. Nothing is
+// updated unless a LoopMetrics is given to the loop.
+struct LoopMetrics {
+  std::atomic<uint64_t> events_read{0};
+  std::atomic<uint64_t> events_selected{0};
+  // batches waiting to be evaluated, and evaluated batches waiting to be
+  // consumed, in EventLoop
+  std::atomic<uint64_t> input_queue_depth{0};
+  std::atomic<uint64_t> output_queue_depth{0};
+  // input bytes consumed by the readers, see MultiFileReader
+  std::atomic<uint64_t> bytes_read{0};
+};
+
+// A point-in-time view of a LoopMetrics, with the derived rates
+struct MetricsSnapshot {
+  double elapsed_s;
+  uint64_t events_read;
+  uint64_t events_selected;
+  // over the last reporting interval, and since the reporter started
+  double events_per_s;
+  double events_per_s_avg;
+  // 0 if unknown
+  uint64_t bytes_read;
+  uint64_t bytes_total;
+  // negative if unknown
+  double eta_s;
+  uint64_t input_queue_depth;
+  uint64_t output_queue_depth;
+};
+
+// One human-readable line
+std::string format_progress(MetricsSnapshot const &snap);
+// The Prometheus text exposition format, for the node_exporter textfile
+// collector
+std::string format_prometheus(MetricsSnapshot const &snap);
+
+// Reports a LoopMetrics every interval_s seconds from a background thread, by
+// printing a line to stderr if print is set, and by rewriting textfile, if
+// given, atomically with a rename. A last report is made when the reporter
+// is stopped.
+//
+// Bytes read are those counted in metrics by the input readers. The ETA is
+// estimated from the events still to read if events_total is known, otherwise
+// from the bytes still to read if bytes_total, usually the sum of the sizes
+// of the input files, is known.
+class MetricsReporter {
+  LoopMetrics const &metrics;
+  std::chrono::duration<double> interval;
+  bool print;
+  std::string textfile;
+  uint64_t bytes_total;
+  uint64_t events_total;
+
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point last;
+  uint64_t last_events_read;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping;
+  std::thread thread;
+
+  MetricsSnapshot snapshot();
+  void report();
+
+public:
+  MetricsReporter(LoopMetrics const &metrics, double interval_s, bool print,
+                  std::string textfile = "", uint64_t bytes_total = 0,
+                  uint64_t events_total = 0);
+  MetricsReporter(MetricsReporter const &) = delete;
+  MetricsReporter &operator=(MetricsReporter const &) = delete;
+  ~MetricsReporter();
+
+  void stop();
+};
+
+} // namespace ps
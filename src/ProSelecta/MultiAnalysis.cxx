@@ -0,0 +1,98 @@
+#include "ProSelecta/MultiAnalysis.h"
+#include "ProSelecta/ResultStore.h"
+
+#include <memory>
+#include <set>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+std::unique_ptr<AsyncSinks> open_sinks(std::vector<Analysis> const &analyses) {
+  if (analyses.empty()) {
+    throw std::runtime_error("run_analyses requires at least one analysis.");
+  }
+
+  std::set<std::string> output_paths;
+  for (auto const &ana : analyses) {
+    if (!output_paths.insert(ana.output_path).second) {
+      throw std::runtime_error("Analysis " + ana.name +
+                               " writes to the same output as another, " +
+                               ana.output_path);
+    }
+  }
+
+  // one writer thread is shared by the outputs of every analysis
+  std::vector<std::unique_ptr<OutputSink>> outputs;
+  std::vector<OutputColumns> cols;
+  for (auto const &ana : analyses) {
+    outputs.push_back(deduce_sink(ana.output_path, ana.output_format));
+    cols.push_back(ana.columns);
+  }
+  auto sinks = std::make_unique<AsyncSinks>(std::move(outputs));
+  sinks->open(cols);
+  return sinks;
+}
+
+// Moves the rows of each analysis out of the results of every analysis on a
+// block of events, results[i * nanalyses + a] is that of analysis a on event
+// i
+void write_rows(std::vector<EventResult> &results, AsyncSinks &sinks,
+                std::vector<size_t> &events_selected) {
+  size_t const nanalyses = sinks.size();
+  for (size_t i = 0; i < results.size(); ++i) {
+    events_selected[i % nanalyses] += results[i].pass;
+    sinks.write(i % nanalyses, std::move(results[i]));
+  }
+}
+
+} // namespace
+
+AnalysesResult run_analyses(HepMC3::Reader &rdr,
+                            std::vector<Analysis> const &analyses,
+                            size_t nthreads, size_t batch_size,
+                            EventRange const &range) {
+  auto sinks = open_sinks(analyses);
+  std::vector<EventHooks> hooks;
+  for (auto const &ana : analyses) {
+    hooks.push_back(ana.hooks);
+  }
+
+  AnalysesResult res{0, std::vector<size_t>(analyses.size(), 0)};
+  EventLoop loop(std::move(hooks), nthreads, batch_size);
+  res.events_read = loop.run(
+      rdr,
+      [&](EventBatch &batch) {
+        write_rows(batch.results, *sinks, res.events_selected);
+      },
+      range);
+
+  sinks->close();
+  return res;
+}
+
+AnalysesResult run_analyses(std::vector<std::string> const &files,
+                            ResultStore &store, HookSources const &sources,
+                            std::vector<Analysis> const &analyses,
+                            size_t nthreads, size_t batch_size) {
+  auto sinks = open_sinks(analyses);
+  std::vector<NamedHooks> sets;
+  for (auto const &ana : analyses) {
+    sets.push_back(NamedHooks{ana.hooks, ana.select_name, ana.columns});
+  }
+
+  AnalysesResult res{0, std::vector<size_t>(analyses.size(), 0)};
+  run_with_store(
+      store, sources, files, sets,
+      [&](std::vector<EventResult> &results) {
+        res.events_read += results.size() / analyses.size();
+        write_rows(results, *sinks, res.events_selected);
+      },
+      nthreads, batch_size);
+
+  sinks->close();
+  return res;
+}
+
+} // namespace ps
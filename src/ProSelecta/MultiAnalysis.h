@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/OutputSink.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace HepMC3 {
+class Reader;
+}
+
+namespace ps {
+
+class HookSources;
+class ResultStore;
+
+// One analysis of a multi-analysis run: the hooks of a single selection, the
+// names of its columns, and the file that its rows are written to, in any
+// format of deduce_sink
+struct Analysis {
+  std::string name;
+  EventHooks hooks;
+  OutputColumns columns;
+  std::string output_path;
+  std::string output_format;
+  // the name of the selection function, which keys its results in a
+  // ResultStore, empty if hooks has no selection
+  std::string select_name{};
+};
+
+struct AnalysesResult {
+  size_t events_read;
+  // the number of events that passed the selection of each analysis
+  std::vector<size_t> events_selected;
+};
+
+// Evaluates every analysis on each event of rdr, so that the input is read
+// and parsed once rather than once per analysis. The projections and weights
+// of an analysis are only evaluated for events that pass its own selection.
+// Each analysis writes one row per event to its own output, exactly as
+// ProSelectaCPP would for that analysis alone. See EventLoop for nthreads and
+// batch_size. Throws std::runtime_error if two analyses share an output, or
+// if an output cannot be written.
+AnalysesResult run_analyses(HepMC3::Reader &rdr,
+                            std::vector<Analysis> const &analyses,
+                            size_t nthreads = 1, size_t batch_size = 256,
+                            EventRange const &range = EventRange());
+
+// As above, for every event of the input files, but taking the results of
+// each analysis on each file from store if they are there, see
+// run_with_store. The results of each hook are keyed by the hash of its
+// source in sources, and every hook must be named in columns and select_name.
+AnalysesResult run_analyses(std::vector<std::string> const &files,
+                            ResultStore &store, HookSources const &sources,
+                            std::vector<Analysis> const &analyses,
+                            size_t nthreads = 1, size_t batch_size = 256);
+
+} // namespace ps
@@ -0,0 +1,384 @@
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/Metrics.h"
+
+#include <glob.h>
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+void expand_input_path(std::string const &arg,
+                       std::vector<std::string> &paths) {
+  if (arg.size() && (arg[0] == '@')) {
+    std::ifstream ifs(arg.substr(1));
+    if (!ifs) {
+      throw std::runtime_error("Failed to open input list file: " +
+                               arg.substr(1));
+    }
+    for (std::string line; std::getline(ifs, line);) {
+      size_t first = line.find_first_not_of(" \t\r");
+      if ((first == std::string::npos) || (line[first] == '#')) {
+        continue;
+      }
+      size_t last = line.find_last_not_of(" \t\r");
+      expand_input_path(line.substr(first, last + 1 - first), paths);
+    }
+    return;
+  }
+
+  if (arg.find_first_of("*?[") == std::string::npos) {
+    paths.push_back(arg);
+    return;
+  }
+
+  glob_t matches;
+  int rtn = glob(arg.c_str(), 0, nullptr, &matches);
+  if (rtn) {
+    globfree(&matches);
+    std::stringstream ss("");
+    ss << "Input pattern " << arg
+       << ((rtn == GLOB_NOMATCH) ? " did not match any files."
+                                 : " could not be expanded.");
+    throw std::runtime_error(ss.str());
+  }
+  // glob sorts the matches, so the order of the events is reproducible
+  for (size_t i = 0; i < matches.gl_pathc; ++i) {
+    paths.push_back(matches.gl_pathv[i]);
+  }
+  globfree(&matches);
+}
+
+// Has rdr add the bytes that it reads to metrics, returns false if it cannot
+bool count_bytes_read(HepMC3::Reader &rdr, LoopMetrics *metrics) {
+  if (auto ascii = dynamic_cast<AsciiReader *>(&rdr)) {
+    ascii->set_metrics(metrics);
+    return true;
+  }
+  if (auto cache = dynamic_cast<EventCacheReader *>(&rdr)) {
+    cache->set_metrics(metrics);
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+std::vector<std::string>
+expand_input_paths(std::vector<std::string> const &args) {
+  std::vector<std::string> paths;
+  for (auto const &arg : args) {
+    expand_input_path(arg, paths);
+  }
+  return paths;
+}
+
+MultiFileReader::Decoder::Decoder(size_t f, size_t qd)
+    : file(f), skip(0), blocks(qd), thread(), error() {}
+
+MultiFileReader::MultiFileReader(std::vector<std::string> p, size_t nr,
+                                 size_t prefetch,
+                                 std::optional<AsciiReaderOptions> fa,
+                                 bool ui, LoopMetrics *m)
+    : paths(std::move(p)), fast_ascii(fa), use_index(ui), metrics(m),
+      index_mutex(),
+      index_opened(paths.size(), 0), indices(paths.size()),
+      nreaders(std::max<size_t>(nr, 1)),
+      queue_depth(std::max<size_t>((prefetch + block_size - 1) / block_size,
+                                   1)),
+      next_file(0), next_file_skip(0), decoders(), block(), block_pos(0),
+      block_file(0), file_events(0), stats(), is_failed(false), pool() {
+  for (auto const &path : paths) {
+    stats.push_back(InputFileStats{path});
+  }
+  start_decoders();
+}
+
+MultiFileReader::~MultiFileReader() { stop(); }
+
+std::shared_ptr<EventIndex const> MultiFileReader::file_index(size_t file) {
+  {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    if (index_opened[file]) {
+      return indices[file];
+    }
+  }
+  // indexed without the lock, so that a file being indexed does not hold up
+  // the decoders of the others
+  std::shared_ptr<EventIndex const> index;
+  if (is_hepmc3_ascii(paths[file])) {
+    index = std::make_shared<EventIndex const>(open_event_index(paths[file]));
+  }
+  std::lock_guard<std::mutex> lock(index_mutex);
+  index_opened[file] = 1;
+  indices[file] = index;
+  return index;
+}
+
+bool MultiFileReader::has_index(size_t file) {
+  std::lock_guard<std::mutex> lock(index_mutex);
+  return index_opened[file];
+}
+
+void MultiFileReader::set_index(size_t file,
+                                std::shared_ptr<EventIndex const> index) {
+  std::lock_guard<std::mutex> lock(index_mutex);
+  index_opened.at(file) = 1;
+  indices[file] = std::move(index);
+}
+
+std::optional<size_t> MultiFileReader::seekable_events(size_t file) {
+  if (is_event_cache(paths[file])) {
+    return EventCacheReader(paths[file]).size();
+  }
+  if (use_index) {
+    if (auto index = file_index(file)) {
+      return index->nevents();
+    }
+  }
+  return std::nullopt;
+}
+
+void MultiFileReader::start_decoders() {
+  while ((decoders.size() < nreaders) && (next_file < paths.size())) {
+    auto dec = std::make_unique<Decoder>(next_file++, queue_depth);
+    Decoder &d = *dec;
+    d.skip = next_file_skip;
+    next_file_skip = 0;
+    std::string const &path = paths[d.file];
+    d.thread = std::thread([this, &d, &path]() {
+      try {
+        std::shared_ptr<HepMC3::Reader> rdr;
+        size_t skip = d.skip;
+        // a file is only indexed up front to seek into it, one that is read
+        // from its start is indexed as it is decoded, unless its sidecar
+        // already holds an index
+        auto index = (use_index && skip) ? file_index(d.file) : nullptr;
+        std::optional<EventIndexBuilder> builder;
+        AsciiReader *indexed = nullptr;
+        if (index) {
+          // start at the indexed offset of the first event to read
+          auto ascii = std::make_shared<AsciiReader>(
+              path, fast_ascii.value_or(AsciiReaderOptions()));
+          if (skip >= index->nevents()) {
+            ascii->close();
+          } else if (!ascii->seek(index->offsets[skip])) {
+            throw std::runtime_error("Event index " + event_index_path(path) +
+                                     " does not match the file, remove it "
+                                     "so that it is rebuilt.");
+          }
+          rdr = ascii;
+          skip = 0;
+        } else if (use_index && !skip && !has_index(d.file) &&
+                   is_hepmc3_ascii(path)) {
+          auto ascii = std::make_shared<AsciiReader>(
+              path, fast_ascii.value_or(AsciiReaderOptions()));
+          if (auto loaded = load_event_index(path)) {
+            set_index(d.file,
+                      std::make_shared<EventIndex const>(std::move(*loaded)));
+          } else {
+            builder.emplace(path, *ascii);
+            indexed = ascii.get();
+          }
+          rdr = ascii;
+        } else {
+          rdr = open_reader(path, fast_ascii ? &fast_ascii.value() : nullptr);
+        }
+        if (!rdr) {
+          throw std::runtime_error(
+              "Failed to determine input type for HepMC3 file: " + path);
+        }
+        bool const counted = metrics && count_bytes_read(*rdr, metrics);
+        for (size_t skipped = 0; skipped < skip;) {
+          int n = int(std::min<size_t>(skip - skipped, INT_MAX));
+          rdr->skip(n);
+          skipped += n;
+        }
+        EventBlock blk;
+        bool closed = false;
+        while (!rdr->failed()) {
+          auto evt = pool.acquire();
+          size_t const offset = indexed ? indexed->tell() : 0;
+          rdr->read_event(*evt);
+          if (rdr->failed()) {
+            pool.release(std::move(evt));
+            break;
+          }
+          if (builder) {
+            builder->add(offset, evt->weights());
+          }
+          blk.push_back(std::move(evt));
+          if (blk.size() == block_size) {
+            if (!d.blocks.push(std::move(blk))) {
+              closed = true; // the reader was closed
+              break;
+            }
+            blk = EventBlock();
+          }
+        }
+        if (blk.size()) {
+          d.blocks.push(std::move(blk));
+        }
+        rdr->close();
+        // only a file that was read to the end is completely indexed
+        if (builder && !closed) {
+          save_event_index(builder->get());
+          set_index(d.file, std::make_shared<EventIndex const>(builder->get()));
+        }
+        if (metrics && !counted && !closed) {
+          std::error_code ec;
+          auto size = std::filesystem::file_size(path, ec);
+          metrics->bytes_read.fetch_add(ec ? 0 : size,
+                                        std::memory_order_relaxed);
+        }
+      } catch (...) {
+        d.error = std::current_exception();
+      }
+      d.blocks.close();
+    });
+    decoders.push_back(std::move(dec));
+  }
+}
+
+void MultiFileReader::finish_file() {
+  auto dec = std::move(decoders.front());
+  decoders.pop_front();
+  dec->thread.join();
+  if (dec->error) {
+    is_failed = true;
+    std::rethrow_exception(dec->error);
+  }
+  start_decoders();
+}
+
+std::unique_ptr<HepMC3::GenEvent> MultiFileReader::pop_event() {
+  while (!is_failed) {
+    if (block_pos < block.size()) {
+      file_events++;
+      return std::move(block[block_pos++]);
+    }
+    if (decoders.empty()) {
+      is_failed = true;
+      break;
+    }
+    if (auto blk = decoders.front()->blocks.pop()) {
+      block = std::move(*blk);
+      block_pos = 0;
+      if (block_file != decoders.front()->file) {
+        block_file = decoders.front()->file;
+        file_events = 0;
+      }
+    } else {
+      finish_file();
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<HepMC3::GenEvent> MultiFileReader::next_event() {
+  auto evt = pop_event();
+  if (evt) {
+    auto &st = stats[block_file];
+    double w = evt->weights().size() ? evt->weights().front() : 1;
+    st.nevents++;
+    st.sumw += w;
+    st.sumw2 += w * w;
+  }
+  return evt;
+}
+
+bool MultiFileReader::read_event(HepMC3::GenEvent &evt) {
+  auto decoded = next_event();
+  if (!decoded) {
+    return false;
+  }
+  evt = *decoded;
+  pool.release(std::move(decoded));
+  return true;
+}
+
+bool MultiFileReader::skip(const int nevents) {
+  size_t n = std::max(nevents, 0);
+  // events that are already decoded, or queued to be, are dropped, and any
+  // further events are seeked past with the indices, or skipped in caches
+  size_t const decoded = (block.size() - block_pos) + queue_depth * block_size;
+  if ((n > decoded) && !is_failed && paths.size()) {
+    InputPosition const start = position();
+    InputPosition pos = start;
+    while (auto nevents = seekable_events(pos.file)) {
+      size_t left = *nevents - std::min(pos.events, *nevents);
+      if ((n <= left) || ((pos.file + 1) == paths.size())) {
+        bool past_end = (n > left);
+        pos.events += std::min(n, left);
+        seek(pos, stats);
+        is_failed = past_end;
+        return !is_failed;
+      }
+      n -= left;
+      pos.file++;
+      pos.events = 0;
+    }
+    // the rest are skipped from the start of a file that is not indexed
+    if ((pos.file != start.file) || (pos.events != start.events)) {
+      seek(pos, stats);
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    auto evt = pop_event();
+    if (!evt) {
+      break;
+    }
+    pool.release(std::move(evt));
+  }
+  return !is_failed;
+}
+
+void MultiFileReader::seek(InputPosition const &pos,
+                           std::vector<InputFileStats> const &st) {
+  if ((st.size() != paths.size()) || (pos.file > paths.size())) {
+    std::stringstream ss("");
+    ss << "Cannot seek to file " << pos.file << " with statistics for "
+       << st.size() << " files in a MultiFileReader of " << paths.size()
+       << " files";
+    throw std::runtime_error(ss.str());
+  }
+  stop();
+  for (size_t i = 0; i < paths.size(); ++i) {
+    stats[i] = st[i];
+    stats[i].path = paths[i];
+  }
+  next_file = pos.file;
+  next_file_skip = pos.events;
+  block_pos = 0;
+  block_file = pos.file;
+  file_events = pos.events;
+  is_failed = false;
+  start_decoders();
+}
+
+void MultiFileReader::stop() {
+  // unblock any decoders waiting to hand off a block
+  for (auto &dec : decoders) {
+    dec->blocks.close();
+  }
+  for (auto &dec : decoders) {
+    dec->thread.join();
+  }
+  decoders.clear();
+  block.clear();
+}
+
+void MultiFileReader::close() {
+  stop();
+  is_failed = true;
+}
+
+} // namespace ps
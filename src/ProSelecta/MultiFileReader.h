@@ -0,0 +1,176 @@
+#pragma once
+
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/BoundedQueue.h"
+#include "ProSelecta/GenEventPool.h"
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/Reader.h"
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ps {
+
+struct EventIndex;
+struct LoopMetrics;
+
+// The events read from one input file, and the sums of their first weight,
+// or 1 for events without weights, for normalization
+struct InputFileStats {
+  std::string path;
+  size_t nevents = 0;
+  double sumw = 0;
+  double sumw2 = 0;
+};
+
+// Where a MultiFileReader is in its input: the file that the last event was
+// read or skipped from, and the number of events read or skipped from it
+struct InputPosition {
+  size_t file = 0;
+  size_t events = 0;
+};
+
+// Expands input file arguments into a list of paths. Arguments containing
+// any of the glob characters *?[ are expanded with glob(3), and must match at
+// least one file. Arguments starting with @ name a list file with one path,
+// or glob pattern, per line, blank lines and lines starting with # are
+// ignored. Other arguments are passed through as they are. Throws
+// std::runtime_error on failure.
+std::vector<std::string>
+expand_input_paths(std::vector<std::string> const &args);
+
+// Reads the events of several HepMC3 files, one after the other, as if they
+// were a single input.
+//
+// Up to nreaders files are opened and decoded concurrently, each on its own
+// thread, into blocks of decoded events. Each file is decoded at most
+// prefetch events, rounded up to whole blocks, ahead of the caller, and the
+// next file is opened as soon as the first of the files being decoded has
+// been read to the end, so that opening and parsing overlaps with processing
+// the events.
+//
+// Events are decoded ahead of the caller, so read_event copies each decoded
+// event into the caller's GenEvent. Use next_event to take ownership of the
+// decoded event instead, and hand it back with recycle once it is no longer
+// needed so that it can be refilled. Errors opening or decoding a file are
+// rethrown from the call that reaches that file.
+//
+// If fast_ascii is given, uncompressed HepMC3 ASCII files are read with an
+// AsciiReader with those options, see open_reader.
+//
+// If use_index is set, uncompressed HepMC3 ASCII files are read with an
+// AsciiReader and indexed. A file that is read from its start is indexed as
+// it is decoded, and its index is saved once it has been read to the end,
+// while a file that is seeked or skipped into is indexed up front, with
+// open_event_index, if it has no index yet. skip then moves past the events
+// that have not yet been decoded by seeking with the indices, and seek
+// starts part way through a file at the indexed offset of the event, rather
+// than reading the events before it. Event caches are always skipped through
+// without decoding the skipped events.
+//
+// If metrics is given, the bytes of each file that are read are added to
+// metrics->bytes_read as they are decoded by AsciiReaders and
+// EventCacheReaders, and for other readers, which cannot count them, the
+// size of the file is added once it has been read to the end. metrics must
+// outlive the reader.
+class MultiFileReader : public HepMC3::Reader {
+  using EventBlock = std::vector<std::unique_ptr<HepMC3::GenEvent>>;
+
+  struct Decoder {
+    size_t file;
+    // events at the start of the file to skip without decoding them
+    size_t skip;
+    BoundedQueue<EventBlock> blocks;
+    std::thread thread;
+    std::exception_ptr error;
+
+    Decoder(size_t file, size_t queue_depth);
+  };
+
+  std::vector<std::string> paths;
+  std::optional<AsciiReaderOptions> fast_ascii;
+  bool use_index;
+  LoopMetrics *metrics;
+  // the index of each file, once it has been opened, or nullptr for files
+  // that cannot be indexed
+  std::mutex index_mutex;
+  std::vector<char> index_opened;
+  std::vector<std::shared_ptr<EventIndex const>> indices;
+  size_t nreaders;
+  size_t queue_depth;
+  size_t next_file;
+  size_t next_file_skip;
+  std::deque<std::unique_ptr<Decoder>> decoders;
+  EventBlock block;
+  size_t block_pos;
+  size_t block_file;
+  size_t file_events;
+  std::vector<InputFileStats> stats;
+  bool is_failed;
+  GenEventPool pool;
+
+  // The index of file, which is opened, with open_event_index, if it has not
+  // been yet
+  std::shared_ptr<EventIndex const> file_index(size_t file);
+  bool has_index(size_t file);
+  // The number of events in file, if they can be skipped without decoding
+  // them, as for event caches and indexed files
+  std::optional<size_t> seekable_events(size_t file);
+  void start_decoders();
+  void finish_file();
+  std::unique_ptr<HepMC3::GenEvent> pop_event();
+  void stop();
+
+public:
+  // Decoded events are handed over in blocks of this many
+  static size_t const block_size = 64;
+
+  explicit MultiFileReader(
+      std::vector<std::string> paths, size_t nreaders = 4,
+      size_t prefetch = 256,
+      std::optional<AsciiReaderOptions> fast_ascii = std::nullopt,
+      bool use_index = false, LoopMetrics *metrics = nullptr);
+  ~MultiFileReader();
+
+  // Returns nullptr at the end of the last file
+  std::unique_ptr<HepMC3::GenEvent> next_event();
+  // Returns an event from next_event to be refilled, can be called from any
+  // thread
+  void recycle(std::unique_ptr<HepMC3::GenEvent> evt) {
+    pool.release(std::move(evt));
+  }
+  // The number of GenEvents allocated, rather than reused, so far
+  size_t events_allocated() { return pool.allocated(); }
+
+  bool read_event(HepMC3::GenEvent &evt) override;
+  // Skipped events are not counted in the file statistics
+  bool skip(const int nevents) override;
+  bool failed() override { return is_failed; }
+  void close() override;
+
+  // The statistics of the events returned so far, one entry per file
+  std::vector<InputFileStats> const &get_file_stats() const { return stats; }
+
+  // Uses index for file, rather than opening it when it is first needed, so
+  // that indices already in memory are not read again. Must be called
+  // before any events are skipped.
+  void set_index(size_t file, std::shared_ptr<EventIndex const> index);
+
+  InputPosition position() const { return {block_file, file_events}; }
+  // Continues from the position of an earlier reader of the same files, with
+  // the file statistics that it had there, for resuming a run. The files
+  // before pos.file are not opened again, and the events of pos.file are
+  // skipped by its reader, without being decoded. Must be called before any
+  // events are read.
+  void seek(InputPosition const &pos, std::vector<InputFileStats> const &stats);
+};
+
+} // namespace ps
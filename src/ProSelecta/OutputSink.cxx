@@ -0,0 +1,750 @@
+#include "ProSelecta/OutputSink.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+FILE *open_output(std::string const &path, char const *mode) {
+  if (path == "-") {
+    return stdout;
+  }
+  FILE *f = std::fopen(path.c_str(), mode);
+  if (!f) {
+    std::stringstream ss("");
+    ss << "Failed to open output file: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+  return f;
+}
+
+void write_or_throw(FILE *f, std::string const &path, void const *data,
+                    size_t size) {
+  if (size && (std::fwrite(data, 1, size, f) != size)) {
+    std::stringstream ss("");
+    ss << "Failed writing to output file: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+}
+
+void close_output(FILE *&f, std::string const &path) {
+  if (!f) {
+    return;
+  }
+  int rtn = (f == stdout) ? std::fflush(f) : std::fclose(f);
+  f = nullptr;
+  if (rtn) {
+    std::stringstream ss("");
+    ss << "Failed to close output file: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+}
+
+// Flushes the output to disk, so that a checkpoint never refers to output
+// that could still be lost, and returns its size
+uint64_t sync_output(FILE *f, std::string const &path) {
+  if (f == stdout) {
+    throw std::runtime_error(
+        "Output written to stdout cannot be checkpointed, write to a file.");
+  }
+  struct stat st;
+  if (std::fflush(f) || fsync(fileno(f)) || fstat(fileno(f), &st)) {
+    std::stringstream ss("");
+    ss << "Failed to flush output file: " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+  return uint64_t(st.st_size);
+}
+
+// Reopens the output of an interrupted run to append to it, discarding
+// anything written after it was size bytes long
+FILE *reopen_output(std::string const &path, uint64_t size) {
+  if (path == "-") {
+    throw std::runtime_error(
+        "Output written to stdout cannot be resumed, write to a file.");
+  }
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(path, ec);
+  if (ec || (file_size < size)) {
+    std::stringstream ss("");
+    ss << "Cannot resume output file: " << path << ", expected at least "
+       << size << " bytes, but "
+       << (ec ? ec.message() : (std::to_string(file_size) + " were found"));
+    throw std::runtime_error(ss.str());
+  }
+  std::filesystem::resize_file(path, size, ec);
+  if (ec) {
+    throw std::runtime_error("Failed to truncate output file: " + path +
+                             ": " + ec.message());
+  }
+  return open_output(path, "ab");
+}
+
+template <typename T> void append_pod(std::string &buf, T const &v) {
+  buf.append(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+template <typename T> T read_pod(std::FILE *f, std::string const &path) {
+  T v;
+  if (std::fread(&v, sizeof(T), 1, f) != 1) {
+    throw std::runtime_error("Unexpected end of binary table: " + path);
+  }
+  return v;
+}
+
+bool is_binary_table_magic(char const *magic) {
+  return !std::memcmp(magic, BinarySink::magic, 8) ||
+         !std::memcmp(magic, BinarySink::magic_v1, 8);
+}
+
+} // namespace
+
+uint64_t OutputSink::checkpoint() {
+  throw std::runtime_error(
+      "This output format cannot be checkpointed, use csv or bin.");
+}
+
+void OutputSink::resume(OutputColumns const &, uint64_t) {
+  throw std::runtime_error(
+      "This output format cannot be resumed, use csv or bin.");
+}
+
+CSVSink::CSVSink(std::string const &p)
+    : path(p), file(nullptr), nproj(0), nwgt(0), nmask(0), buffer() {}
+
+CSVSink::~CSVSink() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void CSVSink::flush_buffer() {
+  write_or_throw(file, path, buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+void CSVSink::set_columns(OutputColumns const &cols) {
+  nproj = cols.projections.size();
+  nwgt = cols.weights.size();
+  nmask = selmask_words(cols.selections.size());
+  buffer.reserve(buffer_size + (1 << 12));
+}
+
+void CSVSink::open(OutputColumns const &cols) {
+  file = open_output(path, "w");
+  set_columns(cols);
+
+  buffer += "# evtnum, pass";
+  for (auto const &n : cols.projections) {
+    buffer += ", " + n;
+  }
+  for (auto const &n : cols.weights) {
+    buffer += ", " + n;
+  }
+  if (nmask) {
+    buffer += ", selmask";
+  }
+  buffer += "\n";
+  if (nwgt) {
+    buffer += "# weights: " + std::to_string(nwgt) + "\n";
+  }
+  if (nmask) {
+    buffer += "# selections: ";
+    for (size_t i = 0; i < cols.selections.size(); ++i) {
+      buffer += (i ? ", " : "") + cols.selections[i];
+    }
+    buffer += "\n";
+  }
+}
+
+void CSVSink::write(std::vector<EventResult> const &rows) {
+  // "%g" matches the default formatting of doubles by std::ostream
+  char num[64];
+  for (auto const &res : rows) {
+    auto conv = std::to_chars(num, num + sizeof(num), res.evtnum);
+    buffer.append(num, conv.ptr);
+    buffer += res.pass ? ", pass, " : ", cut, ";
+    for (size_t i = 0; i < (nproj + nwgt); ++i) {
+      if (res.pass) {
+        int n = std::snprintf(num, sizeof(num), "%g", res.values[i]);
+        buffer.append(num, n);
+      } else {
+        buffer += " - ";
+      }
+      if ((i + 1) != (nproj + nwgt)) {
+        buffer += ", ";
+      }
+    }
+    if (nmask) {
+      // most significant word first, so that it reads as a single number
+      buffer += (nproj + nwgt) ? ", 0x" : "0x";
+      for (size_t w = nmask; w > 0; --w) {
+        int n = std::snprintf(num, sizeof(num), "%016llx",
+                              (unsigned long long)res.selmask[w - 1]);
+        buffer.append(num, n);
+      }
+    }
+    buffer += "\n";
+  }
+  if (buffer.size() > buffer_size) {
+    flush_buffer();
+  }
+}
+
+void CSVSink::close() {
+  if (!file) {
+    return;
+  }
+  flush_buffer();
+  close_output(file, path);
+}
+
+uint64_t CSVSink::checkpoint() {
+  flush_buffer();
+  return sync_output(file, path);
+}
+
+void CSVSink::resume(OutputColumns const &cols, uint64_t size) {
+  file = reopen_output(path, size);
+  set_columns(cols);
+}
+
+char const BinarySink::magic[9] = "PSCOLS02";
+char const BinarySink::magic_v1[9] = "PSCOLS01";
+
+BinarySink::BinarySink(std::string const &p)
+    : path(p), file(nullptr), nvalues(0), nmask(0), buffer() {}
+
+BinarySink::~BinarySink() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void BinarySink::open(OutputColumns const &cols) {
+  file = open_output(path, "wb");
+  nvalues = cols.projections.size() + cols.weights.size();
+  nmask = selmask_words(cols.selections.size());
+
+  buffer.append(magic, 8);
+  append_pod(buffer, uint64_t(cols.projections.size()));
+  append_pod(buffer, uint64_t(cols.weights.size()));
+  append_pod(buffer, uint64_t(cols.selections.size()));
+  for (auto const *names :
+       {&cols.projections, &cols.weights, &cols.selections}) {
+    for (auto const &n : *names) {
+      append_pod(buffer, uint64_t(n.size()));
+      buffer += n;
+    }
+  }
+  write_or_throw(file, path, buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+void BinarySink::write(std::vector<EventResult> const &rows) {
+  if (rows.empty()) {
+    return;
+  }
+  buffer.clear();
+  append_pod(buffer, uint64_t(rows.size()));
+  for (auto const &res : rows) {
+    append_pod(buffer, uint64_t(res.evtnum));
+  }
+  for (auto const &res : rows) {
+    append_pod(buffer, uint8_t(res.pass));
+  }
+  for (size_t i = 0; i < nvalues; ++i) {
+    for (auto const &res : rows) {
+      append_pod(buffer, res.pass ? res.values[i]
+                                  : std::numeric_limits<double>::quiet_NaN());
+    }
+  }
+  for (size_t w = 0; w < nmask; ++w) {
+    for (auto const &res : rows) {
+      append_pod(buffer, uint64_t(res.selmask[w]));
+    }
+  }
+  write_or_throw(file, path, buffer.data(), buffer.size());
+}
+
+void BinarySink::close() { close_output(file, path); }
+
+uint64_t BinarySink::checkpoint() { return sync_output(file, path); }
+
+void BinarySink::resume(OutputColumns const &cols, uint64_t size) {
+  file = reopen_output(path, size);
+  nvalues = cols.projections.size() + cols.weights.size();
+  nmask = selmask_words(cols.selections.size());
+}
+
+namespace {
+
+std::runtime_error root_io_unavailable(std::string const &path) {
+  return std::runtime_error(
+      "ROOT files require ProSelectaROOTIO, which was either not built or not "
+      "enabled with ps::enable_root_io: " +
+      path);
+}
+
+// Reads one block of rows, as written, at a time
+class BinaryTableReader : public OutputTableReader {
+  std::string path;
+  std::unique_ptr<FILE, int (*)(FILE *)> f;
+  OutputColumns cols;
+  size_t nvalues;
+  size_t nmask;
+
+public:
+  explicit BinaryTableReader(std::string const &p)
+      : path(p), f(std::fopen(p.c_str(), "rb"), &std::fclose), cols(),
+        nvalues(0), nmask(0) {
+    if (!f) {
+      throw std::runtime_error("Failed to open binary table: " + path);
+    }
+
+    char magic[8];
+    if ((std::fread(magic, 1, 8, f.get()) != 8) ||
+        !is_binary_table_magic(magic)) {
+      throw std::runtime_error("Not a ProSelecta binary table: " + path);
+    }
+    bool const v1 = !std::memcmp(magic, BinarySink::magic_v1, 8);
+
+    size_t nproj = read_pod<uint64_t>(f.get(), path);
+    size_t nwgt = read_pod<uint64_t>(f.get(), path);
+    size_t nsel = v1 ? 0 : read_pod<uint64_t>(f.get(), path);
+    for (size_t i = 0; i < (nproj + nwgt + nsel); ++i) {
+      std::string name(read_pod<uint64_t>(f.get(), path), '\0');
+      if (std::fread(name.data(), 1, name.size(), f.get()) != name.size()) {
+        throw std::runtime_error("Unexpected end of binary table: " + path);
+      }
+      (i < nproj            ? cols.projections
+       : i < (nproj + nwgt) ? cols.weights
+                            : cols.selections)
+          .push_back(name);
+    }
+    nvalues = nproj + nwgt;
+    nmask = selmask_words(nsel);
+  }
+
+  OutputColumns const &columns() const { return cols; }
+
+  bool read(std::vector<EventResult> &rows) {
+    rows.clear();
+    uint64_t nrows;
+    if (std::fread(&nrows, sizeof(nrows), 1, f.get()) != 1) {
+      return false;
+    }
+    rows.resize(nrows);
+    for (auto &row : rows) {
+      row.evtnum = read_pod<uint64_t>(f.get(), path);
+    }
+    for (auto &row : rows) {
+      row.pass = read_pod<uint8_t>(f.get(), path);
+    }
+    for (size_t i = 0; i < nvalues; ++i) {
+      for (auto &row : rows) {
+        double v = read_pod<double>(f.get(), path);
+        if (row.pass) {
+          row.values.push_back(v);
+        }
+      }
+    }
+    for (size_t w = 0; w < nmask; ++w) {
+      for (auto &row : rows) {
+        row.selmask.push_back(read_pod<uint64_t>(f.get(), path));
+      }
+    }
+    return true;
+  }
+};
+
+std::vector<std::string> split_csv(std::string const &line) {
+  std::vector<std::string> fields;
+  for (size_t pos = 0;;) {
+    size_t sep = line.find(", ", pos);
+    fields.push_back(line.substr(pos, sep - pos));
+    if (sep == std::string::npos) {
+      return fields;
+    }
+    pos = sep + 2;
+  }
+}
+
+// Reads up to block_rows lines at a time
+class CSVTableReader : public OutputTableReader {
+  std::string path;
+  std::ifstream ifs;
+  OutputColumns cols;
+  size_t nvalues;
+  size_t nmask;
+  size_t nfields;
+
+public:
+  static size_t const block_rows = 4096;
+
+  explicit CSVTableReader(std::string const &p)
+      : path(p), ifs(p), cols(), nvalues(0), nmask(0), nfields(0) {
+    if (!ifs) {
+      throw std::runtime_error("Failed to open CSV table: " + path);
+    }
+
+    std::string line;
+    if (!std::getline(ifs, line) || (line.rfind("# evtnum, pass", 0) != 0)) {
+      throw std::runtime_error("Not a ProSelecta CSV table: " + path);
+    }
+    auto header = split_csv(line);
+    bool const has_mask = (header.back() == "selmask");
+    std::vector<std::string> values(header.begin() + 2,
+                                    header.end() - (has_mask ? 1 : 0));
+    nvalues = values.size();
+
+    // the header may be followed by the number of weights, the last value
+    // columns, and the names of the selections, tables without the former
+    // only have projections
+    size_t nwgt = 0;
+    std::string const wgt_prefix = "# weights: ";
+    std::string const sel_prefix = "# selections: ";
+    while (ifs.peek() == '#') {
+      std::getline(ifs, line);
+      if (line.rfind(wgt_prefix, 0) == 0) {
+        nwgt = std::stoul(line.substr(wgt_prefix.size()));
+      } else if (line.rfind(sel_prefix, 0) == 0) {
+        cols.selections = split_csv(line.substr(sel_prefix.size()));
+      }
+    }
+    if (nwgt > nvalues) {
+      std::stringstream ss("");
+      ss << "CSV table " << path << " has " << nwgt << " weights but only "
+         << nvalues << " value columns.";
+      throw std::runtime_error(ss.str());
+    }
+    if (has_mask && cols.selections.empty()) {
+      throw std::runtime_error("Expected a selections line in CSV table: " +
+                               path);
+    }
+    cols.projections.assign(values.begin(), values.end() - nwgt);
+    cols.weights.assign(values.end() - nwgt, values.end());
+    nmask = selmask_words(cols.selections.size());
+    nfields = 2 + nvalues + (has_mask ? 1 : 0);
+  }
+
+  OutputColumns const &columns() const { return cols; }
+
+  bool read(std::vector<EventResult> &rows) {
+    rows.clear();
+    std::string line;
+    while ((rows.size() < block_rows) && std::getline(ifs, line)) {
+      auto fields = split_csv(line);
+      if ((fields.size() < 2) ||
+          ((nfields > 2) && (fields.size() != nfields))) {
+        throw std::runtime_error("Malformed row in CSV table: " + path +
+                                 ": " + line);
+      }
+      EventResult res{std::stoul(fields[0]), fields[1] == "pass", {}, {}};
+      if (res.pass) {
+        for (size_t i = 0; i < nvalues; ++i) {
+          res.values.push_back(std::stod(fields[i + 2]));
+        }
+      }
+      if (nmask) {
+        // 16 hexadecimal digits per word, most significant word first
+        std::string const &hex = fields.back();
+        if (hex.size() != (2 + 16 * nmask)) {
+          throw std::runtime_error("Malformed selmask in CSV table: " + path +
+                                   ": " + line);
+        }
+        for (size_t w = nmask; w > 0; --w) {
+          res.selmask.push_back(
+              std::stoull(hex.substr(2 + 16 * (w - 1), 16), nullptr, 16));
+        }
+      }
+      rows.push_back(std::move(res));
+    }
+    return rows.size();
+  }
+};
+
+} // namespace
+
+OutputTable read_table(OutputTableReader &rdr) {
+  OutputTable table{rdr.columns(), {}};
+  std::vector<EventResult> rows;
+  while (rdr.read(rows)) {
+    for (auto &row : rows) {
+      table.rows.push_back(std::move(row));
+    }
+  }
+  return table;
+}
+
+OutputTable read_binary_table(std::string const &path) {
+  BinaryTableReader rdr(path);
+  return read_table(rdr);
+}
+
+OutputTable read_csv_table(std::string const &path) {
+  CSVTableReader rdr(path);
+  return read_table(rdr);
+}
+
+ROOTSinkFactory &root_sink_factory() {
+  static ROOTSinkFactory factory = nullptr;
+  return factory;
+}
+
+ROOTTableReader &root_table_reader() {
+  static ROOTTableReader reader = nullptr;
+  return reader;
+}
+
+std::unique_ptr<OutputTableReader>
+open_output_table(std::string const &path) {
+  std::string ext = std::filesystem::path(path).extension().string();
+  if (ext == ".root") {
+    if (!root_table_reader()) {
+      throw root_io_unavailable(path);
+    }
+    return root_table_reader()(path);
+  }
+
+  char magic[8];
+  std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"),
+                                           &std::fclose);
+  if (f && (std::fread(magic, 1, 8, f.get()) == 8) &&
+      is_binary_table_magic(magic)) {
+    return std::make_unique<BinaryTableReader>(path);
+  }
+  return std::make_unique<CSVTableReader>(path);
+}
+
+OutputTable read_output_table(std::string const &path) {
+  return read_table(*open_output_table(path));
+}
+
+AsyncSink::AsyncSink(std::unique_ptr<OutputSink> s, size_t br, size_t qd)
+    : sink(std::move(s)), block_rows(br), blocks(qd), pending(), writer(),
+      error(), closed(false), written_mtx(), written_cv(), nblocks_pushed(0),
+      nblocks_written(0) {}
+
+AsyncSink::~AsyncSink() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void AsyncSink::start_writer() {
+  writer = std::thread([this]() {
+    while (auto block = blocks.pop()) {
+      // drop anything queued after a failure
+      if (!error) {
+        try {
+          sink->write(*block);
+        } catch (...) {
+          error = std::current_exception();
+          blocks.close();
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lk(written_mtx);
+        nblocks_written++;
+      }
+      written_cv.notify_all();
+    }
+  });
+}
+
+void AsyncSink::open(OutputColumns const &cols) {
+  sink->open(cols);
+  start_writer();
+}
+
+void AsyncSink::resume(OutputColumns const &cols, uint64_t size) {
+  sink->resume(cols, size);
+  start_writer();
+}
+
+uint64_t AsyncSink::checkpoint() {
+  push_pending();
+  {
+    std::unique_lock<std::mutex> lk(written_mtx);
+    written_cv.wait(lk, [this]() { return nblocks_written == nblocks_pushed; });
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  // the writer is waiting for the next block, so the sink is not in use
+  return sink->checkpoint();
+}
+
+void AsyncSink::push_pending() {
+  if (pending.empty()) {
+    return;
+  }
+  // if the writer failed, the queue is closed and the push fails
+  {
+    std::lock_guard<std::mutex> lk(written_mtx);
+    nblocks_pushed++;
+  }
+  if (blocks.push(std::move(pending))) {
+    pending = std::vector<EventResult>();
+    pending.reserve(block_rows);
+    return;
+  }
+  writer.join();
+  closed = true;
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void AsyncSink::write(std::vector<EventResult> const &rows) {
+  for (auto const &row : rows) {
+    pending.push_back(row);
+    if (pending.size() == block_rows) {
+      push_pending();
+    }
+  }
+}
+
+void AsyncSink::close() {
+  if (closed) {
+    return;
+  }
+  closed = true;
+  if (writer.joinable()) {
+    blocks.push(std::move(pending));
+    blocks.close();
+    writer.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  sink->close();
+}
+
+AsyncSinks::AsyncSinks(std::vector<std::unique_ptr<OutputSink>> s, size_t br,
+                       size_t qd)
+    : sinks(std::move(s)), block_rows(br), blocks(qd), pending(sinks.size()),
+      writer(), error(), closed(false) {}
+
+AsyncSinks::~AsyncSinks() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void AsyncSinks::open(std::vector<OutputColumns> const &cols) {
+  if (cols.size() != sinks.size()) {
+    std::stringstream ss("");
+    ss << "AsyncSinks::open passed " << cols.size() << " sets of columns for "
+       << sinks.size() << " sinks.";
+    throw std::runtime_error(ss.str());
+  }
+  for (size_t s = 0; s < sinks.size(); ++s) {
+    sinks[s]->open(cols[s]);
+  }
+  writer = std::thread([this]() {
+    while (auto block = blocks.pop()) {
+      // drop anything queued after a failure
+      if (error) {
+        continue;
+      }
+      try {
+        sinks[block->first]->write(block->second);
+      } catch (...) {
+        error = std::current_exception();
+        blocks.close();
+      }
+    }
+  });
+}
+
+void AsyncSinks::push_pending(size_t s) {
+  // if the writer failed, the queue is closed and the push fails
+  if (blocks.push({s, std::move(pending[s])})) {
+    pending[s] = std::vector<EventResult>();
+    pending[s].reserve(block_rows);
+    return;
+  }
+  writer.join();
+  closed = true;
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void AsyncSinks::write(size_t s, EventResult &&row) {
+  pending[s].push_back(std::move(row));
+  if (pending[s].size() == block_rows) {
+    push_pending(s);
+  }
+}
+
+void AsyncSinks::close() {
+  if (closed) {
+    return;
+  }
+  closed = true;
+  if (writer.joinable()) {
+    for (size_t s = 0; s < sinks.size(); ++s) {
+      if (pending[s].size() && !blocks.push({s, std::move(pending[s])})) {
+        break;
+      }
+    }
+    blocks.close();
+    writer.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  for (auto &sink : sinks) {
+    sink->close();
+  }
+}
+
+std::unique_ptr<OutputSink> deduce_sink(std::string const &path,
+                                        std::string format) {
+  if (format.empty()) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    format = (ext == ".root") ? "root" : (ext == ".bin") ? "bin" : "csv";
+  }
+
+  if (format == "csv") {
+    return std::make_unique<CSVSink>(path);
+  } else if (format == "bin") {
+    return std::make_unique<BinarySink>(path);
+  } else if (format == "root") {
+    if (!root_sink_factory()) {
+      throw root_io_unavailable(path);
+    }
+    return root_sink_factory()(path);
+  }
+
+  std::stringstream ss("");
+  ss << "Unknown output format: " << format
+     << ", expected one of csv, bin, or root.";
+  throw std::runtime_error(ss.str());
+}
+
+} // namespace ps
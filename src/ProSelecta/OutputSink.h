@@ -0,0 +1,222 @@
+#pragma once
+
+#include "ProSelecta/BoundedQueue.h"
+#include "ProSelecta/EventLoop.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ps {
+
+// The names of the value columns of an output table, each row holds the
+// event number, whether the event passed the selection, the projections and
+// then the weights, and, if there are any selections, their bitmask.
+struct OutputColumns {
+  std::vector<std::string> projections;
+  std::vector<std::string> weights;
+  std::vector<std::string> selections;
+};
+
+// Writes rows of evaluated events. open is called once before the first rows
+// are written, and close once after the last. Errors are reported by throwing
+// std::runtime_error.
+//
+// Sinks that write to a file that can be appended to also support resuming
+// an interrupted run: checkpoint writes every row so far to disk and returns
+// the size of the output, and resume, called in place of open, reopens the
+// output written by the interrupted run and discards anything after that
+// size. The other sinks throw from both.
+class OutputSink {
+public:
+  virtual ~OutputSink() {}
+  virtual void open(OutputColumns const &cols) = 0;
+  virtual void write(std::vector<EventResult> const &rows) = 0;
+  virtual void close() = 0;
+
+  virtual uint64_t checkpoint();
+  virtual void resume(OutputColumns const &cols, uint64_t size);
+};
+
+// Comma-separated text, one row per event, matching the format that
+// ProSelectaCPP has always written to stdout. Values of events that fail the
+// selection are written as ' - '. If there are weights, the header is
+// followed by a '# weights: ' line with the number of weights, which are the
+// last value columns. If there are selections, it is then followed by a
+// '# selections: ' line that names them in bit order, and the last column,
+// selmask, holds the bitmask as one hexadecimal number. Output is
+// accumulated in a large buffer and written in blocks rather than flushed row
+// by row.
+class CSVSink : public OutputSink {
+  std::string path;
+  FILE *file;
+  size_t nproj;
+  size_t nwgt;
+  size_t nmask;
+  std::string buffer;
+
+  void flush_buffer();
+  void set_columns(OutputColumns const &cols);
+
+public:
+  static size_t const buffer_size = 1 << 20;
+
+  // path "-" writes to stdout
+  explicit CSVSink(std::string const &path = "-");
+  ~CSVSink();
+  void open(OutputColumns const &cols);
+  void write(std::vector<EventResult> const &rows);
+  void close();
+  uint64_t checkpoint();
+  void resume(OutputColumns const &cols, uint64_t size);
+};
+
+// A compact native-endian binary column format. The file begins with the
+// 8-byte magic, the number of projection, weight, and selection columns as
+// uint64, and the name of each column as a uint64 length and its characters.
+// It is followed by blocks of rows, each block is the uint64 number of rows,
+// nrows uint64 event numbers, nrows uint8 pass flags, nrows doubles for each
+// value column in turn, and then nrows uint64 for each word of the selection
+// bitmask. Values of events that fail the selection are written as NaN.
+//
+// Files written before selections were supported have the magic_v1 magic and
+// no selection count, names, or bitmasks, and can still be read.
+class BinarySink : public OutputSink {
+  std::string path;
+  FILE *file;
+  size_t nvalues;
+  size_t nmask;
+  std::string buffer;
+
+public:
+  static char const magic[9];
+  static char const magic_v1[9];
+
+  explicit BinarySink(std::string const &path);
+  ~BinarySink();
+  void open(OutputColumns const &cols);
+  void write(std::vector<EventResult> const &rows);
+  void close();
+  uint64_t checkpoint();
+  void resume(OutputColumns const &cols, uint64_t size);
+};
+
+// A table read back from a file written by one of the sinks
+struct OutputTable {
+  OutputColumns columns;
+  std::vector<EventResult> rows;
+};
+
+// Reads the rows of a table a block at a time, in the order that they were
+// written, so that tables need not fit in memory
+class OutputTableReader {
+public:
+  virtual ~OutputTableReader() {}
+  virtual OutputColumns const &columns() const = 0;
+  // Replaces rows with the next block of rows, returns false at the end
+  virtual bool read(std::vector<EventResult> &rows) = 0;
+};
+// Reads every remaining row
+OutputTable read_table(OutputTableReader &rdr);
+
+OutputTable read_binary_table(std::string const &path);
+// Tables written without a '# weights: ' line have no weights, and every
+// value column is read as a projection.
+OutputTable read_csv_table(std::string const &path);
+// Deduces the format like deduce_sink, and from the file contents for
+// binary tables without a .bin extension
+std::unique_ptr<OutputTableReader> open_output_table(std::string const &path);
+OutputTable read_output_table(std::string const &path);
+
+// The ROOT format of deduce_sink and open_output_table is provided by the
+// optional ProSelectaROOTIO library, which sets these in ps::enable_root_io,
+// see ProSelecta/ROOTIO.h. Until then, ROOT outputs throw std::runtime_error.
+using ROOTSinkFactory = std::unique_ptr<OutputSink> (*)(std::string const &);
+using ROOTTableReader =
+    std::unique_ptr<OutputTableReader> (*)(std::string const &);
+ROOTSinkFactory &root_sink_factory();
+ROOTTableReader &root_table_reader();
+
+// Forwards rows to another sink from a dedicated writer thread, so that
+// formatting and I/O overlap with event evaluation. Rows are accumulated into
+// blocks of exactly block_rows, except for the last, before they are handed
+// to the writer, so that the blocks written do not depend on how rows were
+// passed to write. At most queue_depth blocks are held in flight. An
+// exception thrown by the wrapped sink is rethrown from the next call to write
+// or close.
+class AsyncSink : public OutputSink {
+  std::unique_ptr<OutputSink> sink;
+  size_t block_rows;
+  BoundedQueue<std::vector<EventResult>> blocks;
+  std::vector<EventResult> pending;
+  std::thread writer;
+  std::exception_ptr error;
+  bool closed;
+  // blocks pushed to, and written by, the writer, to wait for it to catch up
+  std::mutex written_mtx;
+  std::condition_variable written_cv;
+  size_t nblocks_pushed;
+  size_t nblocks_written;
+
+  void start_writer();
+  void push_pending();
+
+public:
+  AsyncSink(std::unique_ptr<OutputSink> sink, size_t block_rows = 4096,
+            size_t queue_depth = 8);
+  ~AsyncSink();
+  void open(OutputColumns const &cols);
+  void write(std::vector<EventResult> const &rows);
+  void close();
+  // Hands any partial block to the writer and waits until every block has
+  // been written before checkpointing the wrapped sink
+  uint64_t checkpoint();
+  void resume(OutputColumns const &cols, uint64_t size);
+};
+
+// Forwards rows to each of several sinks from one writer thread shared by all
+// of them, so that a run with many outputs does not start a thread per
+// output. As for AsyncSink, the rows of each sink are accumulated into blocks
+// of block_rows, and at most queue_depth blocks, over all of the sinks, are
+// held in flight. Rows are moved rather than copied into the blocks. An
+// exception thrown by any of the sinks is rethrown from the next call to write
+// or close.
+class AsyncSinks {
+  std::vector<std::unique_ptr<OutputSink>> sinks;
+  size_t block_rows;
+  BoundedQueue<std::pair<size_t, std::vector<EventResult>>> blocks;
+  std::vector<std::vector<EventResult>> pending;
+  std::thread writer;
+  std::exception_ptr error;
+  bool closed;
+
+  void push_pending(size_t s);
+
+public:
+  AsyncSinks(std::vector<std::unique_ptr<OutputSink>> sinks,
+             size_t block_rows = 4096, size_t queue_depth = 8);
+  AsyncSinks(AsyncSinks const &) = delete;
+  AsyncSinks &operator=(AsyncSinks const &) = delete;
+  ~AsyncSinks();
+  size_t size() const { return sinks.size(); }
+  // Opens sink s with cols[s], then starts the writer
+  void open(std::vector<OutputColumns> const &cols);
+  void write(size_t s, EventResult &&row);
+  // Writes the last partial block of every sink, then closes them
+  void close();
+};
+
+// Builds the sink for format, one of "csv", "bin", or "root". If format is
+// empty it is deduced from the extension of path: ".root" for a TTreeSink,
+// ".bin" for a BinarySink, and CSV otherwise, including for stdout, "-".
+std::unique_ptr<OutputSink> deduce_sink(std::string const &path,
+                                        std::string format = "");
+
+} // namespace ps
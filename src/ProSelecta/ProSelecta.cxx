@@ -84,6 +84,72 @@ bool ProSelecta::load_analysis(std::string const &file_to_read,
   }
 }
 
+bool ProSelecta::unload_file(std::string const &file_to_read,
+                             ProSelecta::Interpreter itype) {
+
+  if (itype == Interpreter::kAuto) {
+    itype = GuessInterpreter(file_to_read);
+  }
+  switch (itype) {
+  case Interpreter::kCling: {
+    return cling::unload_file(file_to_read);
+  }
+  default: {
+    throw std::runtime_error("invalid interpreter type");
+  }
+  }
+}
+
+bool ProSelecta::reload_file(std::string const &file_to_read,
+                             ProSelecta::Interpreter itype) {
+
+  if (itype == Interpreter::kAuto) {
+    itype = GuessInterpreter(file_to_read);
+  }
+  switch (itype) {
+  case Interpreter::kCling: {
+    return cling::reload_file(file_to_read);
+  }
+  default: {
+    throw std::runtime_error("invalid interpreter type");
+  }
+  }
+}
+
+bool ProSelecta::unload_analysis(std::string const &file_to_read,
+                                 std::string const &path,
+                                 ProSelecta::Interpreter itype) {
+
+  if (itype == Interpreter::kAuto) {
+    itype = GuessInterpreter(file_to_read);
+  }
+  switch (itype) {
+  case Interpreter::kCling: {
+    return cling::unload_analysis(file_to_read, path);
+  }
+  default: {
+    throw std::runtime_error("invalid interpreter type");
+  }
+  }
+}
+
+bool ProSelecta::reload_analysis(std::string const &file_to_read,
+                                 std::string const &path,
+                                 ProSelecta::Interpreter itype) {
+
+  if (itype == Interpreter::kAuto) {
+    itype = GuessInterpreter(file_to_read);
+  }
+  switch (itype) {
+  case Interpreter::kCling: {
+    return cling::reload_analysis(file_to_read, path);
+  }
+  default: {
+    throw std::runtime_error("invalid interpreter type");
+  }
+  }
+}
+
 void ProSelecta::add_include_path(std::string const &path,
                                   ProSelecta::Interpreter itype) {
   switch (itype) {
@@ -102,9 +168,45 @@ void ProSelecta::add_include_path(std::string const &path,
   }
 }
 
+void ProSelecta::enable_jit_symbol_export(bool perf, bool gdb,
+                                          ProSelecta::Interpreter itype) {
+  switch (itype) {
+  case Interpreter::kAuto: {
+    throw std::runtime_error(
+        "Cannot call ProSelecta::enable_jit_symbol_export with Interpreter "
+        "type kAuto. Explicitly specify the interpreter type.");
+  }
+  case Interpreter::kCling: {
+    cling::enable_jit_symbol_export(perf, gdb);
+    return;
+  }
+  default: {
+    throw std::runtime_error("invalid interpreter type");
+  }
+  }
+}
+
+void ProSelecta::add_snippet_directory(std::string const &dir,
+                                       ProSelecta::Interpreter itype) {
+  switch (itype) {
+  case Interpreter::kAuto: {
+    throw std::runtime_error(
+        "Cannot call ProSelecta::add_snippet_directory with Interpreter type "
+        "kAuto. Explicitly specify the interpreter type.");
+  }
+  case Interpreter::kCling: {
+    cling::add_snippet_directory(dir);
+    return;
+  }
+  default: {
+    throw std::runtime_error("invalid interpreter type");
+  }
+  }
+}
+
 ProSelecta::Interpreter ProSelecta::resolve_type(std::string const &fnname,
                                                  std::string const &) {
-  bool cf = ps::cling::func_is_defined(fnname, "HepMC3::GenEvent const &");
+  bool cf = ps::cling::load_indexed_snippet(fnname);
 
   if (cf) {
     return Interpreter::kCling;
@@ -27,9 +27,27 @@ public:
   bool load_analysis(std::string const &, std::string const &,
                      Interpreter itype = Interpreter::kCling);
 
+  bool unload_file(std::string const &,
+                   Interpreter itype = Interpreter::kCling);
+  bool reload_file(std::string const &,
+                   Interpreter itype = Interpreter::kCling);
+  bool unload_analysis(std::string const &, std::string const &,
+                       Interpreter itype = Interpreter::kCling);
+  bool reload_analysis(std::string const &, std::string const &,
+                       Interpreter itype = Interpreter::kCling);
+
   void add_include_path(std::string const &,
                         Interpreter itype = Interpreter::kCling);
 
+  // Must be called before any snippets are loaded
+  void enable_jit_symbol_export(bool perf, bool gdb,
+                                Interpreter itype = Interpreter::kCling);
+
+  // Snippets in a registered directory are not loaded up front, the snippet
+  // defining a function is loaded when that function is first requested.
+  void add_snippet_directory(std::string const &,
+                             Interpreter itype = Interpreter::kCling);
+
   SelectFunc get_select_func(std::string const &,
                              Interpreter itype = Interpreter::kCling);
   SelectsFunc get_selects_func(std::string const &,
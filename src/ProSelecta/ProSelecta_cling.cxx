@@ -1,13 +1,40 @@
 #include "ProSelecta/ProSelecta_cling.h"
 #include "ProSelecta/ProSelecta.h"
+#include "ProSelecta/Profiling.h"
+#include "ProSelecta/SymbolIndex.h"
+#include "ProSelecta/Timing.h"
+
+#include "ProSelecta/detail/except.h"
 
 #include "TInterpreter.h"
+#include "TSystem.h"
 
+#include <atomic>
 #include <cassert>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <regex>
+#include <set>
 #include <stdexcept>
+#include <vector>
+
+// The environment's backtrace hook, looked up by name from the interpreter so
+// that the environment never needs to parse ROOT headers.
+extern "C" void ProSelecta_detail_StackTrace() { gSystem->StackTrace(); }
+
+namespace {
+// exceptions thrown from env functions in compiled code linked against this
+// library also get stack traces
+[[maybe_unused]] bool const backtrace_hook_installed = []() {
+  ps::detail::backtrace_hook() = &ProSelecta_detail_StackTrace;
+  return true;
+}();
+} // namespace
 
 namespace ps {
 namespace cling {
@@ -61,33 +88,29 @@ bool returns_vector_double(std::string const &symname,
   return returns_impl<3>(symname, cling_err);
 }
 
-bool load_file(std::string const &file_to_read) {
-  ps::cling::initialize_environment();
-  return !bool(gInterpreter->LoadFile(
-      std::filesystem::canonical(file_to_read).native().c_str()));
-}
-
-std::vector<std::string> analyses;
-bool load_analysis(std::string const &file_to_read, std::string location) {
-  ps::cling::initialize_environment();
-  if (std::find(ps::cling::analyses.begin(), ps::cling::analyses.end(),
-                location + file_to_read) != ps::cling::analyses.end()) {
-    return true;
+bool returns_type(size_t N, std::string const &symname,
+                  TInterpreter::EErrorCode &cling_err) {
+  switch (N) {
+  case 0: {
+    return returns_impl<0>(symname, cling_err);
+  }
+  case 1: {
+    return returns_impl<1>(symname, cling_err);
+  }
+  case 2: {
+    return returns_impl<2>(symname, cling_err);
+  }
+  case 3: {
+    return returns_impl<3>(symname, cling_err);
+  }
+  default: {
+    return false;
+  }
   }
-  ps::cling::add_include_path(location);
-  ps::cling::analyses.push_back(location + file_to_read);
-  return !bool(gInterpreter->LoadFile(file_to_read.c_str()));
-}
-
-bool load_text(std::string const &txt) {
-  ps::cling::initialize_environment();
-  return bool(gInterpreter->LoadText(txt.c_str()));
-}
-void add_include_path(std::string const &path) {
-  gInterpreter->AddIncludePath(path.c_str());
 }
 
-bool func_is_defined(std::string const &fnname, std::string const &arglist) {
+void *find_func_with_prototype(std::string const &fnname,
+                               std::string const &arglist) {
 
   std::string mname = gInterpreter
                           ->GetMangledNameWithPrototype(nullptr, fnname.c_str(),
@@ -97,20 +120,18 @@ bool func_is_defined(std::string const &fnname, std::string const &arglist) {
   void *sym = gInterpreter->FindSym(fnname.c_str());
   void *msym = gInterpreter->FindSym(mname.c_str());
 
-  return bool(sym) || bool(msym);
+  return sym ? sym : msym;
+}
+
+bool func_is_defined(std::string const &fnname, std::string const &arglist) {
+  return bool(find_func_with_prototype(fnname, arglist));
 }
 
 void *get_func_with_prototype(std::string const &fnname,
                               std::string const &arglist) {
 
-  std::string mname = gInterpreter
-                          ->GetMangledNameWithPrototype(nullptr, fnname.c_str(),
-                                                        arglist.c_str())
-                          .Data();
-
-  void *sym = gInterpreter->FindSym(fnname.c_str());
-  void *msym = gInterpreter->FindSym(mname.c_str());
-  if (!sym && !msym) {
+  void *sym = find_func_with_prototype(fnname, arglist);
+  if (!sym) {
     std::cout << "No function named: " << fnname << " declared to TCling."
               << std::endl;
     std::cout << "Searched for " << fnname << " and C++ mangled: " << fnname
@@ -123,21 +144,213 @@ void *get_func_with_prototype(std::string const &fnname,
     return nullptr;
   }
 
-  return sym ? sym : msym;
+  return sym;
+}
+
+// Every handle returned by get_*_func calls through one of these so that
+// unloading or replacing a snippet can retarget or invalidate the handles
+// that were already given out. sym is nullptr once the function has been
+// unloaded, or replaced by a function with a different return type.
+struct func_handle_state {
+  std::string fnname;
+  size_t rtype;
+  std::atomic<void *> sym;
+};
+
+// States are never removed, so handles refer to them by plain pointer
+std::map<std::pair<std::string, size_t>, std::unique_ptr<func_handle_state>>
+    func_handles;
+// guards func_handles, handles only read their state's sym
+std::mutex func_handles_mutex;
+
+[[noreturn]] __attribute__((noinline)) void
+throw_invalidated_handle(func_handle_state const &state) {
+  std::stringstream ss("");
+  ss << "Function: " << state.fnname
+     << " was called through a handle that was invalidated when its "
+        "snippet was unloaded or replaced with an incompatible "
+        "definition. Re-fetch the handle."
+     << std::endl;
+  throw std::runtime_error(ss.str());
+}
+
+// Re-resolves the handles of the functions in fnnames, or of every function
+// if it is null
+void refresh_func_handles(std::set<std::string> const *fnnames = nullptr) {
+  std::lock_guard<std::mutex> lock(func_handles_mutex);
+  for (auto &[key, state] : func_handles) {
+    if (fnnames && !fnnames->count(state->fnname)) {
+      continue;
+    }
+    void *sym = find_func_with_prototype(state->fnname,
+                                         "HepMC3::GenEvent const &");
+    if (sym == state->sym.load()) {
+      continue;
+    }
+
+    TInterpreter::EErrorCode cling_err = TInterpreter::EErrorCode::kNoError;
+    if (sym && !returns_type(state->rtype, state->fnname, cling_err)) {
+      sym = nullptr;
+    }
+    state->sym.store(sym, std::memory_order_release);
+  }
+}
+
+std::string canonical_snippet_path(std::string const &file_to_read) {
+  std::error_code ec;
+  auto path = std::filesystem::canonical(file_to_read, ec);
+  return ec ? file_to_read : path.native();
+}
+
+// snippets passed to load_file, by canonical path
+std::set<std::string> loaded_files;
+
+// Loads file_to_read, and re-resolves the handles of the functions in
+// fnnames, or of every function if it is null
+bool load_snippet(std::string const &file_to_read,
+                  std::set<std::string> const *fnnames) {
+  ps::cling::initialize_environment();
+  timing::PhaseTimer timer("load_file", file_to_read);
+  std::string path = std::filesystem::canonical(file_to_read).native();
+  bool loaded = !bool(gInterpreter->LoadFile(path.c_str()));
+  if (loaded) {
+    loaded_files.insert(path);
+  }
+  refresh_func_handles(fnnames);
+  return loaded;
+}
+
+bool load_file(std::string const &file_to_read) {
+  return load_snippet(file_to_read, nullptr);
+}
+
+bool unload_file(std::string const &file_to_read) {
+  ps::cling::initialize_environment();
+  timing::PhaseTimer timer("unload_file", file_to_read);
+  std::string path = canonical_snippet_path(file_to_read);
+  if (!loaded_files.count(path)) {
+    return false;
+  }
+  bool unloaded = !bool(gInterpreter->UnloadFile(path.c_str()));
+  if (unloaded) {
+    loaded_files.erase(path);
+  }
+  refresh_func_handles();
+  return unloaded;
+}
+
+bool reload_file(std::string const &file_to_read) {
+  std::string path = canonical_snippet_path(file_to_read);
+  if (loaded_files.count(path) && !unload_file(path)) {
+    return false;
+  }
+  return load_file(path);
+}
+
+// snippets passed to load_analysis, by location + file_to_read
+std::set<std::string> analyses;
+bool load_analysis(std::string const &file_to_read, std::string location) {
+  ps::cling::initialize_environment();
+  if (ps::cling::analyses.count(location + file_to_read)) {
+    return true;
+  }
+  timing::PhaseTimer timer("load_analysis", location + file_to_read);
+  ps::cling::add_include_path(location);
+  bool loaded = !bool(gInterpreter->LoadFile(file_to_read.c_str()));
+  if (loaded) {
+    ps::cling::analyses.insert(location + file_to_read);
+  }
+  refresh_func_handles();
+  return loaded;
+}
+
+bool unload_analysis(std::string const &file_to_read, std::string location) {
+  ps::cling::initialize_environment();
+  if (!ps::cling::analyses.count(location + file_to_read)) {
+    return false;
+  }
+  timing::PhaseTimer timer("unload_analysis", location + file_to_read);
+  bool unloaded = !bool(gInterpreter->UnloadFile(file_to_read.c_str()));
+  if (unloaded) {
+    ps::cling::analyses.erase(location + file_to_read);
+  }
+  refresh_func_handles();
+  return unloaded;
 }
 
-template <typename T>
-T CastClingSymbolToFunction(std::string const &fnname,
-                            std::string const &arglist = "") {
-  return VoidToFunctionPtr<typename T::result_type (*)(
-      HepMC3::GenEvent const &)>(get_func_with_prototype(fnname, arglist));
+bool reload_analysis(std::string const &file_to_read, std::string location) {
+  if (ps::cling::analyses.count(location + file_to_read) &&
+      !unload_analysis(file_to_read, location)) {
+    return false;
+  }
+  return load_analysis(file_to_read, location);
 }
 
-template <typename T, size_t N> T get_func_impl(std::string const &fnname) {
+bool load_text(std::string const &txt) {
   ps::cling::initialize_environment();
+  timing::PhaseTimer timer("load_text");
+  bool loaded = bool(gInterpreter->LoadText(txt.c_str()));
+  refresh_func_handles();
+  return loaded;
+}
+void add_include_path(std::string const &path) {
+  gInterpreter->AddIncludePath(path.c_str());
+}
+
+// searched in the order that they were added
+std::vector<SymbolIndex> snippet_indices;
+
+void add_snippet_directory(std::string const &dir) {
+  timing::PhaseTimer timer("open_symbol_index", dir);
+  SymbolIndex index(dir);
+  for (auto const &existing : snippet_indices) {
+    if (existing.get_directory() == index.get_directory()) {
+      return;
+    }
+  }
+  // so that snippets can include headers beside them when they are loaded
+  add_include_path(index.get_directory());
+  snippet_indices.push_back(std::move(index));
+}
 
-  auto cling_func =
-      CastClingSymbolToFunction<T>(fnname, "HepMC3::GenEvent const &");
+bool load_indexed_snippet(std::string const &fnname) {
+  if (func_is_defined(fnname, "HepMC3::GenEvent const &")) {
+    return true;
+  }
+  for (auto const &index : snippet_indices) {
+    std::string path = index.find(fnname);
+    if (!path.size()) {
+      continue;
+    }
+    if (loaded_files.count(canonical_snippet_path(path))) {
+      // the owning snippet is already loaded, but didn't define fnname
+      return false;
+    }
+    // loading a snippet only adds definitions, so only the handles of the
+    // functions that it defines can change
+    std::string const &snippet = index.get_symbols().at(fnname);
+    std::set<std::string> defined;
+    for (auto const &[symname, defined_in] : index.get_symbols()) {
+      if (defined_in == snippet) {
+        defined.insert(symname);
+      }
+    }
+    return load_snippet(path, &defined) &&
+           func_is_defined(fnname, "HepMC3::GenEvent const &");
+  }
+  return false;
+}
+
+template <typename T, size_t N>
+T get_func_impl(std::string const &fnname, char const *kind) {
+  ps::cling::initialize_environment();
+  load_indexed_snippet(fnname);
+  timing::PhaseTimer timer("get_func", fnname);
+
+  void *sym = get_func_with_prototype(fnname, "HepMC3::GenEvent const &");
+  if (!sym) {
+    return T{};
+  }
   TInterpreter::EErrorCode cling_err = TInterpreter::EErrorCode::kNoError;
   if (!returns_impl<N>(fnname, cling_err)) {
     std::stringstream ss("");
@@ -145,27 +358,53 @@ template <typename T, size_t N> T get_func_impl(std::string const &fnname) {
        << " was requested, but it does not return the right type." << std::endl;
     throw std::runtime_error(ss.str());
   }
-  return cling_func;
+
+  func_handle_state *state;
+  {
+    std::lock_guard<std::mutex> lock(func_handles_mutex);
+    auto &owned = func_handles[{fnname, N}];
+    if (!owned) {
+      owned = std::make_unique<func_handle_state>();
+      owned->fnname = fnname;
+      owned->rtype = N;
+    }
+    owned->sym.store(sym, std::memory_order_release);
+    state = owned.get();
+  }
+
+  using func_ptr_t = typename T::result_type (*)(HepMC3::GenEvent const &);
+  T func = [state](HepMC3::GenEvent const &ev) {
+    void *sym = state->sym.load(std::memory_order_acquire);
+    if (__builtin_expect(!sym, 0)) {
+      throw_invalidated_handle(*state);
+    }
+    return VoidToFunctionPtr<func_ptr_t>(sym)(ev);
+  };
+  if (profiling::enabled()) {
+    return profiling::wrap(profiling::function_id(kind, fnname),
+                           std::move(func));
+  }
+  return func;
 }
 
 SelectFunc get_select_func(std::string const &fnname) {
-  return get_func_impl<SelectFunc, 0>(fnname);
+  return get_func_impl<SelectFunc, 0>(fnname, "select");
 }
 
 SelectsFunc get_selects_func(std::string const &fnname) {
-  return get_func_impl<SelectsFunc, 1>(fnname);
+  return get_func_impl<SelectsFunc, 1>(fnname, "selects");
 }
 
 ProjectionFunc get_projection_func(std::string const &fnname) {
-  return get_func_impl<ProjectionFunc, 2>(fnname);
+  return get_func_impl<ProjectionFunc, 2>(fnname, "project");
 }
 
 ProjectionsFunc get_projections_func(std::string const &fnname) {
-  return get_func_impl<ProjectionsFunc, 3>(fnname);
+  return get_func_impl<ProjectionsFunc, 3>(fnname, "projects");
 }
 
 WeightFunc get_weight_func(std::string const &fnname) {
-  return get_func_impl<WeightFunc, 2>(fnname);
+  return get_func_impl<WeightFunc, 2>(fnname, "weight");
 }
 
 bool cling_env_initialized = false;
@@ -174,6 +413,10 @@ void initialize_environment() {
     return;
   }
 
+  timing::PhaseTimer init_timer("initialize_environment");
+
+  std::optional<timing::PhaseTimer> phase_timer;
+  phase_timer.emplace("include_paths");
   char const *pathsc = std::getenv("ProSelecta_INCLUDE_PATH");
   if (!pathsc) {
     throw std::runtime_error(
@@ -190,7 +433,7 @@ void initialize_environment() {
     }
     gInterpreter->AddIncludePath(path.native().c_str());
   }
-
+  phase_timer.emplace("parse", "HepMC3/GenEvent.h");
   if (!gInterpreter->LoadText(R"(#include "HepMC3/GenEvent.h")")) {
     std::cerr << "ProSelecta environment initialization failed." << std::endl;
     throw std::runtime_error(
@@ -199,12 +442,34 @@ void initialize_environment() {
         "variable points to a HepMC3 distribution.");
   }
 
-  if (!gInterpreter->LoadText(R"(#include "ProSelecta/env.h")")) {
+  phase_timer.emplace("parse", "ProSelecta/env.h");
+  // link against the common template instantiations compiled into this
+  // library rather than JIT-ing them for every snippet, and use the same
+  // exception diagnostics mode as this library
+  std::string env_preamble = "#define ProSelecta_EXTERN_TEMPLATES\n";
+#ifdef ProSelecta_LAZY_EXCEPTION_DIAGNOSTICS
+  env_preamble += "#define ProSelecta_LAZY_EXCEPTION_DIAGNOSTICS\n";
+#endif
+  if (!gInterpreter->LoadText(
+          (env_preamble + R"(#include "ProSelecta/env.h")").c_str())) {
     std::cerr << "ProSelecta environment initialization failed." << std::endl;
     throw std::runtime_error("cling returned false when asked to include the "
                              "ProSelecta/env.h.");
   }
 
+  // the interpreter has its own instance of the env's inline hook storage
+  phase_timer.emplace("backtrace_hook");
+  if (!gInterpreter->LoadText(R"(
+extern "C" void ProSelecta_detail_StackTrace();
+static bool ProSelecta_detail_backtrace_hook_installed =
+  (ps::detail::backtrace_hook() = &ProSelecta_detail_StackTrace, true);
+)")) {
+    std::cerr << "ProSelecta environment initialization failed." << std::endl;
+    throw std::runtime_error(
+        "cling returned false when asked to install the backtrace hook.");
+  }
+
+  phase_timer.emplace("return_type_tester");
   bool return_type_tester_parse = gInterpreter->LoadText(R"(
 static bool ProSelecta_detail_func_return_type_is_int = false;
 static bool ProSelecta_detail_func_return_type_is_vect_int = false;
@@ -253,6 +518,7 @@ std::vector<double> ProSelecta_detail_test_vector_double(HepMC3::GenEvent const
           get_func_with_prototype(
               "ProSelecta_detail_GetFuncReturnTypeDeductions", ""));
 
+  phase_timer.emplace("self_tests");
   TInterpreter::EErrorCode cling_err = TInterpreter::EErrorCode::kNoError;
   assert(returns_int("ProSelecta_detail_test_int", cling_err));
   if (cling_err != TInterpreter::EErrorCode::kNoError) {
@@ -279,8 +545,24 @@ std::vector<double> ProSelecta_detail_test_vector_double(HepMC3::GenEvent const
     throw std::runtime_error("ProSelecta_detail_test_vector_double doesn't "
                              "appear to return a vector<double>.");
   }
+  phase_timer.reset();
 
   cling_env_initialized = true;
 }
+
+void enable_jit_symbol_export(bool perf, bool gdb) {
+  // cling only checks for these when the JIT is constructed
+  if (cling_env_initialized) {
+    throw std::runtime_error(
+        "ps::cling::enable_jit_symbol_export must be called before the "
+        "ProSelecta environment is initialized.");
+  }
+  if (perf) {
+    setenv("CLING_PROFILE", "1", 1);
+  }
+  if (gdb) {
+    setenv("CLING_DEBUG", "1", 1);
+  }
+}
 } // namespace cling
 } // namespace ps
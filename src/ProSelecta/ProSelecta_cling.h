@@ -7,12 +7,36 @@ namespace cling {
 
 void initialize_environment();
 
+// Asks cling to describe the code that it JITs to external tools: perf
+// enables cling's perf map/jitdump listener so that perf can attribute samples
+// to snippet functions, gdb registers JIT'd objects with the GDB JIT interface
+// so that they can be stepped through and have symbolized backtraces. Must be
+// called before the environment is initialized.
+void enable_jit_symbol_export(bool perf, bool gdb);
+
 bool load_file(std::string const &);
 bool load_text(std::string const &);
 bool load_analysis(std::string const &file_to_read, std::string location);
 
+// Unloading a snippet reverts its cling transactions, handles to functions
+// that it defined are invalidated and throw if called. Reloading replaces a
+// snippet in place, handles to functions that it redefines with the same
+// return type are retargeted to the new definitions.
+bool unload_file(std::string const &);
+bool reload_file(std::string const &);
+bool unload_analysis(std::string const &file_to_read, std::string location);
+bool reload_analysis(std::string const &file_to_read, std::string location);
+
 void add_include_path(std::string const &);
 
+// Registers a directory of snippets whose symbol index is consulted by the
+// get_*_func functions, the snippet that defines a requested function is
+// loaded the first time that function is requested.
+void add_snippet_directory(std::string const &);
+// Loads the indexed snippet that defines fnname if it is not already defined,
+// returns whether fnname is defined afterwards.
+bool load_indexed_snippet(std::string const &fnname);
+
 bool func_is_defined(std::string const &fnname, std::string const &arglist);
 
 SelectFunc get_select_func(std::string const &);
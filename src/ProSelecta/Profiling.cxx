@@ -0,0 +1,354 @@
+#include "ProSelecta/Profiling.h"
+
+#include "HepMC3/GenEvent.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace ps {
+namespace profiling {
+
+namespace {
+
+size_t const nslowest = 8;
+// 4 exact bins for 0-3 ticks, then 4 bins per octave up to 2^64
+size_t const nbins = 252;
+
+size_t latency_bin(uint64_t t) {
+  if (t < 4) {
+    return t;
+  }
+  size_t msb = 63 - __builtin_clzll(t);
+  return 4 * (msb - 1) + ((t >> (msb - 2)) & 3);
+}
+
+double latency_bin_mid(size_t bin) {
+  if (bin < 4) {
+    return bin;
+  }
+  size_t msb = (bin / 4) + 1;
+  double low = double(4 + (bin % 4)) * double(uint64_t(1) << (msb - 2));
+  double width = double(uint64_t(1) << (msb - 2));
+  return low + 0.5 * width;
+}
+
+struct SlowTicks {
+  uint64_t ticks;
+  int event_number;
+  size_t nparticles;
+};
+
+// Only the owning thread writes the counters, so they are updated with
+// relaxed loads and stores rather than read-modify-write operations. Readers
+// may see a call partially recorded, which is fine for a report.
+struct FunctionStats {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> max{0};
+  std::array<std::atomic<uint64_t>, nbins> bins{};
+  // a call must take longer than this to be one of the slowest
+  std::atomic<uint64_t> slow_threshold{0};
+  std::mutex slow_mtx;
+  std::vector<SlowTicks> slowest;
+};
+
+void bump(std::atomic<uint64_t> &a, uint64_t n) {
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct Accumulator {
+  // guards the structure of stats, which only the owning thread grows
+  std::mutex mtx;
+  std::deque<FunctionStats> stats;
+
+  FunctionStats &get(size_t id) {
+    if (id >= stats.size()) {
+      std::lock_guard<std::mutex> lk(mtx);
+      while (stats.size() <= id) {
+        stats.emplace_back();
+      }
+    }
+    return stats[id];
+  }
+};
+
+// Never destroyed, so that calls recorded during static destruction and the
+// report written at exit are safe
+struct Registry {
+  std::mutex mtx;
+  std::map<std::pair<std::string, std::string>, size_t> ids;
+  std::vector<std::pair<std::string, std::string>> functions;
+  std::vector<std::unique_ptr<Accumulator>> accumulators;
+  // accumulators of threads that have exited, reused by new threads
+  std::vector<Accumulator *> free_accumulators;
+
+  std::chrono::steady_clock::time_point start_time =
+      std::chrono::steady_clock::now();
+  uint64_t start_ticks = ticks();
+};
+
+Registry &registry() {
+  static Registry *reg = new Registry;
+  return *reg;
+}
+
+std::atomic<bool> is_enabled{false};
+
+struct ThreadAccumulator {
+  Accumulator *acc;
+
+  ThreadAccumulator() {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lk(reg.mtx);
+    if (reg.free_accumulators.size()) {
+      acc = reg.free_accumulators.back();
+      reg.free_accumulators.pop_back();
+    } else {
+      reg.accumulators.push_back(std::make_unique<Accumulator>());
+      acc = reg.accumulators.back().get();
+    }
+  }
+  ~ThreadAccumulator() {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lk(reg.mtx);
+    reg.free_accumulators.push_back(acc);
+  }
+};
+
+double tick_seconds() {
+  auto &reg = registry();
+  // calibrate the TSC against the steady clock over at least 50 ms
+  auto min_elapsed = std::chrono::milliseconds(50);
+  auto elapsed = std::chrono::steady_clock::now() - reg.start_time;
+  if (elapsed < min_elapsed) {
+    std::this_thread::sleep_for(min_elapsed - elapsed);
+  }
+  uint64_t nticks = ticks() - reg.start_ticks;
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - reg.start_time)
+                       .count();
+  return nticks ? (seconds / nticks) : 0;
+}
+
+std::string json_escape(std::string const &str) {
+  std::string out;
+  for (char c : str) {
+    if ((c == '"') || (c == '\\')) {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+// Set from PROSELECTA_PROFILE when the library is loaded
+std::string exit_report_path;
+
+void write_exit_report() {
+  try {
+    write_json(exit_report_path);
+  } catch (std::exception const &e) {
+    std::cerr << "[ERROR]: " << e.what() << std::endl;
+  }
+}
+
+[[maybe_unused]] bool const profile_from_env = []() {
+  if (char const *path = std::getenv("PROSELECTA_PROFILE")) {
+    exit_report_path = path;
+    enable();
+    std::atexit(&write_exit_report);
+  }
+  return true;
+}();
+
+} // namespace
+
+void enable(bool on) { is_enabled.store(on, std::memory_order_relaxed); }
+bool enabled() { return is_enabled.load(std::memory_order_relaxed); }
+
+size_t function_id(std::string const &kind, std::string const &name) {
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lk(reg.mtx);
+  auto it = reg.ids.find({kind, name});
+  if (it != reg.ids.end()) {
+    return it->second;
+  }
+  reg.functions.emplace_back(kind, name);
+  return reg.ids[{kind, name}] = reg.functions.size() - 1;
+}
+
+void record(size_t id, uint64_t nticks, HepMC3::GenEvent const &ev) {
+  thread_local ThreadAccumulator tacc;
+  auto &st = tacc.acc->get(id);
+
+  bump(st.calls, 1);
+  bump(st.total, nticks);
+  if (nticks > st.max.load(std::memory_order_relaxed)) {
+    st.max.store(nticks, std::memory_order_relaxed);
+  }
+  bump(st.bins[latency_bin(nticks)], 1);
+
+  if (nticks > st.slow_threshold.load(std::memory_order_relaxed)) {
+    SlowTicks slow{nticks, ev.event_number(), ev.particles().size()};
+    std::lock_guard<std::mutex> lk(st.slow_mtx);
+    auto pos = std::find_if(
+        st.slowest.begin(), st.slowest.end(),
+        [&](SlowTicks const &other) { return other.ticks < nticks; });
+    st.slowest.insert(pos, slow);
+    if (st.slowest.size() > nslowest) {
+      st.slowest.pop_back();
+    }
+    if (st.slowest.size() == nslowest) {
+      st.slow_threshold.store(st.slowest.back().ticks,
+                              std::memory_order_relaxed);
+    }
+  }
+}
+
+std::vector<FunctionProfile> profiles() {
+  double const tick_s = tick_seconds();
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lk(reg.mtx);
+
+  struct Merged {
+    uint64_t calls = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> bins = std::vector<uint64_t>(nbins, 0);
+    std::vector<SlowTicks> slowest;
+  };
+  std::vector<Merged> merged(reg.functions.size());
+
+  for (auto const &acc : reg.accumulators) {
+    std::lock_guard<std::mutex> acc_lk(acc->mtx);
+    for (size_t id = 0; id < acc->stats.size(); ++id) {
+      auto &st = acc->stats[id];
+      auto &m = merged[id];
+      m.calls += st.calls.load(std::memory_order_relaxed);
+      m.total += st.total.load(std::memory_order_relaxed);
+      m.max = std::max(m.max, st.max.load(std::memory_order_relaxed));
+      for (size_t b = 0; b < nbins; ++b) {
+        m.bins[b] += st.bins[b].load(std::memory_order_relaxed);
+      }
+      std::lock_guard<std::mutex> slow_lk(st.slow_mtx);
+      m.slowest.insert(m.slowest.end(), st.slowest.begin(), st.slowest.end());
+    }
+  }
+
+  std::vector<FunctionProfile> out;
+  for (size_t id = 0; id < merged.size(); ++id) {
+    auto &m = merged[id];
+    if (!m.calls) {
+      continue;
+    }
+    FunctionProfile prof{reg.functions[id].first,
+                         reg.functions[id].second,
+                         m.calls,
+                         m.total * tick_s,
+                         0,
+                         0,
+                         m.max * tick_s,
+                         {}};
+
+    auto quantile = [&](double q) {
+      uint64_t target = uint64_t(q * m.calls);
+      uint64_t cumulative = 0;
+      for (size_t b = 0; b < nbins; ++b) {
+        cumulative += m.bins[b];
+        if (cumulative > target) {
+          return std::min(latency_bin_mid(b), double(m.max)) * tick_s;
+        }
+      }
+      return m.max * tick_s;
+    };
+    prof.p50_s = quantile(0.5);
+    prof.p99_s = quantile(0.99);
+
+    std::stable_sort(m.slowest.begin(), m.slowest.end(),
+                     [](SlowTicks const &a, SlowTicks const &b) {
+                       return a.ticks > b.ticks;
+                     });
+    for (size_t i = 0; i < std::min(nslowest, m.slowest.size()); ++i) {
+      prof.slowest.push_back(SlowCall{m.slowest[i].ticks * tick_s,
+                                      m.slowest[i].event_number,
+                                      m.slowest[i].nparticles});
+    }
+    out.push_back(std::move(prof));
+  }
+
+  std::stable_sort(out.begin(), out.end(),
+                   [](FunctionProfile const &a, FunctionProfile const &b) {
+                     return a.total_s > b.total_s;
+                   });
+  return out;
+}
+
+void reset() {
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lk(reg.mtx);
+  for (auto const &acc : reg.accumulators) {
+    std::lock_guard<std::mutex> acc_lk(acc->mtx);
+    for (auto &st : acc->stats) {
+      st.calls = 0;
+      st.total = 0;
+      st.max = 0;
+      for (auto &bin : st.bins) {
+        bin = 0;
+      }
+      std::lock_guard<std::mutex> slow_lk(st.slow_mtx);
+      st.slowest.clear();
+      st.slow_threshold = 0;
+    }
+  }
+}
+
+std::string json() {
+  std::stringstream ss("");
+  ss << std::setprecision(9) << "{\n  \"functions\": [";
+  bool first = true;
+  for (auto const &prof : profiles()) {
+    ss << (first ? "" : ",") << "\n    {\n"
+       << "      \"kind\": \"" << prof.kind << "\",\n"
+       << "      \"name\": \"" << json_escape(prof.name) << "\",\n"
+       << "      \"calls\": " << prof.calls << ",\n"
+       << "      \"total_s\": " << prof.total_s << ",\n"
+       << "      \"mean_s\": " << (prof.total_s / prof.calls) << ",\n"
+       << "      \"p50_s\": " << prof.p50_s << ",\n"
+       << "      \"p99_s\": " << prof.p99_s << ",\n"
+       << "      \"max_s\": " << prof.max_s << ",\n"
+       << "      \"slowest\": [";
+    for (size_t i = 0; i < prof.slowest.size(); ++i) {
+      auto const &slow = prof.slowest[i];
+      ss << (i ? "," : "") << "\n        {\"event_number\": "
+         << slow.event_number << ", \"nparticles\": " << slow.nparticles
+         << ", \"seconds\": " << slow.seconds << "}";
+    }
+    ss << (prof.slowest.size() ? "\n      ]" : "]") << "\n    }";
+    first = false;
+  }
+  ss << (first ? "]" : "\n  ]") << "\n}\n";
+  return ss.str();
+}
+
+void write_json(std::string const &path) {
+  std::ofstream ofs(path);
+  ofs << json();
+  if (!ofs) {
+    throw std::runtime_error("Failed to write profile to: " + path);
+  }
+}
+
+} // namespace profiling
+} // namespace ps
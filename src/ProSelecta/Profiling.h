@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace HepMC3 {
+class GenEvent;
+}
+
+namespace ps {
+namespace profiling {
+
+// Opt-in per-function latency profiling of the hooks returned by the
+// get_*_func functions. While enabled, every handle that is fetched is
+// wrapped so that each call is timed with the TSC, where available, and
+// accumulated per thread without locking. Handles fetched before profiling
+// was enabled are not profiled.
+//
+// Profiling is also enabled by setting PROSELECTA_PROFILE to a path, the JSON
+// report is then written there when the process exits.
+void enable(bool on = true);
+bool enabled();
+
+// One of the slowest calls of a function, for reproduction
+struct SlowCall {
+  double seconds;
+  int event_number;
+  // the number of particles in the event
+  size_t nparticles;
+};
+
+struct FunctionProfile {
+  // select, selects, project, projects, or weight
+  std::string kind;
+  std::string name;
+  uint64_t calls;
+  double total_s;
+  // from a latency histogram with 4 bins per octave, so to within ~20%
+  double p50_s;
+  double p99_s;
+  double max_s;
+  // slowest first
+  std::vector<SlowCall> slowest;
+};
+
+// The profiles of every thread merged, slowest total first
+std::vector<FunctionProfile> profiles();
+// Must not be called while profiled hooks are running
+void reset();
+
+std::string json();
+// throws std::runtime_error if path cannot be written
+void write_json(std::string const &path);
+
+// The number of the function, the same for every handle of the same function
+size_t function_id(std::string const &kind, std::string const &name);
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void record(size_t id, uint64_t nticks, HepMC3::GenEvent const &ev);
+
+// Records the call on destruction, so that calls that throw are also counted
+struct CallTimer {
+  size_t id;
+  HepMC3::GenEvent const &ev;
+  uint64_t start;
+
+  CallTimer(size_t i, HepMC3::GenEvent const &e)
+      : id(i), ev(e), start(ticks()) {}
+  ~CallTimer() { record(id, ticks() - start, ev); }
+};
+
+template <typename R>
+std::function<R(HepMC3::GenEvent const &)>
+wrap(size_t id, std::function<R(HepMC3::GenEvent const &)> func) {
+  return [id, func = std::move(func)](HepMC3::GenEvent const &ev) {
+    CallTimer timer(id, ev);
+    return func(ev);
+  };
+}
+
+} // namespace profiling
+} // namespace ps
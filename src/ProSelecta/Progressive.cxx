@@ -0,0 +1,290 @@
+#include "ProSelecta/Progressive.h"
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/MultiFileReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+double const inf = std::numeric_limits<double>::infinity();
+
+// A block of the events of one input file, the unit that is sampled
+struct SampleBlock {
+  size_t file;
+  size_t first;
+  size_t nevents;
+};
+
+// The sums over the blocks read so far of the per-block totals, y, of some
+// quantity, for ratio estimates of its total over every event
+struct BlockSums {
+  double y = 0;
+  double yy = 0;
+  double yn = 0;
+
+  void add(double yb, double nb) {
+    y += yb;
+    yy += yb * yb;
+    yn += yb * nb;
+  }
+};
+
+// The number of events in the blocks read so far
+struct BlockSizes {
+  size_t m = 0;
+  double n = 0;
+  double nn = 0;
+};
+
+// The ratio estimate of a total over the nevents events of nblocks blocks,
+// with the variance of a sample of blocks drawn without replacement
+Estimate estimate(BlockSums const &s, BlockSizes const &sz, size_t nblocks,
+                  double nevents) {
+  if (!sz.m) {
+    return {0, inf};
+  }
+  double const r = s.y / sz.n;
+  Estimate e{nevents * r, 0};
+  if (sz.m >= nblocks) {
+    return e;
+  }
+  if (sz.m < 2) {
+    e.error = inf;
+    return e;
+  }
+  double const m = double(sz.m);
+  double const nbar = sz.n / m;
+  double const s2 =
+      std::max((s.yy - 2 * r * s.yn + r * r * sz.nn) / (m - 1), 0.0);
+  e.error = nevents * std::sqrt((1 - (m / nblocks)) * s2 / m) / nbar;
+  return e;
+}
+
+// A total that no sampled event has contributed to is estimated as 0 with no
+// uncertainty, so it is never precise
+double relative_error(Estimate const &e) {
+  return (e.value == 0) ? inf : (e.error / std::abs(e.value));
+}
+
+} // namespace
+
+ProgressiveEstimate run_progressive(
+    std::vector<std::string> const &files, SelectFunc const &select,
+    std::vector<HistogramSpec> const &hists, ProgressiveOptions const &opts,
+    std::function<bool(ProgressiveEstimate const &)> const &progress) {
+  auto const start = std::chrono::steady_clock::now();
+  if (!opts.block_events || !opts.chunk_size) {
+    throw std::runtime_error(
+        "Progressive runs need non-zero block and chunk sizes.");
+  }
+
+  // every input must be seekable, an indexed HepMC3 ASCII file, or a cache
+  std::vector<std::shared_ptr<EventIndex const>> indices(files.size());
+  std::vector<std::shared_ptr<HepMC3::Reader>> readers(files.size());
+  std::vector<SampleBlock> blocks;
+  // the number of the first event of each file across every input
+  std::vector<size_t> first_event(files.size());
+  ProgressiveEstimate est;
+  for (size_t f = 0; f < files.size(); ++f) {
+    first_event[f] = est.nevents;
+    size_t nevents = 0;
+    if (is_event_cache(files[f])) {
+      auto cache = std::make_shared<EventCacheReader>(files[f]);
+      nevents = cache->size();
+      readers[f] = cache;
+    } else if (is_hepmc3_ascii(files[f])) {
+      indices[f] = std::make_shared<EventIndex const>(
+          open_event_index(files[f]));
+      nevents = indices[f]->nevents();
+    } else {
+      throw std::runtime_error(
+          "Progressive runs can only read uncompressed HepMC3 ASCII files, "
+          "or event caches: " +
+          files[f]);
+    }
+    for (size_t first = 0; first < nevents; first += opts.block_events) {
+      blocks.push_back(SampleBlock{
+          f, first, std::min(opts.block_events, nevents - first)});
+    }
+    est.nevents += nevents;
+  }
+  // the blocks, in event order, are read in a random order
+  std::vector<size_t> order(blocks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937_64 rng(opts.seed);
+  std::shuffle(order.begin(), order.end(), rng);
+  est.nblocks = blocks.size();
+
+  EventHooks hooks{select, {}, {}, {}};
+  HistogramSet prototype(hists);
+  EventLoop loop(hooks, opts.nthreads, opts.batch_size);
+  if (hists.size()) {
+    loop.fill_histograms(prototype);
+  }
+  HistogramSet block_hists = prototype.empty_clone();
+  est.histograms = prototype.histograms;
+
+  BlockSizes sizes;
+  BlockSums selected;
+  size_t nselected_sampled = 0;
+  // the fills of each sampled block, for an exact run that samples every
+  // block, with the event numbers of a pass over every input
+  bool keep_fills = opts.exact;
+  size_t nkept_fills = 0;
+  std::vector<std::vector<HistogramFill>> kept_fills(blocks.size());
+  // the bins of each histogram, followed by its integral
+  std::vector<std::vector<BlockSums>> bins;
+  for (auto const &h : prototype.histograms) {
+    bins.emplace_back(h.sumw.size() + 1);
+  }
+
+  auto elapsed = [&]() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+
+  for (size_t b : order) {
+    auto const &block = blocks[b];
+    auto &rdr = readers[block.file];
+    bool positioned;
+    if (indices[block.file]) {
+      if (!rdr) {
+        rdr = std::make_shared<AsciiReader>(files[block.file]);
+      }
+      positioned = static_cast<AsciiReader &>(*rdr).seek(
+          indices[block.file]->offsets[block.first]);
+    } else {
+      positioned = static_cast<EventCacheReader &>(*rdr).seek(block.first);
+    }
+
+    size_t nselected = 0;
+    size_t nread = 0;
+    block_hists.reset();
+    if (positioned) {
+      EventRange range;
+      range.max_events = block.nevents;
+      nread = loop.run(
+          *rdr,
+          [&](EventBatch const &batch) {
+            for (auto const &res : batch.results) {
+              nselected += res.pass;
+            }
+            apply_fills(block_hists.histograms, batch.fills);
+            if (keep_fills) {
+              for (auto fill : batch.fills) {
+                fill.evtnum += first_event[block.file] + block.first;
+                kept_fills[b].push_back(fill);
+              }
+            }
+          },
+          range);
+    }
+    if (keep_fills) {
+      nkept_fills += kept_fills[b].size();
+      if (nkept_fills > opts.max_kept_fills) {
+        keep_fills = false;
+        kept_fills = std::vector<std::vector<HistogramFill>>();
+      }
+    }
+    if (nread != block.nevents) {
+      std::stringstream ss("");
+      ss << "Failed to read events " << block.first << " to "
+         << (block.first + block.nevents) << " of " << files[block.file]
+         << ", the file may have changed since it was indexed.";
+      throw std::runtime_error(ss.str());
+    }
+
+    double const nb = double(block.nevents);
+    sizes.m++;
+    sizes.n += nb;
+    sizes.nn += nb * nb;
+    selected.add(double(nselected), nb);
+    nselected_sampled += nselected;
+    for (size_t h = 0; h < bins.size(); ++h) {
+      auto const &sumw = block_hists.histograms[h].sumw;
+      double integral = 0;
+      for (size_t i = 0; i < sumw.size(); ++i) {
+        bins[h][i].add(sumw[i], nb);
+        integral += sumw[i];
+      }
+      bins[h].back().add(integral, nb);
+      est.histograms[h].entries += block_hists.histograms[h].entries;
+    }
+
+    est.blocks_read = sizes.m;
+    est.events_read += block.nevents;
+    est.elapsed_s = elapsed();
+    double const nevents = double(est.nevents);
+    est.selected = estimate(selected, sizes, est.nblocks, nevents);
+    est.efficiency = {est.selected.value / nevents,
+                      est.selected.error / nevents};
+    double worst = relative_error(est.selected);
+    for (size_t h = 0; h < bins.size(); ++h) {
+      auto &hist = est.histograms[h];
+      for (size_t i = 0; i < hist.sumw.size(); ++i) {
+        auto e = estimate(bins[h][i], sizes, est.nblocks, nevents);
+        hist.sumw[i] = e.value;
+        hist.sumw2[i] = e.error * e.error;
+      }
+      auto integral = estimate(bins[h].back(), sizes, est.nblocks, nevents);
+      worst = std::max(worst, relative_error(integral));
+    }
+
+    bool const more = !progress || progress(est);
+    bool const precise = (opts.precision > 0) &&
+                         (sizes.m >= opts.min_blocks) &&
+                         (worst <= opts.precision);
+    if (!more || precise ||
+        ((opts.time_budget_s > 0) && (est.elapsed_s >= opts.time_budget_s))) {
+      break;
+    }
+  }
+
+  if (opts.exact) {
+    // the histograms are summed as those of any other run over the files
+    HistogramAccumulator acc(prototype.histograms, opts.chunk_size);
+    size_t nselected = 0;
+    if (keep_fills && (sizes.m == blocks.size())) {
+      // every block was sampled, and the fills of the blocks in event order
+      // are those of a pass over the files
+      for (auto const &fills : kept_fills) {
+        acc.add(fills);
+      }
+      nselected = nselected_sampled;
+    } else {
+      MultiFileReader rdr(files);
+      loop.run(rdr, [&](EventBatch const &batch) {
+        for (auto const &res : batch.results) {
+          nselected += res.pass;
+        }
+        acc.add(batch.fills);
+      });
+    }
+    est.exact = true;
+    est.elapsed_s = elapsed();
+    est.selected = {double(nselected), 0};
+    est.efficiency = {est.nevents ? (double(nselected) / est.nevents) : 0, 0};
+    est.histograms = acc.finish();
+    if (progress) {
+      progress(est);
+    }
+  }
+  return est;
+}
+
+} // namespace ps
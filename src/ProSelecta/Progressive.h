@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/FuncTypes.h"
+#include "ProSelecta/Histogram.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+struct ProgressiveOptions {
+  // the events of each input file are sampled in blocks of this many
+  size_t block_events = 4096;
+  uint64_t seed = 0;
+  // stop once the relative uncertainty of the number of selected events,
+  // and of the integral of every histogram, is at most precision, 0 to read
+  // every block
+  double precision = 0;
+  // the precision is only checked once this many blocks have been read, as
+  // the uncertainties estimated from a few blocks are themselves uncertain
+  size_t min_blocks = 10;
+  // stop once this many seconds have passed, 0 for no limit
+  double time_budget_s = 0;
+  // once sampling stops, read every event in order to give exact results
+  bool exact = false;
+  // the histograms of the exact results are summed in chunks of this many
+  // events, see HistogramAccumulator, so that they are identical to those of
+  // ProSelectaCPP --Hist with the same --shard-chunk
+  size_t chunk_size = EventRange().chunk_size;
+  // the most histogram fills, of 32 bytes each, kept from the sampled blocks
+  // for the exact results, beyond which those read the inputs again
+  size_t max_kept_fills = size_t(1) << 22;
+  size_t nthreads = 1;
+  size_t batch_size = 256;
+};
+
+// A total over every event of the inputs, and its statistical uncertainty
+struct Estimate {
+  double value = 0;
+  double error = 0;
+};
+
+// The state of a progressive run after a block of events. Totals are
+// estimated from the blocks read so far, scaled up to every event of the
+// inputs, and the uncertainties are those of that scaling. The histograms
+// hold the estimated bin contents in sumw, and their variances in sumw2.
+//
+// Once every block has been read, the estimates are the totals, and their
+// uncertainties are 0. If exact is set, the totals, and the histograms, are
+// instead those of a full pass over the inputs in order, with the sums of
+// squared weights in sumw2, as for any other run. That pass does not read
+// the inputs again if every block was sampled.
+struct ProgressiveEstimate {
+  // the blocks, and events, sampled so far, of every block and event
+  size_t blocks_read = 0;
+  size_t nblocks = 0;
+  size_t events_read = 0;
+  size_t nevents = 0;
+  double elapsed_s = 0;
+  bool exact = false;
+  // the number of events that pass the selection, and the fraction
+  Estimate selected;
+  Estimate efficiency;
+  std::vector<Histogram> histograms;
+};
+
+// Estimates the number of events that pass select, and the histograms of
+// hists, from blocks of the events of files read in a random order, so that
+// the estimates converge on the totals as early as possible.
+//
+// The blocks are chosen without replacement, so the uncertainties are those
+// of cluster sampling, with the blocks as clusters, which accounts for
+// neighbouring events being alike, as they often are when inputs are sorted
+// by process. Until two blocks have been read, the uncertainties are
+// infinite.
+//
+// Each input must be either an uncompressed HepMC3 ASCII file, which is
+// indexed with open_event_index, or an event cache. progress is called after
+// every block, and sampling stops early if it returns false, or once the
+// precision or time budget of opts is reached. An estimate of 0 is never
+// precise, as it has no uncertainty until an event has contributed to it.
+ProgressiveEstimate run_progressive(
+    std::vector<std::string> const &files, SelectFunc const &select,
+    std::vector<HistogramSpec> const &hists, ProgressiveOptions const &opts,
+    std::function<bool(ProgressiveEstimate const &)> const &progress =
+        nullptr);
+
+} // namespace ps
@@ -0,0 +1,94 @@
+#include "ProSelecta/ROOTIO.h"
+
+#include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TH3D.h"
+#include "THn.h"
+
+#include <memory>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+std::unique_ptr<TH1> make_th(Histogram const &hist) {
+  auto const &ax = hist.axes;
+  std::unique_ptr<TH1> th;
+  if (ax.size() == 1) {
+    th = std::make_unique<TH1D>(hist.name.c_str(), hist.name.c_str(),
+                                ax[0].nbins(), ax[0].edges.data());
+  } else if (ax.size() == 2) {
+    th = std::make_unique<TH2D>(hist.name.c_str(), hist.name.c_str(),
+                                ax[0].nbins(), ax[0].edges.data(),
+                                ax[1].nbins(), ax[1].edges.data());
+  } else {
+    th = std::make_unique<TH3D>(hist.name.c_str(), hist.name.c_str(),
+                                ax[0].nbins(), ax[0].edges.data(),
+                                ax[1].nbins(), ax[1].edges.data(),
+                                ax[2].nbins(), ax[2].edges.data());
+  }
+  th->SetDirectory(nullptr);
+  th->Sumw2();
+  // the global bin numbering of TH1, TH2 and TH3 matches Histogram
+  for (size_t bin = 0; bin < hist.sumw.size(); ++bin) {
+    th->SetBinContent(bin, hist.sumw[bin]);
+    th->GetSumw2()->fArray[bin] = hist.sumw2[bin];
+  }
+  th->SetEntries(hist.entries);
+  return th;
+}
+
+std::unique_ptr<THnD> make_thn(Histogram const &hist) {
+  std::vector<int> nbins;
+  for (auto const &axis : hist.axes) {
+    nbins.push_back(axis.nbins());
+  }
+  // the placeholder ranges are replaced with the bin edges below
+  std::vector<double> const lows(hist.axes.size(), 0);
+  std::vector<double> const highs(hist.axes.size(), 1);
+  auto thn = std::make_unique<THnD>(hist.name.c_str(), hist.name.c_str(),
+                                    int(nbins.size()), nbins.data(),
+                                    lows.data(), highs.data());
+  for (size_t i = 0; i < hist.axes.size(); ++i) {
+    thn->GetAxis(i)->Set(nbins[i], hist.axes[i].edges.data());
+  }
+  thn->Sumw2();
+
+  std::vector<int> idx(hist.axes.size());
+  for (size_t bin = 0; bin < hist.sumw.size(); ++bin) {
+    size_t rem = bin;
+    for (size_t i = 0; i < hist.axes.size(); ++i) {
+      idx[i] = rem % (nbins[i] + 2);
+      rem /= (nbins[i] + 2);
+    }
+    Long64_t thn_bin = thn->GetBin(idx.data());
+    thn->SetBinContent(thn_bin, hist.sumw[bin]);
+    thn->SetBinError2(thn_bin, hist.sumw2[bin]);
+  }
+  thn->SetEntries(hist.entries);
+  return thn;
+}
+
+} // namespace
+
+void write_histograms_root(std::string const &path,
+                           std::vector<Histogram> const &hists) {
+  std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "RECREATE"));
+  if (!file || file->IsZombie()) {
+    throw std::runtime_error("Failed to open output ROOT file: " + path);
+  }
+
+  for (auto const &hist : hists) {
+    file->cd();
+    if (hist.axes.size() <= 3) {
+      make_th(hist)->Write();
+    } else {
+      make_thn(hist)->Write();
+    }
+  }
+  file->Close();
+}
+
+} // namespace ps
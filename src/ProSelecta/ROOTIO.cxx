@@ -0,0 +1,16 @@
+#include "ProSelecta/ROOTIO.h"
+
+namespace ps {
+
+void enable_root_io() {
+  root_sink_factory() =
+      [](std::string const &path) -> std::unique_ptr<OutputSink> {
+    return std::make_unique<TTreeSink>(path);
+  };
+  root_table_reader() = [](std::string const &path) {
+    return open_ttree_table(path);
+  };
+  root_histogram_writer() = &write_histograms_root;
+}
+
+} // namespace ps
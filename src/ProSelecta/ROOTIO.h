@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ProSelecta/Histogram.h"
+#include "ProSelecta/OutputSink.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class TFile;
+class TTree;
+
+// The ROOT file formats, which are built into the optional ProSelectaROOTIO
+// library, so that the interpreter library only depends on ROOT's core and
+// its interpreter.
+
+namespace ps {
+
+// A ROOT TTree with one ULong64_t evtnum branch, one Bool_t pass branch and
+// one Double_t branch per value column, named for its hook. Values of events
+// that fail the selection are filled as NaN. If there are selections, their
+// bitmask is held in a fixed-size ULong64_t array branch, selmask, and their
+// names, in bit order, in the space-separated title of a TNamed named
+// selections in the tree's user info. Constructing one enables ROOT's thread
+// safety, as it is written from the writer thread of an AsyncSink, or of an
+// AsyncSinks, while the main thread keeps using the interpreter.
+class TTreeSink : public OutputSink {
+  std::string path;
+  std::string treename;
+  std::unique_ptr<TFile> file;
+  TTree *tree;
+  unsigned long long evtnum;
+  bool pass;
+  std::vector<double> values;
+  std::vector<unsigned long long> selmask;
+
+public:
+  explicit TTreeSink(std::string const &path,
+                     std::string const &treename = "ProSelecta");
+  ~TTreeSink();
+  void open(OutputColumns const &cols);
+  void write(std::vector<EventResult> const &rows);
+  void close();
+};
+
+std::unique_ptr<OutputTableReader>
+open_ttree_table(std::string const &path,
+                 std::string const &treename = "ProSelecta");
+OutputTable read_ttree_table(std::string const &path,
+                             std::string const &treename = "ProSelecta");
+
+// One TH1D, TH2D, or TH3D, or THnD for higher dimensions, per histogram, with
+// the errors set from the sum of squared weights.
+void write_histograms_root(std::string const &path,
+                           std::vector<Histogram> const &hists);
+
+// Makes the ROOT formats available to deduce_sink, read_output_table and
+// write_histograms. Call once, before starting any thread that uses them.
+void enable_root_io();
+
+} // namespace ps
@@ -0,0 +1,688 @@
+#include "ProSelecta/ResultStore.h"
+#include "ProSelecta/SymbolIndex.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+namespace {
+
+char const column_magic[9] = "PSRCOL01";
+char const stats_magic[9] = "PSRSTA01";
+
+[[noreturn]] void throw_errno(char const *what, std::string const &path) {
+  std::stringstream ss("");
+  ss << what << ": " << path << ": " << std::strerror(errno);
+  throw std::runtime_error(ss.str());
+}
+
+template <typename T> void append_pod(std::string &buf, T const &v) {
+  buf.append(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+template <typename T>
+void append_values(std::string &buf, std::vector<T> const &v) {
+  buf.append(reinterpret_cast<char const *>(v.data()), sizeof(T) * v.size());
+}
+
+// Returns the whole file, or nothing if it does not exist
+std::optional<std::string> read_file(std::string const &path) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) {
+    return std::nullopt;
+  }
+  std::stringstream ss("");
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+// Writes to a temporary file that is renamed over path, so that readers
+// never see a partial file
+void write_file(std::string const &path, std::string const &buf) {
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path());
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (!f) {
+    throw_errno("Failed to open result store file", tmp);
+  }
+  bool ok = (std::fwrite(buf.data(), 1, buf.size(), f) == buf.size());
+  ok = !std::fclose(f) && ok;
+  if (!ok) {
+    throw_errno("Failed writing result store file", tmp);
+  }
+  if (std::rename(tmp.c_str(), path.c_str())) {
+    throw_errno("Failed to replace result store file", path);
+  }
+}
+
+// A 128-bit non-cryptographic hash of a stream of bytes, taken 8 bytes at a
+// time so that hashing large inputs costs little more than reading them
+class Hasher {
+  uint64_t h1 = 0x9e3779b97f4a7c15ull;
+  uint64_t h2 = 0xc2b2ae3d27d4eb4full;
+  uint64_t length = 0;
+  char tail[8];
+  size_t ntail = 0;
+
+  static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+  static uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+  }
+  void word(uint64_t w) {
+    h1 = rotl(h1 ^ (w * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+    h2 = rotl(h2 ^ (w * 0x4cf5ad432745937full), 33) * 0x87c37b91114253d5ull;
+  }
+
+public:
+  void update(char const *data, size_t size) {
+    length += size;
+    while (ntail && size) {
+      tail[ntail++] = *data++;
+      size--;
+      if (ntail == 8) {
+        uint64_t w;
+        std::memcpy(&w, tail, 8);
+        word(w);
+        ntail = 0;
+      }
+    }
+    for (; size >= 8; data += 8, size -= 8) {
+      uint64_t w;
+      std::memcpy(&w, data, 8);
+      word(w);
+    }
+    std::memcpy(tail, data, size);
+    ntail = size;
+  }
+
+  void update_file(std::string const &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw_errno("Failed to open file to hash", path);
+    }
+    std::vector<char> buf(1 << 20);
+    ssize_t n;
+    while ((n = ::read(fd, buf.data(), buf.size())) > 0) {
+      update(buf.data(), n);
+    }
+    ::close(fd);
+    if (n < 0) {
+      throw_errno("Failed reading file to hash", path);
+    }
+  }
+
+  std::string hex() const {
+    uint64_t w = 0;
+    std::memcpy(&w, tail, ntail);
+    uint64_t a = fmix(h1 ^ fmix(w ^ length));
+    uint64_t b = fmix(h2 ^ fmix(w + length));
+    std::stringstream ss("");
+    ss << std::hex << std::setfill('0') << std::setw(16) << a << std::setw(16)
+       << b;
+    return ss.str();
+  }
+};
+
+// Function names may hold namespace qualifiers, which are escaped so that
+// every name is a single valid file name
+std::string escape_name(std::string const &name) {
+  std::stringstream ss("");
+  for (unsigned char c : name) {
+    if (std::isalnum(c) || (c == '_')) {
+      ss << c;
+    } else {
+      ss << '%' << std::hex << std::setfill('0') << std::setw(2) << int(c);
+    }
+  }
+  return ss.str();
+}
+
+size_t nwords(size_t nevents) { return (nevents + 63) / 64; }
+
+} // namespace
+
+ResultStore::ResultStore(std::string const &d) : dir(d) {
+  std::filesystem::create_directories(dir);
+}
+
+std::string ResultStore::hash_files(std::vector<std::string> const &paths) {
+  Hasher h;
+  for (auto const &path : paths) {
+    h.update_file(path);
+  }
+  return h.hex();
+}
+
+std::string ResultStore::input_hash(std::string const &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st)) {
+    throw_errno("Failed to stat input file", path);
+  }
+  std::stringstream key("");
+  key << st.st_size << " " << st.st_mtim.tv_sec << "." << std::setfill('0')
+      << std::setw(9) << st.st_mtim.tv_nsec;
+
+  Hasher path_hash;
+  std::string abs =
+      std::filesystem::absolute(path).lexically_normal().string();
+  path_hash.update(abs.data(), abs.size());
+  std::string const cache_path = dir + "/inputs/" + path_hash.hex();
+
+  if (auto cached = read_file(cache_path)) {
+    std::stringstream ss(*cached);
+    std::string cached_key, hash;
+    if (std::getline(ss, cached_key) && (cached_key == key.str()) &&
+        std::getline(ss, hash) && hash.size()) {
+      return hash;
+    }
+  }
+
+  std::string hash = hash_files({path});
+  write_file(cache_path, key.str() + "\n" + hash + "\n");
+  return hash;
+}
+
+std::string ResultStore::column_path(std::string const &input_hash,
+                                     std::string const &source_hash,
+                                     std::string const &kind,
+                                     std::string const &name) const {
+  return dir + "/" + input_hash + "/" + source_hash + "/" +
+         escape_name(name) + "." + kind;
+}
+
+std::optional<StoredColumn>
+ResultStore::load(std::string const &input_hash,
+                  std::string const &source_hash, std::string const &kind,
+                  std::string const &name) const {
+  std::string const path = column_path(input_hash, source_hash, kind, name);
+  auto buf = read_file(path);
+  size_t const header_size = 8 + 2 * sizeof(uint64_t);
+  if (!buf || (buf->size() < header_size) ||
+      std::memcmp(buf->data(), column_magic, 8)) {
+    return std::nullopt;
+  }
+
+  StoredColumn col;
+  uint64_t kind_id, nevents;
+  std::memcpy(&kind_id, buf->data() + 8, sizeof(uint64_t));
+  std::memcpy(&nevents, buf->data() + 8 + sizeof(uint64_t), sizeof(uint64_t));
+  if ((kind_id != StoredColumn::kSelect) &&
+      (kind_id != StoredColumn::kValues)) {
+    return std::nullopt;
+  }
+  col.kind = StoredColumn::Kind(kind_id);
+  col.nevents = nevents;
+  size_t const nvalues = (col.kind == StoredColumn::kValues) ? nevents : 0;
+  // a truncated or corrupt column is treated as missing, and recomputed
+  if (((nevents / 64) > buf->size()) ||
+      (buf->size() != (header_size + sizeof(uint64_t) * nwords(nevents) +
+                       sizeof(double) * nvalues))) {
+    return std::nullopt;
+  }
+  col.bits.resize(nwords(nevents));
+  col.values.resize(nvalues);
+  char const *data = buf->data() + header_size;
+  std::memcpy(col.bits.data(), data, sizeof(uint64_t) * col.bits.size());
+  std::memcpy(col.values.data(), data + sizeof(uint64_t) * col.bits.size(),
+              sizeof(double) * col.values.size());
+  return col;
+}
+
+void ResultStore::save(std::string const &input_hash,
+                       std::string const &source_hash,
+                       std::string const &kind, std::string const &name,
+                       StoredColumn const &col) {
+  std::string buf(column_magic, 8);
+  append_pod(buf, uint64_t(col.kind));
+  append_pod(buf, uint64_t(col.nevents));
+  append_values(buf, col.bits);
+  append_values(buf, col.values);
+  write_file(column_path(input_hash, source_hash, kind, name), buf);
+}
+
+std::optional<InputFileStats>
+ResultStore::load_stats(std::string const &input_hash) const {
+  auto buf = read_file(dir + "/" + input_hash + "/stats");
+  if (!buf || (buf->size() != (8 + sizeof(uint64_t) + 2 * sizeof(double))) ||
+      std::memcmp(buf->data(), stats_magic, 8)) {
+    return std::nullopt;
+  }
+  InputFileStats stats;
+  uint64_t nevents;
+  std::memcpy(&nevents, buf->data() + 8, sizeof(uint64_t));
+  std::memcpy(&stats.sumw, buf->data() + 8 + sizeof(uint64_t), sizeof(double));
+  std::memcpy(&stats.sumw2, buf->data() + 8 + sizeof(uint64_t) + sizeof(double),
+              sizeof(double));
+  stats.nevents = nevents;
+  return stats;
+}
+
+void ResultStore::save_stats(std::string const &input_hash,
+                             InputFileStats const &stats) {
+  std::string buf(stats_magic, 8);
+  append_pod(buf, uint64_t(stats.nevents));
+  append_pod(buf, stats.sumw);
+  append_pod(buf, stats.sumw2);
+  write_file(dir + "/" + input_hash + "/stats", buf);
+}
+
+namespace {
+
+// Adds the file at path to h, followed by every header that it includes with
+// quotes that is found beside it or in include_dirs. Each header is added
+// once.
+void hash_with_includes(Hasher &h, std::filesystem::path const &path,
+                        std::vector<std::string> const &include_dirs,
+                        std::set<std::string> &seen) {
+  auto src = read_file(path.native());
+  if (!src) {
+    throw_errno("Failed to open file to hash", path.native());
+  }
+  h.update(src->data(), src->size());
+
+  static std::regex const include_re(R"re(^\s*#\s*include\s*"([^"]+)")re");
+  std::stringstream ss(*src);
+  std::string line;
+  while (std::getline(ss, line)) {
+    std::smatch m;
+    if (!std::regex_search(line, m, include_re)) {
+      continue;
+    }
+    std::vector<std::filesystem::path> candidates{path.parent_path() /
+                                                  m[1].str()};
+    for (auto const &d : include_dirs) {
+      candidates.push_back(std::filesystem::path(d) / m[1].str());
+    }
+    for (auto const &header : candidates) {
+      if (std::filesystem::is_regular_file(header)) {
+        auto canonical = std::filesystem::weakly_canonical(header);
+        if (seen.insert(canonical.native()).second) {
+          hash_with_includes(h, canonical, include_dirs, seen);
+        }
+        break;
+      }
+    }
+  }
+}
+
+// The hash of the ProSelecta version and of every environment header under
+// the paths of ProSelecta_INCLUDE_PATH, which every snippet includes
+std::string environment_hash() {
+  Hasher h;
+  std::string const version = ProSelecta_VERSION;
+  h.update(version.data(), version.size());
+
+  char const *pathsc = std::getenv("ProSelecta_INCLUDE_PATH");
+  std::stringstream ss(pathsc ? pathsc : "");
+  std::string path;
+  while (std::getline(ss, path, ':')) {
+    auto const env_dir = std::filesystem::path(path) / "ProSelecta";
+    if (path.empty() || !std::filesystem::exists(env_dir / "env.h")) {
+      continue;
+    }
+    std::vector<std::string> headers;
+    for (auto const &entry :
+         std::filesystem::recursive_directory_iterator(env_dir)) {
+      if (entry.is_regular_file()) {
+        headers.push_back(entry.path().native());
+      }
+    }
+    std::sort(headers.begin(), headers.end());
+    for (auto const &header : headers) {
+      h.update_file(header);
+    }
+  }
+  return h.hex();
+}
+
+} // namespace
+
+HookSources::HookSources(std::vector<std::string> const &files,
+                         std::vector<std::string> const &snippet_dirs,
+                         std::vector<std::string> const &include_dirs) {
+  std::string const env = environment_hash();
+  auto snippet_hash = [&](std::string const &path) {
+    Hasher h;
+    h.update(env.data(), env.size());
+    std::set<std::string> seen;
+    hash_with_includes(h, path, include_dirs, seen);
+    return h.hex();
+  };
+
+  Hasher all;
+  all.update(env.data(), env.size());
+  for (auto const &file : files) {
+    std::string const hash = snippet_hash(file);
+    all.update(hash.data(), hash.size());
+    for (auto const &name : SymbolIndex::scan_snippet(file)) {
+      hashes.emplace(name, hash);
+    }
+  }
+  for (auto const &d : snippet_dirs) {
+    SymbolIndex index(d);
+    // snippet path -> hash, as a snippet may define many hooks
+    std::map<std::string, std::string> snippets;
+    for (auto const &sym : index.get_symbols()) {
+      std::string const path = index.find(sym.first);
+      auto it = snippets.find(path);
+      if (it == snippets.end()) {
+        it = snippets.emplace(path, snippet_hash(path)).first;
+      }
+      hashes.emplace(sym.first, it->second);
+    }
+    for (auto const &snippet : snippets) {
+      all.update(snippet.second.data(), snippet.second.size());
+    }
+  }
+  all_snippets = all.hex();
+}
+
+std::string const &HookSources::hash(std::string const &name) const {
+  auto it = hashes.find(name);
+  return (it == hashes.end()) ? all_snippets : it->second;
+}
+
+namespace {
+
+// The columns of one set of hooks for one input file, empty where the store
+// did not hold a usable column
+struct SetColumns {
+  std::optional<StoredColumn> select;
+  std::vector<std::optional<StoredColumn>> selections;
+  // the projections followed by the weights
+  std::vector<std::optional<StoredColumn>> values;
+
+  bool pass(size_t i) const { return !select || select->test(i); }
+
+  bool values_missing() const {
+    for (auto const &col : values) {
+      if (!col) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool complete(NamedHooks const &set) const {
+    if (set.select.size() && !select) {
+      return false;
+    }
+    for (auto const &col : selections) {
+      if (!col) {
+        return false;
+      }
+    }
+    return !values_missing();
+  }
+};
+
+std::vector<std::pair<std::string, std::string>>
+value_keys(NamedHooks const &set) {
+  std::vector<std::pair<std::string, std::string>> keys;
+  for (auto const &name : set.columns.projections) {
+    keys.emplace_back("project", name);
+  }
+  for (auto const &name : set.columns.weights) {
+    keys.emplace_back("weight", name);
+  }
+  return keys;
+}
+
+// Loads the columns of set that are usable for an input with stats, none are
+// usable if its stats are missing. Values are only usable if they were
+// evaluated on every event that passes the selection.
+SetColumns load_columns(ResultStore const &store, std::string const &ih,
+                        HookSources const &sources, NamedHooks const &set,
+                        std::optional<InputFileStats> const &stats) {
+  size_t const nevents = stats ? stats->nevents : 0;
+  auto usable = [&](std::optional<StoredColumn> col,
+                    StoredColumn::Kind kind) {
+    return (stats && col && (col->kind == kind) && (col->nevents == nevents))
+               ? col
+               : std::nullopt;
+  };
+
+  SetColumns cols;
+  if (set.select.size()) {
+    cols.select =
+        usable(store.load(ih, sources.hash(set.select), "select", set.select),
+               StoredColumn::kSelect);
+  }
+  for (auto const &name : set.columns.selections) {
+    cols.selections.push_back(usable(
+        store.load(ih, sources.hash(name), "select", name),
+        StoredColumn::kSelect));
+  }
+  bool const pass_known = !set.select.size() || cols.select;
+  for (auto const &[kind, name] : value_keys(set)) {
+    auto col = usable(store.load(ih, sources.hash(name), kind, name),
+                      StoredColumn::kValues);
+    for (size_t i = 0; pass_known && col && (i < nevents); ++i) {
+      if (cols.pass(i) && !col->test(i)) {
+        col.reset();
+      }
+    }
+    // a partial column is kept, and completed, if the run must read the file
+    cols.values.push_back(pass_known ? col : std::nullopt);
+  }
+  return cols;
+}
+
+void push_back(StoredColumn &col, bool bit, double value = 0) {
+  if (!(col.nevents % 64)) {
+    col.bits.push_back(0);
+  }
+  if (bit) {
+    col.set(col.nevents);
+  }
+  if (col.kind == StoredColumn::kValues) {
+    col.values.push_back(value);
+  }
+  col.nevents++;
+}
+
+// Evaluates the hooks of each set whose columns are missing on every event
+// of file, adds their columns to cols and to the store, and returns the
+// statistics of file
+InputFileStats compute_missing(ResultStore &store, std::string const &ih,
+                               HookSources const &sources,
+                               std::string const &file,
+                               std::vector<NamedHooks> const &sets,
+                               std::vector<SetColumns> &cols, size_t nthreads,
+                               size_t batch_size) {
+  size_t const nsets = sets.size();
+
+  // the missing hooks of each set, with the index of the column that each
+  // fills
+  std::vector<EventHooks> hooks(nsets);
+  std::vector<std::vector<size_t>> selection_idx(nsets), value_idx(nsets);
+  for (size_t h = 0; h < nsets; ++h) {
+    auto const &set = sets[h];
+    auto const &have = cols[h];
+    if (set.select.size() && (!have.select || have.values_missing())) {
+      hooks[h].select = set.hooks.select;
+    }
+    for (size_t j = 0; j < set.hooks.selections.size(); ++j) {
+      if (!have.selections[j]) {
+        hooks[h].selections.push_back(set.hooks.selections[j]);
+        selection_idx[h].push_back(j);
+      }
+    }
+    size_t const nproj = set.hooks.projections.size();
+    for (size_t j = 0; j < have.values.size(); ++j) {
+      if (!have.values[j]) {
+        if (j < nproj) {
+          hooks[h].projections.push_back(set.hooks.projections[j]);
+        } else {
+          hooks[h].weights.push_back(set.hooks.weights[j - nproj]);
+        }
+        value_idx[h].push_back(j);
+      }
+    }
+  }
+
+  std::vector<StoredColumn> select(nsets);
+  std::vector<std::vector<StoredColumn>> selections(nsets), values(nsets);
+  for (size_t h = 0; h < nsets; ++h) {
+    selections[h].resize(selection_idx[h].size());
+    values[h].resize(value_idx[h].size(),
+                     StoredColumn{StoredColumn::kValues, 0, {}, {}});
+  }
+
+  MultiFileReader rdr({file}, 1);
+  EventLoop loop(hooks, std::max<size_t>(nthreads, 1), batch_size);
+  loop.run(rdr, [&](EventBatch const &batch) {
+    for (size_t i = 0; i < batch.nevents; ++i) {
+      for (size_t h = 0; h < nsets; ++h) {
+        auto const &res = batch.results[i * nsets + h];
+        push_back(select[h], res.pass);
+        for (size_t j = 0; j < selections[h].size(); ++j) {
+          push_back(selections[h][j], selmask_test(res.selmask, j));
+        }
+        // values are in the order of the missing projections, then weights
+        for (size_t j = 0; j < values[h].size(); ++j) {
+          push_back(values[h][j], res.pass, res.pass ? res.values[j] : 0);
+        }
+      }
+    }
+  });
+  InputFileStats stats = rdr.get_file_stats().front();
+  store.save_stats(ih, stats);
+
+  for (size_t h = 0; h < nsets; ++h) {
+    auto const &set = sets[h];
+    auto &have = cols[h];
+    if (hooks[h].select) {
+      store.save(ih, sources.hash(set.select), "select", set.select,
+                 select[h]);
+      have.select = std::move(select[h]);
+    }
+    for (size_t j = 0; j < selection_idx[h].size(); ++j) {
+      auto const &name = set.columns.selections[selection_idx[h][j]];
+      store.save(ih, sources.hash(name), "select", name, selections[h][j]);
+      have.selections[selection_idx[h][j]] = std::move(selections[h][j]);
+    }
+    auto const keys = value_keys(set);
+    for (size_t j = 0; j < value_idx[h].size(); ++j) {
+      auto const &[kind, name] = keys[value_idx[h][j]];
+      auto &col = values[h][j];
+      // keep the values of a column stored by a run with another selection
+      auto const &sh = sources.hash(name);
+      auto old = store.load(ih, sh, kind, name);
+      if (old && (old->kind == StoredColumn::kValues) &&
+          (old->nevents == col.nevents)) {
+        for (size_t i = 0; i < col.nevents; ++i) {
+          if (!col.test(i) && old->test(i)) {
+            col.set(i);
+            col.values[i] = old->values[i];
+          }
+        }
+      }
+      store.save(ih, sh, kind, name, col);
+      have.values[value_idx[h][j]] = std::move(col);
+    }
+  }
+  return stats;
+}
+
+} // namespace
+
+StoredRunResult
+run_with_store(ResultStore &store, HookSources const &sources,
+               std::vector<std::string> const &files,
+               std::vector<NamedHooks> const &sets,
+               std::function<void(std::vector<EventResult> &)> const &consume,
+               size_t nthreads, size_t batch_size) {
+  if (sets.empty()) {
+    throw std::runtime_error("run_with_store requires at least one set of "
+                             "hooks.");
+  }
+  for (auto const &set : sets) {
+    if ((bool(set.hooks.select) != bool(set.select.size())) ||
+        (set.hooks.projections.size() != set.columns.projections.size()) ||
+        (set.hooks.weights.size() != set.columns.weights.size()) ||
+        (set.hooks.selections.size() != set.columns.selections.size())) {
+      throw std::runtime_error("Every hook stored in a result store must be "
+                               "named.");
+    }
+  }
+
+  size_t const nsets = sets.size();
+  StoredRunResult result{0, 0, {}};
+  std::vector<EventResult> block;
+  size_t offset = 0;
+  for (auto const &file : files) {
+    std::string const ih = store.input_hash(file);
+    auto stats = store.load_stats(ih);
+
+    std::vector<SetColumns> cols;
+    bool complete = bool(stats);
+    for (auto const &set : sets) {
+      cols.push_back(load_columns(store, ih, sources, set, stats));
+      complete = complete && cols.back().complete(set);
+    }
+    if (!complete) {
+      stats = compute_missing(store, ih, sources, file, sets, cols, nthreads,
+                              batch_size);
+      result.events_read += stats->nevents;
+      result.files_read++;
+    }
+    stats->path = file;
+    result.inputs.push_back(*stats);
+
+    for (size_t i = 0; i < stats->nevents; ++i) {
+      for (size_t h = 0; h < nsets; ++h) {
+        auto const &c = cols[h];
+        EventResult res{offset + i, c.pass(i), {}, {}};
+        if (c.selections.size()) {
+          res.selmask.assign(selmask_words(c.selections.size()), 0);
+          for (size_t j = 0; j < c.selections.size(); ++j) {
+            if (c.selections[j]->test(i)) {
+              res.selmask[j / 64] |= (uint64_t(1) << (j % 64));
+            }
+          }
+        }
+        if (res.pass) {
+          for (auto const &col : c.values) {
+            res.values.push_back(col->values[i]);
+          }
+        }
+        block.push_back(std::move(res));
+      }
+      if (block.size() >= (1024 * nsets)) {
+        consume(block);
+        block.clear();
+      }
+    }
+    offset += stats->nevents;
+  }
+  if (block.size()) {
+    consume(block);
+  }
+  return result;
+}
+
+} // namespace ps
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/OutputSink.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+// The results of one hook on every event of an input file. Selections are
+// stored as a bitmask, and projections and weights as values with a bitmask
+// of the events that they were evaluated on, as they are only evaluated on
+// the events that pass the run's selection.
+struct StoredColumn {
+  enum Kind : uint64_t { kSelect = 0, kValues = 1 };
+
+  Kind kind = kSelect;
+  size_t nevents = 0;
+  // pass bits for kSelect, evaluated bits for kValues
+  std::vector<uint64_t> bits;
+  std::vector<double> values;
+
+  bool test(size_t i) const { return (bits[i / 64] >> (i % 64)) & 1; }
+  void set(size_t i) { bits[i / 64] |= (uint64_t(1) << (i % 64)); }
+};
+
+// An on-disk store of the results of hooks on input files, so that runs that
+// repeat the same hooks on the same inputs do not read the inputs again.
+//
+// Columns are keyed by the hash of the content of the input file, the hash of
+// the source of the hook, see HookSources, and the hook's kind and function
+// name. The hash of each input is itself cached, by its path, size, and
+// modification time, so that unchanged inputs are hashed once. Every file in
+// the store is written to a temporary file and renamed into place, so that
+// concurrent runs can share a store. Errors are reported by throwing
+// std::runtime_error.
+class ResultStore {
+  std::string dir;
+
+  std::string column_path(std::string const &input_hash,
+                          std::string const &source_hash,
+                          std::string const &kind,
+                          std::string const &name) const;
+
+public:
+  explicit ResultStore(std::string const &dir);
+
+  // A hex digest of the content of the files at paths, in order
+  static std::string hash_files(std::vector<std::string> const &paths);
+
+  // The hex digest of the content of the input file at path
+  std::string input_hash(std::string const &path);
+
+  // kind is one of select, project, or weight, and source_hash is that of
+  // the hook, see HookSources::hash
+  std::optional<StoredColumn> load(std::string const &input_hash,
+                                   std::string const &source_hash,
+                                   std::string const &kind,
+                                   std::string const &name) const;
+  void save(std::string const &input_hash, std::string const &source_hash,
+            std::string const &kind, std::string const &name,
+            StoredColumn const &col);
+
+  std::optional<InputFileStats> load_stats(std::string const &input_hash) const;
+  void save_stats(std::string const &input_hash, InputFileStats const &stats);
+};
+
+// The hashes of the sources of hooks, which key their columns in a
+// ResultStore, so that editing one snippet only invalidates the results of
+// the hooks that it defines. A hook is found in the files, as
+// SymbolIndex::scan_snippet finds it, or else in the SymbolIndex of the first
+// of snippet_dirs that defines it, as the interpreter looks them up. Its hash
+// covers that snippet, the headers that it includes with quotes, found beside
+// the including file or in include_dirs, the ProSelecta environment headers
+// under each path of ProSelecta_INCLUDE_PATH, and the ProSelecta version. A
+// hook that no snippet defines is hashed with every snippet instead.
+class HookSources {
+  // the hash of every snippet, for hooks that no snippet defines
+  std::string all_snippets;
+  // function name -> hash of the snippet that defines it
+  std::map<std::string, std::string> hashes;
+
+public:
+  HookSources(std::vector<std::string> const &files,
+              std::vector<std::string> const &snippet_dirs = {},
+              std::vector<std::string> const &include_dirs = {});
+
+  std::string const &hash(std::string const &name) const;
+};
+
+// A set of hooks and the names of their functions, which key their columns
+// in a ResultStore. select is empty if the hooks have no selection.
+struct NamedHooks {
+  EventHooks hooks;
+  std::string select;
+  OutputColumns columns;
+};
+
+struct StoredRunResult {
+  // the events read from the input files, rather than from the store
+  size_t events_read;
+  size_t files_read;
+  std::vector<InputFileStats> inputs;
+};
+
+// Evaluates each set of hooks on every event of the files, in order, as
+// EventLoop would, but taking the results of every hook that store holds
+// for a file from the store, keyed by the hash of its source in sources. A
+// file is only read if a result is missing, and then only the missing hooks
+// are evaluated, along with the selection if projections or weights are
+// missing, as it decides the events that they are evaluated on. The new
+// results are added to the store.
+//
+// The results of each block of events, numbered from 0 at the start of the
+// first file, are passed to consume in event order, results[i * nsets + h] is
+// that of set h on event i, and consume may move them out of the block. See
+// EventLoop for nthreads and batch_size.
+StoredRunResult
+run_with_store(ResultStore &store, HookSources const &sources,
+               std::vector<std::string> const &files,
+               std::vector<NamedHooks> const &sets,
+               std::function<void(std::vector<EventResult> &)> const &consume,
+               size_t nthreads = 1, size_t batch_size = 256);
+
+} // namespace ps
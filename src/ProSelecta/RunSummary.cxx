@@ -0,0 +1,189 @@
+#include "ProSelecta/RunSummary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+char const *RunSummary::header = "# ProSelecta run summary v1";
+
+std::string RunSummary::str() const {
+  std::stringstream ss("");
+  ss << header << "\n" << std::setprecision(17);
+  // the path goes last as it may contain spaces
+  for (auto const &in : inputs) {
+    ss << "input " << in.nevents << " " << in.sumw << " " << in.sumw2 << " "
+       << in.path << "\n";
+  }
+  ss << "skip " << range.skip << "\n"
+     << "max_events ";
+  if (range.max_events == std::numeric_limits<size_t>::max()) {
+    ss << "all\n";
+  } else {
+    ss << range.max_events << "\n";
+  }
+  ss << "shard " << range.shard << "/" << range.nshards << "\n"
+     << "chunk_size " << range.chunk_size << "\n"
+     << "batch_size " << batch_size << "\n"
+     << "events_read " << events_read << "\n"
+     << "events_selected " << events_selected << "\n";
+  for (auto const &[name, npassed] : selection_passed) {
+    ss << "selection_passed " << name << " " << npassed << "\n";
+  }
+  for (auto const &[name, entries] : histogram_entries) {
+    ss << "histogram_entries " << name << " " << entries << "\n";
+  }
+  return ss.str();
+}
+
+void RunSummary::write(std::string const &path) const {
+  std::ofstream ofs(path);
+  if (!ofs) {
+    throw std::runtime_error("Failed to open run summary file: " + path);
+  }
+  ofs << str();
+  if (!ofs) {
+    throw std::runtime_error("Failed writing run summary file: " + path);
+  }
+}
+
+RunSummary RunSummary::read(std::string const &path) {
+  std::ifstream ifs(path);
+  return parse(ifs, path);
+}
+
+RunSummary RunSummary::parse(std::istream &is, std::string const &name) {
+  std::string line;
+  if (!std::getline(is, line) || (line != header)) {
+    throw std::runtime_error("Not a ProSelecta run summary: " + name);
+  }
+
+  RunSummary summary;
+  while (std::getline(is, line)) {
+    std::stringstream ss(line);
+    std::string key;
+    ss >> key;
+    if (key == "input") {
+      InputFileStats in;
+      ss >> in.nevents >> in.sumw >> in.sumw2;
+      std::getline(ss >> std::ws, in.path);
+      summary.inputs.push_back(in);
+    } else if (key == "skip") {
+      ss >> summary.range.skip;
+    } else if (key == "max_events") {
+      std::string val;
+      ss >> val;
+      if (val != "all") {
+        summary.range.max_events = std::stoul(val);
+      }
+    } else if (key == "shard") {
+      char slash;
+      ss >> summary.range.shard >> slash >> summary.range.nshards;
+    } else if (key == "chunk_size") {
+      ss >> summary.range.chunk_size;
+    } else if (key == "batch_size") {
+      ss >> summary.batch_size;
+    } else if (key == "events_read") {
+      ss >> summary.events_read;
+    } else if (key == "events_selected") {
+      ss >> summary.events_selected;
+    } else if (key == "selection_passed") {
+      std::pair<std::string, size_t> sel;
+      ss >> sel.first >> sel.second;
+      summary.selection_passed.push_back(sel);
+    } else if (key == "histogram_entries") {
+      std::pair<std::string, size_t> ent;
+      ss >> ent.first >> ent.second;
+      summary.histogram_entries.push_back(ent);
+    } else {
+      throw std::runtime_error("Unknown key in run summary " + name + ": " +
+                               line);
+    }
+    if (ss.fail()) {
+      throw std::runtime_error("Malformed line in run summary " + name +
+                               ": " + line);
+    }
+  }
+  return summary;
+}
+
+RunSummary RunSummary::merge_shards(std::vector<RunSummary> const &shards) {
+  if (shards.empty()) {
+    throw std::runtime_error("No run summaries to merge.");
+  }
+
+  RunSummary merged = shards.front();
+  merged.range.shard = 0;
+  merged.range.nshards = 1;
+  merged.events_read = 0;
+  merged.events_selected = 0;
+  for (auto &in : merged.inputs) {
+    in = InputFileStats{in.path};
+  }
+  for (auto &sel : merged.selection_passed) {
+    sel.second = 0;
+  }
+  for (auto &ent : merged.histogram_entries) {
+    ent.second = 0;
+  }
+
+  size_t const nshards = shards.front().range.nshards;
+  std::vector<bool> seen(nshards, false);
+  auto same_inputs = [&](RunSummary const &shard) {
+    return std::equal(shard.inputs.begin(), shard.inputs.end(),
+                      merged.inputs.begin(), merged.inputs.end(),
+                      [](InputFileStats const &a, InputFileStats const &b) {
+                        return a.path == b.path;
+                      });
+  };
+
+  for (auto const &shard : shards) {
+    bool same_run =
+        same_inputs(shard) &&
+        (shard.range.skip == merged.range.skip) &&
+        (shard.range.max_events == merged.range.max_events) &&
+        (shard.range.nshards == nshards) &&
+        (shard.range.chunk_size == merged.range.chunk_size) &&
+        (shard.batch_size == merged.batch_size) &&
+        (shard.selection_passed.size() == merged.selection_passed.size()) &&
+        (shard.histogram_entries.size() == merged.histogram_entries.size());
+    if (!same_run || (shard.range.shard >= nshards) ||
+        seen[shard.range.shard]) {
+      std::stringstream ss("");
+      ss << "Run summary for shard " << shard.range.shard << "/"
+         << shard.range.nshards
+         << " is not a distinct shard of the same run as shard "
+         << shards.front().range.shard << "/" << nshards;
+      throw std::runtime_error(ss.str());
+    }
+    seen[shard.range.shard] = true;
+
+    merged.events_read += shard.events_read;
+    merged.events_selected += shard.events_selected;
+    for (size_t i = 0; i < merged.inputs.size(); ++i) {
+      merged.inputs[i].nevents += shard.inputs[i].nevents;
+      merged.inputs[i].sumw += shard.inputs[i].sumw;
+      merged.inputs[i].sumw2 += shard.inputs[i].sumw2;
+    }
+    for (size_t i = 0; i < merged.selection_passed.size(); ++i) {
+      merged.selection_passed[i].second += shard.selection_passed[i].second;
+    }
+    for (size_t i = 0; i < merged.histogram_entries.size(); ++i) {
+      merged.histogram_entries[i].second += shard.histogram_entries[i].second;
+    }
+  }
+
+  if (shards.size() != nshards) {
+    std::stringstream ss("");
+    ss << "Expected run summaries for all " << nshards << " shards, but got "
+       << shards.size();
+    throw std::runtime_error(ss.str());
+  }
+  return merged;
+}
+
+} // namespace ps
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/MultiFileReader.h"
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ps {
+
+// The cutflow of a ProSelectaCPP run: how many events were read from the
+// range, and from each input file along with their summed weights, how many
+// passed the selection, and each of the bitmask selections, and how many
+// entries each histogram received.
+// Written as text, so that runs can be compared with diff, and the summaries
+// of the shards of a run can be merged into the summary of an unsharded run.
+struct RunSummary {
+  std::vector<InputFileStats> inputs;
+  EventRange range;
+  size_t batch_size = 0;
+  size_t events_read = 0;
+  size_t events_selected = 0;
+  std::vector<std::pair<std::string, size_t>> selection_passed;
+  std::vector<std::pair<std::string, size_t>> histogram_entries;
+
+  static char const *header;
+
+  void write(std::string const &path) const;
+  static RunSummary read(std::string const &path);
+  // The text written by write, and parsed by read, name is only used in
+  // error messages
+  std::string str() const;
+  static RunSummary parse(std::istream &is, std::string const &name);
+
+  // Merges the summaries of every shard of a run, throws std::runtime_error
+  // if they are not exactly the shards 0..N-1 of the same run
+  static RunSummary merge_shards(std::vector<RunSummary> const &shards);
+};
+
+} // namespace ps
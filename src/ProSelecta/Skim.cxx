@@ -0,0 +1,124 @@
+#include "ProSelecta/Skim.h"
+#include "ProSelecta/EventCache.h"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/WriterAscii.h"
+#include "HepMC3/WriterAsciiHepMC2.h"
+#include "HepMC3/WriterHEPEVT.h"
+
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+char const *const SkimWriter::source_event_attribute =
+    "ProSelecta.source_event";
+char const *const SkimWriter::sources_attribute = "ProSelecta.sources";
+
+SkimWriter::SkimWriter(std::shared_ptr<HepMC3::Writer> w,
+                       std::vector<std::string> const &srcs)
+    : wrtr(std::move(w)), sources(), input_run(), skim_run(), nwritten(0) {
+  for (auto const &src : srcs) {
+    sources += (sources.size() ? "\n" : "") + src;
+  }
+}
+
+SkimWriter::~SkimWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void SkimWriter::write(HepMC3::GenEvent const &evt, size_t evtnum) {
+  if (!wrtr) {
+    throw std::runtime_error("Cannot write to a closed skim.");
+  }
+  if (!skim_run) {
+    input_run = evt.run_info();
+    skim_run = input_run ? std::make_shared<HepMC3::GenRunInfo>(*input_run)
+                         : std::make_shared<HepMC3::GenRunInfo>();
+    skim_run->tools().push_back(
+        {"ProSelecta", "", "skim of the events that passed a selection"});
+    skim_run->add_attribute(sources_attribute,
+                            std::make_shared<HepMC3::StringAttribute>(sources));
+  } else if (evt.run_info() != input_run) {
+    // writers only write the run info of the first event, so every input
+    // must name its weights as the first did
+    input_run = evt.run_info();
+    std::vector<std::string> const names =
+        input_run ? input_run->weight_names() : std::vector<std::string>();
+    if (names != skim_run->weight_names()) {
+      std::stringstream ss("");
+      ss << "Cannot skim event " << evtnum << ", its input names its "
+         << "weights differently to the first input, and every event of a "
+         << "skim shares one run info.";
+      throw std::runtime_error(ss.str());
+    }
+  }
+
+  HepMC3::GenEvent out(evt);
+  out.set_run_info(skim_run);
+  out.add_attribute(source_event_attribute,
+                    std::make_shared<HepMC3::LongAttribute>(long(evtnum)));
+  wrtr->write_event(out);
+  if (wrtr->failed()) {
+    throw std::runtime_error("Failed writing event to skim.");
+  }
+  nwritten++;
+}
+
+void SkimWriter::write(EventBatch const &batch, size_t hooks) {
+  if (batch.events.empty()) {
+    return;
+  }
+  size_t const nhooks = batch.results.size() / batch.events.size();
+  for (size_t i = 0; i < batch.events.size(); ++i) {
+    auto const &res = batch.results[i * nhooks + hooks];
+    if (res.pass) {
+      write(*batch.events[i], res.evtnum);
+    }
+  }
+}
+
+void SkimWriter::close() {
+  if (wrtr) {
+    auto w = std::move(wrtr);
+    w->close();
+  }
+}
+
+std::shared_ptr<HepMC3::Writer> deduce_writer(std::string const &path,
+                                              std::string format) {
+  if (format.empty()) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    format = (ext == ".pscache")  ? "pscache"
+             : (ext == ".hepmc2") ? "hepmc2"
+             : (ext == ".hepevt") ? "hepevt"
+                                  : "hepmc3";
+  }
+
+  std::shared_ptr<HepMC3::Writer> wrtr;
+  if (format == "hepmc3") {
+    wrtr = std::make_shared<HepMC3::WriterAscii>(path);
+  } else if (format == "hepmc2") {
+    wrtr = std::make_shared<HepMC3::WriterAsciiHepMC2>(path);
+  } else if (format == "hepevt") {
+    wrtr = std::make_shared<HepMC3::WriterHEPEVT>(path);
+  } else if (format == "pscache") {
+    wrtr = std::make_shared<EventCacheWriter>(path);
+  } else {
+    std::stringstream ss("");
+    ss << "Unknown skim format: " << format
+       << ", expected one of hepmc3, hepmc2, hepevt, or pscache.";
+    throw std::runtime_error(ss.str());
+  }
+
+  if (wrtr->failed()) {
+    throw std::runtime_error("Failed to open skim output: " + path);
+  }
+  return wrtr;
+}
+
+} // namespace ps
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ProSelecta/EventLoop.h"
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/Writer.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+// Writes the events that pass a selection to a new HepMC3 file or event
+// cache, so that later passes with different projections only read those
+// events.
+//
+// Events are written whole, with their weights and attributes. The number of
+// each event in the input, see EventRange, is recorded in its
+// ProSelecta.source_event attribute. Every event is written with one run
+// info, a copy of that of the first event's input that also lists the input
+// files, one per line, in the ProSelecta.sources run attribute. As the
+// weights of every event are named by it, write throws std::runtime_error if
+// an event's input names its weights differently.
+class SkimWriter {
+  std::shared_ptr<HepMC3::Writer> wrtr;
+  std::string sources;
+  // the run info of the last event's input, and the run info of the skim
+  std::shared_ptr<HepMC3::GenRunInfo> input_run;
+  std::shared_ptr<HepMC3::GenRunInfo> skim_run;
+  size_t nwritten;
+
+public:
+  static char const *const source_event_attribute;
+  static char const *const sources_attribute;
+
+  explicit SkimWriter(std::shared_ptr<HepMC3::Writer> wrtr,
+                      std::vector<std::string> const &sources = {});
+  ~SkimWriter();
+
+  // Writes evt, which is event evtnum of the input
+  void write(HepMC3::GenEvent const &evt, size_t evtnum);
+  // Writes the events of batch that pass the selection of its hooks-th set
+  // of hooks
+  void write(EventBatch const &batch, size_t hooks = 0);
+  // The number of events written
+  size_t size() const { return nwritten; }
+  void close();
+};
+
+// Opens a HepMC3 writer for a skim at path. format is one of hepmc3, hepmc2,
+// hepevt, or pscache, for an event cache, and if empty is deduced from the
+// extension of path, .hepmc2, .hepevt, and .pscache, or is otherwise hepmc3.
+// Throws std::runtime_error if the format is unknown or the file cannot be
+// opened.
+std::shared_ptr<HepMC3::Writer> deduce_writer(std::string const &path,
+                                              std::string format = "");
+
+} // namespace ps
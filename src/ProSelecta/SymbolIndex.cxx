@@ -0,0 +1,244 @@
+#include "ProSelecta/SymbolIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <sstream>
+
+namespace ps {
+
+char const *SymbolIndex::index_file_name = ".ProSelecta.symbols";
+
+namespace {
+
+char const *index_file_header = "# ProSelecta symbol index v1";
+
+std::set<std::string> const snippet_extensions = {".cxx", ".cpp", ".cc",
+                                                  ".C"};
+
+bool is_word_char(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || (c == '_');
+}
+
+// Strips comments and the contents of string literals and removes all
+// whitespace that does not separate two identifier characters, so that hook
+// signatures can be matched independently of how the source was formatted.
+std::string normalize_source(std::string const &src) {
+  std::string out;
+  out.reserve(src.size());
+
+  bool pending_space = false;
+  for (size_t i = 0; i < src.size(); ++i) {
+    char c = src[i];
+    char next = ((i + 1) < src.size()) ? src[i + 1] : '\0';
+
+    if ((c == '/') && (next == '/')) {
+      i = src.find('\n', i);
+      if (i == std::string::npos) {
+        break;
+      }
+      pending_space = true;
+      continue;
+    } else if ((c == '/') && (next == '*')) {
+      i = src.find("*/", i + 2);
+      if (i == std::string::npos) {
+        break;
+      }
+      i++;
+      pending_space = true;
+      continue;
+    } else if ((c == '"') && out.size() && (out.back() == 'R')) {
+      size_t open = src.find('(', i);
+      if (open == std::string::npos) {
+        break;
+      }
+      std::string close = ")" + src.substr(i + 1, open - i - 1) + "\"";
+      i = src.find(close, open);
+      if (i == std::string::npos) {
+        break;
+      }
+      i += close.size() - 1;
+      out += "\"\"";
+      continue;
+    } else if ((c == '"') || (c == '\'')) {
+      size_t j = i + 1;
+      while ((j < src.size()) && (src[j] != c)) {
+        j += (src[j] == '\\') ? 2 : 1;
+      }
+      i = j;
+      out += c;
+      out += c;
+      continue;
+    } else if (std::isspace(static_cast<unsigned char>(c))) {
+      pending_space = true;
+      continue;
+    }
+
+    if (pending_space && out.size() && is_word_char(out.back()) &&
+        is_word_char(c)) {
+      out += ' ';
+    }
+    pending_space = false;
+    out += c;
+  }
+
+  return out;
+}
+
+std::map<std::string, long long> list_snippets(std::string const &dir) {
+  std::map<std::string, long long> snippets;
+
+  std::error_code ec;
+  for (auto const &entry : std::filesystem::recursive_directory_iterator(
+           dir, std::filesystem::directory_options::skip_permission_denied,
+           ec)) {
+    if (!entry.is_regular_file() ||
+        !snippet_extensions.count(entry.path().extension().native())) {
+      continue;
+    }
+    snippets[std::filesystem::relative(entry.path(), dir).generic_string()] =
+        entry.last_write_time().time_since_epoch().count();
+  }
+
+  return snippets;
+}
+
+} // namespace
+
+std::vector<std::string> SymbolIndex::scan_snippet(std::string const &path) {
+  std::ifstream fin(path);
+  std::stringstream ss("");
+  ss << fin.rdbuf();
+
+  std::string const src = normalize_source(ss.str());
+
+  static std::regex const hook_def_re(
+      R"((?:^|[^\w:]))"
+      R"((?:int |double |std::vector<int> ?|std::vector<double> ?))"
+      R"(([A-Za-z_]\w*)\((?:HepMC3::GenEvent const&|const HepMC3::GenEvent&))"
+      R"((?:[A-Za-z_]\w*)?\)\{)");
+
+  std::vector<std::string> syms;
+  for (auto it = std::sregex_iterator(src.begin(), src.end(), hook_def_re);
+       it != std::sregex_iterator(); ++it) {
+    syms.push_back((*it)[1].str());
+  }
+  return syms;
+}
+
+SymbolIndex::SymbolIndex(std::string const &snippet_dir) {
+  directory = std::filesystem::weakly_canonical(snippet_dir).native();
+
+  if (!std::filesystem::is_directory(directory)) {
+    std::stringstream ss("");
+    ss << "SymbolIndex passed snippet directory: " << snippet_dir
+       << " which does not exist." << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  if (!read() || !is_up_to_date()) {
+    build();
+    // an unwritable snippet directory just means that the index is rebuilt
+    // every time
+    write();
+  }
+}
+
+std::string SymbolIndex::find(std::string const &symname) const {
+  auto it = symbols.find(symname);
+  if (it == symbols.end()) {
+    return "";
+  }
+  return (std::filesystem::path(directory) / it->second).native();
+}
+
+bool SymbolIndex::is_up_to_date() const {
+  return list_snippets(directory) == snippets;
+}
+
+bool SymbolIndex::read() {
+  std::ifstream fin(std::filesystem::path(directory) / index_file_name);
+  if (!fin.good()) {
+    return false;
+  }
+
+  std::string line;
+  if (!std::getline(fin, line) || (line != index_file_header)) {
+    return false;
+  }
+
+  snippets.clear();
+  symbols.clear();
+  while (std::getline(fin, line)) {
+    std::stringstream ls(line);
+    std::string type, rel_path;
+    ls >> type;
+    if (type == "snippet") {
+      long long mtime;
+      ls >> mtime >> std::ws;
+      std::getline(ls, rel_path);
+      snippets[rel_path] = mtime;
+    } else if (type == "symbol") {
+      std::string symname;
+      ls >> symname >> std::ws;
+      std::getline(ls, rel_path);
+      symbols[symname] = rel_path;
+    } else if (type.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SymbolIndex::build() {
+  snippets = list_snippets(directory);
+  symbols.clear();
+
+  for (auto const &[rel_path, mtime] : snippets) {
+    for (auto const &symname :
+         scan_snippet((std::filesystem::path(directory) / rel_path).native())) {
+      auto it = symbols.find(symname);
+      if (it != symbols.end()) {
+        std::cerr << "[WARN]: SymbolIndex found " << symname
+                  << " defined in both " << it->second << " and " << rel_path
+                  << " in " << directory << ", indexing the former."
+                  << std::endl;
+        continue;
+      }
+      symbols[symname] = rel_path;
+    }
+  }
+}
+
+bool SymbolIndex::write() const {
+  auto index_path = std::filesystem::path(directory) / index_file_name;
+  auto tmp_path = index_path;
+  tmp_path += ".tmp";
+
+  {
+    std::ofstream fout(tmp_path);
+    if (!fout.good()) {
+      return false;
+    }
+    fout << index_file_header << "\n";
+    for (auto const &[rel_path, mtime] : snippets) {
+      fout << "snippet " << mtime << " " << rel_path << "\n";
+    }
+    for (auto const &[symname, rel_path] : symbols) {
+      fout << "symbol " << symname << " " << rel_path << "\n";
+    }
+    if (!fout.good()) {
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, index_path, ec);
+  return !ec;
+}
+
+} // namespace ps
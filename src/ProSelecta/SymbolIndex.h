@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ps {
+
+// Maps the names of functions with a ProSelecta hook signature, as defined in
+// FuncTypes.h, to the snippet files in a directory that define them. This
+// lets the interpreter defer loading a snippet until one of its symbols is
+// first requested.
+//
+// The index is stored in the snippet directory as index_file_name and is
+// rebuilt whenever a snippet is added, removed, or modified.
+class SymbolIndex {
+  std::string directory;
+  // snippet path relative to directory -> last write time
+  std::map<std::string, long long> snippets;
+  // symbol name -> snippet path relative to directory
+  std::map<std::string, std::string> symbols;
+
+  bool read();
+  void build();
+
+public:
+  static char const *index_file_name;
+
+  // Reads the index for snippet_dir, building and writing it if it does not
+  // exist or is out of date.
+  explicit SymbolIndex(std::string const &snippet_dir);
+
+  std::string const &get_directory() const { return directory; }
+  std::map<std::string, std::string> const &get_symbols() const {
+    return symbols;
+  }
+
+  // absolute path of the snippet that defines symname, or an empty string
+  std::string find(std::string const &symname) const;
+
+  bool is_up_to_date() const;
+  bool write() const;
+
+  // names of the functions with a hook signature defined in a source file
+  static std::vector<std::string> scan_snippet(std::string const &path);
+};
+
+} // namespace ps
@@ -0,0 +1,183 @@
+#include "ProSelecta/ROOTIO.h"
+
+#include "TFile.h"
+#include "TList.h"
+#include "TNamed.h"
+#include "TObjArray.h"
+#include "TParameter.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace ps {
+
+TTreeSink::TTreeSink(std::string const &p, std::string const &tn)
+    : path(p), treename(tn), file(), tree(nullptr), evtnum(0), pass(false),
+      values(), selmask() {
+  // must be called before the writer thread is started, it is a no-op if
+  // thread safety is already enabled
+  ROOT::EnableThreadSafety();
+}
+
+TTreeSink::~TTreeSink() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void TTreeSink::open(OutputColumns const &cols) {
+  file = std::unique_ptr<TFile>(TFile::Open(path.c_str(), "RECREATE"));
+  if (!file || file->IsZombie()) {
+    std::stringstream ss("");
+    ss << "Failed to open output ROOT file: " << path;
+    throw std::runtime_error(ss.str());
+  }
+
+  // the tree is owned by the file
+  tree = new TTree(treename.c_str(), "ProSelecta output");
+  tree->SetDirectory(file.get());
+  tree->Branch("evtnum", &evtnum, "evtnum/l");
+  tree->Branch("pass", &pass, "pass/O");
+  // records which value branches are projections, and which are weights
+  tree->GetUserInfo()->Add(
+      new TParameter<Long64_t>("nprojections", cols.projections.size()));
+
+  values.resize(cols.projections.size() + cols.weights.size());
+  size_t i = 0;
+  for (auto const *names : {&cols.projections, &cols.weights}) {
+    for (auto const &n : *names) {
+      tree->Branch(n.c_str(), &values[i++], (n + "/D").c_str());
+    }
+  }
+
+  selmask.resize(selmask_words(cols.selections.size()));
+  if (selmask.size()) {
+    std::string names;
+    for (auto const &n : cols.selections) {
+      names += (names.size() ? " " : "") + n;
+    }
+    tree->GetUserInfo()->Add(new TNamed("selections", names.c_str()));
+    tree->Branch(
+        "selmask", selmask.data(),
+        ("selmask[" + std::to_string(selmask.size()) + "]/l").c_str());
+  }
+}
+
+void TTreeSink::write(std::vector<EventResult> const &rows) {
+  for (auto const &res : rows) {
+    evtnum = res.evtnum;
+    pass = res.pass;
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] =
+          res.pass ? res.values[i] : std::numeric_limits<double>::quiet_NaN();
+    }
+    std::copy(res.selmask.begin(), res.selmask.end(), selmask.begin());
+    tree->Fill();
+  }
+}
+
+void TTreeSink::close() {
+  if (!file) {
+    return;
+  }
+  file->cd();
+  tree->Write();
+  file->Close();
+  file.reset();
+  tree = nullptr;
+}
+
+namespace {
+
+// Reads up to block_rows entries at a time
+class TTreeTableReader : public OutputTableReader {
+  std::unique_ptr<TFile> file;
+  TTree *tree;
+  OutputColumns cols;
+  Long64_t next_entry;
+  unsigned long long evtnum;
+  bool pass;
+  std::vector<double> values;
+  std::vector<unsigned long long> selmask;
+
+public:
+  static size_t const block_rows = 4096;
+
+  TTreeTableReader(std::string const &path, std::string const &treename)
+      : file(TFile::Open(path.c_str(), "READ")), tree(nullptr), cols(),
+        next_entry(0), evtnum(0), pass(false), values(), selmask() {
+    tree = file ? file->Get<TTree>(treename.c_str()) : nullptr;
+    if (!tree) {
+      std::stringstream ss("");
+      ss << "Failed to read TTree " << treename
+         << " from ROOT file: " << path;
+      throw std::runtime_error(ss.str());
+    }
+
+    auto *nproj_param = dynamic_cast<TParameter<Long64_t> *>(
+        tree->GetUserInfo()->FindObject("nprojections"));
+    auto *sel_names = dynamic_cast<TNamed *>(
+        tree->GetUserInfo()->FindObject("selections"));
+
+    if (sel_names) {
+      std::stringstream ss(sel_names->GetTitle());
+      for (std::string n; ss >> n;) {
+        cols.selections.push_back(n);
+      }
+    }
+    selmask.resize(selmask_words(cols.selections.size()));
+
+    auto *branches = tree->GetListOfBranches();
+    // the first two branches are evtnum and pass, and the last the selmask
+    size_t const nvalues =
+        branches->GetEntries() - 2 - (selmask.size() ? 1 : 0);
+    size_t const nproj = nproj_param ? nproj_param->GetVal() : nvalues;
+
+    values.resize(nvalues);
+    tree->SetBranchAddress("evtnum", &evtnum);
+    tree->SetBranchAddress("pass", &pass);
+    for (size_t i = 0; i < nvalues; ++i) {
+      std::string name = branches->At(i + 2)->GetName();
+      (i < nproj ? cols.projections : cols.weights).push_back(name);
+      tree->SetBranchAddress(name.c_str(), &values[i]);
+    }
+    if (selmask.size()) {
+      tree->SetBranchAddress("selmask", selmask.data());
+    }
+  }
+
+  ~TTreeTableReader() { tree->ResetBranchAddresses(); }
+
+  OutputColumns const &columns() const { return cols; }
+
+  bool read(std::vector<EventResult> &rows) {
+    rows.clear();
+    for (; (rows.size() < block_rows) && (next_entry < tree->GetEntries());
+         ++next_entry) {
+      tree->GetEntry(next_entry);
+      rows.push_back(
+          EventResult{evtnum, pass, pass ? values : std::vector<double>(),
+                      std::vector<uint64_t>(selmask.begin(), selmask.end())});
+    }
+    return rows.size();
+  }
+};
+
+} // namespace
+
+std::unique_ptr<OutputTableReader>
+open_ttree_table(std::string const &path, std::string const &treename) {
+  return std::make_unique<TTreeTableReader>(path, treename);
+}
+
+OutputTable read_ttree_table(std::string const &path,
+                             std::string const &treename) {
+  return read_table(*open_ttree_table(path, treename));
+}
+
+} // namespace ps
@@ -0,0 +1,91 @@
+#include "ProSelecta/Timing.h"
+
+#include <sys/resource.h>
+
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+namespace ps {
+namespace timing {
+
+namespace {
+std::mutex records_mutex;
+std::vector<PhaseRecord> all_records;
+} // namespace
+
+long peak_rss_kb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return 0;
+  }
+#ifdef __APPLE__
+  // ru_maxrss is reported in bytes on macOS and in kilobytes on linux
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+PhaseTimer::PhaseTimer(std::string phase_, std::string name_)
+    : phase(std::move(phase_)), name(std::move(name_)),
+      start(std::chrono::steady_clock::now()),
+      start_peak_rss_kb(peak_rss_kb()) {}
+
+PhaseTimer::~PhaseTimer() {
+  long end_peak_rss_kb = peak_rss_kb();
+  record(PhaseRecord{
+      std::move(phase), std::move(name),
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count(),
+      end_peak_rss_kb, end_peak_rss_kb - start_peak_rss_kb});
+}
+
+void record(PhaseRecord rec) {
+  std::lock_guard<std::mutex> lock(records_mutex);
+  all_records.push_back(std::move(rec));
+}
+
+std::vector<PhaseRecord> records() {
+  std::lock_guard<std::mutex> lock(records_mutex);
+  return all_records;
+}
+
+void reset() {
+  std::lock_guard<std::mutex> lock(records_mutex);
+  all_records.clear();
+}
+
+std::string summary() {
+  auto recs = records();
+
+  std::stringstream ss("");
+  ss << "[ProSelecta timing]\n";
+  ss << std::left << std::setw(24) << "  phase" << std::setw(48) << "name"
+     << std::right << std::setw(12) << "wall [s]" << std::setw(16)
+     << "peak rss [kB]" << std::setw(14) << "growth [kB]" << "\n";
+
+  std::map<std::string, std::pair<size_t, double>> phase_totals;
+  for (auto const &rec : recs) {
+    ss << "  " << std::left << std::setw(22) << rec.phase << std::setw(48)
+       << rec.name << std::right << std::fixed << std::setprecision(4)
+       << std::setw(12) << rec.wall_s << std::setw(16) << rec.peak_rss_kb
+       << std::setw(14) << rec.peak_rss_growth_kb << "\n";
+    phase_totals[rec.phase].first++;
+    phase_totals[rec.phase].second += rec.wall_s;
+  }
+
+  ss << "[ProSelecta timing totals]\n";
+  for (auto const &[phase, tot] : phase_totals) {
+    ss << "  " << std::left << std::setw(22) << phase << std::right
+       << std::setw(6) << tot.first << " x " << std::fixed
+       << std::setprecision(4) << std::setw(12) << tot.second << " s\n";
+  }
+  ss << "  final peak rss: " << peak_rss_kb() << " kB\n";
+
+  return ss.str();
+}
+
+} // namespace timing
+} // namespace ps
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace ps {
+namespace timing {
+
+// One timed phase of interpreter start up or snippet/symbol processing.
+// phase is the kind of work (e.g. "parse", "load_file", "get_func") and name
+// identifies the file, header, or symbol that the phase was run for.
+struct PhaseRecord {
+  std::string phase;
+  std::string name;
+  double wall_s;
+  // process peak resident set size, in kB, when the phase finished
+  long peak_rss_kb;
+  // growth of the process peak resident set size during the phase, in kB
+  long peak_rss_growth_kb;
+};
+
+// RAII timer, records a PhaseRecord when it goes out of scope
+class PhaseTimer {
+  std::string phase;
+  std::string name;
+  std::chrono::steady_clock::time_point start;
+  long start_peak_rss_kb;
+
+public:
+  PhaseTimer(std::string phase, std::string name = "");
+  PhaseTimer(PhaseTimer const &) = delete;
+  PhaseTimer &operator=(PhaseTimer const &) = delete;
+  ~PhaseTimer();
+};
+
+long peak_rss_kb();
+
+void record(PhaseRecord rec);
+std::vector<PhaseRecord> records();
+void reset();
+
+// Human-readable table of all records with per-phase totals
+std::string summary();
+
+} // namespace timing
+} // namespace ps
@@ -0,0 +1,168 @@
+#include "ProSelecta/AsciiReader.h"
+
+#include "HepMC3/Data/GenEventData.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/ReaderFactory.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+
+using namespace ps;
+
+// Compares the read rates of HepMC3::deduce_reader and ps::AsciiReader on a
+// HepMC3 ASCII file, after checking that they read the same events and run
+// info. It is not a test, AsciiReaderTests checks the same on the example
+// file.
+//
+// asciiReaderBench <file.hepmc3> [repeats]
+
+bool SameData(HepMC3::GenEventData const &a, HepMC3::GenEventData const &b) {
+  if ((a.event_number != b.event_number) ||
+      (a.momentum_unit != b.momentum_unit) ||
+      (a.length_unit != b.length_unit) ||
+      (a.particles.size() != b.particles.size()) ||
+      (a.vertices.size() != b.vertices.size()) ||
+      !(a.event_pos == b.event_pos) || (a.links1 != b.links1) ||
+      (a.links2 != b.links2) || (a.weights != b.weights) ||
+      (a.attribute_id != b.attribute_id) ||
+      (a.attribute_name != b.attribute_name) ||
+      (a.attribute_string != b.attribute_string)) {
+    return false;
+  }
+  for (size_t p = 0; p < a.particles.size(); ++p) {
+    if ((a.particles[p].pid != b.particles[p].pid) ||
+        (a.particles[p].status != b.particles[p].status) ||
+        (a.particles[p].is_mass_set != b.particles[p].is_mass_set) ||
+        (a.particles[p].mass != b.particles[p].mass) ||
+        !(a.particles[p].momentum == b.particles[p].momentum)) {
+      return false;
+    }
+  }
+  for (size_t v = 0; v < a.vertices.size(); ++v) {
+    if ((a.vertices[v].status != b.vertices[v].status) ||
+        !(a.vertices[v].position == b.vertices[v].position)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SameRunInfo(HepMC3::GenRunInfo const &a, HepMC3::GenRunInfo const &b) {
+  if ((a.weight_names() != b.weight_names()) ||
+      (a.tools().size() != b.tools().size()) ||
+      (a.attribute_names() != b.attribute_names())) {
+    return false;
+  }
+  for (size_t t = 0; t < a.tools().size(); ++t) {
+    if ((a.tools()[t].name != b.tools()[t].name) ||
+        (a.tools()[t].version != b.tools()[t].version) ||
+        (a.tools()[t].description != b.tools()[t].description)) {
+      return false;
+    }
+  }
+  for (auto const &name : a.attribute_names()) {
+    if (a.attribute_as_string(name) != b.attribute_as_string(name)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads every event with read, which returns false at the end of the file,
+// repeats times, and prints the rate
+void Time(std::string const &name, size_t repeats, size_t nbytes,
+          std::function<size_t()> const &read) {
+  auto start = std::chrono::steady_clock::now();
+  size_t nevents = 0;
+  for (size_t r = 0; r < repeats; ++r) {
+    nevents += read();
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           start)
+                 .count();
+  std::printf("%-32s %10.0f events/s %8.1f MB/s\n", name.c_str(),
+              nevents / s, (repeats * nbytes) / (s * 1E6));
+}
+
+int main(int argc, char const *argv[]) {
+  if (argc < 2) {
+    std::cout << "[ERROR]: Expected asciiReaderBench <file.hepmc3> [repeats]"
+              << std::endl;
+    return 1;
+  }
+  std::string const path = argv[1];
+  size_t const repeats = (argc > 2) ? std::stoul(argv[2]) : 10;
+  size_t const nbytes = std::filesystem::file_size(path);
+
+  {
+    auto ref = HepMC3::deduce_reader(path);
+    AsciiReader rdr(path);
+    HepMC3::GenEvent ev_ref, ev;
+    HepMC3::GenEventData d_ref, d;
+    size_t nevents = 0;
+    while (ref->read_event(ev_ref) && !ref->failed()) {
+      if (!rdr.read_event(ev)) {
+        std::cout << "[ERROR]: AsciiReader ended after " << nevents
+                  << " events." << std::endl;
+        return 1;
+      }
+      ev_ref.write_data(d_ref);
+      ev.write_data(d);
+      if (!SameData(d_ref, d)) {
+        std::cout << "[ERROR]: AsciiReader read event " << nevents
+                  << " differently to HepMC3::ReaderAscii." << std::endl;
+        return 1;
+      }
+      nevents++;
+    }
+    if (rdr.read_event(ev)) {
+      std::cout << "[ERROR]: AsciiReader read more than " << nevents
+                << " events." << std::endl;
+      return 1;
+    }
+    if (!SameRunInfo(*ref->run_info(), *rdr.run_info())) {
+      std::cout << "[ERROR]: AsciiReader read the run info differently to "
+                   "HepMC3::ReaderAscii."
+                << std::endl;
+      return 1;
+    }
+    std::cout << path << ": " << nevents << " events, " << nbytes
+              << " bytes, read identically." << std::endl;
+  }
+
+  Time("HepMC3::deduce_reader", repeats, nbytes, [&]() {
+    auto rdr = HepMC3::deduce_reader(path);
+    HepMC3::GenEvent ev;
+    size_t n = 0;
+    while (rdr->read_event(ev) && !rdr->failed()) {
+      n++;
+    }
+    return n;
+  });
+  auto time_ascii = [&](std::string const &name, AsciiReaderOptions opts) {
+    Time(name, repeats, nbytes, [&]() {
+      AsciiReader rdr(path, opts);
+      HepMC3::GenEvent ev;
+      size_t n = 0;
+      while (rdr.read_event(ev)) {
+        n++;
+      }
+      return n;
+    });
+  };
+  time_ascii("ps::AsciiReader", AsciiReaderOptions());
+  time_ascii("ps::AsciiReader, skipping", AsciiReaderOptions{true, true});
+  Time("ps::AsciiReader::read_data", repeats, nbytes, [&]() {
+    AsciiReader rdr(path);
+    HepMC3::GenEventData d;
+    size_t n = 0;
+    while (rdr.read_data(d)) {
+      n++;
+    }
+    return n;
+  });
+}
@@ -0,0 +1,232 @@
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/Data/GenEventData.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/ReaderAscii.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace ps;
+
+std::string WriteAsciiEvents(TestDir const &dir, std::string const &name,
+                             size_t nevents) {
+  std::string const path = (dir / name);
+
+  TestEvents spec;
+  spec.beam_GeV = [](size_t i) { return 1 + 0.01 * i; };
+  spec.out = [](size_t i) {
+    return std::vector<std::string>{"13 1 " + std::to_string(0.5 + 0.01 * i),
+                                    "2212 1 " +
+                                        std::to_string(0.1 * (i % 7))};
+  };
+  spec.first = 0;
+  spec.weights = [](size_t i) {
+    return std::vector<double>{0.1 * ((i % 13) + 1), 2};
+  };
+  spec.run = std::make_shared<HepMC3::GenRunInfo>();
+  spec.run->set_weight_names({"CV", "syst"});
+  spec.run->tools().push_back({"ProSelectaTests", "1", "ascii\nreader tests"});
+  spec.run->add_attribute(
+      "NEvents", std::make_shared<HepMC3::IntAttribute>(int(nevents)));
+  spec.finish = [](HepMC3::GenEvent &ev, size_t i) {
+    ev.add_attribute("ProcID", std::make_shared<HepMC3::IntAttribute>(
+                                   int(i % 5)));
+    ev.add_attribute("Comment", std::make_shared<HepMC3::StringAttribute>(
+                                    "event\n" + std::to_string(i)));
+    // the primary vertex is written explicitly when it has a position
+    if (i % 2) {
+      ev.vertices()[0]->set_position(HepMC3::FourVector(0, 0, 0.5 * i, 0));
+    }
+  };
+  WriteTestEvents(path, nevents, spec);
+  return path;
+}
+
+void RequireSameData(HepMC3::GenEventData const &da,
+                     HepMC3::GenEventData const &db) {
+  REQUIRE(da.event_number == db.event_number);
+  REQUIRE(da.momentum_unit == db.momentum_unit);
+  REQUIRE(da.length_unit == db.length_unit);
+  REQUIRE(da.particles.size() == db.particles.size());
+  for (size_t p = 0; p < da.particles.size(); ++p) {
+    REQUIRE(da.particles[p].pid == db.particles[p].pid);
+    REQUIRE(da.particles[p].status == db.particles[p].status);
+    REQUIRE(da.particles[p].is_mass_set == db.particles[p].is_mass_set);
+    REQUIRE(da.particles[p].mass == db.particles[p].mass);
+    REQUIRE(da.particles[p].momentum == db.particles[p].momentum);
+  }
+  REQUIRE(da.vertices.size() == db.vertices.size());
+  for (size_t v = 0; v < da.vertices.size(); ++v) {
+    REQUIRE(da.vertices[v].status == db.vertices[v].status);
+    REQUIRE(da.vertices[v].position == db.vertices[v].position);
+  }
+  REQUIRE(da.event_pos == db.event_pos);
+  REQUIRE(da.links1 == db.links1);
+  REQUIRE(da.links2 == db.links2);
+  REQUIRE(da.weights == db.weights);
+  REQUIRE(da.attribute_id == db.attribute_id);
+  REQUIRE(da.attribute_name == db.attribute_name);
+  REQUIRE(da.attribute_string == db.attribute_string);
+}
+
+void RequireSameRunInfo(HepMC3::GenRunInfo const &a,
+                        HepMC3::GenRunInfo const &b) {
+  REQUIRE(a.weight_names() == b.weight_names());
+  REQUIRE(a.tools().size() == b.tools().size());
+  for (size_t t = 0; t < a.tools().size(); ++t) {
+    REQUIRE(a.tools()[t].name == b.tools()[t].name);
+    REQUIRE(a.tools()[t].version == b.tools()[t].version);
+    REQUIRE(a.tools()[t].description == b.tools()[t].description);
+  }
+  REQUIRE(a.attribute_names() == b.attribute_names());
+  for (auto const &name : a.attribute_names()) {
+    REQUIRE(a.attribute_as_string(name) == b.attribute_as_string(name));
+  }
+}
+
+void RequireSameEvent(HepMC3::GenEvent const &a, HepMC3::GenEvent const &b) {
+  HepMC3::GenEventData da, db;
+  a.write_data(da);
+  b.write_data(db);
+  RequireSameData(da, db);
+}
+
+TEST_CASE("AsciiReader::read_event", "[ps::AsciiReader]") {
+  TestDir dir("ascii_events");
+  auto path = WriteAsciiEvents(dir, "events.hepmc3", 100);
+  REQUIRE(is_hepmc3_ascii(path));
+
+  HepMC3::ReaderAscii ref_rdr(path);
+  AsciiReader rdr(path);
+  HepMC3::GenEvent ev, ref;
+  for (size_t i = 0; i < 100; ++i) {
+    REQUIRE(ref_rdr.read_event(ref));
+    REQUIRE(rdr.read_event(ev));
+    RequireSameEvent(ev, ref);
+    REQUIRE(ev.weight("syst") == 2);
+    REQUIRE(ev.attribute<HepMC3::StringAttribute>("Comment")->value() ==
+            ("event\n" + std::to_string(i)));
+  }
+  REQUIRE(!rdr.read_event(ev));
+  REQUIRE(rdr.failed());
+
+  RequireSameRunInfo(*rdr.run_info(), *ref_rdr.run_info());
+  REQUIRE(rdr.run_info()->tools().size() == 1);
+  REQUIRE(rdr.run_info()->tools()[0].description == "ascii\nreader tests");
+  REQUIRE(rdr.run_info()->attribute_as_string("NEvents") == "100");
+}
+
+// The example file is written by a generator rather than by these tests, see
+// also asciiReaderBench
+TEST_CASE("AsciiReader reads the example file", "[ps::AsciiReader]") {
+  std::string const path = ProSelecta_EXAMPLE_HEPMC3;
+  REQUIRE(is_hepmc3_ascii(path));
+
+  HepMC3::ReaderAscii ref_rdr(path);
+  AsciiReader rdr(path);
+  HepMC3::GenEvent ev, ref;
+  size_t nevents = 0;
+  while (ref_rdr.read_event(ref) && !ref_rdr.failed()) {
+    REQUIRE(rdr.read_event(ev));
+    RequireSameEvent(ev, ref);
+    nevents++;
+  }
+  REQUIRE(nevents > 0);
+  REQUIRE(!rdr.read_event(ev));
+  RequireSameRunInfo(*rdr.run_info(), *ref_rdr.run_info());
+}
+
+TEST_CASE("AsciiReader::skip", "[ps::AsciiReader]") {
+  TestDir dir("ascii_skip");
+  auto path = WriteAsciiEvents(dir, "skip.hepmc3", 50);
+
+  AsciiReader rdr(path);
+  HepMC3::GenEventData data;
+  int next = 0;
+  for (int n : {3, 5, 0, 17, 1}) {
+    REQUIRE(rdr.skip(n));
+    next += n;
+    REQUIRE(rdr.read_data(data));
+    REQUIRE(data.event_number == next++);
+  }
+  REQUIRE(!rdr.skip(100));
+  REQUIRE(rdr.failed());
+}
+
+TEST_CASE("AsciiReaderOptions", "[ps::AsciiReader]") {
+  TestDir dir("ascii_options");
+  auto path = WriteAsciiEvents(dir, "options.hepmc3", 10);
+
+  AsciiReader full(path);
+  AsciiReader lean(path, AsciiReaderOptions{true, true});
+  HepMC3::GenEventData df, dl;
+  while (full.read_data(df)) {
+    REQUIRE(lean.read_data(dl));
+    REQUIRE(dl.event_number == df.event_number);
+    REQUIRE(dl.particles.size() == df.particles.size());
+    REQUIRE(dl.links1 == df.links1);
+    REQUIRE(dl.links2 == df.links2);
+    REQUIRE(dl.weights == df.weights);
+    for (auto const &v : dl.vertices) {
+      REQUIRE(v.position.z() == 0);
+    }
+    REQUIRE(dl.attribute_name.empty());
+    REQUIRE(!df.attribute_name.empty());
+  }
+  REQUIRE(!lean.read_data(dl));
+  // the run attributes are always read
+  REQUIRE(lean.run_info()->attribute_as_string("NEvents") == "10");
+}
+
+TEST_CASE("MultiFileReader reads with an AsciiReader", "[ps::AsciiReader]") {
+  TestDir dir("ascii_multi");
+  auto path = WriteAsciiEvents(dir, "multi.hepmc3", 30);
+
+  MultiFileReader ref({path, path});
+  MultiFileReader rdr({path, path}, 2, 64, AsciiReaderOptions());
+  for (size_t i = 0; i < 60; ++i) {
+    auto ref_evt = ref.next_event();
+    auto evt = rdr.next_event();
+    REQUIRE(ref_evt);
+    REQUIRE(evt);
+    RequireSameEvent(*evt, *ref_evt);
+  }
+  REQUIRE(!rdr.next_event());
+  REQUIRE(rdr.get_file_stats()[1].nevents == 30);
+}
+
+TEST_CASE("AsciiReader rejects malformed files", "[ps::AsciiReader]") {
+  TestDir dir("ascii_malformed");
+  std::string const header = "HepMC::Version 3.02.06\n"
+                             "HepMC::Asciiv3-START_EVENT_LISTING\n";
+  auto write = [&](std::string const &name, std::string const &content) {
+    std::string const path = (dir / name);
+    std::ofstream(path) << content;
+    return path;
+  };
+
+  auto not_hepmc = write("not_hepmc.txt", "E 0 1 1\n");
+  REQUIRE(!is_hepmc3_ascii(not_hepmc));
+  REQUIRE_THROWS_AS(AsciiReader(not_hepmc), std::runtime_error);
+
+  HepMC3::GenEventData data;
+  for (char const *event :
+       {"E 0 1\n", "E 0 1 1\nP 1 0 14 abc 0 1 1 0 4\n",
+        "E 0 1 2\nP 1 0 14 0 0 1 1 0 4\nP 3 1 13 0 0 1 1 0 1\n",
+        "E 0 1 1\nV -1 0 [1,\nP 1 0 14 0 0 1 1 0 4\n",
+        "E 0 1 1\nV -1 0 [2]\nP 1 0 14 0 0 1 1 0 4\n",
+        "E 0 1 1\nU GEV KM\n"}) {
+    AsciiReader rdr(write("malformed.hepmc3", header + event));
+    REQUIRE_THROWS_AS(rdr.read_data(data), std::runtime_error);
+  }
+}
@@ -0,0 +1,70 @@
+# Checks, with nm, that the environment template instantiations compiled into
+# LIBRARY are the ones that USER, built with ProSelecta_EXTERN_TEMPLATES, uses:
+# USER must not define any event or part function template itself, and must
+# reference every one that LIBRARY defines.
+#
+# cmake -DNM=<nm> -DLIBRARY=<libProSelectaInterpreter> -DUSER=<executable>
+#   -P CheckInstantiations.cmake
+
+foreach(var NM LIBRARY USER)
+  if(NOT DEFINED ${var})
+    message(FATAL_ERROR "CheckInstantiations.cmake requires -D${var}=...")
+  endif()
+endforeach()
+
+# mangled names of the function templates in ps::event and ps::part, and of
+# the ps::detail particle selection templates that they are built on
+string(CONCAT ENV_TEMPLATE_RE "_ZN2ps(5event|4part|6detail(9particles|"
+  "13has_particles|17nuclear_particles|19has_particles_exact|"
+  "21has_particles_atleast|3cat))[0-9]*[a-z_]*I[^ \n]*")
+set(PUBLIC_TEMPLATE_RE "_ZN2ps(5event|4part)[0-9]+[a-z_]+I[^ \n]*")
+
+function(nm_symbols out_var file)
+  execute_process(COMMAND ${NM} ${ARGN} ${file}
+    OUTPUT_VARIABLE syms
+    RESULT_VARIABLE rtn)
+  if(NOT rtn EQUAL 0)
+    message(FATAL_ERROR "Failed to list the symbols of ${file}")
+  endif()
+  set(${out_var} "${syms}" PARENT_SCOPE)
+endfunction()
+
+nm_symbols(library_syms ${LIBRARY} -D --defined-only)
+nm_symbols(user_defined_syms ${USER} --defined-only)
+nm_symbols(user_undefined_syms ${USER} --undefined-only)
+
+string(REGEX MATCHALL " [A-Za-z] ${ENV_TEMPLATE_RE}" compiled_again
+  "${user_defined_syms}")
+if(compiled_again)
+  list(LENGTH compiled_again ncompiled_again)
+  string(REPLACE ";" "\n" compiled_again "${compiled_again}")
+  message(FATAL_ERROR "${USER} compiled ${ncompiled_again} environment "
+    "template instantiations itself, rather than using those in "
+    "${LIBRARY}:\n${compiled_again}")
+endif()
+
+string(REGEX MATCHALL " [WT] ${PUBLIC_TEMPLATE_RE}" precompiled
+  "${library_syms}")
+if(NOT precompiled)
+  message(FATAL_ERROR "Found no environment template instantiations in "
+    "${LIBRARY}")
+endif()
+set(unused)
+foreach(sym IN LISTS precompiled)
+  string(REGEX REPLACE "^ [WT] " "" sym "${sym}")
+  string(FIND "${user_undefined_syms}" " ${sym}\n" pos)
+  if(pos EQUAL -1)
+    list(APPEND unused ${sym})
+  endif()
+endforeach()
+if(unused)
+  list(LENGTH unused nunused)
+  string(REPLACE ";" "\n" unused "${unused}")
+  message(FATAL_ERROR "${nunused} environment template instantiations in "
+    "${LIBRARY} are not used by ${USER}, remove them from "
+    "ProSelecta/detail/instantiations.h if nothing needs them:\n${unused}")
+endif()
+
+list(LENGTH precompiled nprecompiled)
+message(STATUS "${USER} uses all ${nprecompiled} environment template "
+  "instantiations in ${LIBRARY}")
@@ -0,0 +1,200 @@
+#include "ProSelecta/Checkpoint.h"
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/OutputSink.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace ps;
+
+// Writes nfiles files with a different number of weighted events each
+std::vector<std::string> BuildWeightedFiles(std::filesystem::path const &dir,
+                                            size_t nfiles) {
+  TestEvents spec;
+  spec.beam_GeV = [](size_t i) { return 1 + 0.01 * ((i * 7) % 100); };
+  spec.out = [](size_t) { return std::vector<std::string>{}; };
+  spec.weights = [](size_t i) {
+    return std::vector<double>{0.1 * ((i % 13) + 1)};
+  };
+  std::vector<std::string> paths;
+  for (size_t f = 0; f < nfiles; ++f) {
+    paths.push_back((dir / ("events." + std::to_string(f) + ".hepmc3")));
+    WriteTestEvents(paths.back(), 70 + (f * 37) % 100, spec);
+  }
+  return paths;
+}
+
+std::string ReadFile(std::string const &path) {
+  std::ifstream ifs(path);
+  std::stringstream ss("");
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+TEST_CASE("MultiFileReader::seek", "[ps::Checkpoint]") {
+  TestDir dir("ckpt_seek");
+  auto paths = BuildWeightedFiles(dir.path(), 4);
+
+  MultiFileReader all(paths, 2, 1);
+  std::vector<double> energies;
+  while (auto evt = next_event(all)) {
+    energies.push_back(event::beam_part(*evt, pdg::kNuMu)->momentum().e());
+  }
+
+  // including the very start and end of a file
+  for (size_t nread : {0, 1, 69, 70, 71, 200}) {
+    MultiFileReader first(paths, 2, 1);
+    for (size_t i = 0; i < nread; ++i) {
+      REQUIRE(next_event(first));
+    }
+
+    MultiFileReader rest(paths, 2, 1);
+    rest.seek(first.position(), first.get_file_stats());
+    for (size_t i = nread; i < energies.size(); ++i) {
+      auto evt = next_event(rest);
+      REQUIRE(evt);
+      REQUIRE(event::beam_part(*evt, pdg::kNuMu)->momentum().e() ==
+              energies[i]);
+    }
+    REQUIRE(!next_event(rest));
+
+    // the weight sums carry on exactly as if the file had been read in one go
+    for (size_t f = 0; f < paths.size(); ++f) {
+      REQUIRE(rest.get_file_stats()[f].nevents ==
+              all.get_file_stats()[f].nevents);
+      REQUIRE(rest.get_file_stats()[f].sumw == all.get_file_stats()[f].sumw);
+      REQUIRE(rest.get_file_stats()[f].sumw2 ==
+              all.get_file_stats()[f].sumw2);
+    }
+  }
+}
+
+TEST_CASE("Checkpoint::resume", "[ps::Checkpoint]") {
+  TestDir dir("ckpt_resume");
+  auto paths = BuildWeightedFiles(dir.path(), 3);
+  std::string const ckpt_path = (dir / "run.ckpt");
+
+  auto energy = [](HepMC3::GenEvent const &ev) {
+    return event::beam_part(ev, pdg::kNuMu)->momentum().e();
+  };
+  EventHooks hooks{[=](HepMC3::GenEvent const &ev) {
+                     return energy(ev) > 1.3 * unit::GeV;
+                   },
+                   {energy},
+                   {[](HepMC3::GenEvent const &ev) {
+                     return ev.weights().front();
+                   }},
+                   {}};
+  OutputColumns const cols{{"energy"}, {"weight"}, {}};
+  HistogramSet hists({HistogramSpec{"energy",
+                                    {HistogramAxis::uniform(10, 1, 2)},
+                                    {energy},
+                                    {hooks.weights.front()},
+                                    {}}});
+
+  // processes events from e_it to the end of segment, as ProSelectaCPP does
+  // between checkpoints
+  auto run = [&](MultiFileReader &rdr, OutputSink &sink,
+                 HistogramAccumulator &acc, size_t &nselected,
+                 EventRange const &segment, size_t &e_it) {
+    EventLoop loop(hooks, 3, 16, 2);
+    loop.fill_histograms(hists);
+    loop.run(
+        rdr,
+        [&](EventBatch const &batch) {
+          for (auto const &res : batch.results) {
+            nselected += res.pass;
+          }
+          sink.write(batch.results);
+          acc.add(batch.fills);
+        },
+        segment, &e_it);
+  };
+
+  std::string const ref_path = (dir / "ref.csv");
+  MultiFileReader ref_rdr(paths);
+  AsyncSink ref_sink(std::make_unique<CSVSink>(ref_path), 50);
+  HistogramAccumulator ref_acc(hists.histograms, 64);
+  size_t ref_selected = 0;
+  size_t ref_evtnum = 0;
+  ref_sink.open(cols);
+  run(ref_rdr, ref_sink, ref_acc, ref_selected, EventRange(), ref_evtnum);
+  ref_sink.close();
+  auto ref_hists = ref_acc.finish();
+
+  std::string const out_path = (dir / "out.csv");
+  {
+    MultiFileReader rdr(paths);
+    AsyncSink sink(std::make_unique<CSVSink>(out_path), 50);
+    HistogramAccumulator acc(hists.histograms, 64);
+    size_t nselected = 0;
+    size_t e_it = 0;
+    sink.open(cols);
+    EventRange segment;
+    segment.max_events = 160;
+    run(rdr, sink, acc, nselected, segment, e_it);
+    REQUIRE(e_it == 160);
+
+    Checkpoint ckpt;
+    ckpt.next_evtnum = e_it;
+    ckpt.input = rdr.position();
+    ckpt.summary.inputs = rdr.get_file_stats();
+    ckpt.summary.events_selected = nselected;
+    ckpt.select = "energy_above_1_3";
+    ckpt.output_path = out_path;
+    ckpt.columns = cols;
+    ckpt.output_size = sink.checkpoint();
+    ckpt.histograms = acc.get_state();
+    ckpt.write(ckpt_path);
+    REQUIRE(!std::filesystem::exists(ckpt_path + ".tmp"));
+
+    // killed part way through the next segment, after writing more rows
+    segment.max_events = 240;
+    run(rdr, sink, acc, nselected, segment, e_it);
+    sink.checkpoint();
+  }
+
+  auto ckpt = Checkpoint::read(ckpt_path);
+  REQUIRE(ckpt.next_evtnum == 160);
+  REQUIRE(ckpt.select == "energy_above_1_3");
+  REQUIRE(ckpt.output_path == out_path);
+  REQUIRE(ckpt.columns.weights == cols.weights);
+  REQUIRE(ckpt.histograms);
+  REQUIRE(std::filesystem::file_size(out_path) > ckpt.output_size);
+
+  MultiFileReader rdr(paths);
+  AsyncSink sink(std::make_unique<CSVSink>(out_path), 50);
+  HistogramAccumulator acc(hists.histograms, 64);
+  size_t nselected = ckpt.summary.events_selected;
+  size_t e_it = ckpt.next_evtnum;
+  rdr.seek(ckpt.input, ckpt.summary.inputs);
+  sink.resume(ckpt.columns, ckpt.output_size);
+  acc.restore(*ckpt.histograms);
+  run(rdr, sink, acc, nselected, EventRange(), e_it);
+  sink.close();
+  auto const &out_hists = acc.finish();
+
+  REQUIRE(e_it == ref_evtnum);
+  REQUIRE(nselected == ref_selected);
+  REQUIRE(ReadFile(out_path) == ReadFile(ref_path));
+  REQUIRE(out_hists.front().entries == ref_hists.front().entries);
+  REQUIRE(out_hists.front().sumw == ref_hists.front().sumw);
+  REQUIRE(out_hists.front().sumw2 == ref_hists.front().sumw2);
+  for (size_t f = 0; f < paths.size(); ++f) {
+    REQUIRE(rdr.get_file_stats()[f].sumw == ref_rdr.get_file_stats()[f].sumw);
+  }
+
+  // output that is shorter than at the checkpoint cannot be resumed
+  std::filesystem::resize_file(out_path, ckpt.output_size - 1);
+  CSVSink short_sink(out_path);
+  REQUIRE_THROWS_AS(short_sink.resume(cols, ckpt.output_size),
+                    std::runtime_error);
+}
@@ -1,4 +1,5 @@
 #include "ProSelecta/ProSelecta.h"
+#include "ProSelecta/ProSelecta_cling.h"
 
 #include "test_event_builder.h"
 
@@ -171,3 +172,98 @@ TEST_CASE("LoadText::include_ext", "[ps::ProSelecta]") {
 #include "ProSelecta/ext/nu/event_proj.h"
 )"));
 }
+
+TEST_CASE("ReloadFile::handle_follows_snippet", "[ps::ProSelecta]") {
+
+  std::ofstream out("envTests.out10.cpp");
+  out << "int no_op10(HepMC3::GenEvent const &){ return 1; };";
+  out.close();
+
+  HepMC3::GenEvent evt;
+
+  REQUIRE(ps::ProSelecta::Get().load_file("envTests.out10.cpp"));
+  auto func1 = ps::ProSelecta::Get().get_select_func("no_op10");
+
+  REQUIRE(func1(evt) == 1);
+
+  std::ofstream out2("envTests.out10.cpp");
+  out2 << "int no_op10(HepMC3::GenEvent const &){ return 2; };";
+  out2.close();
+
+  REQUIRE(ps::ProSelecta::Get().reload_file("envTests.out10.cpp"));
+
+  REQUIRE(func1(evt) == 2);
+}
+
+TEST_CASE("UnloadFile::handle_invalidated", "[ps::ProSelecta]") {
+
+  std::ofstream out("envTests.out11.cpp");
+  out << "int no_op11(HepMC3::GenEvent const &){ return 1; };";
+  out.close();
+
+  HepMC3::GenEvent evt;
+
+  REQUIRE(ps::ProSelecta::Get().load_file("envTests.out11.cpp"));
+  auto func1 = ps::ProSelecta::Get().get_select_func("no_op11");
+
+  REQUIRE(func1(evt) == 1);
+
+  REQUIRE(ps::ProSelecta::Get().unload_file("envTests.out11.cpp"));
+  REQUIRE_FALSE(ps::ProSelecta::Get().unload_file("envTests.out11.cpp"));
+
+  REQUIRE_THROWS_AS(func1(evt), std::runtime_error);
+
+  REQUIRE(ps::ProSelecta::Get().load_file("envTests.out11.cpp"));
+  REQUIRE(func1(evt) == 1);
+}
+
+TEST_CASE("GetFunc::undefined_is_empty", "[ps::ProSelecta]") {
+  REQUIRE_FALSE(ps::ProSelecta::Get().get_select_func("no_op_undefined"));
+  REQUIRE_FALSE(ps::ProSelecta::Get().get_projection_func("no_op_undefined"));
+  REQUIRE_FALSE(ps::ProSelecta::Get().get_weight_func("no_op_undefined"));
+}
+
+TEST_CASE("SnippetDirectory::lazy_load", "[ps::ProSelecta]") {
+
+  std::filesystem::create_directories("envTests.snippets12");
+  std::ofstream out("envTests.snippets12/used.cxx");
+  out << "double no_op12(HepMC3::GenEvent const &){ return 12; };";
+  out.close();
+  std::ofstream out2("envTests.snippets12/unused.cxx");
+  out2 << "double no_op12_unused(HepMC3::GenEvent const &){ return 13; };";
+  out2.close();
+
+  HepMC3::GenEvent evt;
+
+  ps::ProSelecta::Get().add_snippet_directory("envTests.snippets12");
+
+  REQUIRE(std::filesystem::exists("envTests.snippets12/.ProSelecta.symbols"));
+  REQUIRE_FALSE(
+      ps::cling::func_is_defined("no_op12", "HepMC3::GenEvent const &"));
+
+  auto func1 = ps::ProSelecta::Get().get_projection_func("no_op12");
+
+  REQUIRE(func1(evt) == 12);
+  REQUIRE_FALSE(ps::cling::func_is_defined("no_op12_unused",
+                                           "HepMC3::GenEvent const &"));
+}
+
+TEST_CASE("LoadText::precompiled_instantiations", "[ps::ProSelecta]") {
+
+  auto evt = BuildEvent({{"14 4 3 0", "1000060120 20 0"},
+                         {"2212 1 0.15", "13 1 0.7", "13 1 1.2", "-13 1 1.3"}});
+
+  REQUIRE(ps::ProSelecta::Get().load_text(R"(
+double no_op13(HepMC3::GenEvent const &ev){
+  auto nparts = ps::event::num_out_part(ev, ps::pids(13, -13));
+  auto hm_mu = ps::part::highest(ps::p3mod, ps::event::all_out_part(ev, 13));
+  return (nparts[0] * 10) + nparts[1] + hm_mu->momentum().p3mod();
+})"));
+
+  auto func1 = ps::ProSelecta::Get().get_projection_func("no_op13");
+
+  REQUIRE(func1(evt) ==
+          (21 + ps::part::highest(ps::p3mod, ps::event::all_out_part(evt, 13))
+                    ->momentum()
+                    .p3mod()));
+}
@@ -0,0 +1,205 @@
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/Data/GenEventData.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <filesystem>
+
+using namespace ps;
+
+std::vector<HepMC3::GenEvent> BuildCacheEvents(size_t nevents) {
+  TestEvents spec;
+  spec.beam_GeV = [](size_t i) { return 1 + 0.01 * i; };
+  spec.out = [](size_t i) {
+    return std::vector<std::string>{"13 1 " + std::to_string(0.5 + 0.01 * i),
+                                    "2212 1 " +
+                                        std::to_string(0.1 * (i % 7))};
+  };
+  spec.first = 0;
+  spec.weights = [](size_t i) {
+    return std::vector<double>{0.1 * ((i % 13) + 1), 2};
+  };
+  spec.run = std::make_shared<HepMC3::GenRunInfo>();
+  spec.run->set_weight_names({"CV", "syst"});
+  spec.run->tools().push_back({"ProSelectaTests", "1", "event cache tests"});
+  return BuildTestEvents(nevents, spec);
+}
+
+void RequireSameEvent(HepMC3::GenEvent const &a, HepMC3::GenEvent const &b) {
+  HepMC3::GenEventData da, db;
+  a.write_data(da);
+  b.write_data(db);
+  REQUIRE(da.event_number == db.event_number);
+  REQUIRE(da.particles.size() == db.particles.size());
+  for (size_t p = 0; p < da.particles.size(); ++p) {
+    REQUIRE(da.particles[p].pid == db.particles[p].pid);
+    REQUIRE(da.particles[p].status == db.particles[p].status);
+    REQUIRE(da.particles[p].momentum.e() == db.particles[p].momentum.e());
+    REQUIRE(da.particles[p].momentum.pz() == db.particles[p].momentum.pz());
+  }
+  REQUIRE(da.vertices.size() == db.vertices.size());
+  REQUIRE(da.links1 == db.links1);
+  REQUIRE(da.links2 == db.links2);
+  REQUIRE(da.weights == db.weights);
+  REQUIRE(da.attribute_string == db.attribute_string);
+}
+
+TEST_CASE("EventCacheReader::read_event", "[ps::EventCache]") {
+  TestDir dir("cache_read_event");
+  auto evts = BuildCacheEvents(100);
+
+  std::vector<EventCache::Codec> codecs{EventCache::kNone};
+  if (EventCache::has_zlib()) {
+    codecs.push_back(EventCache::kZlib);
+  }
+  for (auto codec : codecs) {
+    std::string const path = (dir / "events.pscache");
+    EventCacheWriter wrtr(path, 16, codec);
+    for (auto const &ev : evts) {
+      wrtr.write_event(ev);
+    }
+    wrtr.close();
+    REQUIRE(is_event_cache(path));
+
+    EventCacheReader rdr(path);
+    REQUIRE(rdr.size() == evts.size());
+    REQUIRE(rdr.run_info()->weight_names() ==
+            evts.front().run_info()->weight_names());
+    REQUIRE(rdr.run_info()->tools().size() == 1);
+
+    HepMC3::GenEvent ev;
+    for (auto const &ref : evts) {
+      REQUIRE(rdr.read_event(ev));
+      RequireSameEvent(ev, ref);
+      REQUIRE(ev.weight("syst") == 2);
+    }
+    REQUIRE(!rdr.read_event(ev));
+    REQUIRE(rdr.failed());
+  }
+}
+
+TEST_CASE("EventCacheReader::skip", "[ps::EventCache]") {
+  TestDir dir("cache_skip");
+  auto evts = BuildCacheEvents(50);
+  std::string const path = (dir / "skip.pscache");
+  EventCacheWriter wrtr(path, 8);
+  for (auto const &ev : evts) {
+    wrtr.write_event(ev);
+  }
+  wrtr.close();
+
+  // across block boundaries and within a block
+  EventCacheReader rdr(path);
+  HepMC3::GenEvent ev;
+  size_t next = 0;
+  for (int n : {3, 5, 0, 17, 1}) {
+    REQUIRE(rdr.skip(n));
+    next += n;
+    REQUIRE(rdr.read_event(ev));
+    RequireSameEvent(ev, evts[next++]);
+  }
+
+  CachedEvent view;
+  REQUIRE(rdr.read_view(view));
+  HepMC3::GenEventData ref;
+  evts[next].write_data(ref);
+  REQUIRE(view.event_number == int(next));
+  REQUIRE(view.nparticles == ref.particles.size());
+  for (size_t p = 0; p < view.nparticles; ++p) {
+    REQUIRE(view.pid[p] == ref.particles[p].pid);
+    REQUIRE(view.pz[p] == ref.particles[p].momentum.pz());
+  }
+  REQUIRE(view.nweights == 2);
+  REQUIRE(view.weights[0] == evts[next].weights()[0]);
+
+  REQUIRE(!rdr.skip(100));
+  REQUIRE(rdr.failed());
+}
+
+TEST_CASE("EventCacheReader::seek", "[ps::EventCache]") {
+  TestDir dir("cache_seek");
+  auto evts = BuildCacheEvents(50);
+  std::string const path = (dir / "seek.pscache");
+  EventCacheWriter wrtr(path, 8);
+  for (auto const &ev : evts) {
+    wrtr.write_event(ev);
+  }
+  wrtr.close();
+
+  // forwards and backwards, across and within blocks
+  EventCacheReader rdr(path);
+  HepMC3::GenEvent ev;
+  for (size_t event : {30, 2, 49, 0, 17, 16}) {
+    REQUIRE(rdr.seek(event));
+    REQUIRE(rdr.read_event(ev));
+    RequireSameEvent(ev, evts[event]);
+  }
+  REQUIRE(rdr.read_event(ev));
+  RequireSameEvent(ev, evts[17]);
+
+  // reading past the end does not stop a later seek
+  REQUIRE(rdr.seek(49));
+  REQUIRE(rdr.read_event(ev));
+  REQUIRE(!rdr.read_event(ev));
+  REQUIRE(rdr.failed());
+  REQUIRE(!rdr.seek(50));
+  REQUIRE(rdr.seek(8));
+  REQUIRE(!rdr.failed());
+  REQUIRE(rdr.read_event(ev));
+  RequireSameEvent(ev, evts[8]);
+}
+
+TEST_CASE("MultiFileReader reads event caches", "[ps::EventCache]") {
+  TestDir dir("cache_multi");
+  auto evts = BuildCacheEvents(150);
+  std::string const path = (dir / "multi.pscache");
+  {
+    EventCacheWriter wrtr(path, 64);
+    for (auto const &ev : evts) {
+      wrtr.write_event(ev);
+    }
+  }
+
+  MultiFileReader rdr({path, path});
+  for (size_t i = 0; i < 2 * evts.size(); ++i) {
+    auto evt = rdr.next_event();
+    REQUIRE(evt);
+    RequireSameEvent(*evt, evts[i % evts.size()]);
+  }
+  REQUIRE(!rdr.next_event());
+  REQUIRE(rdr.get_file_stats()[1].nevents == evts.size());
+
+  // skips past the decoded events seek within, and across, the caches
+  MultiFileReader skipper({path, path, path}, 2, 64);
+  REQUIRE(skipper.skip(100));
+  auto evt = skipper.next_event();
+  REQUIRE(evt);
+  RequireSameEvent(*evt, evts[100]);
+  REQUIRE(skipper.skip(180));
+  evt = skipper.next_event();
+  REQUIRE(evt);
+  RequireSameEvent(*evt, evts[131]);
+  REQUIRE(skipper.position().file == 1);
+  REQUIRE(!skipper.skip(200));
+}
+
+TEST_CASE("EventCacheReader rejects incomplete caches", "[ps::EventCache]") {
+  TestDir dir("cache_incomplete");
+  auto evts = BuildCacheEvents(10);
+  std::string const path = (dir / "incomplete.pscache");
+  {
+    EventCacheWriter wrtr(path, 4);
+    for (auto const &ev : evts) {
+      wrtr.write_event(ev);
+    }
+  }
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  REQUIRE_THROWS_AS(EventCacheReader(path), std::runtime_error);
+}
@@ -0,0 +1,167 @@
+#include "ProSelecta/AsciiReader.h"
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/Data/GenEventData.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+
+using namespace ps;
+
+std::string WriteIndexedEvents(TestDir const &dir, std::string const &name,
+                               size_t nevents, int first) {
+  std::string const path = (dir / name);
+  std::filesystem::remove(event_index_path(path));
+
+  TestEvents spec;
+  spec.beam_GeV = [](size_t i) { return 1 + 0.01 * i; };
+  spec.first = first;
+  spec.weights = [](size_t i) {
+    return std::vector<double>{0.5 * ((i % 3) + 1)};
+  };
+  WriteTestEvents(path, nevents, spec);
+  return path;
+}
+
+TEST_CASE("build_event_index", "[ps::EventIndex]") {
+  TestDir dir("index_build");
+  auto path = WriteIndexedEvents(dir, "events.hepmc3", 100, 0);
+  auto index = build_event_index(path);
+  REQUIRE(index.nevents() == 100);
+  REQUIRE(index.file_size == std::filesystem::file_size(path));
+  REQUIRE(index.run_info_offset > 0);
+  // 33 events of each weight, and one more of the first
+  REQUIRE(index.sumw == (0.5 * 34 + 1 * 33 + 1.5 * 33));
+  REQUIRE(index.stats().nevents == 100);
+
+  // every offset is the start of its event
+  AsciiReader rdr(path);
+  HepMC3::GenEventData data;
+  for (size_t i : {0, 1, 57, 99, 3}) {
+    REQUIRE(rdr.seek(index.offsets[i]));
+    REQUIRE(rdr.read_data(data));
+    REQUIRE(data.event_number == int(i));
+  }
+  REQUIRE(!rdr.seek(index.offsets[3] + 1));
+  REQUIRE(!rdr.seek(index.file_size));
+
+  // the parts cover every event once
+  size_t next = 0;
+  for (size_t k = 0; k < 7; ++k) {
+    auto [first, last] = index.part(k, 7);
+    REQUIRE(first == next);
+    REQUIRE(((last - first) == 14) || ((last - first) == 15));
+    next = last;
+  }
+  REQUIRE(next == 100);
+  REQUIRE_THROWS_AS(index.part(7, 7), std::runtime_error);
+}
+
+TEST_CASE("open_event_index", "[ps::EventIndex]") {
+  TestDir dir("index_open");
+  auto path = WriteIndexedEvents(dir, "sidecar.hepmc3", 20, 0);
+  REQUIRE(!load_event_index(path));
+
+  auto built = open_event_index(path);
+  REQUIRE(std::filesystem::exists(event_index_path(path)));
+  auto loaded = load_event_index(path);
+  REQUIRE(loaded);
+  REQUIRE(loaded->offsets == built.offsets);
+  REQUIRE(loaded->sumw == built.sumw);
+  REQUIRE(loaded->sumw2 == built.sumw2);
+  REQUIRE(loaded->run_info_offset == built.run_info_offset);
+
+  // a rewritten file is indexed again
+  WriteIndexedEvents(dir, "sidecar.hepmc3", 30, 0);
+  std::filesystem::last_write_time(
+      path, std::filesystem::last_write_time(path) + std::chrono::seconds(1));
+  REQUIRE(!load_event_index(path));
+  REQUIRE(open_event_index(path).nevents() == 30);
+
+  // as is a truncated index
+  std::filesystem::resize_file(event_index_path(path), 70);
+  REQUIRE(!load_event_index(path));
+}
+
+TEST_CASE("MultiFileReader skips with indices", "[ps::EventIndex]") {
+  TestDir dir("index_multi");
+  std::vector<std::string> files;
+  for (int f = 0; f < 3; ++f) {
+    files.push_back(WriteIndexedEvents(
+        dir, "multi" + std::to_string(f) + ".hepmc3", 500, 1000 * f));
+  }
+
+  for (bool fast : {false, true}) {
+    std::optional<AsciiReaderOptions> opts;
+    if (fast) {
+      opts = AsciiReaderOptions();
+    }
+    MultiFileReader rdr(files, 2, 64, opts, true);
+    // within a file, into the next, and across the rest of one into the last
+    for (auto [skip, evtnum] : std::vector<std::pair<int, int>>{
+             {3, 3}, {200, 204}, {295, 1000}, {0, 1001}, {997, 2499}}) {
+      REQUIRE(rdr.skip(skip));
+      auto evt = rdr.next_event();
+      REQUIRE(evt);
+      REQUIRE(evt->event_number() == evtnum);
+    }
+    REQUIRE(!rdr.next_event());
+    REQUIRE(std::filesystem::exists(event_index_path(files[2])));
+
+    // skipped events are not counted
+    REQUIRE(rdr.get_file_stats()[0].nevents == 2);
+    REQUIRE(rdr.get_file_stats()[1].nevents == 2);
+    REQUIRE(rdr.get_file_stats()[2].nevents == 1);
+
+    MultiFileReader past(files, 2, 64, opts, true);
+    REQUIRE(!past.skip(2000));
+    REQUIRE(past.failed());
+  }
+
+  // seek starts part way through a file at its indexed offset
+  MultiFileReader rdr(files, 2, 64, std::nullopt, true);
+  rdr.seek({1, 250}, rdr.get_file_stats());
+  auto evt = rdr.next_event();
+  REQUIRE(evt);
+  REQUIRE(evt->event_number() == 1250);
+}
+
+TEST_CASE("MultiFileReader indexes files as it reads them",
+          "[ps::EventIndex]") {
+  TestDir dir("index_while_reading");
+  auto path = WriteIndexedEvents(dir, "read.hepmc3", 500, 0);
+
+  // a file that is not read to the end is not indexed, nor is one read from
+  // its start indexed up front
+  {
+    MultiFileReader rdr({path}, 1, 64, std::nullopt, true);
+    REQUIRE(rdr.next_event());
+  }
+  REQUIRE(!std::filesystem::exists(event_index_path(path)));
+
+  {
+    MultiFileReader rdr({path}, 1, 64, std::nullopt, true);
+    size_t nevents = 0;
+    while (rdr.next_event()) {
+      nevents++;
+    }
+    REQUIRE(nevents == 500);
+  }
+  auto loaded = load_event_index(path);
+  REQUIRE(loaded);
+  auto built = build_event_index(path);
+  REQUIRE(loaded->offsets == built.offsets);
+  REQUIRE(loaded->sumw == built.sumw);
+  REQUIRE(loaded->sumw2 == built.sumw2);
+  REQUIRE(loaded->run_info_offset == built.run_info_offset);
+  REQUIRE(loaded->run_info_size == built.run_info_size);
+}
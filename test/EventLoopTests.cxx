@@ -0,0 +1,289 @@
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+
+#include "HepMC3/ReaderAscii.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace ps;
+
+EventHooks TestHooks() {
+  return EventHooks{
+      [](HepMC3::GenEvent const &ev) {
+        return event::beam_part(ev, pdg::kNuMu)->momentum().e() >
+               1.5 * unit::GeV;
+      },
+      {[](HepMC3::GenEvent const &ev) {
+         return event::beam_part(ev, pdg::kNuMu)->momentum().e();
+       },
+       [](HepMC3::GenEvent const &ev) {
+         return event::hm_out_part(ev, pdg::kMuon)->momentum().e();
+       }},
+      {[](HepMC3::GenEvent const &) { return 2.0; }},
+      {}};
+}
+
+TEST_CASE("EventLoop::ordered", "[ps::EventLoop]") {
+  size_t const nevents = 1000;
+  std::string const evstr = TestEventStream(nevents, MuonProtonEvents());
+  auto hooks = TestHooks();
+
+  std::vector<EventResult> serial;
+  {
+    std::stringstream ss(evstr);
+    HepMC3::ReaderAscii rdr(ss);
+    HepMC3::GenEvent evt;
+    for (size_t e_it = 0; rdr.read_event(evt) && !rdr.failed(); ++e_it) {
+      serial.push_back(evaluate_event(hooks, e_it, evt));
+    }
+  }
+  REQUIRE(serial.size() == nevents);
+
+  for (size_t nthreads : {1, 2, 7}) {
+    for (size_t batch_size : {1, 13, 256}) {
+      std::stringstream ss(evstr);
+      HepMC3::ReaderAscii rdr(ss);
+
+      std::vector<EventResult> threaded;
+      size_t next_batch = 0;
+      EventLoop loop(hooks, nthreads, batch_size, 2);
+      size_t nread = loop.run(rdr, [&](EventBatch const &batch) {
+        REQUIRE(batch.index == next_batch++);
+        threaded.insert(threaded.end(), batch.results.begin(),
+                        batch.results.end());
+      });
+
+      REQUIRE(nread == nevents);
+      REQUIRE(threaded.size() == nevents);
+      for (size_t i = 0; i < nevents; ++i) {
+        REQUIRE(threaded[i].evtnum == i);
+        REQUIRE(threaded[i].pass == serial[i].pass);
+        REQUIRE(threaded[i].values == serial[i].values);
+      }
+    }
+  }
+}
+
+TEST_CASE("EventLoop::rethrows", "[ps::EventLoop]") {
+  std::string const evstr = TestEventStream(500, MuonProtonEvents());
+
+  std::stringstream ss(evstr);
+  HepMC3::ReaderAscii rdr(ss);
+  auto hooks = TestHooks();
+  hooks.projections.push_back([](HepMC3::GenEvent const &ev) {
+    return event::hm_out_part(ev, pdg::kElectron)->momentum().e();
+  });
+
+  EventLoop loop(hooks, 4, 16, 1);
+  REQUIRE_THROWS_AS(loop.run(rdr, [](EventBatch const &) {}),
+                    part::EmptyParticleList);
+
+  std::stringstream ss2(evstr);
+  HepMC3::ReaderAscii rdr2(ss2);
+  EventLoop loop2(TestHooks(), 4, 16, 1);
+  REQUIRE_THROWS_AS(loop2.run(rdr2,
+                              [](EventBatch const &batch) {
+                                if (batch.index == 3) {
+                                  throw std::runtime_error("stop");
+                                }
+                              }),
+                    std::runtime_error);
+}
+
+TEST_CASE("EventLoop::selmask", "[ps::EventLoop]") {
+  std::string const evstr = TestEventStream(1000, MuonProtonEvents());
+
+  // more than 64 selections, so that the mask spans two words
+  size_t const nsel = 70;
+  EventHooks hooks;
+  for (size_t i = 0; i < nsel; ++i) {
+    hooks.selections.push_back([=](HepMC3::GenEvent const &ev) {
+      return event::beam_part(ev, pdg::kNuMu)->momentum().e() >=
+             (1000 + 14 * i) * unit::MeV;
+    });
+  }
+
+  std::stringstream ss(evstr);
+  HepMC3::ReaderAscii rdr(ss);
+  EventLoop loop(hooks, 3, 64);
+  size_t nread = loop.run(rdr, [&](EventBatch const &batch) {
+    for (size_t i = 0; i < batch.nevents; ++i) {
+      auto const &res = batch.results[i];
+      // every event passes without a select
+      REQUIRE(res.pass);
+      REQUIRE(res.selmask.size() == selmask_words(nsel));
+      double e = event::beam_part(*batch.events[i], pdg::kNuMu)->momentum().e();
+      for (size_t s = 0; s < nsel; ++s) {
+        REQUIRE(selmask_test(res.selmask, s) ==
+                (e >= (1000 + 14 * s) * unit::MeV));
+      }
+    }
+  });
+  REQUIRE(nread == 1000);
+}
+
+TEST_CASE("EventLoop::histograms", "[ps::EventLoop]") {
+  std::string const evstr = TestEventStream(1000, MuonProtonEvents());
+  auto hooks = TestHooks();
+
+  HistogramSet hists({HistogramSpec{"enu",
+                                    {HistogramAxis::uniform(10, 1E3, 2E3)},
+                                    {hooks.projections[0]},
+                                    {[](HepMC3::GenEvent const &ev) {
+                                      return 1.0 / event::beam_part(ev, 14)
+                                                       ->momentum()
+                                                       .e();
+                                    }},
+                                    {}}});
+
+  // filled one event at a time, in event order
+  auto serial = hists.empty_clone();
+  {
+    std::stringstream ss(evstr);
+    HepMC3::ReaderAscii rdr(ss);
+    HepMC3::GenEvent ev;
+    while (rdr.read_event(ev) && !rdr.failed()) {
+      serial.fill(ev, bool(hooks.select(ev)));
+    }
+  }
+
+  std::vector<HistogramSet> results{serial};
+  for (size_t nthreads : {1, 3, 8}) {
+    for (size_t batch_size : {1, 32, 100}) {
+      std::stringstream ss(evstr);
+      HepMC3::ReaderAscii rdr(ss);
+
+      auto total = hists.empty_clone();
+      EventLoop loop(hooks, nthreads, batch_size);
+      loop.fill_histograms(hists);
+      size_t next_evtnum = 0;
+      loop.run(rdr, [&](EventBatch const &batch) {
+        for (auto const &fill : batch.fills) {
+          REQUIRE(fill.evtnum >= next_evtnum);
+          REQUIRE(fill.evtnum < (batch.first_evtnum + batch.nevents));
+          next_evtnum = fill.evtnum;
+        }
+        apply_fills(total.histograms, batch.fills);
+      });
+      results.push_back(total);
+    }
+  }
+
+  // only events passing the event loop selection are filled
+  REQUIRE(results[0].histograms[0].entries == 490);
+  for (auto const &res : results) {
+    REQUIRE(res.histograms[0].sumw == results[0].histograms[0].sumw);
+    REQUIRE(res.histograms[0].sumw2 == results[0].histograms[0].sumw2);
+  }
+}
+
+TEST_CASE("EventRange::shards", "[ps::EventLoop]") {
+  EventRange range;
+  range.skip = 10;
+  range.max_events = 1000;
+  range.nshards = 3;
+  range.chunk_size = 64;
+  REQUIRE_NOTHROW(range.validate(32));
+  REQUIRE_THROWS_AS(range.validate(48), std::runtime_error);
+
+  // every event of the range is in exactly one shard, and next visits them
+  // in order
+  std::vector<size_t> nseen(1100, 0);
+  for (size_t shard = 0; shard < range.nshards; ++shard) {
+    range.shard = shard;
+    for (size_t e = range.next(0); e < range.end(); e = range.next(e + 1)) {
+      REQUIRE(range.contains(e));
+      REQUIRE(range.run_end(e) <= (((e / 64) + 1) * 64));
+      nseen[e]++;
+    }
+  }
+  for (size_t e = 0; e < nseen.size(); ++e) {
+    REQUIRE(nseen[e] == (((e >= 10) && (e < 1010)) ? 1 : 0));
+  }
+
+  range.shard = 3;
+  REQUIRE_THROWS_AS(range.validate(32), std::runtime_error);
+}
+
+TEST_CASE("EventLoop::shards", "[ps::EventLoop]") {
+  std::string const evstr = TestEventStream(1000, MuonProtonEvents());
+  auto hooks = TestHooks();
+
+  HistogramSet hists({HistogramSpec{"enu",
+                                    {HistogramAxis::uniform(10, 1E3, 2E3)},
+                                    {hooks.projections[0]},
+                                    {[](HepMC3::GenEvent const &ev) {
+                                      return 1.0 / event::beam_part(ev, 14)
+                                                       ->momentum()
+                                                       .e();
+                                    }},
+                                    {}}});
+
+  EventRange range;
+  range.skip = 17;
+  range.max_events = 900;
+  range.chunk_size = 64;
+
+  auto run = [&](EventRange const &r, std::vector<EventResult> &rows,
+                 HistogramAccumulator &acc) {
+    std::stringstream ss(evstr);
+    HepMC3::ReaderAscii rdr(ss);
+    EventLoop loop(hooks, 3, 32);
+    loop.fill_histograms(hists);
+    return loop.run(
+        rdr,
+        [&](EventBatch const &batch) {
+          rows.insert(rows.end(), batch.results.begin(), batch.results.end());
+          acc.add(batch.fills);
+        },
+        r);
+  };
+
+  std::vector<EventResult> rows;
+  HistogramAccumulator acc(hists.histograms, range.chunk_size);
+  REQUIRE(run(range, rows, acc) == 900);
+  auto const &total = acc.finish();
+
+  std::vector<EventResult> shard_rows;
+  std::vector<HistogramChunk> chunks;
+  range.nshards = 4;
+  for (size_t shard = 0; shard < range.nshards; ++shard) {
+    range.shard = shard;
+    HistogramAccumulator shard_acc(hists.histograms, range.chunk_size, true);
+    run(range, shard_rows, shard_acc);
+    shard_acc.finish();
+    chunks.insert(chunks.end(), shard_acc.get_chunks().begin(),
+                  shard_acc.get_chunks().end());
+  }
+
+  std::sort(shard_rows.begin(), shard_rows.end(),
+            [](EventResult const &a, EventResult const &b) {
+              return a.evtnum < b.evtnum;
+            });
+  REQUIRE(shard_rows.size() == rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    REQUIRE(shard_rows[i].evtnum == rows[i].evtnum);
+    REQUIRE(shard_rows[i].values == rows[i].values);
+  }
+
+  std::sort(chunks.begin(), chunks.end(),
+            [](HistogramChunk const &a, HistogramChunk const &b) {
+              return a.index < b.index;
+            });
+  HistogramAccumulator merged(hists.histograms, range.chunk_size);
+  for (auto const &chunk : chunks) {
+    merged.add_chunk(chunk);
+  }
+  auto const &merged_total = merged.finish();
+
+  // the merged shards reproduce the unsharded sums exactly
+  REQUIRE(merged_total[0].entries == total[0].entries);
+  REQUIRE(merged_total[0].sumw == total[0].sumw);
+  REQUIRE(merged_total[0].sumw2 == total[0].sumw2);
+}
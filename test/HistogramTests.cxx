@@ -0,0 +1,131 @@
+#include "ProSelecta/Histogram.h"
+
+#include "test_temp_dir.h"
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+using namespace Catch::Matchers;
+using namespace ps;
+
+TEST_CASE("HistogramAxis::find_bin", "[ps::Histogram]") {
+  auto axis = HistogramAxis::uniform(4, 0, 2);
+  REQUIRE(axis.nbins() == 4);
+  REQUIRE(axis.find_bin(-1) == 0);
+  REQUIRE(axis.find_bin(0) == 1);
+  REQUIRE(axis.find_bin(0.49) == 1);
+  REQUIRE(axis.find_bin(0.5) == 2);
+  REQUIRE(axis.find_bin(1.99) == 4);
+  REQUIRE(axis.find_bin(2) == 5);
+  REQUIRE(axis.find_bin(std::numeric_limits<double>::quiet_NaN()) == 5);
+
+  HistogramAxis varaxis{{0, 1, 10, 100}};
+  REQUIRE(varaxis.find_bin(5) == 2);
+  REQUIRE(varaxis.find_bin(50) == 3);
+
+  REQUIRE_THROWS_AS(HistogramAxis::uniform(0, 0, 1), std::runtime_error);
+  REQUIRE_THROWS_AS(HistogramAxis::uniform(1, 1, 0), std::runtime_error);
+  REQUIRE_THROWS_AS(Histogram("h", {HistogramAxis{{1, 0}}}),
+                    std::runtime_error);
+}
+
+TEST_CASE("Histogram::fill_add", "[ps::Histogram]") {
+  Histogram h("h", {HistogramAxis::uniform(2, 0, 2),
+                    HistogramAxis{{0, 1, 10, 100}}});
+  REQUIRE(h.sumw.size() == (4 * 5));
+
+  double x[] = {1.5, 50};
+  h.fill(x, 2);
+  h.fill(x, 3);
+  // the first axis varies fastest
+  size_t bin = 2 + 4 * 3;
+  REQUIRE(h.find_bin(x) == bin);
+  REQUIRE_THAT(h.sumw[bin], WithinAbs(5, 1E-12));
+  REQUIRE_THAT(h.sumw2[bin], WithinAbs(13, 1E-12));
+
+  Histogram h2 = h;
+  h2.add(h);
+  REQUIRE_THAT(h2.sumw[bin], WithinAbs(10, 1E-12));
+  REQUIRE(h2.entries == 4);
+
+  REQUIRE_THROWS_AS(h.add(Histogram("other", {HistogramAxis::uniform(3, 0, 2),
+                                              HistogramAxis{{0, 1, 10, 100}}})),
+                    std::runtime_error);
+}
+
+TEST_CASE("HistogramAccumulator::add", "[ps::Histogram]") {
+  std::vector<Histogram> prototype{
+      Histogram("h", {HistogramAxis::uniform(4, 0, 4)})};
+
+  std::vector<HistogramFill> fills;
+  for (size_t e = 0; e < 100; ++e) {
+    fills.push_back({e, 0, 1 + (e % 4), 0.1 * double(e)});
+  }
+
+  // the chunk partials are summed in chunk order into the total
+  std::vector<Histogram> ref = prototype;
+  for (size_t first = 0; first < fills.size(); first += 16) {
+    std::vector<Histogram> chunk = prototype;
+    for (size_t e = first; e < std::min<size_t>(first + 16, 100); ++e) {
+      chunk[0].fill_bin(fills[e].bin, fills[e].w);
+    }
+    add_histograms(ref, chunk);
+  }
+
+  // however the fills are split between calls
+  for (size_t split : {1, 7, 100}) {
+    HistogramAccumulator acc(prototype, 16, true);
+    for (size_t first = 0; first < fills.size(); first += split) {
+      acc.add({fills.begin() + first,
+               fills.begin() + std::min(first + split, fills.size())});
+    }
+    auto const &total = acc.finish();
+    REQUIRE(total[0].sumw == ref[0].sumw);
+    REQUIRE(total[0].sumw2 == ref[0].sumw2);
+    REQUIRE(total[0].entries == 100);
+    REQUIRE(acc.get_chunks().size() == 7);
+    REQUIRE(acc.get_chunks().back().index == 6);
+    REQUIRE(acc.get_chunks().back().histograms[0].entries == 4);
+  }
+
+  // and across a saved state
+  HistogramAccumulator first(prototype, 16);
+  first.add({fills.begin(), fills.begin() + 40});
+  HistogramAccumulator resumed(prototype, 16);
+  resumed.restore(first.get_state());
+  resumed.add({fills.begin() + 40, fills.end()});
+  REQUIRE(resumed.finish()[0].sumw == ref[0].sumw);
+}
+
+TEST_CASE("Histogram::binary_roundtrip", "[ps::Histogram]") {
+  TestDir dir("hist_binary_roundtrip");
+  auto outfile = dir / "hists.bin";
+
+  std::vector<Histogram> hists{
+      Histogram("a", {HistogramAxis::uniform(10, -1, 1)}),
+      Histogram("b", {HistogramAxis::uniform(3, 0, 3),
+                      HistogramAxis{{0, 1, 2}}, HistogramAxis{{-5, 5}},
+                      HistogramAxis::uniform(2, 0, 1)})};
+  for (int i = 0; i < 100; ++i) {
+    double x[] = {std::sin(i), std::cos(i), double(i % 7) - 3, 0.01 * i};
+    hists[0].fill(x, 0.5 * i);
+    hists[1].fill(x, 1);
+  }
+
+  write_histograms_binary(outfile.native(), hists);
+  auto read = read_histograms_binary(outfile.native());
+  REQUIRE(read.size() == 2);
+  for (size_t i = 0; i < hists.size(); ++i) {
+    REQUIRE(read[i].name == hists[i].name);
+    REQUIRE(read[i].axes == hists[i].axes);
+    REQUIRE(read[i].entries == hists[i].entries);
+    REQUIRE(read[i].sumw == hists[i].sumw);
+    REQUIRE(read[i].sumw2 == hists[i].sumw2);
+  }
+}
@@ -0,0 +1,135 @@
+// Built with ProSelecta_EXTERN_TEMPLATES, so that, like snippets, it uses the
+// instantiations compiled into libProSelectaInterpreter rather than its own.
+// Every instantiation listed in ProSelecta/detail/instantiations.h is used
+// here, so that CheckInstantiations.cmake can check with nm that none of them
+// are unused, and that none of them were compiled again into this test.
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <algorithm>
+
+using namespace ps;
+
+HepMC3::GenEvent BuildInstantiationsEvent() {
+  return BuildEvent({{"14 4 3 0", "1000060120 20 0"},
+                     {"13 1 0.7", "2212 1 0.5", "2212 1 0.2", "211 1 0.3",
+                      "111 1 0.4"}});
+}
+
+template <typename PIDs>
+void CheckEventFuncs(HepMC3::GenEvent const &ev, PIDs const &out,
+                     PIDs const &beam, PIDs const &target) {
+  PIDs counts = out;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    counts[i] = event::num_out_part(ev, out)[i];
+  }
+  int const nout = event::num_out_part(ev, out, flatten);
+  REQUIRE(nout == int(out.size() + ((out.size() > 1) ? 1 : 0)));
+  REQUIRE(event::num_out_part_except(ev, out) == (5 - nout));
+  REQUIRE(event::has_out_part(ev, out));
+  REQUIRE(event::has_exact_out_part(ev, out, counts));
+  REQUIRE(event::has_at_least_out_part(ev, out, counts));
+  REQUIRE(event::out_part_topology_matches(ev, out, counts) == (nout == 5));
+  REQUIRE(event::all_out_part(ev, out)[0].size() == 1);
+  REQUIRE(event::all_out_part(ev, out, flatten).size() == size_t(nout));
+  REQUIRE(event::all_out_part_except(ev, out).size() == size_t(5 - nout));
+
+  auto hm = event::hm_out_part(ev, out);
+  REQUIRE(hm == event::try_hm_out_part(ev, out));
+  REQUIRE(hm[0]->pid() == 13);
+  REQUIRE(event::hm_out_part(ev, out, flatten)->pid() == 13);
+  REQUIRE(event::try_hm_out_part(ev, out, flatten)->pid() == 13);
+
+  REQUIRE(event::has_beam_part(ev, beam));
+  REQUIRE(event::beam_part(ev, beam)->pid() == 14);
+  REQUIRE(event::try_beam_part(ev, beam)->pid() == 14);
+  REQUIRE(event::has_target_part(ev, target));
+  REQUIRE(event::target_part(ev, target)->pid() == 1000060120);
+  REQUIRE(event::try_target_part(ev, target)->pid() == 1000060120);
+}
+
+TEST_CASE("event functions", "[ps::instantiations]") {
+  auto ev = BuildInstantiationsEvent();
+
+  CheckEventFuncs(ev, pids(13), pids(14), pids(1000060120));
+  CheckEventFuncs(ev, pids(13, 2212), pdg::kNeutralLeptons_matter,
+                  pids(1000060120, pdg::Oxygen16));
+  CheckEventFuncs(ev, pids(13, 2212, 211), pids(12, 14, -14),
+                  pids(1000060120, pdg::Oxygen16, pdg::Argon40));
+  CheckEventFuncs(ev, pids(13, 2212, 211, 111), pdg::kNeutralLeptons,
+                  pids(1000060120, pdg::Oxygen16, pdg::Argon40, pdg::Iron56));
+}
+
+template <typename Projector>
+void CheckSortingFuncs(HepMC3::GenEvent const &ev, Projector const &proj) {
+  auto protons = event::all_out_part(ev, pdg::kProton);
+  auto sorted = part::sort_ascending(proj, protons);
+  REQUIRE(std::is_sorted(
+      sorted.begin(), sorted.end(),
+      [&](auto const &a, auto const &b) { return proj(a) < proj(b); }));
+  REQUIRE(part::highest(proj, protons) == sorted.back());
+  REQUIRE(part::lowest(proj, protons) == sorted.front());
+  REQUIRE(part::try_highest(proj, protons) == sorted.back());
+  REQUIRE(part::try_lowest(proj, protons) == sorted.front());
+
+  auto groups = event::all_out_part(ev, pids(pdg::kProton, pdg::kPiPlus));
+  auto sorted_groups = part::sort_ascending(proj, groups);
+  REQUIRE(sorted_groups[0] == sorted);
+  REQUIRE(part::highest(proj, groups)[0] == sorted.back());
+  REQUIRE(part::lowest(proj, groups)[0] == sorted.front());
+  REQUIRE(part::try_highest(proj, groups) == part::highest(proj, groups));
+  REQUIRE(part::try_lowest(proj, groups) == part::lowest(proj, groups));
+
+  auto sorted_all = part::sort_ascending(proj, groups, flatten);
+  REQUIRE(sorted_all.size() == 3);
+  REQUIRE(part::highest(proj, groups, flatten) == sorted_all.back());
+  REQUIRE(part::lowest(proj, groups, flatten) == sorted_all.front());
+  REQUIRE(part::try_highest(proj, groups, flatten) == sorted_all.back());
+  REQUIRE(part::try_lowest(proj, groups, flatten) == sorted_all.front());
+}
+
+TEST_CASE("sorting part functions", "[ps::instantiations]") {
+  auto ev = BuildInstantiationsEvent();
+
+  CheckSortingFuncs(ev, p3mod);
+  CheckSortingFuncs(ev, energy);
+  CheckSortingFuncs(ev, kinetic_energy);
+  CheckSortingFuncs(ev, theta);
+  CheckSortingFuncs(ev, costheta);
+}
+
+template <typename Projector>
+void CheckSummingFuncs(HepMC3::GenEvent const &ev, Projector const &proj) {
+  auto protons = event::all_out_part(ev, pdg::kProton);
+  auto groups = event::all_out_part(ev, pids(pdg::kProton, pdg::kPiPlus));
+  auto sums = part::sum(proj, groups);
+  REQUIRE(sums[0] == part::sum(proj, protons));
+  REQUIRE(part::sum(proj, groups, flatten) == (sums[0] + sums[1]));
+}
+
+TEST_CASE("summing part functions", "[ps::instantiations]") {
+  auto ev = BuildInstantiationsEvent();
+
+  CheckSummingFuncs(ev, p3mod);
+  CheckSummingFuncs(ev, energy);
+  CheckSummingFuncs(ev, kinetic_energy);
+  CheckSummingFuncs(ev, momentum);
+}
+
+TEST_CASE("filtering part functions", "[ps::instantiations]") {
+  auto ev = BuildInstantiationsEvent();
+
+  auto protons = event::all_out_part(ev, pdg::kProton);
+  auto groups = event::all_out_part(ev, pids(pdg::kProton, pdg::kPiPlus));
+  auto fast = p3mod > 0.25 * unit::GeV;
+
+  REQUIRE(part::filter(fast, protons).size() == 1);
+  auto filtered = part::filter(fast, groups);
+  REQUIRE(filtered[0].size() == 1);
+  REQUIRE(filtered[1].size() == 1);
+  REQUIRE(part::filter(fast, groups, flatten).size() == 2);
+  REQUIRE(part::cat(groups).size() == 3);
+}
@@ -0,0 +1,92 @@
+// Built with ProSelecta_LAZY_EXCEPTION_DIAGNOSTICS and run with
+// ProSelecta_BACKTRACE set. It uses the environment headers on their own, as
+// the interpreter library is built with the diagnostics that it was
+// configured with, and installs its own backtrace hook.
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <execinfo.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+using namespace ps;
+
+static_assert(ps::detail::lazy_exception_diagnostics);
+
+int nhook_calls = 0;
+
+void CountingHook() { nhook_calls++; }
+
+__attribute__((noinline)) void
+ThrowFromLazyExceptionTests(HepMC3::GenEvent const &ev) {
+  event::beam_part(ev, pdg::kNuE);
+}
+
+bool FramesInclude(std::vector<void *> const &frames,
+                   std::string const &name) {
+  std::unique_ptr<char *, decltype(&std::free)> symbols(
+      ::backtrace_symbols(frames.data(), int(frames.size())), &std::free);
+  for (size_t i = 0; symbols && (i < frames.size()); ++i) {
+    if (std::string(symbols.get()[i]).find(name) != std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST_CASE("frames are captured at construction", "[ps::detail::exception]") {
+  REQUIRE(ps::detail::backtrace_enabled());
+  ps::detail::backtrace_hook() = &CountingHook;
+  nhook_calls = 0;
+
+  auto evt = BuildEvent({{"14 4 1", "1000060120 20 0"},
+                         {"13 1 0.7", "2212 1 0.15"}});
+
+  bool caught = false;
+  try {
+    ThrowFromLazyExceptionTests(evt);
+  } catch (event::NoMatchingParts const &e) {
+    caught = true;
+    REQUIRE(!e.diagnosed);
+    REQUIRE(e.frames.size());
+    // the function that threw has returned, so the frames can only include
+    // it if they were taken when the exception was constructed
+    REQUIRE(FramesInclude(e.frames, "ThrowFromLazyExceptionTests"));
+
+    REQUIRE(std::string(e.what()) == "beam_part(12): NoMatchingParts");
+    REQUIRE(e.diagnosed);
+  }
+  REQUIRE(caught);
+  // the hook prints the stack of its caller, so lazy diagnostics never call it
+  REQUIRE(nhook_calls == 0);
+}
+
+TEST_CASE("handled exceptions are not diagnosed", "[ps::detail::exception]") {
+  ps::detail::backtrace_hook() = &CountingHook;
+  nhook_calls = 0;
+
+  auto evt = BuildEvent({{"14 4 1", "1000060120 20 0"},
+                         {"13 1 0.7", "2212 1 0.15"}});
+
+  for (int i = 0; i < 10; ++i) {
+    try {
+      event::hm_out_part(evt, pdg::kElectron);
+    } catch (part::EmptyParticleList const &e) {
+      REQUIRE(!e.diagnosed);
+    }
+  }
+  REQUIRE(nhook_calls == 0);
+}
+
+TEST_CASE("frames are not captured without a hook", "[ps::detail::exception]") {
+  ps::detail::backtrace_hook() = nullptr;
+
+  event::NoMatchingParts e("no hook");
+  REQUIRE(e.frames.empty());
+  REQUIRE(std::string(e.what()) == "no hook");
+}
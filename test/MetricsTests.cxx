@@ -0,0 +1,120 @@
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/Metrics.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/ReaderAscii.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace ps;
+
+TEST_CASE("EventLoop::metrics", "[ps::Metrics]") {
+  size_t const nevents = 1000;
+  std::string const evstr = TestEventStream(nevents, MuonProtonEvents());
+  EventHooks hooks{[](HepMC3::GenEvent const &ev) {
+                     return event::beam_part(ev, pdg::kNuMu)->momentum().e() >
+                            1.5 * unit::GeV;
+                   },
+                   {},
+                   {},
+                   {}};
+
+  for (size_t nthreads : {1, 4}) {
+    std::stringstream ss(evstr);
+    HepMC3::ReaderAscii rdr(ss);
+
+    LoopMetrics metrics;
+    size_t nselected = 0;
+    EventLoop loop(hooks, nthreads, 13, 2);
+    loop.set_metrics(&metrics);
+    loop.run(rdr, [&](EventBatch const &batch) {
+      for (auto const &res : batch.results) {
+        nselected += res.pass;
+      }
+      // at most queue_depth batches per queue, and one more waiting to be
+      // pushed by the reader and by each worker
+      REQUIRE(metrics.input_queue_depth <= ((2 * nthreads) + 1));
+      REQUIRE(metrics.output_queue_depth <= (3 * nthreads));
+    });
+
+    REQUIRE(metrics.events_read == nevents);
+    REQUIRE(metrics.events_selected == nselected);
+    REQUIRE(metrics.input_queue_depth == 0);
+    REQUIRE(metrics.output_queue_depth == 0);
+  }
+}
+
+TEST_CASE("MultiFileReader::metrics", "[ps::Metrics]") {
+  TestDir dir("metrics_bytes_read");
+  std::string const path = dir / "events.hepmc3";
+  WriteTestEvents(path, 500);
+  auto const size = std::filesystem::file_size(path);
+
+  // other readers count the whole file once it has been read
+  LoopMetrics metrics;
+  MultiFileReader rdr({path, path}, 2, 256, std::nullopt, false, &metrics);
+  while (rdr.next_event()) {
+  }
+  REQUIRE(metrics.bytes_read == (2 * size));
+
+  // an AsciiReader counts the events as it reads them, but not the lines
+  // before and after them
+  LoopMetrics ascii_metrics;
+  MultiFileReader ascii_rdr({path}, 1, 256, AsciiReaderOptions(), false,
+                            &ascii_metrics);
+  for (size_t i = 0; i < 100; ++i) {
+    ascii_rdr.next_event();
+  }
+  REQUIRE(ascii_metrics.bytes_read > 0);
+  REQUIRE(ascii_metrics.bytes_read < size);
+  while (ascii_rdr.next_event()) {
+  }
+  REQUIRE(ascii_metrics.bytes_read > (size - 200));
+  REQUIRE(ascii_metrics.bytes_read < size);
+}
+
+TEST_CASE("MetricsReporter::textfile", "[ps::Metrics]") {
+  TestDir dir("metrics_textfile");
+  auto outfile = dir / "metrics.prom";
+
+  LoopMetrics metrics;
+  MetricsReporter reporter(metrics, 1E-2, false, outfile.native(), 0, 200);
+  metrics.events_read = 150;
+  metrics.events_selected = 15;
+  reporter.stop();
+
+  std::ifstream ifs(outfile);
+  std::stringstream ss("");
+  ss << ifs.rdbuf();
+  std::string const prom = ss.str();
+  REQUIRE(prom.find("# TYPE proselecta_events_read_total counter\n"
+                    "proselecta_events_read_total 150\n") !=
+          std::string::npos);
+  REQUIRE(prom.find("\nproselecta_events_selected_total 15\n") !=
+          std::string::npos);
+  // 50 of 200 events are left
+  REQUIRE(prom.find("\nproselecta_eta_seconds ") != std::string::npos);
+  REQUIRE(!std::filesystem::exists(outfile.native() + ".tmp"));
+}
+
+TEST_CASE("format_progress", "[ps::Metrics]") {
+  MetricsSnapshot snap{10, 1000, 100, 2500, 100, 5000000, 20000000, 83,
+                       3,  0};
+  REQUIRE(format_progress(snap) ==
+          "[PROGRESS]: 1000 events read, 100 selected, 2.5 kHz (avg 0.1 "
+          "kHz), 5.0/20.0 MB (25.0%), ETA 0:01:23, queued 3 in 0 out");
+  snap.eta_s = -1;
+  snap.bytes_read = 0;
+  snap.input_queue_depth = 0;
+  REQUIRE(format_progress(snap) ==
+          "[PROGRESS]: 1000 events read, 100 selected, 2.5 kHz (avg 0.1 "
+          "kHz)");
+}
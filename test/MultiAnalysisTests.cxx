@@ -0,0 +1,119 @@
+#include "ProSelecta/MultiAnalysis.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/ReaderAscii.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+using namespace ps;
+
+double BeamE(HepMC3::GenEvent const &ev) {
+  return event::beam_part(ev, pdg::kNuMu)->momentum().e();
+}
+
+// Two analyses with overlapping selections, that count how many times their
+// projections are evaluated
+std::vector<Analysis> TestAnalyses(std::filesystem::path const &dir,
+                                   std::atomic<size_t> &nprojected) {
+  return {
+      Analysis{"high",
+               EventHooks{[](HepMC3::GenEvent const &ev) {
+                            return BeamE(ev) > 1.5 * unit::GeV;
+                          },
+                          {[&](HepMC3::GenEvent const &ev) {
+                             nprojected++;
+                             return BeamE(ev);
+                           },
+                           [](HepMC3::GenEvent const &ev) {
+                             return event::hm_out_part(ev, pdg::kMuon)
+                                 ->momentum()
+                                 .e();
+                           }},
+                          {},
+                          {}},
+               OutputColumns{{"beam_e", "mu_e"}, {}, {}},
+               (dir / "high.bin").native(),
+               ""},
+      Analysis{"low",
+               EventHooks{[](HepMC3::GenEvent const &ev) {
+                            return BeamE(ev) < 1.7 * unit::GeV;
+                          },
+                          {[&](HepMC3::GenEvent const &ev) {
+                             nprojected++;
+                             return -BeamE(ev);
+                           }},
+                          {[](HepMC3::GenEvent const &) { return 2.0; }},
+                          {}},
+               OutputColumns{{"minus_beam_e"}, {"wgt"}, {}},
+               (dir / "low.bin").native(),
+               ""},
+  };
+}
+
+TEST_CASE("run_analyses::single_pass", "[ps::MultiAnalysis]") {
+  size_t const nevents = 1000;
+  std::string const evstr = TestEventStream(nevents, MuonProtonEvents());
+  TestDir dir("multi_single_pass");
+
+  std::atomic<size_t> nprojected(0);
+  auto analyses = TestAnalyses(dir.path(), nprojected);
+
+  for (size_t nthreads : {1, 3}) {
+    std::stringstream ss(evstr);
+    HepMC3::ReaderAscii rdr(ss);
+    nprojected = 0;
+    auto res = run_analyses(rdr, analyses, nthreads, 13);
+    REQUIRE(res.events_read == nevents);
+
+    size_t nselected = 0;
+    for (size_t a = 0; a < analyses.size(); ++a) {
+      // each output holds the rows of running that analysis alone
+      auto table = read_output_table(analyses[a].output_path);
+      REQUIRE(table.columns.projections == analyses[a].columns.projections);
+      REQUIRE(table.columns.weights == analyses[a].columns.weights);
+      REQUIRE(table.rows.size() == nevents);
+
+      std::stringstream ss_serial(evstr);
+      HepMC3::ReaderAscii rdr_serial(ss_serial);
+      HepMC3::GenEvent evt;
+      size_t npass = 0;
+      for (size_t i = 0; rdr_serial.read_event(evt) && !rdr_serial.failed();
+           ++i) {
+        auto expected = evaluate_event(analyses[a].hooks, i, evt);
+        REQUIRE(table.rows[i].evtnum == i);
+        REQUIRE(table.rows[i].pass == expected.pass);
+        if (expected.pass) {
+          REQUIRE(table.rows[i].values == expected.values);
+          npass++;
+        }
+      }
+      REQUIRE(res.events_selected[a] == npass);
+      REQUIRE(npass > 0);
+      REQUIRE(npass < nevents);
+      nselected += npass;
+    }
+
+    // the serial evaluation above projected each selected event once more
+    REQUIRE(nprojected == (2 * nselected));
+  }
+}
+
+TEST_CASE("run_analyses::errors", "[ps::MultiAnalysis]") {
+  TestDir dir("multi_errors");
+  std::stringstream ss(TestEventStream(10, MuonProtonEvents()));
+  HepMC3::ReaderAscii rdr(ss);
+
+  std::atomic<size_t> nprojected(0);
+  auto analyses = TestAnalyses(dir.path(), nprojected);
+  analyses[1].output_path = analyses[0].output_path;
+  REQUIRE_THROWS_AS(run_analyses(rdr, analyses), std::runtime_error);
+  REQUIRE_THROWS_AS(run_analyses(rdr, {}), std::runtime_error);
+}
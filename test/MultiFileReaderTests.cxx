@@ -0,0 +1,111 @@
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/ReaderAscii.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace ps;
+
+// Writes nfiles files with a different number of events each, and returns
+// the beam energies of every event in order, as read from each file in turn
+std::vector<double> BuildEventFiles(std::filesystem::path const &dir,
+                                    size_t nfiles) {
+  std::vector<double> energies;
+  for (size_t f = 0; f < nfiles; ++f) {
+    auto path = (dir / ("events." + std::to_string(f) + ".hepmc3")).native();
+    TestEvents spec;
+    spec.beam_GeV = [=](size_t i) { return f + 0.001 * (i + 1); };
+    spec.out = [](size_t) { return std::vector<std::string>{}; };
+    WriteTestEvents(path, 50 + (f * 37) % 100, spec);
+
+    HepMC3::ReaderAscii rdr(path);
+    HepMC3::GenEvent evt;
+    while (rdr.read_event(evt) && !rdr.failed()) {
+      energies.push_back(event::beam_part(evt, pdg::kNuMu)->momentum().e());
+    }
+  }
+  return energies;
+}
+
+TEST_CASE("MultiFileReader::ordered", "[ps::MultiFileReader]") {
+  TestDir dir("mfr_ordered");
+  auto energies = BuildEventFiles(dir.path(), 7);
+  auto paths = expand_input_paths({(dir / "events.*.hepmc3").native()});
+  REQUIRE(paths.size() == 7);
+
+  for (size_t nreaders : {1, 3, 8}) {
+    MultiFileReader rdr(paths, nreaders, 1);
+    REQUIRE(skip_events(rdr, 10));
+
+    size_t nread = 0;
+    while (auto evt = next_event(rdr)) {
+      REQUIRE(event::beam_part(*evt, pdg::kNuMu)->momentum().e() ==
+              energies[10 + nread++]);
+    }
+    REQUIRE(rdr.failed());
+    REQUIRE(nread == (energies.size() - 10));
+
+    // skipped events are not counted
+    size_t nevents = 0;
+    for (auto const &st : rdr.get_file_stats()) {
+      nevents += st.nevents;
+      REQUIRE(st.sumw == st.nevents);
+    }
+    REQUIRE(nevents == nread);
+  }
+}
+
+TEST_CASE("MultiFileReader::recycle", "[ps::MultiFileReader]") {
+  TestDir dir("mfr_recycle");
+  auto energies = BuildEventFiles(dir.path(), 7);
+
+  size_t const nreaders = 2;
+  MultiFileReader rdr(expand_input_paths({(dir / "events.*.hepmc3").native()}),
+                      nreaders, MultiFileReader::block_size);
+  size_t nread = 0;
+  while (auto evt = next_event(rdr)) {
+    REQUIRE(event::beam_part(*evt, pdg::kNuMu)->momentum().e() ==
+            energies[nread++]);
+    recycle_event(rdr, std::move(evt));
+  }
+  REQUIRE(nread == energies.size());
+
+  // at most one block being filled and one queued per decoder, and the block
+  // being read, are in flight at once
+  REQUIRE(rdr.events_allocated() <=
+          ((2 * nreaders + 1) * MultiFileReader::block_size + 1));
+  REQUIRE(rdr.events_allocated() < energies.size());
+}
+
+TEST_CASE("MultiFileReader::errors", "[ps::MultiFileReader]") {
+  TestDir dir("mfr_errors");
+  BuildEventFiles(dir.path(), 2);
+
+  MultiFileReader rdr({(dir / "events.0.hepmc3").native(),
+                       (dir / "does_not_exist.hepmc3").native()},
+                      2);
+  REQUIRE(skip_events(rdr, 50));
+  REQUIRE_THROWS_AS(next_event(rdr), std::runtime_error);
+
+  REQUIRE_THROWS_AS(expand_input_paths({(dir / "*.nothing").native()}),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(expand_input_paths({"@" + (dir / "no_list").native()}),
+                    std::runtime_error);
+
+  std::ofstream((dir / "list.txt").native())
+      << "# input files\n\n  " << (dir / "events.1.hepmc3").native()
+      << "\n" << (dir / "events.*.hepmc3").native() << "\n";
+  auto paths = expand_input_paths({"@" + (dir / "list.txt").native()});
+  REQUIRE(paths.size() == 3);
+  REQUIRE(paths[0] == (dir / "events.1.hepmc3").native());
+  REQUIRE(paths[1] == (dir / "events.0.hepmc3").native());
+}
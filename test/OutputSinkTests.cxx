@@ -0,0 +1,190 @@
+#include "ProSelecta/OutputSink.h"
+
+#include "test_temp_dir.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace ps;
+
+std::vector<EventResult> TestRows(size_t nrows) {
+  std::vector<EventResult> rows;
+  for (size_t i = 0; i < nrows; ++i) {
+    if (i % 3) {
+      rows.push_back({i, true, {0.5 * i, 1.0 / 3.0, 2}, {}});
+    } else {
+      rows.push_back({i, false, {}, {}});
+    }
+  }
+  return rows;
+}
+
+OutputColumns TestColumns() {
+  return OutputColumns{{"proj_a", "proj_b"}, {"wgt"}, {}};
+}
+
+// Rows with a two word selection bitmask
+std::vector<EventResult> TestMaskRows(size_t nrows) {
+  auto rows = TestRows(nrows);
+  for (auto &row : rows) {
+    row.selmask = {0x8000000000000001ull * row.evtnum, row.evtnum % 7};
+  }
+  return rows;
+}
+
+OutputColumns TestMaskColumns() {
+  OutputColumns cols = TestColumns();
+  for (size_t i = 0; i < 67; ++i) {
+    cols.selections.push_back("sel_" + std::to_string(i));
+  }
+  return cols;
+}
+
+TEST_CASE("CSVSink::format", "[ps::OutputSink]") {
+  TestDir dir("sink_csv_format");
+  auto outfile = dir / "sink.csv";
+
+  AsyncSink sink(std::make_unique<CSVSink>(outfile.native()), 2, 1);
+  sink.open(TestColumns());
+  auto rows = TestRows(4);
+  sink.write({rows[0], rows[1]});
+  sink.write({rows[2], rows[3]});
+  sink.close();
+
+  std::ifstream ifs(outfile);
+  std::stringstream ss("");
+  ss << ifs.rdbuf();
+  REQUIRE(ss.str() == "# evtnum, pass, proj_a, proj_b, wgt\n"
+                      "# weights: 1\n"
+                      "0, cut,  - ,  - ,  - \n"
+                      "1, pass, 0.5, 0.333333, 2\n"
+                      "2, pass, 1, 0.333333, 2\n"
+                      "3, cut,  - ,  - ,  - \n");
+}
+
+TEST_CASE("BinarySink::roundtrip", "[ps::OutputSink]") {
+  TestDir dir("sink_bin_roundtrip");
+  auto outfile = dir / "sink.bin";
+
+  auto rows = TestRows(10000);
+  {
+    auto sink = deduce_sink(outfile.native());
+    sink->open(TestColumns());
+    for (size_t i = 0; i < rows.size(); i += 777) {
+      sink->write(std::vector<EventResult>(
+          rows.begin() + i, rows.begin() + std::min(rows.size(), i + 777)));
+    }
+    sink->close();
+  }
+
+  auto table = read_binary_table(outfile.native());
+  REQUIRE(table.columns.projections == TestColumns().projections);
+  REQUIRE(table.columns.weights == TestColumns().weights);
+  REQUIRE(table.rows.size() == rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    REQUIRE(table.rows[i].evtnum == rows[i].evtnum);
+    REQUIRE(table.rows[i].pass == rows[i].pass);
+    REQUIRE(table.rows[i].values == rows[i].values);
+  }
+}
+
+TEST_CASE("AsyncSinks::write", "[ps::OutputSink]") {
+  TestDir dir("async_sinks");
+  std::vector<std::filesystem::path> outfiles{dir / "sink0.bin",
+                                              dir / "sink1.bin"};
+
+  auto rows = TestRows(100);
+  {
+    std::vector<std::unique_ptr<OutputSink>> outputs;
+    for (auto const &outfile : outfiles) {
+      outputs.push_back(deduce_sink(outfile.native()));
+    }
+    AsyncSinks sinks(std::move(outputs), 3, 1);
+    sinks.open({TestColumns(), TestColumns()});
+    // the rows of sink 1 are those of sink 0 in reverse
+    for (size_t i = 0; i < rows.size(); ++i) {
+      sinks.write(0, EventResult(rows[i]));
+      sinks.write(1, EventResult(rows[rows.size() - 1 - i]));
+    }
+    sinks.close();
+  }
+
+  for (size_t s = 0; s < outfiles.size(); ++s) {
+    auto table = read_binary_table(outfiles[s].native());
+    REQUIRE(table.rows.size() == rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      auto const &row = rows[s ? (rows.size() - 1 - i) : i];
+      REQUIRE(table.rows[i].evtnum == row.evtnum);
+      REQUIRE(table.rows[i].values == row.values);
+    }
+  }
+}
+
+TEST_CASE("CSVSink::read", "[ps::OutputSink]") {
+  TestDir dir("sink_csv_read");
+  auto outfile = dir / "sink.csv";
+
+  auto rows = TestRows(100);
+  auto sink = deduce_sink(outfile.native());
+  sink->open(TestColumns());
+  sink->write(rows);
+  sink->close();
+
+  auto table = read_output_table(outfile.native());
+  REQUIRE(table.columns.projections == TestColumns().projections);
+  REQUIRE(table.columns.weights == TestColumns().weights);
+  REQUIRE(table.rows.size() == rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    REQUIRE(table.rows[i].evtnum == rows[i].evtnum);
+    REQUIRE(table.rows[i].pass == rows[i].pass);
+    REQUIRE(table.rows[i].values.size() == rows[i].values.size());
+  }
+  REQUIRE(table.rows[1].values[0] == 0.5);
+
+  // tables written before the number of weights was recorded
+  {
+    std::ofstream ofs(outfile);
+    ofs << "# evtnum, pass, proj_a, wgt\n"
+        << "0, pass, 1, 2\n";
+  }
+  table = read_output_table(outfile.native());
+  REQUIRE(table.columns.projections ==
+          std::vector<std::string>{"proj_a", "wgt"});
+  REQUIRE(table.columns.weights.empty());
+  REQUIRE(table.rows.at(0).values == std::vector<double>{1, 2});
+}
+
+TEST_CASE("OutputSink::selmask", "[ps::OutputSink]") {
+  TestDir dir("sink_selmask");
+  auto rows = TestMaskRows(1000);
+  for (std::string ext : {".csv", ".bin"}) {
+    auto outfile = dir / ("sink" + ext);
+    auto sink = deduce_sink(outfile.native());
+    sink->open(TestMaskColumns());
+    sink->write(rows);
+    sink->close();
+
+    auto table = read_output_table(outfile.native());
+    REQUIRE(table.columns.selections == TestMaskColumns().selections);
+    REQUIRE(table.rows.size() == rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      REQUIRE(table.rows[i].selmask == rows[i].selmask);
+    }
+  }
+}
+
+TEST_CASE("deduce_sink::errors", "[ps::OutputSink]") {
+  REQUIRE_THROWS_AS(deduce_sink("out.csv", "parquet"), std::runtime_error);
+  REQUIRE_THROWS_AS(
+      deduce_sink("/this/path/does/not/exist.csv")->open(TestColumns()),
+      std::runtime_error);
+  // the ROOT format is only available from ProSelectaROOTIO, which this test
+  // does not link
+  REQUIRE_THROWS_AS(deduce_sink("out.root"), std::runtime_error);
+  REQUIRE_THROWS_AS(read_output_table("out.root"), std::runtime_error);
+}
@@ -0,0 +1,85 @@
+#include "ProSelecta/FuncTypes.h"
+#include "ProSelecta/Profiling.h"
+
+#include "HepMC3/GenEvent.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace ps;
+
+// Spins for longer on the events numbered slow_event
+double SpinFor(HepMC3::GenEvent const &ev, int slow_event) {
+  volatile double sum = 0;
+  int n = (ev.event_number() == slow_event) ? 1000000 : 100;
+  for (int i = 0; i < n; ++i) {
+    sum = sum + i;
+  }
+  return sum;
+}
+
+TEST_CASE("profiling::wrap", "[ps::profiling]") {
+  profiling::reset();
+
+  ProjectionFunc proj = [](HepMC3::GenEvent const &ev) {
+    return SpinFor(ev, 777);
+  };
+  SelectFunc sel = [](HepMC3::GenEvent const &ev) {
+    if (ev.event_number() == 5) {
+      throw std::runtime_error("bad event");
+    }
+    return 1;
+  };
+  auto wproj =
+      profiling::wrap(profiling::function_id("project", "test_spin"), proj);
+  auto wsel =
+      profiling::wrap(profiling::function_id("select", "test_throw"), sel);
+  REQUIRE(profiling::function_id("project", "test_spin") ==
+          profiling::function_id("project", "test_spin"));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t]() {
+      HepMC3::GenEvent ev;
+      for (int i = 0; i < 1000; ++i) {
+        ev.set_event_number((t * 1000) + i);
+        REQUIRE(wproj(ev) == proj(ev));
+        if (ev.event_number() == 5) {
+          REQUIRE_THROWS_AS(wsel(ev), std::runtime_error);
+        } else {
+          wsel(ev);
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  auto profs = profiling::profiles();
+  REQUIRE(profs.size() == 2);
+  // sorted by total time
+  REQUIRE(profs[0].name == "test_spin");
+  REQUIRE(profs[0].kind == "project");
+  REQUIRE(profs[0].calls == 4000);
+  REQUIRE(profs[0].p50_s <= profs[0].p99_s);
+  REQUIRE(profs[0].p99_s <= profs[0].max_s);
+  REQUIRE(profs[0].total_s >= profs[0].max_s);
+  // the pathological event stands out
+  REQUIRE(profs[0].slowest.size() == 8);
+  REQUIRE(profs[0].slowest.front().event_number == 777);
+  REQUIRE(profs[0].slowest.front().seconds == profs[0].max_s);
+
+  // calls that throw are still counted
+  REQUIRE(profs[1].name == "test_throw");
+  REQUIRE(profs[1].calls == 4000);
+
+  REQUIRE(profiling::json().find("\"name\": \"test_spin\"") !=
+          std::string::npos);
+
+  profiling::reset();
+  REQUIRE(profiling::profiles().empty());
+}
@@ -0,0 +1,267 @@
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/EventIndex.h"
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/Progressive.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace Catch::Matchers;
+using namespace ps;
+
+TestEvents ProgressiveEvents(int first) {
+  TestEvents spec;
+  spec.first = first;
+  return spec;
+}
+
+// Two HepMC3 ASCII files and an event cache, of 2000, 1400, and 600 events
+// numbered from 0, 10000, and 20000
+std::vector<std::string> WriteProgressiveInputs(TestDir const &dir) {
+  std::vector<std::string> files;
+  for (auto [nevents, first] :
+       std::vector<std::pair<size_t, int>>{{2000, 0}, {1400, 10000}}) {
+    std::string const path = (dir / ("events" + std::to_string(first) +
+                                      ".hepmc3"));
+    WriteTestEvents(path, nevents, ProgressiveEvents(first));
+    files.push_back(path);
+  }
+
+  std::string const path = (dir / "events20000.pscache");
+  EventCacheWriter wrtr(path, 64);
+  for (auto const &ev : BuildTestEvents(600, ProgressiveEvents(20000))) {
+    wrtr.write_event(ev);
+  }
+  wrtr.close();
+  files.push_back(path);
+  return files;
+}
+
+// As when inputs are sorted by process, 30% of the events of the first file
+// pass, and 60% of the others, 1800 in total
+bool SelectProgressive(HepMC3::GenEvent const &ev) {
+  int n = ev.event_number();
+  return (n % 10) < ((n < 10000) ? 3 : 6);
+}
+
+// a bin for each input
+HistogramSpec ProgressiveHistogram() {
+  return {"evtnum",
+          {HistogramAxis::uniform(3, 0, 30000)},
+          {[](HepMC3::GenEvent const &ev) {
+            return double(ev.event_number());
+          }},
+          {},
+          SelectFunc()};
+}
+
+// with weights whose sums depend on the order that they are added in
+HistogramSpec WeightedProgressiveHistogram() {
+  auto spec = ProgressiveHistogram();
+  spec.name = "weighted";
+  spec.weights.push_back([](HepMC3::GenEvent const &ev) {
+    return 0.1 * double((ev.event_number() % 7) + 1) / 3.0;
+  });
+  return spec;
+}
+
+// the histograms of a pass over files, summed as by ProSelectaCPP --Hist
+std::vector<Histogram> PassHistograms(std::vector<std::string> const &files,
+                                      HistogramSpec const &spec,
+                                      size_t chunk_size) {
+  HistogramSet prototype({spec});
+  EventLoop loop(EventHooks{SelectProgressive, {}, {}, {}}, 2, 32);
+  loop.fill_histograms(prototype);
+  HistogramAccumulator acc(prototype.histograms, chunk_size);
+  MultiFileReader rdr(files);
+  loop.run(rdr, [&](EventBatch const &batch) { acc.add(batch.fills); });
+  return acc.finish();
+}
+
+TEST_CASE("run_progressive reads every block", "[ps::Progressive]") {
+  TestDir dir("progressive_every_block");
+  auto files = WriteProgressiveInputs(dir);
+  ProgressiveOptions opts;
+  opts.block_events = 100;
+  opts.nthreads = 2;
+  opts.batch_size = 32;
+
+  size_t calls = 0;
+  auto est = run_progressive(
+      files, SelectProgressive, {ProgressiveHistogram()}, opts,
+      [&](ProgressiveEstimate const &e) {
+        calls++;
+        REQUIRE(e.blocks_read == calls);
+        REQUIRE(!e.exact);
+        // the uncertainty of a single block is unknown
+        REQUIRE(std::isinf(e.selected.error) == (calls == 1));
+        return true;
+      });
+  REQUIRE(std::filesystem::exists(event_index_path(files[0])));
+
+  REQUIRE(calls == 40);
+  REQUIRE(est.nblocks == 40);
+  REQUIRE(est.blocks_read == 40);
+  REQUIRE(est.nevents == 4000);
+  REQUIRE(est.events_read == 4000);
+  REQUIRE(!est.exact);
+
+  // once every block is read, the estimates are the totals
+  REQUIRE_THAT(est.selected.value, WithinAbs(1800, 1E-8));
+  REQUIRE(est.selected.error == 0);
+  REQUIRE_THAT(est.efficiency.value, WithinAbs(0.45, 1E-12));
+  auto const &h = est.histograms.at(0);
+  REQUIRE(h.entries == 1800);
+  REQUIRE_THAT(h.sumw[1], WithinAbs(600, 1E-8));
+  REQUIRE_THAT(h.sumw[2], WithinAbs(840, 1E-8));
+  REQUIRE_THAT(h.sumw[3], WithinAbs(360, 1E-8));
+  REQUIRE(h.sumw2[1] == 0);
+}
+
+TEST_CASE("run_progressive stops at the requested precision",
+          "[ps::Progressive]") {
+  TestDir dir("progressive_precision");
+  auto files = WriteProgressiveInputs(dir);
+  ProgressiveOptions opts;
+  opts.block_events = 100;
+  opts.seed = 7;
+  opts.precision = 0.05;
+  opts.exact = true;
+
+  size_t sampled = 0;
+  size_t exact = 0;
+  auto est = run_progressive(files, SelectProgressive,
+                             {ProgressiveHistogram()}, opts,
+                             [&](ProgressiveEstimate const &e) {
+                               (e.exact ? exact : sampled)++;
+                               return true;
+                             });
+  REQUIRE(sampled >= opts.min_blocks);
+  REQUIRE(sampled < 40);
+  REQUIRE(exact == 1);
+
+  // the final pass reads every event in order
+  REQUIRE(est.exact);
+  REQUIRE(est.blocks_read == sampled);
+  REQUIRE(est.selected.value == 1800);
+  REQUIRE(est.selected.error == 0);
+  REQUIRE(est.efficiency.value == 0.45);
+  auto const &h = est.histograms.at(0);
+  REQUIRE(h.sumw[1] == 600);
+  REQUIRE(h.sumw[2] == 840);
+  REQUIRE(h.sumw[3] == 360);
+  // with the sums of squared weights, as for any other run
+  REQUIRE(h.sumw2[2] == 840);
+}
+
+TEST_CASE("run_progressive exact histograms match a pass over the inputs",
+          "[ps::Progressive]") {
+  TestDir dir("progressive_exact_hists");
+  auto files = WriteProgressiveInputs(dir);
+  ProgressiveOptions opts;
+  opts.block_events = 100;
+  opts.seed = 7;
+  opts.exact = true;
+  opts.chunk_size = 256;
+  auto const ref =
+      PassHistograms(files, WeightedProgressiveHistogram(), opts.chunk_size);
+
+  std::atomic<size_t> nselect{0};
+  auto counted = [&](HepMC3::GenEvent const &ev) {
+    nselect++;
+    return SelectProgressive(ev);
+  };
+
+  // whether sampling stops early, so that the inputs are read again, or every
+  // block is sampled, and their fills are reused
+  for (double precision : {0.05, 0.0}) {
+    opts.precision = precision;
+    nselect = 0;
+    auto est = run_progressive(files, counted, {WeightedProgressiveHistogram()},
+                               opts);
+    REQUIRE(est.exact);
+    REQUIRE(est.selected.value == 1800);
+    auto const &h = est.histograms.at(0);
+    REQUIRE(h.entries == ref[0].entries);
+    REQUIRE(h.sumw == ref[0].sumw);
+    REQUIRE(h.sumw2 == ref[0].sumw2);
+    if (precision > 0) {
+      REQUIRE(est.blocks_read < 40);
+      REQUIRE(nselect == (est.events_read + 4000));
+    } else {
+      REQUIRE(est.blocks_read == 40);
+      REQUIRE(nselect == 4000);
+    }
+  }
+
+  // every block is sampled, but too many fills to keep them all
+  opts.max_kept_fills = 100;
+  nselect = 0;
+  auto est =
+      run_progressive(files, counted, {WeightedProgressiveHistogram()}, opts);
+  REQUIRE(est.blocks_read == 40);
+  REQUIRE(nselect == 8000);
+  REQUIRE(est.selected.value == 1800);
+  REQUIRE(est.histograms.at(0).sumw == ref[0].sumw);
+  REQUIRE(est.histograms.at(0).sumw2 == ref[0].sumw2);
+}
+
+TEST_CASE("run_progressive never treats an estimate of 0 as precise",
+          "[ps::Progressive]") {
+  TestDir dir("progressive_zero");
+  auto files = WriteProgressiveInputs(dir);
+  ProgressiveOptions opts;
+  opts.block_events = 100;
+  opts.precision = 0.5;
+
+  auto est = run_progressive(
+      files, [](HepMC3::GenEvent const &) { return false; }, {}, opts);
+  REQUIRE(est.blocks_read == 40);
+  REQUIRE(est.selected.value == 0);
+}
+
+TEST_CASE("run_progressive stops when progress returns false",
+          "[ps::Progressive]") {
+  TestDir dir("progressive_callback");
+  auto files = WriteProgressiveInputs(dir);
+  ProgressiveOptions opts;
+  opts.block_events = 100;
+
+  size_t calls = 0;
+  auto est = run_progressive(
+      files, SelectProgressive, {}, opts,
+      [&](ProgressiveEstimate const &) { return ++calls < 3; });
+  REQUIRE(est.blocks_read == 3);
+  REQUIRE(est.events_read == 300);
+  REQUIRE(est.histograms.empty());
+  REQUIRE(std::isfinite(est.selected.error));
+}
+
+TEST_CASE("run_progressive rejects unseekable inputs", "[ps::Progressive]") {
+  TestDir dir("progressive_unseekable");
+  auto path = dir / "events.txt";
+  std::ofstream(path) << "not events\n";
+  REQUIRE_THROWS_AS(run_progressive({path.string()}, SelectProgressive, {},
+                                    ProgressiveOptions()),
+                    std::runtime_error);
+
+  ProgressiveOptions opts;
+  opts.block_events = 0;
+  auto const files = WriteProgressiveInputs(dir);
+  REQUIRE_THROWS_AS(run_progressive(files, SelectProgressive, {}, opts),
+                    std::runtime_error);
+  opts.block_events = 100;
+  opts.chunk_size = 0;
+  REQUIRE_THROWS_AS(run_progressive(files, SelectProgressive, {}, opts),
+                    std::runtime_error);
+}
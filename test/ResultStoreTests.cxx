@@ -0,0 +1,273 @@
+#include "ProSelecta/MultiFileReader.h"
+#include "ProSelecta/ResultStore.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace ps;
+
+void WriteEvents(std::string const &path, size_t nevents, size_t seed) {
+  TestEvents spec;
+  spec.beam_GeV = [=](size_t i) {
+    return 1 + 0.01 * (((i + seed) * 7) % 100);
+  };
+  spec.weights = [](size_t i) {
+    return std::vector<double>{0.5 * ((i % 3) + 1)};
+  };
+  WriteTestEvents(path, nevents, spec);
+}
+
+void WriteText(std::string const &path, std::string const &text) {
+  std::ofstream(path) << text;
+}
+
+double BeamE(HepMC3::GenEvent const &ev) {
+  return event::beam_part(ev, pdg::kNuMu)->momentum().e();
+}
+
+// Counts how many times each hook is called
+struct CountedHooks {
+  std::atomic<size_t> nselect{0};
+  std::atomic<size_t> nproject{0};
+  std::atomic<size_t> nextra{0};
+  std::atomic<size_t> nlow{0};
+
+  NamedHooks hooks(bool extra) {
+    NamedHooks set{EventHooks{[this](HepMC3::GenEvent const &ev) {
+                                nselect++;
+                                return BeamE(ev) > 1.5 * unit::GeV;
+                              },
+                              {[this](HepMC3::GenEvent const &ev) {
+                                nproject++;
+                                return BeamE(ev);
+                              }},
+                              {},
+                              {[this](HepMC3::GenEvent const &ev) {
+                                nlow++;
+                                return BeamE(ev) < 1.2 * unit::GeV;
+                              }}},
+                   "beam_e_cut",
+                   OutputColumns{{"beam_e"}, {}, {"beam_e_low"}}};
+    if (extra) {
+      set.hooks.projections.push_back([this](HepMC3::GenEvent const &ev) {
+        nextra++;
+        return -BeamE(ev);
+      });
+      set.columns.projections.push_back("minus_beam_e");
+    }
+    return set;
+  }
+
+  void reset() { nselect = nproject = nextra = nlow = 0; }
+};
+
+// The results of running set over files without a store
+std::vector<EventResult> Expected(std::vector<std::string> const &files,
+                                  NamedHooks const &set) {
+  std::vector<EventResult> results;
+  MultiFileReader rdr(files);
+  EventLoop(set.hooks, 2, 16).run(rdr, [&](EventBatch const &batch) {
+    results.insert(results.end(), batch.results.begin(), batch.results.end());
+  });
+  return results;
+}
+
+void RequireSame(std::vector<EventResult> const &results,
+                 std::vector<EventResult> const &expected) {
+  REQUIRE(results.size() == expected.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    REQUIRE(results[i].evtnum == expected[i].evtnum);
+    REQUIRE(results[i].pass == expected[i].pass);
+    REQUIRE(results[i].values == expected[i].values);
+    REQUIRE(results[i].selmask == expected[i].selmask);
+  }
+}
+
+TEST_CASE("run_with_store", "[ps::ResultStore]") {
+  TestDir dir("store_run_with_store");
+
+  std::vector<std::string> files;
+  for (size_t f = 0; f < 3; ++f) {
+    files.push_back(dir / ("events" + std::to_string(f) + ".hepmc3"));
+    WriteEvents(files.back(), 200 + 50 * f, f);
+  }
+  size_t const nevents = 750;
+
+  // the snippets that define the hooks, the cuts include a header
+  std::string const cuts = dir / "cuts.cxx", cuts_header = dir / "cuts.h",
+                    projs = dir / "projs.cxx";
+  WriteText(cuts_header, "double const kCut = 1.5;\n");
+  WriteText(cuts, "#include \"cuts.h\"\n"
+                  "int beam_e_cut(HepMC3::GenEvent const &ev) { return 1; }\n"
+                  "int beam_e_low(HepMC3::GenEvent const &ev) { return 1; }\n");
+  std::string const projs_src =
+      "double beam_e(HepMC3::GenEvent const &ev) { return 0; }\n"
+      "double minus_beam_e(HepMC3::GenEvent const &ev) { return 0; }\n";
+  WriteText(projs, projs_src);
+
+  CountedHooks counted;
+  ResultStore store((dir / "store").string());
+  auto run = [&](NamedHooks const &set) {
+    std::vector<EventResult> results;
+    auto res = run_with_store(
+        store, HookSources({cuts, projs}), files, {set},
+        [&](std::vector<EventResult> const &block) {
+          results.insert(results.end(), block.begin(), block.end());
+        },
+        3, 16);
+    REQUIRE(res.inputs.size() == files.size());
+    return std::make_pair(res, results);
+  };
+
+  auto const expected = Expected(files, counted.hooks(false));
+  counted.reset();
+
+  // the first run evaluates every hook
+  auto [first, results] = run(counted.hooks(false));
+  RequireSame(results, expected);
+  REQUIRE(first.events_read == nevents);
+  REQUIRE(first.files_read == files.size());
+  REQUIRE(counted.nselect == nevents);
+  size_t const nselected = counted.nproject;
+  REQUIRE(nselected > 0);
+  REQUIRE(nselected < nevents);
+
+  // the second reads nothing
+  counted.reset();
+  auto [second, stored] = run(counted.hooks(false));
+  RequireSame(stored, expected);
+  REQUIRE(second.events_read == 0);
+  REQUIRE(second.files_read == 0);
+  REQUIRE(counted.nselect == 0);
+  REQUIRE(counted.nproject == 0);
+  for (size_t f = 0; f < files.size(); ++f) {
+    REQUIRE(second.inputs[f].path == files[f]);
+    REQUIRE(second.inputs[f].nevents == first.inputs[f].nevents);
+    REQUIRE(second.inputs[f].sumw == first.inputs[f].sumw);
+  }
+
+  // a new projection is evaluated, with the selection that gates it, but the
+  // stored projection is not
+  auto const expected_extra = Expected(files, counted.hooks(true));
+  counted.reset();
+  auto [third, extended] = run(counted.hooks(true));
+  RequireSame(extended, expected_extra);
+  REQUIRE(third.events_read == nevents);
+  REQUIRE(counted.nselect == nevents);
+  REQUIRE(counted.nproject == 0);
+  REQUIRE(counted.nextra == nselected);
+
+  // a changed input is read again, the others are not
+  WriteEvents(files[1], 100, 7);
+  auto const expected_changed = Expected(files, counted.hooks(true));
+  counted.reset();
+  auto [fourth, changed] = run(counted.hooks(true));
+  RequireSame(changed, expected_changed);
+  REQUIRE(fourth.events_read == 100);
+  REQUIRE(fourth.files_read == 1);
+  REQUIRE(counted.nselect == 100);
+
+  // a changed snippet only invalidates the hooks that it defines, along with
+  // the selection that gates them
+  WriteText(projs, "// edited\n" + projs_src);
+  counted.reset();
+  auto const expected_edited = Expected(files, counted.hooks(false));
+  size_t const nselected_edited = counted.nproject;
+  counted.reset();
+  auto [fifth, edited] = run(counted.hooks(false));
+  RequireSame(edited, expected_edited);
+  REQUIRE(fifth.events_read == 600);
+  REQUIRE(fifth.files_read == files.size());
+  REQUIRE(counted.nselect == 600);
+  REQUIRE(counted.nproject == nselected_edited);
+  REQUIRE(counted.nlow == 0);
+
+  // as does a changed header that a snippet includes
+  WriteText(cuts_header, "double const kCut = 2.5;\n");
+  counted.reset();
+  auto [sixth, reheadered] = run(counted.hooks(false));
+  RequireSame(reheadered, expected_edited);
+  REQUIRE(sixth.events_read == 600);
+  REQUIRE(counted.nselect == 600);
+  REQUIRE(counted.nlow == 600);
+}
+
+TEST_CASE("ResultStore", "[ps::ResultStore]") {
+  TestDir dir("store_columns");
+
+  std::string const input = dir / "events.hepmc3";
+  WriteEvents(input, 10, 0);
+  ResultStore store((dir / "store").string());
+  std::string const hash = store.input_hash(input);
+  REQUIRE(hash == ResultStore::hash_files({input}));
+  REQUIRE(hash == store.input_hash(input));
+  REQUIRE(hash != ResultStore::hash_files({input, input}));
+
+  StoredColumn col{StoredColumn::kValues, 70, {0, 0}, std::vector<double>(70)};
+  col.set(3);
+  col.set(69);
+  col.values[69] = 4.5;
+  // function names are escaped to file names
+  store.save(hash, "sources", "project", "ns::func", col);
+  auto loaded = store.load(hash, "sources", "project", "ns::func");
+  REQUIRE(loaded);
+  REQUIRE(loaded->kind == StoredColumn::kValues);
+  REQUIRE(loaded->nevents == 70);
+  REQUIRE(loaded->bits == col.bits);
+  REQUIRE(loaded->values == col.values);
+  REQUIRE(!store.load(hash, "sources", "weight", "ns::func"));
+  REQUIRE(!store.load(hash, "other", "project", "ns::func"));
+
+  NamedHooks unnamed{EventHooks{}, "", OutputColumns{}};
+  unnamed.hooks.projections.push_back(
+      [](HepMC3::GenEvent const &) { return 1.0; });
+  REQUIRE_THROWS_AS(
+      run_with_store(store, HookSources(std::vector<std::string>{}), {input},
+                     {unnamed}, [](std::vector<EventResult> const &) {}),
+      std::runtime_error);
+}
+
+TEST_CASE("HookSources", "[ps::ResultStore]") {
+  TestDir dir("store_hook_sources");
+
+  std::string const a = dir / "a.cxx", b = dir / "b.cxx";
+  auto const snippets = dir / "snippets";
+  std::filesystem::create_directories(snippets / "inc");
+  WriteText(a, "int sel_a(HepMC3::GenEvent const &ev) { return 1; }\n"
+               "double proj_a(HepMC3::GenEvent const &ev) { return 1; }\n");
+  WriteText(b, "int sel_b(HepMC3::GenEvent const &ev) { return 1; }\n");
+  WriteText(snippets / "c.cxx",
+            "#include \"header.h\"\n"
+            "int sel_a(HepMC3::GenEvent const &ev) { return 0; }\n"
+            "int sel_c(HepMC3::GenEvent const &ev) { return 1; }\n");
+  WriteText(snippets / "inc" / "header.h", "#pragma once\n");
+
+  HookSources sources({a, b}, {snippets.native()},
+                      {(snippets / "inc").native()});
+  // hooks of the same snippet share its hash
+  REQUIRE(sources.hash("sel_a") == sources.hash("proj_a"));
+  REQUIRE(sources.hash("sel_a") != sources.hash("sel_b"));
+  REQUIRE(sources.hash("sel_c") != sources.hash("sel_a"));
+  REQUIRE(sources.hash("sel_c") != sources.hash("sel_b"));
+  // hooks that no snippet defines are hashed with every snippet
+  REQUIRE(sources.hash("unknown") == sources.hash("other"));
+  REQUIRE(sources.hash("unknown") != sources.hash("sel_a"));
+
+  // the files take precedence over the snippet directories, as in the
+  // interpreter, and only the snippet that defines a hook changes its hash
+  WriteText(snippets / "inc" / "header.h", "#pragma once\n// edited\n");
+  HookSources edited({a, b}, {snippets.native()},
+                     {(snippets / "inc").native()});
+  REQUIRE(edited.hash("sel_a") == sources.hash("sel_a"));
+  REQUIRE(edited.hash("sel_b") == sources.hash("sel_b"));
+  REQUIRE(edited.hash("sel_c") != sources.hash("sel_c"));
+  REQUIRE(edited.hash("unknown") != sources.hash("unknown"));
+}
@@ -0,0 +1,124 @@
+#include "ProSelecta/EventCache.h"
+#include "ProSelecta/EventLoop.h"
+#include "ProSelecta/Skim.h"
+#include "ProSelecta/env.h"
+
+#include "test_event_builder.h"
+#include "test_temp_dir.h"
+
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/ReaderAscii.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <filesystem>
+
+using namespace ps;
+
+TEST_CASE("SkimWriter", "[ps::Skim]") {
+  TestDir dir("skim");
+
+  std::string const input_path = (dir / "events.hepmc3");
+  TestEvents spec;
+  spec.beam_GeV = [](size_t i) { return 1 + 0.01 * ((i * 7) % 100); };
+  spec.out = [](size_t) { return std::vector<std::string>{}; };
+  spec.first = 0;
+  spec.weights = [](size_t i) {
+    return std::vector<double>{0.1 * ((i % 13) + 1)};
+  };
+  spec.run = std::make_shared<HepMC3::GenRunInfo>();
+  spec.run->set_weight_names({"CV"});
+  WriteTestEvents(input_path, 300, spec);
+
+  auto energy = [](HepMC3::GenEvent const &ev) {
+    return event::beam_part(ev, pdg::kNuMu)->momentum().e();
+  };
+  EventHooks hooks{[=](HepMC3::GenEvent const &ev) {
+                     return energy(ev) > 1.9 * unit::GeV;
+                   },
+                   {},
+                   {},
+                   {}};
+
+  for (std::string const ext : {".hepmc3", ".pscache"}) {
+    std::string const skim_path = (dir / ("skim" + ext));
+    std::vector<size_t> selected;
+    {
+      HepMC3::ReaderAscii rdr(input_path);
+      SkimWriter skim(deduce_writer(skim_path), {input_path});
+      EventLoop(hooks, 3, 16).run(rdr, [&](EventBatch const &batch) {
+        for (auto const &res : batch.results) {
+          if (res.pass) {
+            selected.push_back(res.evtnum);
+          }
+        }
+        skim.write(batch);
+      });
+      REQUIRE(skim.size() == selected.size());
+    }
+    REQUIRE(selected.size());
+    REQUIRE(selected.size() < 30);
+
+    auto rdr = open_reader(skim_path);
+    HepMC3::GenEvent ev;
+    for (size_t evtnum : selected) {
+      REQUIRE(rdr->read_event(ev));
+      REQUIRE(!rdr->failed());
+      REQUIRE(ev.event_number() == int(evtnum));
+      REQUIRE(energy(ev) > 1.9 * unit::GeV);
+      REQUIRE(ev.weights().front() == 0.1 * ((evtnum % 13) + 1));
+      auto source = ev.attribute<HepMC3::LongAttribute>(
+          SkimWriter::source_event_attribute);
+      REQUIRE(source);
+      REQUIRE(source->value() == long(evtnum));
+    }
+    rdr->read_event(ev);
+    REQUIRE(rdr->failed());
+
+    REQUIRE(rdr->run_info()->weight_names() == spec.run->weight_names());
+    auto sources = rdr->run_info()->attribute<HepMC3::StringAttribute>(
+        SkimWriter::sources_attribute);
+    REQUIRE(sources);
+    REQUIRE(sources->value() == input_path);
+  }
+
+  REQUIRE_THROWS_AS(deduce_writer((dir / "skim.hepmc3").string(), "lhef"),
+                    std::runtime_error);
+}
+
+TEST_CASE("SkimWriter::run_info", "[ps::Skim]") {
+  TestDir dir("skim_run_info");
+
+  // the same weights, from two inputs, each with its own run info
+  std::vector<std::shared_ptr<HepMC3::GenRunInfo>> runs;
+  for (auto const &names : std::vector<std::vector<std::string>>{
+           {"CV", "syst"}, {"CV", "syst"}, {"syst", "CV"}}) {
+    runs.push_back(std::make_shared<HepMC3::GenRunInfo>());
+    runs.back()->set_weight_names(names);
+  }
+  TestEvents spec;
+  spec.weights = [](size_t i) { return std::vector<double>{1, 0.5 * i}; };
+  auto evts = BuildTestEvents(4, spec);
+
+  std::string const skim_path = (dir / "skim.hepmc3");
+  {
+    SkimWriter skim(deduce_writer(skim_path));
+    for (size_t i = 0; i < evts.size(); ++i) {
+      evts[i].set_run_info(runs[i / 2]);
+      skim.write(evts[i], i);
+    }
+    // an input that names its weights differently cannot be skimmed with
+    // the others
+    evts[0].set_run_info(runs[2]);
+    REQUIRE_THROWS_AS(skim.write(evts[0], 4), std::runtime_error);
+  }
+
+  auto rdr = open_reader(skim_path);
+  HepMC3::GenEvent ev;
+  for (size_t i = 0; i < evts.size(); ++i) {
+    REQUIRE(rdr->read_event(ev));
+    REQUIRE(!rdr->failed());
+    REQUIRE(ev.weight("syst") == 0.5 * i);
+  }
+  REQUIRE(rdr->run_info()->weight_names() == runs[0]->weight_names());
+}
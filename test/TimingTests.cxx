@@ -0,0 +1,56 @@
+#include "ProSelecta/Timing.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <string>
+
+using namespace ps;
+
+TEST_CASE("timing::PhaseTimer", "[ps::timing]") {
+  timing::reset();
+  REQUIRE(timing::records().empty());
+
+  { timing::PhaseTimer t("load_file", "a.cxx"); }
+  { timing::PhaseTimer t("load_file", "b.cxx"); }
+  { timing::PhaseTimer t("parse"); }
+
+  auto recs = timing::records();
+  REQUIRE(recs.size() == 3);
+  REQUIRE(recs[0].phase == "load_file");
+  REQUIRE(recs[0].name == "a.cxx");
+  REQUIRE(recs[0].wall_s >= 0);
+  REQUIRE(recs[0].peak_rss_kb > 0);
+  REQUIRE(recs[0].peak_rss_growth_kb >= 0);
+  REQUIRE(recs[0].peak_rss_kb <= timing::peak_rss_kb());
+  REQUIRE(recs[1].name == "b.cxx");
+  REQUIRE(recs[2].phase == "parse");
+  REQUIRE(recs[2].name.empty());
+
+  timing::record({"get_func", "my_select", 0.25, 1, 0});
+  REQUIRE(timing::records().size() == 4);
+
+  timing::reset();
+  REQUIRE(timing::records().empty());
+}
+
+TEST_CASE("timing::summary", "[ps::timing]") {
+  timing::reset();
+  timing::record({"load_file", "a.cxx", 0.5, 100, 10});
+  timing::record({"load_file", "b.cxx", 0.25, 110, 10});
+  timing::record({"get_func", "my_select", 0.125, 110, 0});
+
+  auto const summary = timing::summary();
+  REQUIRE(summary.find("a.cxx") != std::string::npos);
+  REQUIRE(summary.find("my_select") != std::string::npos);
+
+  // each phase is totalled once, after every record
+  auto const totals = summary.find("[ProSelecta timing totals]");
+  REQUIRE(totals != std::string::npos);
+  REQUIRE(summary.find("a.cxx", totals) == std::string::npos);
+  REQUIRE(summary.find("2 x       0.7500 s", totals) != std::string::npos);
+  REQUIRE(summary.find("1 x       0.1250 s", totals) != std::string::npos);
+  REQUIRE(summary.find("final peak rss: ", totals) != std::string::npos);
+
+  timing::reset();
+  REQUIRE(timing::summary().find("load_file") == std::string::npos);
+}
@@ -41,6 +41,31 @@ TEST_CASE("beam_part", "[ps::event]") {
                     event::MoreThanOneBeamPart);
 }
 
+TEST_CASE("try_beam_part", "[ps::event]") {
+
+  auto evt1 = BuildEvent({{"14 4 1", "1000060120 20 0"},
+                          {"14 3 1", "1000060110 1 0", "2112 21 0"},
+                          {"13 1 0.7", "2212 1 0.15"}},
+                         {2, 1});
+
+  REQUIRE(event::try_beam_part(evt1, pdg::kNuMu)->pid() == pdg::kNuMu);
+  REQUIRE(event::try_beam_part(evt1, pdg::kNeutralLeptons)->pid() ==
+          pdg::kNuMu);
+  REQUIRE_FALSE(event::try_beam_part(evt1, pdg::kNuE));
+
+  auto evt2 = BuildEvent({{"14 4 1", "12 4 1", "1000060120 20 0"},
+                          {"14 3 1", "1000060110 1 0", "2112 21 0"},
+                          {"13 1 0.7", "2212 1 0.15"}},
+                         {2, 1});
+
+  REQUIRE(event::try_beam_part(evt2, pdg::kNuE)->pid() == pdg::kNuE);
+  REQUIRE_THROWS_AS(event::try_beam_part(evt2, pdg::kNeutralLeptons),
+                    event::MoreThanOneBeamPart);
+  REQUIRE_THROWS_AS(event::try_beam_part(evt2), event::MoreThanOneBeamPart);
+  REQUIRE_FALSE(event::try_target_part(evt2, 1000070140));
+  REQUIRE(event::try_target_part(evt2)->pid() == 1000060120);
+}
+
 TEST_CASE("target_part", "[ps::event]") {
 
   auto evt1 = BuildEvent({{"14 4 1", "1000060120 20 0"},
@@ -253,6 +278,39 @@ TEST_CASE("hm_out_part", "[ps::event]") {
                WithinAbs(1.3 * ps::unit::GeV, 1E-8));
 }
 
+TEST_CASE("try_hm_out_part", "[ps::event]") {
+
+  auto evt1 = BuildEvent(
+      {{"14 4 3 0", "1000060120 20 0"},
+       {"2212 1 0.15", "2212 1 0.25", "13 1 0.7", "13 1 1.2", "-13 1 1.3"}});
+
+  REQUIRE_THAT(event::try_hm_out_part(evt1, 2212)->momentum().length(),
+               WithinAbs(0.25 * ps::unit::GeV, 1E-8));
+  REQUIRE_FALSE(event::try_hm_out_part(evt1, 211));
+
+  auto [hm_mu, hm_pip] = event::try_hm_out_part(evt1, pids(13, 211));
+  REQUIRE_THAT(hm_mu->momentum().length(),
+               WithinAbs(1.2 * ps::unit::GeV, 1E-8));
+  REQUIRE_FALSE(hm_pip);
+
+  REQUIRE_FALSE(event::try_hm_out_part(evt1, pids(211, -211), ps::flatten));
+}
+
+TEST_CASE("try_signal_process_id", "[ps::event]") {
+
+  auto evt1 = BuildEvent({{"14 4 3 0", "1000060120 20 0"},
+                          {"2212 1 0.15", "13 1 0.7"}});
+
+  REQUIRE_FALSE(event::try_signal_process_id(evt1));
+  REQUIRE_THROWS_AS(event::signal_process_id(evt1), event::NoSignalProcessId);
+
+  evt1.add_attribute("signal_process_id",
+                     std::make_shared<HepMC3::IntAttribute>(200));
+
+  REQUIRE(event::try_signal_process_id(evt1) == 200);
+  REQUIRE(event::signal_process_id(evt1) == 200);
+}
+
 TEST_CASE("out_nuclear_parts", "[ps::event]") {
 
   auto evt1 = BuildEvent(
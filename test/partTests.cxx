@@ -283,6 +283,24 @@ TEST_CASE("highest/lowest p3mod", "[ps::part]") {
                WithinAbs(0.5_GeV_c, 1E-8));
 }
 
+TEST_CASE("try_highest/try_lowest p3mod", "[ps::part]") {
+
+  std::vector<HepMC3::ConstGenParticlePtr> protons{
+      BuildPart("2212 1 1.5"), BuildPart("2212 1 1"), BuildPart("2212 1 0.5")};
+  std::vector<HepMC3::ConstGenParticlePtr> none;
+
+  REQUIRE_THAT(part::try_highest(p3mod, protons)->momentum().length(),
+               WithinAbs(1.5_GeV_c, 1E-8));
+  REQUIRE_THAT(part::try_lowest(p3mod, protons)->momentum().length(),
+               WithinAbs(0.5_GeV_c, 1E-8));
+  REQUIRE_FALSE(part::try_highest(p3mod, none));
+  REQUIRE_FALSE(part::try_lowest(p3mod, none));
+
+  auto hm = part::try_highest(p3mod, std::array{protons, none});
+  REQUIRE_THAT(hm[0]->momentum().length(), WithinAbs(1.5_GeV_c, 1E-8));
+  REQUIRE_FALSE(hm[1]);
+}
+
 TEST_CASE("filter p3mod", "[ps::part]") {
 
   std::vector<HepMC3::ConstGenParticlePtr> protons{
@@ -2,11 +2,19 @@
 
 #include "HepMC3/GenEvent.h"
 #include "HepMC3/GenParticle.h"
+#include "HepMC3/GenRunInfo.h"
 #include "HepMC3/GenVertex.h"
+#include "HepMC3/WriterAscii.h"
 
 #include "TRandom.h"
 
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
 
 double default_mass_GeV(int pid) {
   switch (pid) {
@@ -141,4 +149,86 @@ HepMC3::GenEvent BuildEvent(std::vector<std::vector<std::string>> const &parts,
   }
 
   return evt;
-}
\ No newline at end of file
+}
+// The events of a test sample: event i is a muon neutrino of beam_GeV(i),
+// incident on carbon if target is set, that produces the particles out(i),
+// each given as for BuildPart
+struct TestEvents {
+  std::function<double(size_t)> beam_GeV = [](size_t i) {
+    return 1 + 0.01 * (i % 100);
+  };
+  std::function<std::vector<std::string>(size_t)> out = [](size_t) {
+    return std::vector<std::string>{"13 1 0.7"};
+  };
+  bool target = false;
+  // events are numbered from first, if it is set
+  std::optional<int> first = std::nullopt;
+  // the weights of event i, if set
+  std::function<std::vector<double>(size_t)> weights = nullptr;
+  // set as the run info of every event, and written to files, if set
+  std::shared_ptr<HepMC3::GenRunInfo> run = nullptr;
+  // any further changes to event i
+  std::function<void(HepMC3::GenEvent &, size_t)> finish = nullptr;
+};
+
+HepMC3::GenEvent BuildTestEvent(TestEvents const &spec, size_t i) {
+  std::vector<std::string> in{"14 4 " + std::to_string(spec.beam_GeV(i))};
+  if (spec.target) {
+    in.push_back("1000060120 20 0");
+  }
+  auto ev = BuildEvent({in, spec.out(i)});
+  if (spec.first) {
+    ev.set_event_number(*spec.first + int(i));
+  }
+  if (spec.run) {
+    ev.set_run_info(spec.run);
+  }
+  if (spec.weights) {
+    ev.weights() = spec.weights(i);
+  }
+  if (spec.finish) {
+    spec.finish(ev, i);
+  }
+  return ev;
+}
+
+std::vector<HepMC3::GenEvent> BuildTestEvents(size_t nevents,
+                                              TestEvents const &spec = {}) {
+  std::vector<HepMC3::GenEvent> evts;
+  for (size_t i = 0; i < nevents; ++i) {
+    evts.push_back(BuildTestEvent(spec, i));
+  }
+  return evts;
+}
+
+// Writes nevents events of spec to path as HepMC3 ASCII
+void WriteTestEvents(std::string const &path, size_t nevents,
+                     TestEvents const &spec = {}) {
+  HepMC3::WriterAscii wrtr(path, spec.run);
+  for (size_t i = 0; i < nevents; ++i) {
+    wrtr.write_event(BuildTestEvent(spec, i));
+  }
+  wrtr.close();
+}
+
+// The HepMC3 ASCII of nevents events of spec, to be read from a
+// std::stringstream
+std::string TestEventStream(size_t nevents, TestEvents const &spec = {}) {
+  std::stringstream ss("");
+  HepMC3::WriterAscii wrtr(ss, spec.run);
+  for (size_t i = 0; i < nevents; ++i) {
+    wrtr.write_event(BuildTestEvent(spec, i));
+  }
+  wrtr.close();
+  return ss.str();
+}
+
+// Test events on carbon with a muon and a proton in the final state
+TestEvents MuonProtonEvents() {
+  TestEvents spec;
+  spec.target = true;
+  spec.out = [](size_t) {
+    return std::vector<std::string>{"13 1 0.7", "2212 1 0.15"};
+  };
+  return spec;
+}
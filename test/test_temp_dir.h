@@ -0,0 +1,33 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+// An empty temporary directory for one test case, removed when it goes out of
+// scope. ctest runs every test case in a process of its own, and they may run
+// concurrently, so the directory is named for the test case and the process.
+class TestDir {
+  std::filesystem::path dir;
+
+public:
+  explicit TestDir(std::string const &name)
+      : dir(std::filesystem::temp_directory_path() /
+            ("ps_" + name + "." + std::to_string(::getpid()))) {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+  }
+  TestDir(TestDir const &) = delete;
+  TestDir &operator=(TestDir const &) = delete;
+  ~TestDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+  }
+
+  std::filesystem::path const &path() const { return dir; }
+  std::filesystem::path operator/(std::string const &name) const {
+    return dir / name;
+  }
+};